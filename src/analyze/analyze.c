@@ -40,6 +40,7 @@
 #include "unit-name.h"
 #include "special.h"
 #include "hashmap.h"
+#include "set.h"
 #include "pager.h"
 #include "analyze-verify.h"
 
@@ -100,6 +101,15 @@ struct unit_times {
         usec_t deactivated;
         usec_t deactivating;
         usec_t time;
+        char **after;
+};
+
+struct generator_times {
+        const char *name;
+        usec_t wall;
+        usec_t cpu;
+        int code;
+        int status;
 };
 
 struct host_info {
@@ -185,18 +195,212 @@ static int compare_unit_start(const void *a, const void *b) {
 static void free_unit_times(struct unit_times *t, unsigned n) {
         struct unit_times *p;
 
-        for (p = t; p < t + n; p++)
+        for (p = t; p < t + n; p++) {
                 free(p->name);
+                strv_free(p->after);
+        }
 
         free(t);
 }
 
-static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
-        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+/* How many property requests may be in flight at the same time */
+#define UNIT_TIMES_CALLS_MAX 256
+
+static unsigned unit_times_pending = 0;
+static int unit_times_error = 0;
+
+static int unit_times_check_reply(sd_bus_message *reply) {
+        assert(unit_times_pending > 0);
+        unit_times_pending--;
+
+        if (sd_bus_message_is_method_error(reply, NULL)) {
+                log_error("Failed to get unit property: %s",
+                          bus_error_message(sd_bus_message_get_error(reply), 0));
+                unit_times_error = -EIO;
+                return -EIO;
+        }
+
+        return 0;
+}
+
+static int unit_times_reply_usec(sd_bus *bus, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        int r;
+
+        if (unit_times_check_reply(reply) < 0)
+                return 0;
+
+        assert_cc(sizeof(usec_t) == sizeof(uint64_t));
+
+        r = sd_bus_message_read(reply, "v", "t", userdata);
+        if (r < 0)
+                unit_times_error = bus_log_parse_error(r);
+
+        return 0;
+}
+
+static int unit_times_reply_strv(sd_bus *bus, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        int r;
+
+        if (unit_times_check_reply(reply) < 0)
+                return 0;
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_VARIANT, "as");
+        if (r >= 0)
+                r = sd_bus_message_read_strv(reply, userdata);
+        if (r < 0)
+                unit_times_error = bus_log_parse_error(r);
+
+        return 0;
+}
+
+static int unit_times_get(sd_bus *bus, const char *path, const char *property,
+                          sd_bus_message_handler_t callback, void *userdata) {
+        _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+        int r;
+
+        r = sd_bus_message_new_method_call(
+                        bus,
+                        &m,
+                        "org.freedesktop.systemd1",
+                        path,
+                        "org.freedesktop.DBus.Properties",
+                        "Get");
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_append(m, "ss", "org.freedesktop.systemd1.Unit", property);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_call_async(bus, NULL, m, callback, userdata, 0);
+        if (r < 0) {
+                log_error("Failed to get unit property %s: %s", property, strerror(-r));
+                return r;
+        }
+
+        unit_times_pending++;
+        return 0;
+}
+
+static int acquire_time_data_bulk(sd_bus *bus, bool dependencies, struct unit_times **ret, unsigned *ret_n) {
+        static const struct bus_properties_map unit_times_map[] = {
+                { "InactiveExitTimestampMonotonic",  "t",  NULL, offsetof(struct unit_times, activating)   },
+                { "ActiveEnterTimestampMonotonic",   "t",  NULL, offsetof(struct unit_times, activated)    },
+                { "ActiveExitTimestampMonotonic",    "t",  NULL, offsetof(struct unit_times, deactivating) },
+                { "InactiveEnterTimestampMonotonic", "t",  NULL, offsetof(struct unit_times, deactivated)  },
+                { "After",                           "as", NULL, offsetof(struct unit_times, after)        },
+                {}
+        };
+        _cleanup_bus_message_unref_ sd_bus_message *m = NULL, *reply = NULL;
         _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
-        int r, c = 0;
+        _cleanup_strv_free_ char **properties = NULL;
         struct unit_times *unit_times = NULL;
         size_t size = 0;
+        unsigned n = 0;
+        int r;
+
+        /* Gets the timestamps, and the dependencies if asked for,
+         * of all units in a single call. Returns -EOPNOTSUPP if the
+         * manager is too old for that. */
+
+        properties = strv_new("InactiveExitTimestampMonotonic",
+                              "ActiveEnterTimestampMonotonic",
+                              "ActiveExitTimestampMonotonic",
+                              "InactiveEnterTimestampMonotonic",
+                              dependencies ? "After" : NULL,
+                              NULL);
+        if (!properties)
+                return log_oom();
+
+        r = sd_bus_message_new_method_call(
+                        bus,
+                        &m,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "ListUnitPropertiesByPatterns");
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_append_strv(m, NULL);
+        if (r >= 0)
+                r = sd_bus_message_append_strv(m, NULL);
+        if (r >= 0)
+                r = sd_bus_message_append_strv(m, properties);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_call(bus, m, 0, &error, &reply);
+        if (r < 0) {
+                if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD))
+                        return -EOPNOTSUPP;
+
+                log_error("Failed to list units: %s", bus_error_message(&error, r));
+                return r;
+        }
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(sa{sv})");
+        if (r < 0)
+                goto parse_fail;
+
+        while ((r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_STRUCT, "sa{sv}")) > 0) {
+                struct unit_times *t;
+                const char *id;
+
+                if (!GREEDY_REALLOC0(unit_times, size, n+1)) {
+                        r = log_oom();
+                        goto fail;
+                }
+
+                t = unit_times + n;
+
+                r = sd_bus_message_read(reply, "s", &id);
+                if (r < 0)
+                        goto parse_fail;
+
+                t->name = strdup(id);
+                if (!t->name) {
+                        r = log_oom();
+                        goto fail;
+                }
+
+                n++;
+
+                r = bus_message_map_all_properties(bus, reply, unit_times_map, t);
+                if (r < 0)
+                        goto parse_fail;
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        goto parse_fail;
+        }
+        if (r < 0)
+                goto parse_fail;
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                goto parse_fail;
+
+        *ret = unit_times;
+        *ret_n = n;
+        return 0;
+
+parse_fail:
+        bus_log_parse_error(r);
+fail:
+        if (unit_times)
+                free_unit_times(unit_times, n);
+        return r;
+}
+
+static int acquire_time_data_pipelined(sd_bus *bus, bool dependencies, struct unit_times **ret, unsigned *ret_n) {
+        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ const char **paths = NULL;
+        int r;
+        unsigned i, n = 0;
+        struct unit_times *unit_times = NULL;
+        size_t size = 0, paths_size = 0;
         UnitInfo u;
 
         r = sd_bus_call_method(
@@ -219,37 +423,106 @@ static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
         }
 
         while ((r = bus_parse_unit_info(reply, &u)) > 0) {
-                struct unit_times *t;
+                if (!GREEDY_REALLOC0(unit_times, size, n+1) ||
+                    !GREEDY_REALLOC(paths, paths_size, n+1)) {
+                        r = log_oom();
+                        goto fail;
+                }
 
-                if (!GREEDY_REALLOC(unit_times, size, c+1)) {
+                unit_times[n].name = strdup(u.id);
+                if (unit_times[n].name == NULL) {
                         r = log_oom();
                         goto fail;
                 }
 
-                t = unit_times+c;
-                t->name = NULL;
-
-                assert_cc(sizeof(usec_t) == sizeof(uint64_t));
-
-                if (bus_get_uint64_property(bus, u.unit_path,
-                                            "org.freedesktop.systemd1.Unit",
-                                            "InactiveExitTimestampMonotonic",
-                                            &t->activating) < 0 ||
-                    bus_get_uint64_property(bus, u.unit_path,
-                                            "org.freedesktop.systemd1.Unit",
-                                            "ActiveEnterTimestampMonotonic",
-                                            &t->activated) < 0 ||
-                    bus_get_uint64_property(bus, u.unit_path,
-                                            "org.freedesktop.systemd1.Unit",
-                                            "ActiveExitTimestampMonotonic",
-                                            &t->deactivating) < 0 ||
-                    bus_get_uint64_property(bus, u.unit_path,
-                                            "org.freedesktop.systemd1.Unit",
-                                            "InactiveEnterTimestampMonotonic",
-                                            &t->deactivated) < 0) {
-                        r = -EIO;
+                paths[n++] = u.unit_path;
+        }
+        if (r < 0) {
+                bus_log_parse_error(r);
+                goto fail;
+        }
+
+        /*
+         * Keep a number of property requests in flight, instead of
+         * waiting for the reply to each of them in turn. The
+         * dependencies are fetched along if asked for, so that the
+         * critical chain can be followed without further calls.
+         */
+        unit_times_pending = 0;
+        unit_times_error = 0;
+
+        for (i = 0;;) {
+                while (i < n && unit_times_pending + 5 <= UNIT_TIMES_CALLS_MAX && unit_times_error == 0) {
+                        struct unit_times *t = unit_times + i;
+
+                        r = unit_times_get(bus, paths[i], "InactiveExitTimestampMonotonic",
+                                           unit_times_reply_usec, &t->activating);
+                        if (r >= 0)
+                                r = unit_times_get(bus, paths[i], "ActiveEnterTimestampMonotonic",
+                                                   unit_times_reply_usec, &t->activated);
+                        if (r >= 0)
+                                r = unit_times_get(bus, paths[i], "ActiveExitTimestampMonotonic",
+                                                   unit_times_reply_usec, &t->deactivating);
+                        if (r >= 0)
+                                r = unit_times_get(bus, paths[i], "InactiveEnterTimestampMonotonic",
+                                                   unit_times_reply_usec, &t->deactivated);
+                        if (r >= 0 && dependencies)
+                                r = unit_times_get(bus, paths[i], "After",
+                                                   unit_times_reply_strv, &t->after);
+                        if (r < 0)
+                                goto fail;
+
+                        i++;
+                }
+
+                if (unit_times_pending == 0)
+                        break;
+
+                r = sd_bus_process(bus, NULL);
+                if (r < 0) {
+                        log_error("Failed to process bus: %s", strerror(-r));
+                        goto fail;
+                }
+                if (r > 0)
+                        continue;
+
+                r = sd_bus_wait(bus, (uint64_t) -1);
+                if (r < 0) {
+                        log_error("Failed to wait for bus: %s", strerror(-r));
                         goto fail;
                 }
+        }
+
+        if (unit_times_error < 0) {
+                r = unit_times_error;
+                goto fail;
+        }
+
+        *ret = unit_times;
+        *ret_n = n;
+        return 0;
+
+fail:
+        if (unit_times)
+                free_unit_times(unit_times, n);
+        return r;
+}
+
+static int acquire_time_data(sd_bus *bus, bool dependencies, struct unit_times **out) {
+        struct unit_times *unit_times = NULL;
+        unsigned c = 0, i, n = 0;
+        int r;
+
+        /* Managers that cannot return the properties of all units
+         * at once are asked unit by unit */
+        r = acquire_time_data_bulk(bus, dependencies, &unit_times, &n);
+        if (r == -EOPNOTSUPP)
+                r = acquire_time_data_pipelined(bus, dependencies, &unit_times, &n);
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n; i++) {
+                struct unit_times *t = unit_times + i;
 
                 if (t->activated >= t->activating)
                         t->time = t->activated - t->activating;
@@ -258,28 +531,17 @@ static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
                 else
                         t->time = 0;
 
-                if (t->activating == 0)
+                if (t->activating == 0) {
+                        free(t->name);
+                        strv_free(t->after);
                         continue;
-
-                t->name = strdup(u.id);
-                if (t->name == NULL) {
-                        r = log_oom();
-                        goto fail;
                 }
-                c++;
-        }
-        if (r < 0) {
-                bus_log_parse_error(r);
-                goto fail;
+
+                unit_times[c++] = *t;
         }
 
         *out = unit_times;
         return c;
-
-fail:
-        if (unit_times)
-                free_unit_times(unit_times, (unsigned) c);
-        return r;
 }
 
 static int acquire_boot_times(sd_bus *bus, struct boot_times **bt) {
@@ -510,7 +772,7 @@ static int analyze_plot(sd_bus *bus) {
         if (n < 0)
                 return n;
 
-        n = acquire_time_data(bus, &times);
+        n = acquire_time_data(bus, false, &times);
         if (n <= 0)
                 goto out;
 
@@ -729,13 +991,26 @@ static int list_dependencies_print(const char *name, unsigned int level, unsigne
         return 0;
 }
 
+static Hashmap *unit_times_hashmap;
+
 static int list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps) {
         _cleanup_free_ char *path = NULL;
+        struct unit_times *times;
 
         assert(bus);
         assert(name);
         assert(deps);
 
+        /* acquire_time_data() already got these for all started units */
+        times = hashmap_get(unit_times_hashmap, name);
+        if (times) {
+                *deps = strv_copy(times->after);
+                if (!*deps)
+                        return log_oom();
+
+                return 0;
+        }
+
         path = unit_dbus_path_from_name(name);
         if (path == NULL)
                 return -ENOMEM;
@@ -743,8 +1018,6 @@ static int list_dependencies_get_dependencies(sd_bus *bus, const char *name, cha
         return bus_get_unit_property_strv(bus, path, "After", deps);
 }
 
-static Hashmap *unit_times_hashmap;
-
 static int list_dependencies_compare(const void *_a, const void *_b) {
         const char **a = (const char**) _a, **b = (const char**) _b;
         usec_t usa = 0, usb = 0;
@@ -760,7 +1033,7 @@ static int list_dependencies_compare(const void *_a, const void *_b) {
         return usb - usa;
 }
 
-static int list_dependencies_one(sd_bus *bus, const char *name, unsigned int level, char ***units,
+static int list_dependencies_one(sd_bus *bus, const char *name, unsigned int level, Set *units,
                                  unsigned int branches) {
         _cleanup_strv_free_ char **deps = NULL;
         char **c;
@@ -770,7 +1043,8 @@ static int list_dependencies_one(sd_bus *bus, const char *name, unsigned int lev
         struct unit_times *times;
         struct boot_times *boot;
 
-        if (strv_extend(units, name))
+        r = set_put_strdup(units, name);
+        if (r < 0)
                 return log_oom();
 
         r = list_dependencies_get_dependencies(bus, name, &deps);
@@ -824,7 +1098,7 @@ static int list_dependencies_one(sd_bus *bus, const char *name, unsigned int lev
                 if (r < 0)
                         return r;
 
-                if (strv_contains(*units, *c)) {
+                if (set_contains(units, *c)) {
                         r = list_dependencies_print("...", level + 1, (branches << 1) | (to_print ? 1 : 0),
                                                     true, NULL, boot);
                         if (r < 0)
@@ -844,7 +1118,7 @@ static int list_dependencies_one(sd_bus *bus, const char *name, unsigned int lev
 }
 
 static int list_dependencies(sd_bus *bus, const char *name) {
-        _cleanup_strv_free_ char **units = NULL;
+        _cleanup_set_free_free_ Set *units = NULL;
         char ts[FORMAT_TIMESPAN_MAX];
         struct unit_times *times;
         int r;
@@ -894,7 +1168,11 @@ static int list_dependencies(sd_bus *bus, const char *name) {
                         printf("%s\n", id);
         }
 
-        return list_dependencies_one(bus, name, 0, &units, 0);
+        units = set_new(&string_hash_ops);
+        if (!units)
+                return log_oom();
+
+        return list_dependencies_one(bus, name, 0, units, 0);
 }
 
 static int analyze_critical_chain(sd_bus *bus, char *names[]) {
@@ -903,7 +1181,7 @@ static int analyze_critical_chain(sd_bus *bus, char *names[]) {
         Hashmap *h;
         int n, r;
 
-        n = acquire_time_data(bus, &times);
+        n = acquire_time_data(bus, true, &times);
         if (n <= 0)
                 return n;
 
@@ -940,7 +1218,7 @@ static int analyze_blame(sd_bus *bus) {
         unsigned i;
         int n;
 
-        n = acquire_time_data(bus, &times);
+        n = acquire_time_data(bus, false, &times);
         if (n <= 0)
                 return n;
 
@@ -959,6 +1237,122 @@ static int analyze_blame(sd_bus *bus) {
         return 0;
 }
 
+static int compare_generator_time(const void *a, const void *b) {
+        return compare(((struct generator_times *)b)->wall,
+                       ((struct generator_times *)a)->wall);
+}
+
+static int analyze_generators(sd_bus *bus) {
+        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ struct generator_times *times = NULL;
+        size_t allocated = 0;
+        unsigned n = 0, i;
+        const char *name;
+        uint64_t wall, user, system;
+        int32_t code, status;
+        int r;
+
+        r = sd_bus_get_property(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "GeneratorTimings",
+                        &error,
+                        &reply,
+                        "a(stttii)");
+        if (r < 0) {
+                log_error("Failed to get generator timings: %s", bus_error_message(&error, -r));
+                return r;
+        }
+
+        r = sd_bus_message_enter_container(reply, 'a', "(stttii)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_read(reply, "(stttii)", &name, &wall, &user, &system, &code, &status)) > 0) {
+                if (!GREEDY_REALLOC(times, allocated, n + 1))
+                        return log_oom();
+
+                times[n].name = name;
+                times[n].wall = wall;
+                times[n].cpu = user + system;
+                times[n].code = code;
+                times[n].status = status;
+                n++;
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        qsort_safe(times, n, sizeof(struct generator_times), compare_generator_time);
+
+        pager_open_if_enabled();
+
+        if (n > 0)
+                printf("%16s %16s %s\n", "WALL", "CPU", "GENERATOR");
+
+        for (i = 0; i < n; i++) {
+                char ts[FORMAT_TIMESPAN_MAX], ts2[FORMAT_TIMESPAN_MAX];
+
+                printf("%16s %16s %s",
+                       format_timespan(ts, sizeof(ts), times[i].wall, USEC_PER_MSEC),
+                       format_timespan(ts2, sizeof(ts2), times[i].cpu, USEC_PER_MSEC),
+                       times[i].name);
+
+                if (times[i].code == CLD_EXITED && times[i].status != 0)
+                        printf(" (failed with error code %i)", times[i].status);
+                else if (times[i].code != CLD_EXITED)
+                        printf(" (terminated by signal %s)", strna(signal_to_string(times[i].status)));
+
+                printf("\n");
+        }
+
+        return 0;
+}
+
+static void print_reload_time(sd_bus *bus) {
+        char ts[FORMAT_TIMESPAN_MAX];
+        uint64_t start = 0, finish = 0;
+        uint32_t hits = 0, misses = 0;
+
+        /* Older managers do not expose these, hence stay quiet on failure */
+        if (sd_bus_get_property_trivial(bus,
+                                        "org.freedesktop.systemd1",
+                                        "/org/freedesktop/systemd1",
+                                        "org.freedesktop.systemd1.Manager",
+                                        "ReloadStartTimestampMonotonic",
+                                        NULL, 't', &start) < 0 ||
+            sd_bus_get_property_trivial(bus,
+                                        "org.freedesktop.systemd1",
+                                        "/org/freedesktop/systemd1",
+                                        "org.freedesktop.systemd1.Manager",
+                                        "ReloadFinishTimestampMonotonic",
+                                        NULL, 't', &finish) < 0)
+                return;
+
+        /* Never reloaded, or a reload is in progress */
+        if (finish <= 0 || finish < start)
+                return;
+
+        sd_bus_get_property_trivial(bus,
+                                    "org.freedesktop.systemd1",
+                                    "/org/freedesktop/systemd1",
+                                    "org.freedesktop.systemd1.Manager",
+                                    "UnitFileCacheHits",
+                                    NULL, 'u', &hits);
+        sd_bus_get_property_trivial(bus,
+                                    "org.freedesktop.systemd1",
+                                    "/org/freedesktop/systemd1",
+                                    "org.freedesktop.systemd1.Manager",
+                                    "UnitFileCacheMisses",
+                                    NULL, 'u', &misses);
+
+        printf("Last reload took %s (unit file cache: %u hits, %u misses)\n",
+               format_timespan(ts, sizeof(ts), finish - start, USEC_PER_MSEC),
+               hits, misses);
+}
+
 static int analyze_time(sd_bus *bus) {
         _cleanup_free_ char *buf = NULL;
         int r;
@@ -968,6 +1362,8 @@ static int analyze_time(sd_bus *bus) {
                 return r;
 
         puts(buf);
+
+        print_reload_time(bus);
         return 0;
 }
 
@@ -1209,6 +1605,7 @@ static void help(void) {
                "  time                    Print time spent in the kernel before reaching userspace\n"
                "  blame                   Print list of running units ordered by time to init\n"
                "  critical-chain          Print a tree of the time critical chain of units\n"
+               "  generators              Print list of generators ordered by run time\n"
                "  plot                    Output SVG graphic showing service initialization\n"
                "  dot                     Output dependency graph in dot(1) format\n"
                "  set-log-level LEVEL     Set logging threshold for systemd\n"
@@ -1370,6 +1767,8 @@ int main(int argc, char *argv[]) {
                         r = analyze_time(bus);
                 else if (streq(argv[optind], "blame"))
                         r = analyze_blame(bus);
+                else if (streq(argv[optind], "generators"))
+                        r = analyze_generators(bus);
                 else if (streq(argv[optind], "critical-chain"))
                         r = analyze_critical_chain(bus, argv+optind+1);
                 else if (streq(argv[optind], "plot"))
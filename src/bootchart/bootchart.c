@@ -74,6 +74,7 @@ int sysfd=-1;
 
 #define DEFAULT_SAMPLES_LEN 500
 #define DEFAULT_HZ 25.0
+#define DEFAULT_FILTER_THRESHOLD 0.001
 #define DEFAULT_SCALE_X 100.0 /* 100px = 1sec */
 #define DEFAULT_SCALE_Y 20.0  /* 16px = 1 process bar */
 #define DEFAULT_INIT "/sbin/init"
@@ -84,12 +85,14 @@ bool arg_entropy = false;
 bool initcall = true;
 bool arg_relative = false;
 bool arg_filter = true;
+double arg_filter_threshold = DEFAULT_FILTER_THRESHOLD;
 bool arg_show_cmdline = false;
 bool arg_show_cgroup = false;
 bool arg_pss = false;
 int samples;
 int arg_samples_len = DEFAULT_SAMPLES_LEN; /* we record len+1 (1 start sample) */
 double arg_hz = DEFAULT_HZ;
+Collector arg_collector = COLLECTOR_PROC;
 double arg_scale_x = DEFAULT_SCALE_X;
 double arg_scale_y = DEFAULT_SCALE_Y;
 static struct list_sample_data *sampledata;
@@ -98,6 +101,15 @@ struct list_sample_data *head;
 char arg_init_path[PATH_MAX] = DEFAULT_INIT;
 char arg_output_path[PATH_MAX] = DEFAULT_OUTPUT;
 
+static const char* const collector_table[_COLLECTOR_MAX] = {
+        [COLLECTOR_PROC] = "proc",
+        [COLLECTOR_NETLINK] = "netlink",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(collector, Collector);
+
+static DEFINE_CONFIG_PARSE_ENUM(config_parse_collector, collector, Collector, "Failed to parse collector setting");
+
 static void signal_handler(int sig) {
         if (sig++)
                 sig--;
@@ -111,17 +123,19 @@ static void signal_handler(int sig) {
 static void parse_conf(void) {
         char *init = NULL, *output = NULL;
         const ConfigTableItem items[] = {
-                { "Bootchart", "Samples",          config_parse_int,    0, &arg_samples_len },
-                { "Bootchart", "Frequency",        config_parse_double, 0, &arg_hz          },
-                { "Bootchart", "Relative",         config_parse_bool,   0, &arg_relative    },
-                { "Bootchart", "Filter",           config_parse_bool,   0, &arg_filter      },
-                { "Bootchart", "Output",           config_parse_path,   0, &output          },
-                { "Bootchart", "Init",             config_parse_path,   0, &init            },
-                { "Bootchart", "PlotMemoryUsage",  config_parse_bool,   0, &arg_pss         },
-                { "Bootchart", "PlotEntropyGraph", config_parse_bool,   0, &arg_entropy     },
-                { "Bootchart", "ScaleX",           config_parse_double, 0, &arg_scale_x     },
-                { "Bootchart", "ScaleY",           config_parse_double, 0, &arg_scale_y     },
-                { "Bootchart", "ControlGroup",     config_parse_bool,   0, &arg_show_cgroup },
+                { "Bootchart", "Samples",          config_parse_int,       0, &arg_samples_len      },
+                { "Bootchart", "Frequency",        config_parse_double,    0, &arg_hz               },
+                { "Bootchart", "Relative",         config_parse_bool,      0, &arg_relative         },
+                { "Bootchart", "Filter",           config_parse_bool,      0, &arg_filter           },
+                { "Bootchart", "FilterThreshold",  config_parse_double,    0, &arg_filter_threshold },
+                { "Bootchart", "Output",           config_parse_path,      0, &output               },
+                { "Bootchart", "Init",             config_parse_path,      0, &init                 },
+                { "Bootchart", "PlotMemoryUsage",  config_parse_bool,      0, &arg_pss              },
+                { "Bootchart", "PlotEntropyGraph", config_parse_bool,      0, &arg_entropy          },
+                { "Bootchart", "ScaleX",           config_parse_double,    0, &arg_scale_x          },
+                { "Bootchart", "ScaleY",           config_parse_double,    0, &arg_scale_y          },
+                { "Bootchart", "ControlGroup",     config_parse_bool,      0, &arg_show_cgroup      },
+                { "Bootchart", "Collector",        config_parse_collector, 0, &arg_collector        },
                 { NULL, NULL, NULL, 0, NULL }
         };
 
@@ -150,8 +164,11 @@ static void help(void) {
                 "  -o, --output=PATH     Path to output files [%s]\n"
                 "  -i, --init=PATH       Path to init executable [%s]\n"
                 "  -F, --no-filter       Disable filtering of unimportant or ephemeral processes\n"
+                "     --filter-threshold=SEC\n"
+                "                        Filter processes that used less CPU time [%g]\n"
                 "  -C, --cmdline         Display full command lines with arguments\n"
                 "  -c, --control-group   Display process control group\n"
+                "     --collector=NAME   How to find processes: proc or netlink [%s]\n"
                 "  -h, --help            Display this message\n\n"
                 "See bootchart.conf for more information.\n",
                 program_invocation_short_name,
@@ -160,10 +177,17 @@ static void help(void) {
                 DEFAULT_SCALE_X,
                 DEFAULT_SCALE_Y,
                 DEFAULT_OUTPUT,
-                DEFAULT_INIT);
+                DEFAULT_INIT,
+                DEFAULT_FILTER_THRESHOLD,
+                collector_to_string(COLLECTOR_PROC));
 }
 
 static int parse_argv(int argc, char *argv[]) {
+        enum {
+                ARG_COLLECTOR = 0x100,
+                ARG_FILTER_THRESHOLD,
+        };
+
         static const struct option options[] = {
                 {"rel",           no_argument,        NULL,  'r'},
                 {"freq",          required_argument,  NULL,  'f'},
@@ -172,12 +196,14 @@ static int parse_argv(int argc, char *argv[]) {
                 {"output",        required_argument,  NULL,  'o'},
                 {"init",          required_argument,  NULL,  'i'},
                 {"no-filter",     no_argument,        NULL,  'F'},
+                {"filter-threshold", required_argument, NULL, ARG_FILTER_THRESHOLD},
                 {"cmdline",       no_argument,        NULL,  'C'},
                 {"control-group", no_argument,        NULL,  'c'},
                 {"help",          no_argument,        NULL,  'h'},
                 {"scale-x",       required_argument,  NULL,  'x'},
                 {"scale-y",       required_argument,  NULL,  'y'},
                 {"entropy",       no_argument,        NULL,  'e'},
+                {"collector",     required_argument,  NULL,  ARG_COLLECTOR},
                 {}
         };
         int c, r;
@@ -200,6 +226,12 @@ static int parse_argv(int argc, char *argv[]) {
                 case 'F':
                         arg_filter = false;
                         break;
+                case ARG_FILTER_THRESHOLD:
+                        r = safe_atod(optarg, &arg_filter_threshold);
+                        if (r < 0)
+                                log_warning("failed to parse --filter-threshold argument '%s': %s",
+                                            optarg, strerror(-r));
+                        break;
                 case 'C':
                         arg_show_cmdline = true;
                         break;
@@ -238,6 +270,16 @@ static int parse_argv(int argc, char *argv[]) {
                 case 'e':
                         arg_entropy = true;
                         break;
+                case ARG_COLLECTOR: {
+                        Collector collector;
+
+                        collector = collector_from_string(optarg);
+                        if (collector < 0)
+                                log_warning("failed to parse --collector argument '%s'", optarg);
+                        else
+                                arg_collector = collector;
+                        break;
+                }
                 case 'h':
                         help();
                         return 0;
@@ -446,16 +488,7 @@ int main(int argc, char *argv[]) {
         }
 
         /* do some cleanup, close fd's */
-        ps = ps_first;
-        while (ps->next_ps) {
-                ps = ps->next_ps;
-                if (ps->schedstat)
-                        close(ps->schedstat);
-                if (ps->sched)
-                        close(ps->sched);
-                if (ps->smaps)
-                        fclose(ps->smaps);
-        }
+        log_sample_done();
 
         if (!of) {
                 t = time(NULL);
@@ -27,10 +27,21 @@
 #include <dirent.h>
 #include <stdbool.h>
 #include "list.h"
+#include "macro.h"
 
 #define MAXCPUS        16
 #define MAXPIDS     65535
 
+typedef enum Collector {
+        COLLECTOR_PROC,
+        COLLECTOR_NETLINK,
+        _COLLECTOR_MAX,
+        _COLLECTOR_INVALID = -1
+} Collector;
+
+const char* collector_to_string(Collector c) _const_;
+Collector collector_from_string(const char *s) _pure_;
+
 struct block_stat_struct {
         /* /proc/vmstat pgpgin & pgpgout */
         int bi;
@@ -84,6 +95,11 @@ struct ps_struct {
         int schedstat;
         FILE *smaps;
 
+        /* the sample we last looked at this process in, and whether
+         * it is known to be gone */
+        int last_sample;
+        bool exited;
+
         /* pointers to first/last seen timestamps */
         struct ps_sched_struct *first;
         struct ps_sched_struct *last;
@@ -114,6 +130,7 @@ extern struct block_stat_struct blockstat[];
 extern int pscount;
 extern bool arg_relative;
 extern bool arg_filter;
+extern double arg_filter_threshold;
 extern bool arg_show_cmdline;
 extern bool arg_show_cgroup;
 extern bool arg_pss;
@@ -123,6 +140,7 @@ extern int samples;
 extern int cpus;
 extern int arg_samples_len;
 extern double arg_hz;
+extern Collector arg_collector;
 extern double arg_scale_x;
 extern double arg_scale_y;
 extern int overrun;
@@ -32,6 +32,10 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <time.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 
 #include "util.h"
 #include "time-util.h"
@@ -39,6 +43,9 @@
 #include "store.h"
 #include "bootchart.h"
 #include "cgroup-util.h"
+#include "hashmap.h"
+#include "set.h"
+#include "socket-util.h"
 
 /*
  * Alloc a static 4k buffer for stdio - primarily used to increase
@@ -50,6 +57,15 @@ static int skip = 0;
 DIR *proc;
 int procfd = -1;
 
+/* pid -> struct ps_struct, and the end of the ps_first list */
+static Hashmap *ps_by_pid = NULL;
+static struct ps_struct *ps_last = NULL;
+
+/* proc connector socket, and the processes created since the last
+ * sample, for the netlink collector */
+static int events_fd = -1;
+static Set *events_new = NULL;
+
 double gettime_ns(void) {
         struct timespec n;
 
@@ -109,6 +125,434 @@ static int pid_cmdline_strscpy(char *buffer, size_t buf_len, int pid) {
         return 0;
 }
 
+static void ps_close(struct ps_struct *ps) {
+        if (ps->schedstat > 0)
+                close(ps->schedstat);
+        ps->schedstat = 0;
+
+        if (ps->sched > 0)
+                close(ps->sched);
+        ps->sched = 0;
+
+        if (ps->smaps)
+                fclose(ps->smaps);
+        ps->smaps = NULL;
+}
+
+static int events_open(void) {
+        union sockaddr_union sa = {
+                .nl.nl_family = AF_NETLINK,
+                .nl.nl_groups = CN_IDX_PROC,
+        };
+        uint8_t buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] _alignas_(struct nlmsghdr) = {};
+        struct nlmsghdr *nl = (struct nlmsghdr*) buf;
+        struct cn_msg *cn = NLMSG_DATA(nl);
+        _cleanup_close_ int fd = -1;
+
+        fd = socket(PF_NETLINK, SOCK_DGRAM|SOCK_CLOEXEC|SOCK_NONBLOCK, NETLINK_CONNECTOR);
+        if (fd < 0)
+                return -errno;
+
+        if (bind(fd, &sa.sa, sizeof(sa.nl)) < 0)
+                return -errno;
+
+        /* ask the kernel to send us fork and exit notifications */
+        nl->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+        nl->nlmsg_type = NLMSG_DONE;
+        cn->id.idx = CN_IDX_PROC;
+        cn->id.val = CN_VAL_PROC;
+        cn->len = sizeof(enum proc_cn_mcast_op);
+        *(enum proc_cn_mcast_op*) cn->data = PROC_CN_MCAST_LISTEN;
+
+        if (send(fd, buf, nl->nlmsg_len, 0) < 0)
+                return -errno;
+
+        events_new = set_new(&trivial_hash_ops);
+        if (!events_new)
+                return -ENOMEM;
+
+        events_fd = fd;
+        fd = -1;
+
+        return 0;
+}
+
+/* Returns > 0 if notifications were lost and /proc needs to be
+ * scanned again */
+static int events_read(void) {
+        bool lost = false;
+
+        for (;;) {
+                union {
+                        struct nlmsghdr nl;
+                        uint8_t buf[16384];
+                } msg;
+                union sockaddr_union sa;
+                socklen_t salen = sizeof(sa.nl);
+                struct nlmsghdr *nl;
+                ssize_t n;
+
+                n = recvfrom(events_fd, &msg, sizeof(msg), 0, &sa.sa, &salen);
+                if (n < 0) {
+                        if (errno == EAGAIN)
+                                break;
+                        if (errno == EINTR)
+                                continue;
+                        if (errno == ENOBUFS) {
+                                /* the socket overflowed */
+                                lost = true;
+                                continue;
+                        }
+
+                        return -errno;
+                }
+
+                /* only listen to the kernel */
+                if (sa.nl.nl_pid != 0)
+                        continue;
+
+                for (nl = &msg.nl; NLMSG_OK(nl, n); nl = NLMSG_NEXT(nl, n)) {
+                        struct cn_msg *cn = NLMSG_DATA(nl);
+                        struct proc_event *ev;
+
+                        if (nl->nlmsg_type != NLMSG_DONE)
+                                continue;
+
+                        if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+                                continue;
+
+                        ev = (struct proc_event*) cn->data;
+
+                        /* we only care about processes, not threads */
+                        if (ev->what == PROC_EVENT_FORK &&
+                            ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid) {
+                                int r;
+
+                                r = set_put(events_new, INT_TO_PTR(ev->event_data.fork.child_tgid));
+                                if (r < 0 && r != -EEXIST)
+                                        return r;
+
+                        } else if (ev->what == PROC_EVENT_EXIT &&
+                                   ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid) {
+                                struct ps_struct *ps;
+
+                                /* A process that is still in events_new
+                                 * is sampled once nonetheless, while
+                                 * it is a zombie, like a scan would */
+                                ps = hashmap_get(ps_by_pid, INT_TO_PTR(ev->event_data.exit.process_tgid));
+                                if (ps) {
+                                        ps->exited = true;
+                                        ps_close(ps);
+                                }
+                        }
+                }
+        }
+
+        return lost;
+}
+
+static void sample_pid(int pid, struct list_sample_data *sampledata,
+                       struct ps_sched_struct **ps_prev, char *rt, char *wt) {
+        char filename[PATH_MAX];
+        char buf[4096];
+        char key[256];
+        struct ps_struct *ps;
+        char *m;
+        int mod;
+        ssize_t s;
+        int fd;
+        int p;
+
+        if (pid >= MAXPIDS)
+                return;
+
+        ps = hashmap_get(ps_by_pid, INT_TO_PTR(pid));
+        if (ps) {
+                /* already sampled this time around */
+                if (ps->last_sample == samples)
+                        return;
+
+                ps->last_sample = samples;
+                ps->exited = false;
+        } else {
+                /* not known yet? then append a new record */
+                _cleanup_fclose_ FILE *st = NULL;
+                char t[32];
+                struct ps_struct *parent;
+                int r;
+
+                if (!ps_last)
+                        ps_last = ps_first;
+
+                ps = new0(struct ps_struct, 1);
+                if (!ps) {
+                        log_oom();
+                        exit (EXIT_FAILURE);
+                }
+                ps->pid = pid;
+                ps->last_sample = samples;
+
+                if (hashmap_ensure_allocated(&ps_by_pid, &trivial_hash_ops) < 0 ||
+                    hashmap_put(ps_by_pid, INT_TO_PTR(pid), ps) < 0) {
+                        log_oom();
+                        exit (EXIT_FAILURE);
+                }
+
+                ps_last->next_ps = ps;
+                ps_last = ps;
+
+                ps->sample = new0(struct ps_sched_struct, 1);
+                if (!ps->sample) {
+                        log_oom();
+                        exit (EXIT_FAILURE);
+                }
+                ps->sample->sampledata = sampledata;
+
+                pscount++;
+
+                /* mark our first sample */
+                ps->first = ps->last = ps->sample;
+                ps->sample->runtime = atoll(rt);
+                ps->sample->waittime = atoll(wt);
+
+                /* get name, start time */
+                if (!ps->sched) {
+                        sprintf(filename, "%d/sched", pid);
+                        ps->sched = openat(procfd, filename, O_RDONLY);
+                        if (ps->sched == -1)
+                                return;
+                }
+
+                s = pread(ps->sched, buf, sizeof(buf) - 1, 0);
+                if (s <= 0) {
+                        close(ps->sched);
+                        ps->sched = 0;
+                        return;
+                }
+                buf[s] = '\0';
+
+                if (!sscanf(buf, "%s %*s %*s", key))
+                        return;
+
+                strscpy(ps->name, sizeof(ps->name), key);
+
+                /* cmdline */
+                if (arg_show_cmdline)
+                        pid_cmdline_strscpy(ps->name, sizeof(ps->name), pid);
+
+                /* discard line 2 */
+                m = bufgetline(buf);
+                if (!m)
+                        return;
+
+                m = bufgetline(m);
+                if (!m)
+                        return;
+
+                if (!sscanf(m, "%*s %*s %s", t))
+                        return;
+
+                r = safe_atod(t, &ps->starttime);
+                if (r < 0)
+                        return;
+
+                ps->starttime /= 1000.0;
+
+                if (arg_show_cgroup)
+                        /* if this fails, that's OK */
+                        cg_pid_get_path(SYSTEMD_CGROUP_CONTROLLER,
+                                        ps->pid, &ps->cgroup);
+
+                /* ppid */
+                sprintf(filename, "%d/stat", pid);
+                fd = openat(procfd, filename, O_RDONLY);
+                st = fdopen(fd, "r");
+                if (!st)
+                        return;
+                if (!fscanf(st, "%*s %*s %*s %i", &p)) {
+                        return;
+                }
+                ps->ppid = p;
+
+                /*
+                 * setup child pointers
+                 *
+                 * these are used to paint the tree coherently later
+                 * each parent has a LL of children, and a LL of siblings
+                 */
+                if (pid == 1)
+                        return; /* nothing to do for init atm */
+
+                /* kthreadd has ppid=0, which breaks our tree ordering */
+                if (ps->ppid == 0)
+                        ps->ppid = 1;
+
+                parent = hashmap_get(ps_by_pid, INT_TO_PTR(ps->ppid));
+                if (!parent) {
+                        /* orphan */
+                        ps->ppid = 1;
+                        parent = ps_first->next_ps;
+                }
+
+                ps->parent = parent;
+
+                if (!parent->children) {
+                        /* it's the first child */
+                        parent->children = ps;
+                } else {
+                        /* walk all children and append */
+                        struct ps_struct *children;
+                        children = parent->children;
+                        while (children->next)
+                                children = children->next;
+                        children->next = ps;
+                }
+        }
+
+        /* else -> found pid, append data in ps */
+
+        /* below here is all continuous logging parts - we get here on every
+         * iteration */
+
+        /* rt, wt */
+        if (!ps->schedstat) {
+                sprintf(filename, "%d/schedstat", pid);
+                ps->schedstat = openat(procfd, filename, O_RDONLY);
+                if (ps->schedstat == -1)
+                        return;
+        }
+        s = pread(ps->schedstat, buf, sizeof(buf) - 1, 0);
+        if (s <= 0) {
+                /* clean up our file descriptors - assume that the process exited */
+                ps_close(ps);
+                ps->exited = true;
+                return;
+        }
+        buf[s] = '\0';
+
+        if (!sscanf(buf, "%s %s %*s", rt, wt))
+                return;
+
+        ps->sample->next = new0(struct ps_sched_struct, 1);
+        if (!ps->sample->next) {
+                log_oom();
+                exit(EXIT_FAILURE);
+        }
+        ps->sample->next->prev = ps->sample;
+        ps->sample = ps->sample->next;
+        ps->last = ps->sample;
+        ps->sample->runtime = atoll(rt);
+        ps->sample->waittime = atoll(wt);
+        ps->sample->sampledata = sampledata;
+        ps->sample->ps_new = ps;
+        if (*ps_prev) {
+                (*ps_prev)->cross = ps->sample;
+        }
+        *ps_prev = ps->sample;
+        ps->total = (ps->last->runtime - ps->first->runtime)
+                    / 1000000000.0;
+
+        if (!arg_pss)
+                goto catch_rename;
+
+        /* Pss */
+        if (!ps->smaps) {
+                sprintf(filename, "%d/smaps", pid);
+                fd = openat(procfd, filename, O_RDONLY);
+                ps->smaps = fdopen(fd, "r");
+                if (!ps->smaps)
+                        return;
+                setvbuf(ps->smaps, smaps_buf, _IOFBF, sizeof(smaps_buf));
+        }
+        else {
+                rewind(ps->smaps);
+        }
+        /* test to see if we need to skip another field */
+        if (skip == 0) {
+                if (fgets(buf, sizeof(buf), ps->smaps) == NULL) {
+                        return;
+                }
+                if (fread(buf, 1, 28 * 15, ps->smaps) != (28 * 15)) {
+                        return;
+                }
+                if (buf[392] == 'V') {
+                        skip = 2;
+                }
+                else {
+                        skip = 1;
+                }
+                rewind(ps->smaps);
+        }
+        while (1) {
+                int pss_kb;
+
+                /* skip one line, this contains the object mapped. */
+                if (fgets(buf, sizeof(buf), ps->smaps) == NULL) {
+                        break;
+                }
+                /* then there's a 28 char 14 line block */
+                if (fread(buf, 1, 28 * 14, ps->smaps) != 28 * 14) {
+                        break;
+                }
+                pss_kb = atoi(&buf[61]);
+                ps->sample->pss += pss_kb;
+
+                /* skip one more line if this is a newer kernel */
+                if (skip == 2) {
+                       if (fgets(buf, sizeof(buf), ps->smaps) == NULL)
+                               break;
+                }
+        }
+        if (ps->sample->pss > ps->pss_max)
+                ps->pss_max = ps->sample->pss;
+
+catch_rename:
+        /* catch process rename, try to randomize time */
+        mod = (arg_hz < 4.0) ? 4.0 : (arg_hz / 4.0);
+        if (((samples - ps->pid) + pid) % (int)(mod) == 0) {
+
+                /* re-fetch name */
+                /* get name, start time */
+                if (!ps->sched) {
+                        sprintf(filename, "%d/sched", pid);
+                        ps->sched = openat(procfd, filename, O_RDONLY);
+                        if (ps->sched == -1)
+                                return;
+                }
+                s = pread(ps->sched, buf, sizeof(buf) - 1, 0);
+                if (s <= 0) {
+                        /* clean up file descriptors */
+                        ps_close(ps);
+                        ps->exited = true;
+                        return;
+                }
+                buf[s] = '\0';
+
+                if (!sscanf(buf, "%s %*s %*s", key))
+                        return;
+
+                strscpy(ps->name, sizeof(ps->name), key);
+
+                /* cmdline */
+                if (arg_show_cmdline)
+                        pid_cmdline_strscpy(ps->name, sizeof(ps->name), pid);
+        }
+}
+
+static void scan_proc(struct list_sample_data *sampledata,
+                      struct ps_sched_struct **ps_prev, char *rt, char *wt) {
+        struct dirent *ent;
+
+        rewinddir(proc);
+
+        while ((ent = readdir(proc)) != NULL) {
+                if ((ent->d_name[0] < '0') || (ent->d_name[0] > '9'))
+                        continue;
+
+                sample_pid(atoi(ent->d_name), sampledata, ps_prev, rt, wt);
+        }
+}
+
 void log_sample(int sample, struct list_sample_data **ptr) {
         static int vmstat;
         static int schedstat;
@@ -119,15 +563,11 @@ void log_sample(int sample, struct list_sample_data **ptr) {
         char wt[256];
         char *m;
         int c;
-        int p;
-        int mod;
         static int e_fd;
-        ssize_t s;
         ssize_t n;
-        struct dirent *ent;
-        int fd;
         struct list_sample_data *sampledata;
         struct ps_sched_struct *ps_prev = NULL;
+        bool scan = true;
 
         sampledata = *ptr;
 
@@ -138,8 +578,6 @@ void log_sample(int sample, struct list_sample_data **ptr) {
                 if (!proc)
                         return;
                 procfd = dirfd(proc);
-        } else {
-                rewinddir(proc);
         }
 
         if (!vmstat) {
@@ -228,284 +666,78 @@ schedstat_next:
                 }
         }
 
-        while ((ent = readdir(proc)) != NULL) {
-                char filename[PATH_MAX];
-                int pid;
-                struct ps_struct *ps;
-
-                if ((ent->d_name[0] < '0') || (ent->d_name[0] > '9'))
-                        continue;
-
-                pid = atoi(ent->d_name);
-
-                if (pid >= MAXPIDS)
-                        continue;
-
-                ps = ps_first;
-                while (ps->next_ps) {
-                        ps = ps->next_ps;
-                        if (ps->pid == pid)
-                                break;
-                }
-
-                /* end of our LL? then append a new record */
-                if (ps->pid != pid) {
-                        _cleanup_fclose_ FILE *st = NULL;
-                        char t[32];
-                        struct ps_struct *parent;
-                        int r;
-
-                        ps->next_ps = new0(struct ps_struct, 1);
-                        if (!ps->next_ps) {
-                                log_oom();
-                                exit (EXIT_FAILURE);
-                        }
-                        ps = ps->next_ps;
-                        ps->pid = pid;
-
-                        ps->sample = new0(struct ps_sched_struct, 1);
-                        if (!ps->sample) {
-                                log_oom();
-                                exit (EXIT_FAILURE);
-                        }
-                        ps->sample->sampledata = sampledata;
-
-                        pscount++;
-
-                        /* mark our first sample */
-                        ps->first = ps->last = ps->sample;
-                        ps->sample->runtime = atoll(rt);
-                        ps->sample->waittime = atoll(wt);
-
-                        /* get name, start time */
-                        if (!ps->sched) {
-                                sprintf(filename, "%d/sched", pid);
-                                ps->sched = openat(procfd, filename, O_RDONLY);
-                                if (ps->sched == -1)
-                                        continue;
-                        }
-
-                        s = pread(ps->sched, buf, sizeof(buf) - 1, 0);
-                        if (s <= 0) {
-                                close(ps->sched);
-                                continue;
-                        }
-                        buf[s] = '\0';
-
-                        if (!sscanf(buf, "%s %*s %*s", key))
-                                continue;
-
-                        strscpy(ps->name, sizeof(ps->name), key);
-
-                        /* cmdline */
-                        if (arg_show_cmdline)
-                                pid_cmdline_strscpy(ps->name, sizeof(ps->name), pid);
-
-                        /* discard line 2 */
-                        m = bufgetline(buf);
-                        if (!m)
-                                continue;
-
-                        m = bufgetline(m);
-                        if (!m)
-                                continue;
-
-                        if (!sscanf(m, "%*s %*s %s", t))
-                                continue;
-
-                        r = safe_atod(t, &ps->starttime);
-                        if (r < 0)
-                                continue;
-
-                        ps->starttime /= 1000.0;
-
-                        if (arg_show_cgroup)
-                                /* if this fails, that's OK */
-                                cg_pid_get_path(SYSTEMD_CGROUP_CONTROLLER,
-                                                ps->pid, &ps->cgroup);
-
-                        /* ppid */
-                        sprintf(filename, "%d/stat", pid);
-                        fd = openat(procfd, filename, O_RDONLY);
-                        st = fdopen(fd, "r");
-                        if (!st)
-                                continue;
-                        if (!fscanf(st, "%*s %*s %*s %i", &p)) {
-                                continue;
-                        }
-                        ps->ppid = p;
-
-                        /*
-                         * setup child pointers
-                         *
-                         * these are used to paint the tree coherently later
-                         * each parent has a LL of children, and a LL of siblings
-                         */
-                        if (pid == 1)
-                                continue; /* nothing to do for init atm */
-
-                        /* kthreadd has ppid=0, which breaks our tree ordering */
-                        if (ps->ppid == 0)
-                                ps->ppid = 1;
-
-                        parent = ps_first;
-                        while ((parent->next_ps && parent->pid != ps->ppid))
-                                parent = parent->next_ps;
-
-                        if (parent->pid != ps->ppid) {
-                                /* orphan */
-                                ps->ppid = 1;
-                                parent = ps_first->next_ps;
-                        }
+        if (arg_collector == COLLECTOR_NETLINK) {
+                int r;
 
-                        ps->parent = parent;
-
-                        if (!parent->children) {
-                                /* it's the first child */
-                                parent->children = ps;
-                        } else {
-                                /* walk all children and append */
-                                struct ps_struct *children;
-                                children = parent->children;
-                                while (children->next)
-                                        children = children->next;
-                                children->next = ps;
+                /*
+                 * Instead of walking /proc on every sample, follow
+                 * process creation and exit, and only look at the
+                 * processes we know to be alive. /proc is scanned
+                 * once initially, after subscribing, so that
+                 * nothing is missed, and again whenever the kernel
+                 * dropped notifications on us.
+                 */
+                if (events_fd < 0) {
+                        r = events_open();
+                        if (r < 0) {
+                                log_warning("Failed to subscribe to process events, scanning /proc instead: %s",
+                                            strerror(-r));
+                                arg_collector = COLLECTOR_PROC;
                         }
+                } else {
+                        r = events_read();
+                        if (r < 0) {
+                                log_warning("Failed to read process events, scanning /proc instead: %s",
+                                            strerror(-r));
+                                events_fd = safe_close(events_fd);
+                                arg_collector = COLLECTOR_PROC;
+                        } else
+                                scan = r > 0;
                 }
+        }
 
-                /* else -> found pid, append data in ps */
+        if (scan) {
+                scan_proc(sampledata, &ps_prev, rt, wt);
 
-                /* below here is all continuous logging parts - we get here on every
-                 * iteration */
+                if (arg_collector == COLLECTOR_NETLINK) {
+                        struct ps_struct *ps;
+                        Iterator i;
 
-                /* rt, wt */
-                if (!ps->schedstat) {
-                        sprintf(filename, "%d/schedstat", pid);
-                        ps->schedstat = openat(procfd, filename, O_RDONLY);
-                        if (ps->schedstat == -1)
-                                continue;
+                        /* whatever was not found is gone */
+                        HASHMAP_FOREACH(ps, ps_by_pid, i)
+                                if (ps->last_sample != samples) {
+                                        ps->exited = true;
+                                        ps_close(ps);
+                                }
                 }
-                s = pread(ps->schedstat, buf, sizeof(buf) - 1, 0);
-                if (s <= 0) {
-                        /* clean up our file descriptors - assume that the process exited */
-                        close(ps->schedstat);
-                        if (ps->sched)
-                                close(ps->sched);
-                        //if (ps->smaps)
-                        //        fclose(ps->smaps);
-                        continue;
-                }
-                buf[s] = '\0';
+        } else {
+                struct ps_struct *ps;
+                Iterator i;
+                void *pid;
 
-                if (!sscanf(buf, "%s %s %*s", rt, wt))
-                        continue;
+                for (ps = ps_first->next_ps; ps; ps = ps->next_ps)
+                        if (!ps->exited)
+                                sample_pid(ps->pid, sampledata, &ps_prev, rt, wt);
 
-                ps->sample->next = new0(struct ps_sched_struct, 1);
-                if (!ps->sample->next) {
-                        log_oom();
-                        exit(EXIT_FAILURE);
-                }
-                ps->sample->next->prev = ps->sample;
-                ps->sample = ps->sample->next;
-                ps->last = ps->sample;
-                ps->sample->runtime = atoll(rt);
-                ps->sample->waittime = atoll(wt);
-                ps->sample->sampledata = sampledata;
-                ps->sample->ps_new = ps;
-                if (ps_prev) {
-                        ps_prev->cross = ps->sample;
-                }
-                ps_prev = ps->sample;
-                ps->total = (ps->last->runtime - ps->first->runtime)
-                            / 1000000000.0;
-
-                if (!arg_pss)
-                        goto catch_rename;
-
-                /* Pss */
-                if (!ps->smaps) {
-                        sprintf(filename, "%d/smaps", pid);
-                        fd = openat(procfd, filename, O_RDONLY);
-                        ps->smaps = fdopen(fd, "r");
-                        if (!ps->smaps)
-                                continue;
-                        setvbuf(ps->smaps, smaps_buf, _IOFBF, sizeof(smaps_buf));
-                }
-                else {
-                        rewind(ps->smaps);
-                }
-                /* test to see if we need to skip another field */
-                if (skip == 0) {
-                        if (fgets(buf, sizeof(buf), ps->smaps) == NULL) {
-                                continue;
-                        }
-                        if (fread(buf, 1, 28 * 15, ps->smaps) != (28 * 15)) {
-                                continue;
-                        }
-                        if (buf[392] == 'V') {
-                                skip = 2;
-                        }
-                        else {
-                                skip = 1;
-                        }
-                        rewind(ps->smaps);
-                }
-                while (1) {
-                        int pss_kb;
+                SET_FOREACH(pid, events_new, i)
+                        sample_pid(PTR_TO_INT(pid), sampledata, &ps_prev, rt, wt);
+        }
 
-                        /* skip one line, this contains the object mapped. */
-                        if (fgets(buf, sizeof(buf), ps->smaps) == NULL) {
-                                break;
-                        }
-                        /* then there's a 28 char 14 line block */
-                        if (fread(buf, 1, 28 * 14, ps->smaps) != 28 * 14) {
-                                break;
-                        }
-                        pss_kb = atoi(&buf[61]);
-                        ps->sample->pss += pss_kb;
+        if (events_new)
+                set_clear(events_new);
+}
 
-                        /* skip one more line if this is a newer kernel */
-                        if (skip == 2) {
-                               if (fgets(buf, sizeof(buf), ps->smaps) == NULL)
-                                       break;
-                        }
-                }
-                if (ps->sample->pss > ps->pss_max)
-                        ps->pss_max = ps->sample->pss;
+void log_sample_done(void) {
+        struct ps_struct *ps;
 
-catch_rename:
-                /* catch process rename, try to randomize time */
-                mod = (arg_hz < 4.0) ? 4.0 : (arg_hz / 4.0);
-                if (((samples - ps->pid) + pid) % (int)(mod) == 0) {
-
-                        /* re-fetch name */
-                        /* get name, start time */
-                        if (!ps->sched) {
-                                sprintf(filename, "%d/sched", pid);
-                                ps->sched = openat(procfd, filename, O_RDONLY);
-                                if (ps->sched == -1)
-                                        continue;
-                        }
-                        s = pread(ps->sched, buf, sizeof(buf) - 1, 0);
-                        if (s <= 0) {
-                                /* clean up file descriptors */
-                                close(ps->sched);
-                                if (ps->schedstat)
-                                        close(ps->schedstat);
-                                //if (ps->smaps)
-                                //        fclose(ps->smaps);
-                                continue;
-                        }
-                        buf[s] = '\0';
+        for (ps = ps_first->next_ps; ps; ps = ps->next_ps)
+                ps_close(ps);
 
-                        if (!sscanf(buf, "%s %*s %*s", key))
-                                continue;
+        hashmap_free(ps_by_pid);
+        ps_by_pid = NULL;
 
-                        strscpy(ps->name, sizeof(ps->name), key);
+        set_free(events_new);
+        events_new = NULL;
 
-                        /* cmdline */
-                        if (arg_show_cmdline)
-                                pid_cmdline_strscpy(ps->name, sizeof(ps->name), pid);
-                }
-        }
+        events_fd = safe_close(events_fd);
 }
@@ -33,3 +33,4 @@ extern int procfd;
 double gettime_ns(void);
 void log_uptime(void);
 void log_sample(int sample, struct list_sample_data **ptr);
+void log_sample_done(void);
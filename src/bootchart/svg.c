@@ -45,9 +45,7 @@
 #define kb_to_graph(m) ((m) * arg_scale_y * 0.0001)
 #define to_color(n) (192.0 - ((n) * 192.0))
 
-static char str[8092];
-
-#define svg(a...) do { snprintf(str, 8092, ## a); fputs(str, of); fflush(of); } while (0)
+#define svg(a...) fprintf(of, ## a)
 
 static const char * const colorwheel[12] = {
         "rgb(255,32,32)",  // red
@@ -895,7 +893,7 @@ static bool ps_filter(struct ps_struct *ps) {
                 return false;
 
         /* drop stuff that doesn't use any real CPU time */
-        if (ps->total <= 0.001)
+        if (ps->total <= arg_filter_threshold)
                 return true;
 
         return 0;
@@ -989,6 +987,43 @@ static void svg_do_initcall(int count_only) {
         }
 }
 
+/* Adjacent samples of a process with the same load, drawn as one block */
+struct ps_run {
+        double start;
+        double end;
+        double prt;
+        double wrt;
+};
+
+/* Loads that come out at the same height in the graph can be merged */
+static double load_round(double load) {
+        double steps;
+
+        steps = MAX(ps_to_graph(1.0), 1.0);
+
+        return (int) (load * steps + 0.5) / steps;
+}
+
+static void svg_ps_run(struct ps_run *run, int j) {
+        if (run->end <= run->start)
+                return;
+
+        svg("    <rect class=\"wait\" x=\"%.03f\" y=\"%.03f\" width=\"%.03f\" height=\"%.03f\" />\n",
+            time_to_graph(run->start - graph_start),
+            ps_to_graph(j),
+            time_to_graph(run->end - run->start),
+            ps_to_graph(run->wrt));
+
+        /* draw cpu over wait - TODO figure out how/why run + wait > interval */
+        svg("    <rect class=\"cpu\" x=\"%.03f\" y=\"%.03f\" width=\"%.03f\" height=\"%.03f\" />\n",
+            time_to_graph(run->start - graph_start),
+            ps_to_graph(j + (1.0 - run->prt)),
+            time_to_graph(run->end - run->start),
+            ps_to_graph(run->prt));
+
+        run->start = run->end = 0.0;
+}
+
 static void svg_ps_bars(void) {
         struct ps_struct *ps;
         int i = 0;
@@ -1007,9 +1042,10 @@ static void svg_ps_bars(void) {
         ps = ps_first;
         while ((ps = get_next_ps(ps))) {
                 _cleanup_free_ char *enc_name = NULL;
+                struct ps_sched_struct *sample, *prev;
+                struct ps_run run;
                 double endtime;
                 double starttime;
-                int t;
 
                 enc_name = xml_comment_encode(ps->name);
                 if (!enc_name)
@@ -1048,22 +1084,24 @@ static void svg_ps_bars(void) {
                     ps_to_graph(1));
 
                 /* paint cpu load over these */
-                ps->sample = ps->first;
-                t = 1;
-                while (ps->sample->next) {
+                zero(run);
+                prev = ps->first;
+                for (sample = ps->first->next; sample; sample = sample->next) {
                         double rt, prt;
                         double wt, wrt;
-                        struct ps_sched_struct *prev;
+                        double dt;
 
-                        prev = ps->sample;
-                        ps->sample = ps->sample->next;
+                        /* collect samples until they make up at least a pixel */
+                        dt = sample->sampledata->sampletime - prev->sampledata->sampletime;
+                        if (dt <= 0.0 || (time_to_graph(dt) < 1.0 && sample->next))
+                                continue;
 
                         /* calculate over interval */
-                        rt = ps->sample->runtime - prev->runtime;
-                        wt = ps->sample->waittime - prev->waittime;
+                        rt = sample->runtime - prev->runtime;
+                        wt = sample->waittime - prev->waittime;
 
-                        prt = (rt / 1000000000) / (ps->sample->sampledata->sampletime - prev->sampledata->sampletime);
-                        wrt = (wt / 1000000000) / (ps->sample->sampledata->sampletime - prev->sampledata->sampletime);
+                        prt = (rt / 1000000000) / dt;
+                        wrt = (wt / 1000000000) / dt;
 
                         /* this can happen if timekeeping isn't accurate enough */
                         if (prt > 1.0)
@@ -1071,23 +1109,27 @@ static void svg_ps_bars(void) {
                         if (wrt > 1.0)
                                 wrt = 1.0;
 
-                        if ((prt < 0.1) && (wrt < 0.1)) /* =~ 26 (color threshold) */
+                        if ((prt < 0.1) && (wrt < 0.1)) { /* =~ 26 (color threshold) */
+                                svg_ps_run(&run, j);
+                                prev = sample;
                                 continue;
+                        }
+
+                        prt = load_round(prt);
+                        wrt = load_round(wrt);
 
-                        svg("    <rect class=\"wait\" x=\"%.03f\" y=\"%.03f\" width=\"%.03f\" height=\"%.03f\" />\n",
-                            time_to_graph(prev->sampledata->sampletime - graph_start),
-                            ps_to_graph(j),
-                            time_to_graph(ps->sample->sampledata->sampletime - prev->sampledata->sampletime),
-                            ps_to_graph(wrt));
-
-                        /* draw cpu over wait - TODO figure out how/why run + wait > interval */
-                        svg("    <rect class=\"cpu\" x=\"%.03f\" y=\"%.03f\" width=\"%.03f\" height=\"%.03f\" />\n",
-                            time_to_graph(prev->sampledata->sampletime - graph_start),
-                            ps_to_graph(j + (1.0 - prt)),
-                            time_to_graph(ps->sample->sampledata->sampletime - prev->sampledata->sampletime),
-                            ps_to_graph(prt));
-                        t++;
+                        /* extend the current block while the load looks the same */
+                        if (run.end <= run.start || run.prt != prt || run.wrt != wrt) {
+                                svg_ps_run(&run, j);
+                                run.start = prev->sampledata->sampletime;
+                                run.prt = prt;
+                                run.wrt = wrt;
+                        }
+                        run.end = sample->sampledata->sampletime;
+
+                        prev = sample;
                 }
+                svg_ps_run(&run, j);
 
                 /* determine where to display the process name */
                 if ((endtime - starttime) < 1.5)
@@ -1253,7 +1295,9 @@ static void svg_top_ten_pss(void) {
 void svg_do(const char *build) {
         struct ps_struct *ps;
 
-        memzero(&str, sizeof(str));
+        /* the graph easily consists of millions of elements, write
+         * them out in large chunks */
+        setvbuf(of, NULL, _IOFBF, 256 * 1024);
 
         ps = ps_first;
 
@@ -1328,4 +1372,6 @@ void svg_do(const char *build) {
 
         /* svg footer */
         svg("\n</svg>\n");
+
+        fflush(of);
 }
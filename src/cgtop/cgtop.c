@@ -27,6 +27,9 @@
 #include <unistd.h>
 #include <alloca.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/resource.h>
 
 #include "path-util.h"
 #include "util.h"
@@ -35,9 +38,41 @@
 #include "build.h"
 #include "fileio.h"
 
+/* The hierarchies we look at. The number of tasks is determined in
+ * all of them, the other values in the one of the controller in
+ * question. */
+enum {
+        CONTROLLER_SYSTEMD,
+        CONTROLLER_CPUACCT,
+        CONTROLLER_MEMORY,
+        CONTROLLER_BLKIO,
+        _CONTROLLER_MAX
+};
+
+static const char* const controller_table[_CONTROLLER_MAX] = {
+        [CONTROLLER_SYSTEMD] = "name=systemd",
+        [CONTROLLER_CPUACCT] = "cpuacct",
+        [CONTROLLER_MEMORY] = "memory",
+        [CONTROLLER_BLKIO] = "blkio",
+};
+
+static const char* const attribute_table[_CONTROLLER_MAX] = {
+        [CONTROLLER_CPUACCT] = "cpuacct.usage",
+        [CONTROLLER_MEMORY] = "memory.usage_in_bytes",
+        [CONTROLLER_BLKIO] = "blkio.io_service_bytes",
+};
+
 typedef struct Group {
         char *path;
 
+        /* The iteration this group was last seen in */
+        unsigned iteration;
+
+        /* The files we read, kept open across iterations, so that
+         * they only need to be read again */
+        int procs_fd[_CONTROLLER_MAX];
+        int attribute_fd[_CONTROLLER_MAX];
+
         bool n_tasks_valid:1;
         bool cpu_valid:1;
         bool memory_valid:1;
@@ -60,7 +95,10 @@ typedef struct Group {
 
 static unsigned arg_depth = 3;
 static unsigned arg_iterations = 0;
+static bool arg_iterations_set = false;
 static bool arg_batch = false;
+static bool arg_raw = false;
+static bool arg_tasks = true;
 static usec_t arg_delay = 1*USEC_PER_SEC;
 
 static enum {
@@ -76,9 +114,36 @@ static enum {
         CPU_TIME,
 } arg_cpu_type = CPU_PERCENT;
 
+/* Buffer the files are read into, reused for all of them */
+static char *read_buffer = NULL;
+static size_t read_buffer_allocated = 0;
+
+/* How many of the files we keep open. Beyond the limit they are
+ * opened for each read, so that we never run out of fds, whatever
+ * the number of cgroups. Some fds are left for walking the
+ * hierarchies. */
+#define FDS_RESERVED 128U
+#define FDS_CACHED_MAX 16384U
+static unsigned n_cached_fds = 0;
+static unsigned max_cached_fds = 0;
+
 static void group_free(Group *g) {
+        unsigned i;
+
         assert(g);
 
+        for (i = 0; i < _CONTROLLER_MAX; i++) {
+                if (g->procs_fd[i] >= 0) {
+                        safe_close(g->procs_fd[i]);
+                        n_cached_fds--;
+                }
+
+                if (g->attribute_fd[i] >= 0) {
+                        safe_close(g->attribute_fd[i]);
+                        n_cached_fds--;
+                }
+        }
+
         free(g->path);
         free(g);
 }
@@ -95,81 +160,152 @@ static void group_hashmap_free(Hashmap *h) {
         hashmap_free(h);
 }
 
-static int process(const char *controller, const char *path, Hashmap *a, Hashmap *b, unsigned iteration) {
+static int read_attribute(int *fd, int dfd, const char *name, size_t *ret_size) {
+        bool reopened = false;
+        size_t n = 0;
+
+        assert(fd);
+        assert(name);
+
+        /* Reads the whole file into the buffer. If we have it open
+         * already, it is just read again from the start. If that
+         * fails, the cgroup might have been removed and created
+         * again, hence try once more with the file opened anew. A
+         * file opened here is kept open only while we are below the
+         * limit. */
+
+        for (;;) {
+                ssize_t k;
+
+                if (*fd < 0) {
+                        *fd = openat(dfd, name, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+                        if (*fd < 0)
+                                return -errno;
+
+                        reopened = true;
+                }
+
+                if (!GREEDY_REALLOC(read_buffer, read_buffer_allocated, MAX(n + 4096, 4096U) + 1)) {
+                        /* Not counted yet */
+                        if (reopened)
+                                *fd = safe_close(*fd);
+
+                        return -ENOMEM;
+                }
+
+                k = pread(*fd, read_buffer + n, read_buffer_allocated - n - 1, n);
+                if (k < 0) {
+                        int r = -errno;
+
+                        if (r == -EINTR)
+                                continue;
+
+                        *fd = safe_close(*fd);
+
+                        if (reopened)
+                                return r;
+
+                        n_cached_fds--;
+                        n = 0;
+                        continue;
+                }
+
+                if (k == 0)
+                        break;
+
+                n += k;
+        }
+
+        if (reopened) {
+                if (n_cached_fds < max_cached_fds)
+                        n_cached_fds++;
+                else
+                        *fd = safe_close(*fd);
+        }
+
+        read_buffer[n] = 0;
+
+        if (ret_size)
+                *ret_size = n;
+
+        return 0;
+}
+
+static int process(unsigned controller, int dfd, const char *path, Hashmap *a, unsigned iteration) {
         Group *g;
         int r;
-        FILE *f = NULL;
-        pid_t pid;
-        unsigned n;
 
-        assert(controller);
+        assert(controller < _CONTROLLER_MAX);
         assert(path);
         assert(a);
 
         g = hashmap_get(a, path);
         if (!g) {
-                g = hashmap_get(b, path);
-                if (!g) {
-                        g = new0(Group, 1);
-                        if (!g)
-                                return -ENOMEM;
-
-                        g->path = strdup(path);
-                        if (!g->path) {
-                                group_free(g);
-                                return -ENOMEM;
-                        }
+                unsigned i;
 
-                        r = hashmap_put(a, g->path, g);
-                        if (r < 0) {
-                                group_free(g);
-                                return r;
-                        }
-                } else {
-                        r = hashmap_move_one(a, b, path);
-                        if (r < 0)
-                                return r;
-                        g->cpu_valid = g->memory_valid = g->io_valid = g->n_tasks_valid = false;
+                g = new0(Group, 1);
+                if (!g)
+                        return -ENOMEM;
+
+                for (i = 0; i < _CONTROLLER_MAX; i++)
+                        g->procs_fd[i] = g->attribute_fd[i] = -1;
+
+                g->path = strdup(path);
+                if (!g->path) {
+                        group_free(g);
+                        return -ENOMEM;
+                }
+
+                r = hashmap_put(a, g->path, g);
+                if (r < 0) {
+                        group_free(g);
+                        return r;
                 }
         }
 
+        if (g->iteration != iteration) {
+                g->cpu_valid = g->memory_valid = g->io_valid = g->n_tasks_valid = false;
+                g->iteration = iteration;
+        }
+
         /* Regardless which controller, let's find the maximum number
-         * of processes in any of it */
+         * of processes in any of it. This is the most expensive
+         * part, hence it may be turned off. */
 
-        r = cg_enumerate_processes(controller, path, &f);
-        if (r < 0)
-                return r;
+        if (arg_tasks) {
+                size_t size;
+                unsigned n;
+                char *p;
 
-        n = 0;
-        while (cg_read_pid(f, &pid) > 0)
-                n++;
-        fclose(f);
+                r = read_attribute(&g->procs_fd[controller], dfd, "cgroup.procs", &size);
+                if (r < 0)
+                        return r;
 
-        if (n > 0) {
-                if (g->n_tasks_valid)
-                        g->n_tasks = MAX(g->n_tasks, n);
-                else
-                        g->n_tasks = n;
+                for (n = 0, p = read_buffer; (p = memchr(p, '\n', size - (p - read_buffer))); p++)
+                        n++;
+
+                if (n > 0) {
+                        if (g->n_tasks_valid)
+                                g->n_tasks = MAX(g->n_tasks, n);
+                        else
+                                g->n_tasks = n;
 
-                g->n_tasks_valid = true;
+                        g->n_tasks_valid = true;
+                }
         }
 
-        if (streq(controller, "cpuacct")) {
-                uint64_t new_usage;
-                char *p, *v;
-                struct timespec ts;
+        if (!attribute_table[controller])
+                return 0;
 
-                r = cg_get_path(controller, path, "cpuacct.usage", &p);
-                if (r < 0)
-                        return r;
+        r = read_attribute(&g->attribute_fd[controller], dfd, attribute_table[controller], NULL);
+        if (r < 0)
+                return r;
 
-                r = read_one_line_file(p, &v);
-                free(p);
-                if (r < 0)
-                        return r;
+        if (controller == CONTROLLER_CPUACCT) {
+                uint64_t new_usage;
+                struct timespec ts;
 
-                r = safe_atou64(v, &new_usage);
-                free(v);
+                r = safe_atou64(strstrip(read_buffer), &new_usage);
                 if (r < 0)
                         return r;
 
@@ -193,49 +329,28 @@ static int process(const char *controller, const char *path, Hashmap *a, Hashmap
                 g->cpu_timestamp = ts;
                 g->cpu_iteration = iteration;
 
-        } else if (streq(controller, "memory")) {
-                char *p, *v;
-
-                r = cg_get_path(controller, path, "memory.usage_in_bytes", &p);
-                if (r < 0)
-                        return r;
-
-                r = read_one_line_file(p, &v);
-                free(p);
-                if (r < 0)
-                        return r;
+        } else if (controller == CONTROLLER_MEMORY) {
 
-                r = safe_atou64(v, &g->memory);
-                free(v);
+                r = safe_atou64(strstrip(read_buffer), &g->memory);
                 if (r < 0)
                         return r;
 
                 if (g->memory > 0)
                         g->memory_valid = true;
 
-        } else if (streq(controller, "blkio")) {
-                char *p;
+        } else if (controller == CONTROLLER_BLKIO) {
                 uint64_t wr = 0, rd = 0;
                 struct timespec ts;
+                char *l, *next;
 
-                r = cg_get_path(controller, path, "blkio.io_service_bytes", &p);
-                if (r < 0)
-                        return r;
-
-                f = fopen(p, "re");
-                free(p);
-
-                if (!f)
-                        return -errno;
-
-                for (;;) {
-                        char line[LINE_MAX], *l;
+                for (l = read_buffer; l; l = next) {
                         uint64_t k, *q;
 
-                        if (!fgets(line, sizeof(line), f))
-                                break;
+                        next = strchr(l, '\n');
+                        if (next)
+                                *(next++) = 0;
 
-                        l = strstrip(line);
+                        l = strstrip(l);
                         l += strcspn(l, WHITESPACE);
                         l += strspn(l, WHITESPACE);
 
@@ -256,8 +371,6 @@ static int process(const char *controller, const char *path, Hashmap *a, Hashmap
                         *q += k;
                 }
 
-                fclose(f);
-
                 assert_se(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
 
                 if (g->io_iteration == iteration - 1) {
@@ -287,88 +400,107 @@ static int process(const char *controller, const char *path, Hashmap *a, Hashmap
 }
 
 static int refresh_one(
-                const char *controller,
+                unsigned controller,
+                int dfd,
                 const char *path,
                 Hashmap *a,
-                Hashmap *b,
                 unsigned iteration,
                 unsigned depth) {
 
-        DIR *d = NULL;
-        int r;
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        int fd, r;
 
-        assert(controller);
         assert(path);
         assert(a);
 
         if (depth > arg_depth)
                 return 0;
 
-        r = process(controller, path, a, b, iteration);
+        r = process(controller, dfd, path, a, iteration);
         if (r < 0)
                 return r;
 
-        r = cg_enumerate_subgroups(controller, path, &d);
-        if (r < 0) {
-                if (r == -ENOENT)
-                        return 0;
+        /* Subgroups are looked at relative to their parent */
+        fd = openat(dfd, ".", O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY);
+        if (fd < 0)
+                return errno == ENOENT ? 0 : -errno;
 
-                return r;
+        d = fdopendir(fd);
+        if (!d) {
+                safe_close(fd);
+                return -errno;
         }
 
-        for (;;) {
-                char *fn, *p;
+        FOREACH_DIRENT(de, d, return -errno) {
+                _cleanup_close_ int cfd = -1;
+                _cleanup_free_ char *p = NULL;
 
-                r = cg_read_subgroup(d, &fn);
-                if (r <= 0)
-                        goto finish;
+                if (de->d_type != DT_DIR)
+                        continue;
 
-                p = strjoin(path, "/", fn, NULL);
-                free(fn);
+                if (streq(de->d_name, ".") ||
+                    streq(de->d_name, ".."))
+                        continue;
 
-                if (!p) {
-                        r = -ENOMEM;
-                        goto finish;
+                cfd = openat(dirfd(d), de->d_name, O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY|O_NOFOLLOW);
+                if (cfd < 0) {
+                        if (errno == ENOENT)
+                                continue;
+
+                        return -errno;
                 }
 
-                path_kill_slashes(p);
+                p = strjoin(path, "/", de->d_name, NULL);
+                if (!p)
+                        return -ENOMEM;
 
-                r = refresh_one(controller, p, a, b, iteration, depth + 1);
-                free(p);
+                path_kill_slashes(p);
 
-                if (r < 0)
-                        goto finish;
+                r = refresh_one(controller, cfd, p, a, iteration, depth + 1);
+                if (r < 0 && r != -ENOENT && r != -ENODEV)
+                        return r;
         }
 
-finish:
-        if (d)
-                closedir(d);
-
-        return r;
+        return 0;
 }
 
-static int refresh(Hashmap *a, Hashmap *b, unsigned iteration) {
+static int refresh(Hashmap *a, unsigned iteration) {
+        Iterator i;
+        unsigned k;
+        Group *g;
         int r;
 
         assert(a);
 
-        r = refresh_one("name=systemd", "/", a, b, iteration, 0);
-        if (r < 0)
-                if (r != -ENOENT)
-                    return r;
-        r = refresh_one("cpuacct", "/", a, b, iteration, 0);
-        if (r < 0)
-                if (r != -ENOENT)
-                    return r;
-        r = refresh_one("memory", "/", a, b, iteration, 0);
-        if (r < 0)
-                if (r != -ENOENT)
-                    return r;
+        for (k = 0; k < _CONTROLLER_MAX; k++) {
+                _cleanup_free_ char *p = NULL;
+                _cleanup_close_ int fd = -1;
+
+                r = cg_get_path(controller_table[k], "/", NULL, &p);
+                if (r < 0)
+                        return r;
+
+                fd = open(p, O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY);
+                if (fd < 0) {
+                        if (errno == ENOENT)
+                                continue;
+
+                        return -errno;
+                }
+
+                r = refresh_one(k, fd, "/", a, iteration, 0);
+                if (r < 0 && r != -ENOENT)
+                        return r;
+        }
+
+        /* Forget about the groups that went away */
+        HASHMAP_FOREACH(g, a, i)
+                if (g->iteration != iteration) {
+                        hashmap_remove(a, g->path);
+                        group_free(g);
+                }
 
-        r = refresh_one("blkio", "/", a, b, iteration, 0);
-        if (r < 0)
-                if (r != -ENOENT)
-                    return r;
         return 0;
 }
 
@@ -453,7 +585,7 @@ static int display(Hashmap *a) {
         assert(a);
 
         /* Set cursor to top left corner and clear screen */
-        if (on_tty())
+        if (on_tty() && !arg_raw)
                 fputs("\033[H"
                       "\033[2J", stdout);
 
@@ -485,7 +617,7 @@ static int display(Hashmap *a) {
         if (rows <= 10)
                 rows = 10;
 
-        if (on_tty()) {
+        if (on_tty() && !arg_raw) {
                 path_columns = columns() - 36 - strlen(buffer);
                 if (path_columns < 10)
                         path_columns = 10;
@@ -509,11 +641,43 @@ static int display(Hashmap *a) {
         for (j = 0; j < n; j++) {
                 char *p;
 
+                g = array[j];
+
+                /* Unformatted and without any ellipsizing, one
+                 * tab-separated line per group, for consumption by
+                 * other programs */
+                if (arg_raw) {
+                        fputs(g->path, stdout);
+
+                        if (g->n_tasks_valid)
+                                printf("\t%u", g->n_tasks);
+                        else
+                                fputs("\t-", stdout);
+
+                        if (arg_cpu_type == CPU_PERCENT) {
+                                if (g->cpu_valid)
+                                        printf("\t%.2f", g->cpu_fraction*100);
+                                else
+                                        fputs("\t-", stdout);
+                        } else
+                                printf("\t%" PRIu64, g->cpu_usage);
+
+                        if (g->memory_valid)
+                                printf("\t%" PRIu64, g->memory);
+                        else
+                                fputs("\t-", stdout);
+
+                        if (g->io_valid)
+                                printf("\t%" PRIu64 "\t%" PRIu64 "\n", g->io_input_bps, g->io_output_bps);
+                        else
+                                fputs("\t-\t-\n", stdout);
+
+                        continue;
+                }
+
                 if (on_tty() && j + 5 > rows)
                         break;
 
-                g = array[j];
-
                 p = ellipsize(g->path, path_columns, 33);
                 printf("%-*s", path_columns, p ? p : g->path);
                 free(p);
@@ -547,6 +711,12 @@ static int display(Hashmap *a) {
                 putchar('\n');
         }
 
+        /* Separate the iterations */
+        if (arg_raw)
+                putchar('\n');
+
+        fflush(stdout);
+
         return 0;
 }
 
@@ -564,6 +734,8 @@ static void help(void) {
                "  -d --delay=DELAY    Delay between updates\n"
                "  -n --iterations=N   Run for N iterations before exiting\n"
                "  -b --batch          Run in batch mode, accepting no input\n"
+               "  -r --raw            Print unformatted, tab-separated values\n"
+               "     --no-tasks       Do not count the tasks of each group\n"
                "     --depth=DEPTH    Maximum traversal depth (default: %u)\n"
                , program_invocation_short_name, arg_depth);
 }
@@ -573,7 +745,8 @@ static int parse_argv(int argc, char *argv[]) {
         enum {
                 ARG_VERSION = 0x100,
                 ARG_DEPTH,
-                ARG_CPU_TYPE
+                ARG_CPU_TYPE,
+                ARG_NO_TASKS,
         };
 
         static const struct option options[] = {
@@ -582,6 +755,8 @@ static int parse_argv(int argc, char *argv[]) {
                 { "delay",      required_argument, NULL, 'd'         },
                 { "iterations", required_argument, NULL, 'n'         },
                 { "batch",      no_argument,       NULL, 'b'         },
+                { "raw",        no_argument,       NULL, 'r'         },
+                { "no-tasks",   no_argument,       NULL, ARG_NO_TASKS},
                 { "depth",      required_argument, NULL, ARG_DEPTH   },
                 { "cpu",        optional_argument, NULL, ARG_CPU_TYPE},
                 {}
@@ -593,7 +768,7 @@ static int parse_argv(int argc, char *argv[]) {
         assert(argc >= 1);
         assert(argv);
 
-        while ((c = getopt_long(argc, argv, "hptcmin:bd:", options, NULL)) >= 0)
+        while ((c = getopt_long(argc, argv, "hptcmin:brd:", options, NULL)) >= 0)
 
                 switch (c) {
 
@@ -642,12 +817,21 @@ static int parse_argv(int argc, char *argv[]) {
                                 return -EINVAL;
                         }
 
+                        arg_iterations_set = true;
                         break;
 
                 case 'b':
                         arg_batch = true;
                         break;
 
+                case 'r':
+                        arg_raw = true;
+                        break;
+
+                case ARG_NO_TASKS:
+                        arg_tasks = false;
+                        break;
+
                 case 'p':
                         arg_order = ORDER_PATH;
                         break;
@@ -683,9 +867,35 @@ static int parse_argv(int argc, char *argv[]) {
         return 1;
 }
 
+static void setup_fd_limit(void) {
+        struct rlimit rl;
+
+        /* We keep the files of many cgroups open, hence ask for as
+         * many fds as we may have */
+        if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+                log_warning("Failed to read RLIMIT_NOFILE, not keeping any files open: %m");
+                return;
+        }
+
+        if (rl.rlim_cur < rl.rlim_max) {
+                struct rlimit nl = {
+                        .rlim_cur = rl.rlim_max,
+                        .rlim_max = rl.rlim_max,
+                };
+
+                if (setrlimit(RLIMIT_NOFILE, &nl) >= 0)
+                        rl = nl;
+                else
+                        log_debug("Failed to raise RLIMIT_NOFILE: %m");
+        }
+
+        if (rl.rlim_cur > FDS_RESERVED)
+                max_cached_fds = (unsigned) MIN(rl.rlim_cur - FDS_RESERVED, (rlim_t) FDS_CACHED_MAX);
+}
+
 int main(int argc, char *argv[]) {
         int r;
-        Hashmap *a = NULL, *b = NULL;
+        Hashmap *a = NULL;
         unsigned iteration = 0;
         usec_t last_refresh = 0;
         bool quit = false, immediate_refresh = false;
@@ -697,20 +907,20 @@ int main(int argc, char *argv[]) {
         if (r <= 0)
                 goto finish;
 
+        setup_fd_limit();
+
         a = hashmap_new(&string_hash_ops);
-        b = hashmap_new(&string_hash_ops);
-        if (!a || !b) {
+        if (!a) {
                 r = log_oom();
                 goto finish;
         }
 
         signal(SIGWINCH, columns_lines_cache_reset);
 
-        if (!on_tty())
+        if (!on_tty() && !arg_iterations_set)
                 arg_iterations = 1;
 
         while (!quit) {
-                Hashmap *c;
                 usec_t t;
                 char key;
                 char h[FORMAT_TIMESPAN_MAX];
@@ -719,21 +929,15 @@ int main(int argc, char *argv[]) {
 
                 if (t >= last_refresh + arg_delay || immediate_refresh) {
 
-                        r = refresh(a, b, iteration++);
+                        r = refresh(a, iteration++);
                         if (r < 0)
                                 goto finish;
 
-                        group_hashmap_clear(b);
-
-                        c = a;
-                        a = b;
-                        b = c;
-
                         last_refresh = t;
                         immediate_refresh = false;
                 }
 
-                r = display(b);
+                r = display(a);
                 if (r < 0)
                         goto finish;
 
@@ -753,8 +957,10 @@ int main(int argc, char *argv[]) {
                         }
                 }
 
-                fputs("\r \r", stdout);
-                fflush(stdout);
+                if (on_tty()) {
+                        fputs("\r \r", stdout);
+                        fflush(stdout);
+                }
 
                 if (arg_batch)
                         continue;
@@ -839,7 +1045,7 @@ int main(int argc, char *argv[]) {
 
 finish:
         group_hashmap_free(a);
-        group_hashmap_free(b);
+        free(read_buffer);
 
         if (r < 0) {
                 log_error("Exiting with failure: %s", strerror(-r));
@@ -96,6 +96,7 @@ static void unmount_autofs(Automount *a) {
          * around */
         if (a->where &&
             (UNIT(a)->manager->exit_code != MANAGER_RELOAD &&
+             UNIT(a)->manager->exit_code != MANAGER_RELOAD_INCREMENTAL &&
              UNIT(a)->manager->exit_code != MANAGER_REEXECUTE))
                 repeat_unmount(a->where);
 }
@@ -618,21 +619,21 @@ static int automount_stop(Unit *u) {
         return 0;
 }
 
-static int automount_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int automount_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Automount *a = AUTOMOUNT(u);
         void *p;
         Iterator i;
 
         assert(a);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", automount_state_to_string(a->state));
-        unit_serialize_item(u, f, "result", automount_result_to_string(a->result));
-        unit_serialize_item_format(u, f, "dev-id", "%u", (unsigned) a->dev_id);
+        unit_serialize_item(u, st, "state", automount_state_to_string(a->state));
+        unit_serialize_item(u, st, "result", automount_result_to_string(a->result));
+        unit_serialize_item_format(u, st, "dev-id", "%u", (unsigned) a->dev_id);
 
         SET_FOREACH(p, a->tokens, i)
-                unit_serialize_item_format(u, f, "token", "%u", PTR_TO_UINT(p));
+                unit_serialize_item_format(u, st, "token", "%u", PTR_TO_UINT(p));
 
         if (a->pipe_fd >= 0) {
                 int copy;
@@ -641,7 +642,7 @@ static int automount_serialize(Unit *u, FILE *f, FDSet *fds) {
                 if (copy < 0)
                         return copy;
 
-                unit_serialize_item_format(u, f, "pipe-fd", "%i", copy);
+                unit_serialize_item_format(u, st, "pipe-fd", "%i", copy);
         }
 
         return 0;
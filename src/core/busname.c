@@ -541,7 +541,7 @@ static void busname_enter_running(BusName *n) {
         _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
         bool pending = false;
         Unit *other;
-        Iterator i;
+        unsigned i;
         int r;
 
         assert(n);
@@ -564,7 +564,7 @@ static void busname_enter_running(BusName *n) {
 
         /* If there's already a start pending don't bother to do
          * anything */
-        SET_FOREACH(other, UNIT(n)->dependencies[UNIT_TRIGGERS], i)
+        UNIT_FOREACH_DEPENDENCY(other, UNIT(n), UNIT_TRIGGERS, i)
                 if (unit_active_or_pending(other)) {
                         pending = true;
                         break;
@@ -640,18 +640,18 @@ static int busname_stop(Unit *u) {
         return 0;
 }
 
-static int busname_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int busname_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         BusName *n = BUSNAME(u);
 
         assert(n);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", busname_state_to_string(n->state));
-        unit_serialize_item(u, f, "result", busname_result_to_string(n->result));
+        unit_serialize_item(u, st, "state", busname_state_to_string(n->state));
+        unit_serialize_item(u, st, "result", busname_result_to_string(n->result));
 
         if (n->control_pid > 0)
-                unit_serialize_item_format(u, f, "control-pid", PID_FMT, n->control_pid);
+                unit_serialize_item_format(u, st, "control-pid", PID_FMT, n->control_pid);
 
         if (n->starter_fd >= 0) {
                 int copy;
@@ -660,7 +660,7 @@ static int busname_serialize(Unit *u, FILE *f, FDSet *fds) {
                 if (copy < 0)
                         return copy;
 
-                unit_serialize_item_format(u, f, "starter-fd", "%i", copy);
+                unit_serialize_item_format(u, st, "starter-fd", "%i", copy);
         }
 
         return 0;
@@ -21,9 +21,14 @@
 
 #include <fcntl.h>
 #include <fnmatch.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/statfs.h>
 
 #include "path-util.h"
+#include "strv.h"
 #include "special.h"
+#include "missing.h"
 #include "cgroup-util.h"
 #include "cgroup.h"
 
@@ -143,7 +148,196 @@ void cgroup_context_dump(CGroupContext *c, FILE* f, const char *prefix) {
         }
 }
 
+static const char* const cgroup_controller_names[_CGROUP_CONTROLLER_MAX] = {
+        "cpu",
+        "cpuacct",
+        "blkio",
+        "memory",
+        "devices",
+};
+
+static int unit_get_cgroup_fd(Unit *u, CGroupControllerMask controller) {
+        _cleanup_free_ char *p = NULL;
+        unsigned i;
+        int r;
+
+        assert(u);
+
+        i = u32ctz(controller);
+        assert(i < _CGROUP_CONTROLLER_MAX);
+
+        if (u->cgroup_fds[i] >= 0)
+                return u->cgroup_fds[i];
+
+        r = cg_get_path(cgroup_controller_names[i], u->cgroup_path, NULL, &p);
+        if (r < 0)
+                return r;
+
+        /* Kept open while the attributes are applied, so that
+         * further writes do not need to look up the path again */
+        u->cgroup_fds[i] = open(p, O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY);
+        if (u->cgroup_fds[i] < 0)
+                return -errno;
+
+        return u->cgroup_fds[i];
+}
+
+static int unit_write_cgroup_attribute(Unit *u, CGroupControllerMask controller, const char *attribute, const char *value) {
+        _cleanup_close_ int fd = -1;
+        size_t l;
+        ssize_t n;
+        int dfd;
+
+        assert(u);
+        assert(attribute);
+        assert(value);
+
+        dfd = unit_get_cgroup_fd(u, controller);
+        if (dfd < 0)
+                return dfd;
+
+        fd = openat(dfd, attribute, O_WRONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0 && (errno == ENOENT || errno == ENODEV)) {
+                unsigned i;
+
+                /* The cgroup we have open might have been removed
+                 * and created again behind our back, hence look it
+                 * up once more */
+                i = u32ctz(controller);
+                u->cgroup_fds[i] = safe_close(u->cgroup_fds[i]);
+
+                dfd = unit_get_cgroup_fd(u, controller);
+                if (dfd < 0)
+                        return dfd;
+
+                fd = openat(dfd, attribute, O_WRONLY|O_CLOEXEC|O_NOCTTY);
+        }
+        if (fd < 0)
+                return -errno;
+
+        u->manager->n_cgroup_attribute_writes++;
+
+        l = strlen(value);
+        n = write(fd, value, l);
+        if (n < 0)
+                return -errno;
+        if ((size_t) n != l)
+                return -EIO;
+
+        return 0;
+}
+
+static bool unit_cgroup_attribute_cached(Unit *u, const char *key, const char *value) {
+        const char *v;
+
+        v = hashmap_get(u->cgroup_attributes, key);
+        if (!v || !streq(v, value))
+                return false;
+
+        u->manager->n_cgroup_attribute_writes_skipped++;
+        return true;
+}
+
+static void unit_cache_cgroup_attribute(Unit *u, const char *key, const char *value) {
+        char *k = NULL, *v;
+
+        assert(u);
+        assert(key);
+
+        v = hashmap_remove2(u->cgroup_attributes, key, (void**) &k);
+        free(k);
+        free(v);
+
+        /* Without a value the attribute is written again next
+         * time. The same happens if we cannot remember it. */
+        if (!value)
+                return;
+
+        if (hashmap_ensure_allocated(&u->cgroup_attributes, &string_hash_ops) < 0)
+                return;
+
+        k = strdup(key);
+        v = strdup(value);
+        if (!k || !v || hashmap_put(u->cgroup_attributes, k, v) < 0) {
+                free(k);
+                free(v);
+        }
+}
+
+/* Writes the attribute, unless the same value was written to it
+ * before. The key identifies the setting for attributes that take
+ * more than one, like the per-device ones, and defaults to the
+ * attribute name. */
+static int unit_set_cgroup_attribute(Unit *u, CGroupControllerMask controller, const char *attribute, const char *key, const char *value) {
+        int r;
+
+        assert(u);
+        assert(attribute);
+
+        if (!key)
+                key = attribute;
+
+        if (unit_cgroup_attribute_cached(u, key, value))
+                return 0;
+
+        r = unit_write_cgroup_attribute(u, controller, attribute, value);
+        if (r < 0) {
+                log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set %s on %s: %s", attribute, u->cgroup_path, strerror(-r));
+                unit_cache_cgroup_attribute(u, key, NULL);
+                return r;
+        }
+
+        unit_cache_cgroup_attribute(u, key, value);
+        return 0;
+}
+
+void unit_release_cgroup_attributes(Unit *u, CGroupControllerMask keep) {
+        unsigned i;
+
+        assert(u);
+
+        /* Forgets what was written to the controllers not in keep,
+         * since their cgroups are removed or go away. */
+
+        for (i = 0; i < _CGROUP_CONTROLLER_MAX; i++) {
+                Iterator j;
+                char *k, *v;
+
+                if (keep & (1 << i))
+                        continue;
+
+                u->cgroup_fds[i] = safe_close(u->cgroup_fds[i]);
+
+                HASHMAP_FOREACH_KEY(v, k, u->cgroup_attributes, j) {
+                        const char *e;
+
+                        e = startswith(k, cgroup_controller_names[i]);
+                        if (!e || *e != '.')
+                                continue;
+
+                        hashmap_remove(u->cgroup_attributes, k);
+                        free(k);
+                        free(v);
+                }
+        }
+
+        if (hashmap_isempty(u->cgroup_attributes)) {
+                hashmap_free(u->cgroup_attributes);
+                u->cgroup_attributes = NULL;
+        }
+}
+
+static void unit_close_cgroup_fds(Unit *u) {
+        unsigned i;
+
+        assert(u);
+
+        for (i = 0; i < _CGROUP_CONTROLLER_MAX; i++)
+                u->cgroup_fds[i] = safe_close(u->cgroup_fds[i]);
+}
+
 static int lookup_blkio_device(const char *p, dev_t *dev) {
+
         struct stat st;
         int r;
 
@@ -174,12 +368,10 @@ static int lookup_blkio_device(const char *p, dev_t *dev) {
         return 0;
 }
 
-static int whitelist_device(const char *path, const char *node, const char *acc) {
-        char buf[2+DECIMAL_STR_MAX(dev_t)*2+2+4];
+static int whitelist_device(char ***l, const char *node, const char *acc) {
         struct stat st;
-        int r;
 
-        assert(path);
+        assert(l);
         assert(acc);
 
         if (stat(node, &st) < 0) {
@@ -192,26 +384,20 @@ static int whitelist_device(const char *path, const char *node, const char *acc)
                 return -ENODEV;
         }
 
-        sprintf(buf,
-                "%c %u:%u %s",
-                S_ISCHR(st.st_mode) ? 'c' : 'b',
-                major(st.st_rdev), minor(st.st_rdev),
-                acc);
-
-        r = cg_set_attribute("devices", path, "devices.allow", buf);
-        if (r < 0)
-                log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set devices.allow on %s: %s", path, strerror(-r));
-
-        return r;
+        return strv_extendf(l,
+                            "%c %u:%u %s",
+                            S_ISCHR(st.st_mode) ? 'c' : 'b',
+                            major(st.st_rdev), minor(st.st_rdev),
+                            acc);
 }
 
-static int whitelist_major(const char *path, const char *name, char type, const char *acc) {
+static int whitelist_major(char ***l, const char *name, char type, const char *acc) {
         _cleanup_fclose_ FILE *f = NULL;
         char line[LINE_MAX];
         bool good = false;
         int r;
 
-        assert(path);
+        assert(l);
         assert(acc);
         assert(type == 'b' || type == 'c');
 
@@ -222,7 +408,7 @@ static int whitelist_major(const char *path, const char *name, char type, const
         }
 
         FOREACH_LINE(line, f, goto fail) {
-                char buf[2+DECIMAL_STR_MAX(unsigned)+3+4], *p, *w;
+                char *p, *w;
                 unsigned maj;
 
                 truncate_nl(line);
@@ -264,15 +450,13 @@ static int whitelist_major(const char *path, const char *name, char type, const
                 if (fnmatch(name, w, 0) != 0)
                         continue;
 
-                sprintf(buf,
-                        "%c %u:* %s",
-                        type,
-                        maj,
-                        acc);
-
-                r = cg_set_attribute("devices", path, "devices.allow", buf);
+                r = strv_extendf(l,
+                                 "%c %u:* %s",
+                                 type,
+                                 maj,
+                                 acc);
                 if (r < 0)
-                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set devices.allow on %s: %s", path, strerror(-r));
+                        return r;
         }
 
         return 0;
@@ -282,19 +466,132 @@ fail:
         return -errno;
 }
 
-void cgroup_context_apply(CGroupContext *c, CGroupControllerMask mask, const char *path, ManagerState state) {
-        bool is_root;
+static void unit_apply_cgroup_devices(Unit *u, CGroupContext *c) {
+        _cleanup_strv_free_ char **l = NULL;
+        _cleanup_free_ char *joined = NULL;
+        CGroupDeviceAllow *a;
+        const char *reset;
+        char **i, *e;
         int r;
 
-        assert(c);
-        assert(path);
+        /* The device list cannot be written as a whole, but only by
+         * resetting it and then adding the entries one by one. Hence
+         * put together all writes first, and skip them altogether if
+         * they are the same as last time. */
+
+        if (c->device_allow || c->device_policy != CGROUP_AUTO)
+                reset = "devices.deny";
+        else
+                reset = "devices.allow";
+
+        if (c->device_policy == CGROUP_CLOSED ||
+            (c->device_policy == CGROUP_AUTO && c->device_allow)) {
+                static const char auto_devices[] =
+                        "/dev/null\0" "rwm\0"
+                        "/dev/zero\0" "rwm\0"
+                        "/dev/full\0" "rwm\0"
+                        "/dev/random\0" "rwm\0"
+                        "/dev/urandom\0" "rwm\0"
+                        "/dev/tty\0" "rwm\0"
+                        "/dev/pts/ptmx\0" "rw\0"; /* /dev/pts/ptmx may not be duplicated, but accessed */
+
+                const char *x, *y;
+
+                NULSTR_FOREACH_PAIR(x, y, auto_devices)
+                        if (whitelist_device(&l, x, y) == -ENOMEM)
+                                goto oom;
+
+                if (whitelist_major(&l, "pts", 'c', "rw") == -ENOMEM ||
+                    whitelist_major(&l, "kdbus", 'c', "rw") == -ENOMEM ||
+                    whitelist_major(&l, "kdbus/*", 'c', "rw") == -ENOMEM)
+                        goto oom;
+        }
+
+        LIST_FOREACH(device_allow, a, c->device_allow) {
+                char acc[4];
+                unsigned k = 0;
+
+                if (a->r)
+                        acc[k++] = 'r';
+                if (a->w)
+                        acc[k++] = 'w';
+                if (a->m)
+                        acc[k++] = 'm';
+
+                if (k == 0)
+                        continue;
+
+                acc[k++] = 0;
+
+                if (startswith(a->path, "/dev/"))
+                        r = whitelist_device(&l, a->path, acc);
+                else if (startswith(a->path, "block-"))
+                        r = whitelist_major(&l, a->path + 6, 'b', acc);
+                else if (startswith(a->path, "char-"))
+                        r = whitelist_major(&l, a->path + 5, 'c', acc);
+                else {
+                        log_debug("Ignoring device %s while writing cgroup attribute.", a->path);
+                        continue;
+                }
+                if (r == -ENOMEM)
+                        goto oom;
+        }
+
+        e = strjoin(reset, " a", NULL);
+        if (!e)
+                goto oom;
+
+        r = strv_consume_prepend(&l, e);
+        if (r < 0)
+                goto oom;
+
+        joined = strv_join(l, "\n");
+        if (!joined)
+                goto oom;
+
+        if (unit_cgroup_attribute_cached(u, "devices.list", joined))
+                return;
+
+        /* The first entry resets the list, all others are added */
+        STRV_FOREACH(i, l) {
+                r = unit_write_cgroup_attribute(u, CGROUP_DEVICE,
+                                                i == l ? reset : "devices.allow",
+                                                i == l ? "a" : *i);
+                if (r < 0) {
+                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set devices.list on %s: %s", u->cgroup_path, strerror(-r));
+
+                        /* Whatever made it, it needs to be redone */
+                        unit_cache_cgroup_attribute(u, "devices.list", NULL);
+                        return;
+                }
+        }
+
+        unit_cache_cgroup_attribute(u, "devices.list", joined);
+        return;
+
+oom:
+        log_oom();
+}
+
+void unit_apply_cgroup_attributes(Unit *u, CGroupControllerMask mask, ManagerState state) {
+        CGroupContext *c;
+        bool is_root;
+
+        assert(u);
+
+        c = unit_get_cgroup_context(u);
+        if (!c)
+                return;
 
         if (mask == 0)
                 return;
 
+        if (!u->cgroup_path)
+                return;
+
         /* Some cgroup attributes are not support on the root cgroup,
          * hence silently ignore */
-        is_root = isempty(path) || path_equal(path, "/");
+        is_root = isempty(u->cgroup_path) || path_equal(u->cgroup_path, "/");
 
         if ((mask & CGROUP_CPU) && !is_root) {
                 char buf[MAX(DECIMAL_STR_MAX(unsigned long), DECIMAL_STR_MAX(usec_t)) + 1];
@@ -302,37 +599,31 @@ void cgroup_context_apply(CGroupContext *c, CGroupControllerMask mask, const cha
                 sprintf(buf, "%lu\n",
                         IN_SET(state, MANAGER_STARTING, MANAGER_INITIALIZING) && c->startup_cpu_shares != (unsigned long) -1 ? c->startup_cpu_shares :
                         c->cpu_shares != (unsigned long) -1 ? c->cpu_shares : 1024);
-                r = cg_set_attribute("cpu", path, "cpu.shares", buf);
-                if (r < 0)
-                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set cpu.shares on %s: %s", path, strerror(-r));
+                unit_set_cgroup_attribute(u, CGROUP_CPU, "cpu.shares", NULL, buf);
 
                 sprintf(buf, USEC_FMT "\n", CGROUP_CPU_QUOTA_PERIOD_USEC);
-                r = cg_set_attribute("cpu", path, "cpu.cfs_period_us", buf);
-                if (r < 0)
-                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set cpu.cfs_period_us on %s: %s", path, strerror(-r));
+                unit_set_cgroup_attribute(u, CGROUP_CPU, "cpu.cfs_period_us", NULL, buf);
 
                 if (c->cpu_quota_per_sec_usec != USEC_INFINITY) {
                         sprintf(buf, USEC_FMT "\n", c->cpu_quota_per_sec_usec * CGROUP_CPU_QUOTA_PERIOD_USEC / USEC_PER_SEC);
-                        r = cg_set_attribute("cpu", path, "cpu.cfs_quota_us", buf);
+                        unit_set_cgroup_attribute(u, CGROUP_CPU, "cpu.cfs_quota_us", NULL, buf);
                 } else
-                        r = cg_set_attribute("cpu", path, "cpu.cfs_quota_us", "-1");
-                if (r < 0)
-                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set cpu.cfs_quota_us on %s: %s", path, strerror(-r));
+                        unit_set_cgroup_attribute(u, CGROUP_CPU, "cpu.cfs_quota_us", NULL, "-1");
         }
 
         if (mask & CGROUP_BLKIO) {
                 char buf[MAX3(DECIMAL_STR_MAX(unsigned long)+1,
                               DECIMAL_STR_MAX(dev_t)*2+2+DECIMAL_STR_MAX(unsigned long)*1,
                               DECIMAL_STR_MAX(dev_t)*2+2+DECIMAL_STR_MAX(uint64_t)+1)];
+                char key[sizeof("blkio.throttle.write_bps_device ") + DECIMAL_STR_MAX(dev_t)*2+1];
                 CGroupBlockIODeviceWeight *w;
                 CGroupBlockIODeviceBandwidth *b;
+                int r;
 
                 if (!is_root) {
                         sprintf(buf, "%lu\n", IN_SET(state, MANAGER_STARTING, MANAGER_INITIALIZING) && c->startup_blockio_weight != (unsigned long) -1 ? c->startup_blockio_weight :
                                 c->blockio_weight != (unsigned long) -1 ? c->blockio_weight : 1000);
-                        r = cg_set_attribute("blkio", path, "blkio.weight", buf);
-                        if (r < 0)
-                                log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set blkio.weight on %s: %s", path, strerror(-r));
+                        unit_set_cgroup_attribute(u, CGROUP_BLKIO, "blkio.weight", NULL, buf);
 
                         /* FIXME: no way to reset this list */
                         LIST_FOREACH(device_weights, w, c->blockio_device_weights) {
@@ -342,10 +633,9 @@ void cgroup_context_apply(CGroupContext *c, CGroupControllerMask mask, const cha
                                 if (r < 0)
                                         continue;
 
+                                sprintf(key, "blkio.weight_device %u:%u", major(dev), minor(dev));
                                 sprintf(buf, "%u:%u %lu", major(dev), minor(dev), w->weight);
-                                r = cg_set_attribute("blkio", path, "blkio.weight_device", buf);
-                                if (r < 0)
-                                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set blkio.weight_device on %s: %s", path, strerror(-r));
+                                unit_set_cgroup_attribute(u, CGROUP_BLKIO, "blkio.weight_device", key, buf);
                         }
                 }
 
@@ -360,10 +650,9 @@ void cgroup_context_apply(CGroupContext *c, CGroupControllerMask mask, const cha
 
                         a = b->read ? "blkio.throttle.read_bps_device" : "blkio.throttle.write_bps_device";
 
+                        sprintf(key, "%s %u:%u", a, major(dev), minor(dev));
                         sprintf(buf, "%u:%u %" PRIu64 "\n", major(dev), minor(dev), b->bandwidth);
-                        r = cg_set_attribute("blkio", path, a, buf);
-                        if (r < 0)
-                                log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set %s on %s: %s", a, path, strerror(-r));
+                        unit_set_cgroup_attribute(u, CGROUP_BLKIO, a, key, buf);
                 }
         }
 
@@ -372,71 +661,17 @@ void cgroup_context_apply(CGroupContext *c, CGroupControllerMask mask, const cha
                         char buf[DECIMAL_STR_MAX(uint64_t) + 1];
 
                         sprintf(buf, "%" PRIu64 "\n", c->memory_limit);
-                        r = cg_set_attribute("memory", path, "memory.limit_in_bytes", buf);
+                        unit_set_cgroup_attribute(u, CGROUP_MEMORY, "memory.limit_in_bytes", NULL, buf);
                 } else
-                        r = cg_set_attribute("memory", path, "memory.limit_in_bytes", "-1");
-
-                if (r < 0)
-                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to set memory.limit_in_bytes on %s: %s", path, strerror(-r));
+                        unit_set_cgroup_attribute(u, CGROUP_MEMORY, "memory.limit_in_bytes", NULL, "-1");
         }
 
-        if ((mask & CGROUP_DEVICE) && !is_root) {
-                CGroupDeviceAllow *a;
+        if ((mask & CGROUP_DEVICE) && !is_root)
+                unit_apply_cgroup_devices(u, c);
 
-                if (c->device_allow || c->device_policy != CGROUP_AUTO)
-                        r = cg_set_attribute("devices", path, "devices.deny", "a");
-                else
-                        r = cg_set_attribute("devices", path, "devices.allow", "a");
-                if (r < 0)
-                        log_full(r == -ENOENT ? LOG_DEBUG : LOG_WARNING, "Failed to reset devices.list on %s: %s", path, strerror(-r));
-
-                if (c->device_policy == CGROUP_CLOSED ||
-                    (c->device_policy == CGROUP_AUTO && c->device_allow)) {
-                        static const char auto_devices[] =
-                                "/dev/null\0" "rwm\0"
-                                "/dev/zero\0" "rwm\0"
-                                "/dev/full\0" "rwm\0"
-                                "/dev/random\0" "rwm\0"
-                                "/dev/urandom\0" "rwm\0"
-                                "/dev/tty\0" "rwm\0"
-                                "/dev/pts/ptmx\0" "rw\0"; /* /dev/pts/ptmx may not be duplicated, but accessed */
-
-                        const char *x, *y;
-
-                        NULSTR_FOREACH_PAIR(x, y, auto_devices)
-                                whitelist_device(path, x, y);
-
-                        whitelist_major(path, "pts", 'c', "rw");
-                        whitelist_major(path, "kdbus", 'c', "rw");
-                        whitelist_major(path, "kdbus/*", 'c', "rw");
-                }
-
-                LIST_FOREACH(device_allow, a, c->device_allow) {
-                        char acc[4];
-                        unsigned k = 0;
-
-                        if (a->r)
-                                acc[k++] = 'r';
-                        if (a->w)
-                                acc[k++] = 'w';
-                        if (a->m)
-                                acc[k++] = 'm';
-
-                        if (k == 0)
-                                continue;
-
-                        acc[k++] = 0;
-
-                        if (startswith(a->path, "/dev/"))
-                                whitelist_device(path, a->path, acc);
-                        else if (startswith(a->path, "block-"))
-                                whitelist_major(path, a->path + 6, 'b', acc);
-                        else if (startswith(a->path, "char-"))
-                                whitelist_major(path, a->path + 5, 'c', acc);
-                        else
-                                log_debug("Ignoring device %s while writing cgroup attribute.", a->path);
-                }
-        }
+        /* There might be many units, hence don't keep the
+         * directories open until next time */
+        unit_close_cgroup_fds(u);
 }
 
 CGroupControllerMask cgroup_context_get_mask(CGroupContext *c) {
@@ -487,9 +722,9 @@ CGroupControllerMask unit_get_members_mask(Unit *u) {
 
         if (u->type == UNIT_SLICE) {
                 Unit *member;
-                Iterator i;
+                unsigned i;
 
-                SET_FOREACH(member, u->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(member, u, UNIT_BEFORE, i) {
 
                         if (member == u)
                                 continue;
@@ -594,6 +829,7 @@ static const char *migrate_callback(CGroupControllerMask mask, void *userdata) {
 
 static int unit_create_cgroups(Unit *u, CGroupControllerMask mask) {
         _cleanup_free_ char *path = NULL;
+        CGroupControllerMask keep;
         int r;
 
         assert(u);
@@ -619,10 +855,19 @@ static int unit_create_cgroups(Unit *u, CGroupControllerMask mask) {
                 return r;
         }
 
+        /* The cgroups in the other hierarchies are gone now, and
+         * those of controllers we did not have before are new,
+         * hence forget what we wrote to either */
+        keep = u->cgroup_realized ? mask & u->cgroup_realized_mask : 0;
+        unit_release_cgroup_attributes(u, keep);
+
         /* Keep track that this is now realized */
         u->cgroup_realized = true;
         u->cgroup_realized_mask = mask;
 
+        /* Get told when it runs empty, if the kernel can do that */
+        unit_watch_cgroup(u);
+
         /* Then, possibly move things over */
         r = cg_migrate_everywhere(u->manager->cgroup_supported, u->cgroup_path, u->cgroup_path, migrate_callback, u);
         if (r < 0)
@@ -672,7 +917,7 @@ static int unit_realize_cgroup_now(Unit *u, ManagerState state) {
                 return r;
 
         /* Finally, apply the necessary attributes. */
-        cgroup_context_apply(unit_get_cgroup_context(u), mask, u->cgroup_path, state);
+        unit_apply_cgroup_attributes(u, mask, state);
 
         return 0;
 }
@@ -715,10 +960,10 @@ static void unit_queue_siblings(Unit *u) {
          * neither the specified unit itself nor the parents.) */
 
         while ((slice = UNIT_DEREF(u->slice))) {
-                Iterator i;
+                unsigned i;
                 Unit *m;
 
-                SET_FOREACH(m, slice->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(m, slice, UNIT_BEFORE, i) {
                         if (m == u)
                                 continue;
 
@@ -780,6 +1025,9 @@ void unit_destroy_cgroup(Unit *u) {
         if (!u->cgroup_path)
                 return;
 
+        unit_unwatch_cgroup(u);
+        unit_release_cgroup_attributes(u, 0);
+
         r = cg_trim_everywhere(u->manager->cgroup_supported, u->cgroup_path, !unit_has_name(u, SPECIAL_ROOT_SLICE));
         if (r < 0)
                 log_debug("Failed to destroy cgroup %s: %s", u->cgroup_path, strerror(-r));
@@ -790,7 +1038,78 @@ void unit_destroy_cgroup(Unit *u) {
         u->cgroup_path = NULL;
         u->cgroup_realized = false;
         u->cgroup_realized_mask = 0;
+}
+
+int unit_watch_cgroup(Unit *u) {
+        _cleanup_free_ char *populated = NULL;
+        int r;
 
+        assert(u);
+
+        if (u->manager->cgroup_inotify_fd < 0)
+                return 0;
+
+        if (u->cgroup_inotify_wd >= 0)
+                return 0;
+
+        if (!u->cgroup_path)
+                return 0;
+
+        /* The root cgroup never runs empty */
+        if (unit_has_name(u, SPECIAL_ROOT_SLICE))
+                return 0;
+
+        /* Newer kernels expose the populated state of a cgroup in
+         * "cgroup.events", older ones with the sane behaviour
+         * hierarchy in "cgroup.populated". Both are modified when
+         * the state changes. Where neither exists we are left with
+         * the release agent. */
+        r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, "cgroup.events", &populated);
+        if (r < 0)
+                return r;
+
+        if (access(populated, F_OK) < 0) {
+                free(populated);
+                populated = NULL;
+
+                r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, "cgroup.populated", &populated);
+                if (r < 0)
+                        return r;
+
+                if (access(populated, F_OK) < 0)
+                        return 0;
+        }
+
+        r = hashmap_ensure_allocated(&u->manager->cgroup_inotify_wd_unit, &trivial_hash_ops);
+        if (r < 0)
+                return log_oom();
+
+        u->cgroup_inotify_wd = inotify_add_watch(u->manager->cgroup_inotify_fd, populated, IN_MODIFY);
+        if (u->cgroup_inotify_wd < 0) {
+                log_warning("Failed to watch %s, relying on the release agent: %m", populated);
+                return -errno;
+        }
+
+        r = hashmap_put(u->manager->cgroup_inotify_wd_unit, INT_TO_PTR(u->cgroup_inotify_wd), u);
+        if (r < 0) {
+                log_warning("Failed to add watch descriptor to hash map: %s", strerror(-r));
+                unit_unwatch_cgroup(u);
+                return r;
+        }
+
+        return 0;
+}
+
+void unit_unwatch_cgroup(Unit *u) {
+        assert(u);
+
+        if (u->cgroup_inotify_wd < 0)
+                return;
+
+        inotify_rm_watch(u->manager->cgroup_inotify_fd, u->cgroup_inotify_wd);
+        hashmap_remove_value(u->manager->cgroup_inotify_wd_unit, INT_TO_PTR(u->cgroup_inotify_wd), u);
+
+        u->cgroup_inotify_wd = -1;
 }
 
 pid_t unit_search_main_pid(Unit *u) {
@@ -830,6 +1149,128 @@ pid_t unit_search_main_pid(Unit *u) {
         return pid;
 }
 
+static void unit_add_to_cgroup_empty_queue(Unit *u) {
+
+        if (u->in_cgroup_empty_queue)
+                return;
+
+        LIST_PREPEND(cgroup_empty_queue, u->manager->cgroup_empty_queue, u);
+        u->in_cgroup_empty_queue = true;
+}
+
+unsigned manager_dispatch_cgroup_empty_queue(Manager *m) {
+        unsigned n = 0;
+        Unit *u;
+        int r;
+
+        /* Notifications are only collected here, and handled in one
+         * go from the main loop, so that a burst of them, as
+         * generated when a lot of units are stopped at once, is
+         * not processed one event loop iteration at a time. */
+
+        while ((u = m->cgroup_empty_queue)) {
+                assert(u->in_cgroup_empty_queue);
+
+                LIST_REMOVE(cgroup_empty_queue, m->cgroup_empty_queue, u);
+                u->in_cgroup_empty_queue = false;
+
+                n++;
+
+                if (!u->cgroup_path)
+                        continue;
+
+                r = cg_is_empty_recursive(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, true);
+                if (r <= 0)
+                        continue;
+
+                if (UNIT_VTABLE(u)->notify_cgroup_empty)
+                        UNIT_VTABLE(u)->notify_cgroup_empty(u);
+
+                unit_add_to_gc_queue(u);
+        }
+
+        return n;
+}
+
+static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        _cleanup_free_ uint8_t *buf = NULL;
+        Manager *m = userdata;
+        struct inotify_event *e;
+        ssize_t k;
+        int l;
+
+        assert(m);
+        assert(fd == m->cgroup_inotify_fd);
+
+        if (ioctl(fd, FIONREAD, &l) < 0) {
+                log_error("FIONREAD failed: %m");
+                return -errno;
+        }
+
+        if (l <= 0)
+                return 0;
+
+        buf = malloc(l);
+        if (!buf)
+                return log_oom();
+
+        k = read(fd, buf, l);
+        if (k < 0) {
+                if (errno == EAGAIN || errno == EINTR)
+                        return 0;
+
+                log_error("Failed to read cgroup inotify event: %m");
+                return -errno;
+        }
+
+        e = (struct inotify_event*) buf;
+
+        while (k > 0) {
+                size_t step;
+                Unit *u;
+
+                u = hashmap_get(m->cgroup_inotify_wd_unit, INT_TO_PTR(e->wd));
+                if (u) {
+                        if (e->mask & IN_IGNORED) {
+                                /* The cgroup went away, and so
+                                 * did the watch */
+                                hashmap_remove(m->cgroup_inotify_wd_unit, INT_TO_PTR(e->wd));
+                                u->cgroup_inotify_wd = -1;
+                        }
+
+                        /* Whether it is empty is checked when
+                         * the queue is dispatched, so there is
+                         * no need to parse the file here */
+                        unit_add_to_cgroup_empty_queue(u);
+                }
+
+                step = sizeof(struct inotify_event) + e->len;
+                assert(step <= (size_t) k);
+
+                e = (struct inotify_event*) ((uint8_t*) e + step);
+                k -= step;
+        }
+
+        return 0;
+}
+
+static bool cgroup_populated_supported(const char *path) {
+        struct statfs fs;
+        char *p;
+
+        /* On the unified hierarchy every non-root cgroup has
+         * "cgroup.events" */
+        if (statfs(path, &fs) >= 0 && F_TYPE_EQUAL(fs.f_type, CGROUP2_SUPER_MAGIC))
+                return true;
+
+        p = strappenda(path, "/cgroup.populated");
+        if (access(p, F_OK) >= 0)
+                return true;
+
+        p = strappenda(path, "/cgroup.events");
+        return access(p, F_OK) >= 0;
+}
+
 int manager_setup_cgroup(Manager *m) {
         _cleanup_free_ char *path = NULL;
         int r;
@@ -904,9 +1345,26 @@ int manager_setup_cgroup(Manager *m) {
 
                 /* 6.  Always enable hierarchial support if it exists... */
                 cg_set_attribute("memory", "/", "memory.use_hierarchy", "1");
+
+                /* 7. Watch for cgroups running empty ourselves, if
+                 * the kernel tells us about it. The release agent
+                 * stays installed for the cgroups we cannot watch. */
+                if (m->cgroup_inotify_fd < 0 && cgroup_populated_supported(path)) {
+                        m->cgroup_inotify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+                        if (m->cgroup_inotify_fd < 0)
+                                log_warning("Failed to create cgroup inotify object, relying on the release agent: %m");
+                        else {
+                                r = sd_event_add_io(m->event, &m->cgroup_inotify_event_source, m->cgroup_inotify_fd, EPOLLIN, on_cgroup_inotify_event, m);
+                                if (r < 0) {
+                                        log_warning("Failed to watch cgroup inotify object, relying on the release agent: %s", strerror(-r));
+                                        m->cgroup_inotify_fd = safe_close(m->cgroup_inotify_fd);
+                                } else
+                                        log_debug("Watching cgroups for running empty.");
+                        }
+                }
         }
 
-        /* 7. Figure out which controllers are supported */
+        /* 8. Figure out which controllers are supported */
         m->cgroup_supported = cg_mask_supported();
 
         return 0;
@@ -922,6 +1380,9 @@ void manager_shutdown_cgroup(Manager *m, bool delete) {
 
         m->pin_cgroupfs_fd = safe_close(m->pin_cgroupfs_fd);
 
+        m->cgroup_inotify_event_source = sd_event_source_unref(m->cgroup_inotify_event_source);
+        m->cgroup_inotify_fd = safe_close(m->cgroup_inotify_fd);
+
         free(m->cgroup_root);
         m->cgroup_root = NULL;
 }
@@ -971,21 +1432,16 @@ Unit *manager_get_unit_by_pid(Manager *m, pid_t pid) {
 
 int manager_notify_cgroup_empty(Manager *m, const char *cgroup) {
         Unit *u;
-        int r;
 
         assert(m);
         assert(cgroup);
 
+        /* Coming from the release agent. This is handled the same
+         * way as the inotify notifications, i.e. batched up in the
+         * queue. */
         u = manager_get_unit_by_cgroup(m, cgroup);
-        if (u) {
-                r = cg_is_empty_recursive(SYSTEMD_CGROUP_CONTROLLER, u->cgroup_path, true);
-                if (r > 0) {
-                        if (UNIT_VTABLE(u)->notify_cgroup_empty)
-                                UNIT_VTABLE(u)->notify_cgroup_empty(u);
-
-                        unit_add_to_gc_queue(u);
-                }
-        }
+        if (u)
+                unit_add_to_cgroup_empty_queue(u);
 
         return 0;
 }
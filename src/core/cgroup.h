@@ -92,7 +92,6 @@ struct CGroupContext {
 void cgroup_context_init(CGroupContext *c);
 void cgroup_context_done(CGroupContext *c);
 void cgroup_context_dump(CGroupContext *c, FILE* f, const char *prefix);
-void cgroup_context_apply(CGroupContext *c, CGroupControllerMask mask, const char *path, ManagerState state);
 
 CGroupControllerMask cgroup_context_get_mask(CGroupContext *c);
 
@@ -106,13 +105,19 @@ CGroupControllerMask unit_get_members_mask(Unit *u);
 CGroupControllerMask unit_get_target_mask(Unit *u);
 
 void unit_update_cgroup_members_masks(Unit *u);
+void unit_apply_cgroup_attributes(Unit *u, CGroupControllerMask mask, ManagerState state);
+void unit_release_cgroup_attributes(Unit *u, CGroupControllerMask keep);
 int unit_realize_cgroup(Unit *u);
 void unit_destroy_cgroup(Unit *u);
 
+int unit_watch_cgroup(Unit *u);
+void unit_unwatch_cgroup(Unit *u);
+
 int manager_setup_cgroup(Manager *m);
 void manager_shutdown_cgroup(Manager *m, bool delete);
 
 unsigned manager_dispatch_cgroup_queue(Manager *m);
+unsigned manager_dispatch_cgroup_empty_queue(Manager *m);
 
 Unit *manager_get_unit_by_cgroup(Manager *m, const char *cgroup);
 Unit* manager_get_unit_by_pid(Manager *m, pid_t pid);
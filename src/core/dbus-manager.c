@@ -21,6 +21,7 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <fnmatch.h>
 
 #include "log.h"
 #include "strv.h"
@@ -258,6 +259,65 @@ static int property_get_n_failed_units(
         return sd_bus_message_append(reply, "u", (uint32_t) set_size(m->failed_units));
 }
 
+static int property_get_unit_file_cache(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = userdata;
+
+        assert(bus);
+        assert(reply);
+        assert(m);
+
+        if (streq(property, "UnitFileCacheHits"))
+                return sd_bus_message_append(reply, "u", (uint32_t) m->unit_file_cache->n_hits);
+
+        return sd_bus_message_append(reply, "u", (uint32_t) m->unit_file_cache->n_misses);
+}
+
+static int property_get_generator_timings(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = userdata;
+        unsigned i;
+        int r;
+
+        assert(bus);
+        assert(reply);
+        assert(m);
+
+        r = sd_bus_message_open_container(reply, 'a', "(stttii)");
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < m->n_generator_timings; i++) {
+                GeneratorTiming *t = m->generator_timings + i;
+
+                r = sd_bus_message_append(reply, "(stttii)",
+                                          t->name,
+                                          t->wall_usec,
+                                          t->user_usec,
+                                          t->system_usec,
+                                          t->code,
+                                          t->status);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
 static int property_get_n_jobs(
                 sd_bus *bus,
                 const char *path,
@@ -656,7 +716,7 @@ static int method_start_transient_unit(sd_bus *bus, sd_bus_message *message, voi
         if (r < 0)
                 return r;
 
-        if (u->load_state != UNIT_NOT_FOUND || set_size(u->dependencies[UNIT_REFERENCED_BY]) > 0)
+        if (u->load_state != UNIT_NOT_FOUND || unit_dependency_count(u, UNIT_REFERENCED_BY) > 0)
                 return sd_bus_error_setf(error, BUS_ERROR_UNIT_EXISTS, "Unit %s already exists.", name);
 
         /* OK, the unit failed to load and is unreferenced, now let's
@@ -768,7 +828,28 @@ static int method_reset_failed(sd_bus *bus, sd_bus_message *message, void *userd
         return sd_bus_reply_method_return(message, NULL);
 }
 
-static int list_units_filtered(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error, char **states) {
+static bool unit_matches_filter(Unit *u, char **states, char **patterns) {
+        char **p;
+
+        assert(u);
+
+        if (!strv_isempty(states) &&
+            !strv_contains(states, unit_load_state_to_string(u->load_state)) &&
+            !strv_contains(states, unit_active_state_to_string(unit_active_state(u))) &&
+            !strv_contains(states, unit_sub_state_to_string(u)))
+                return false;
+
+        if (strv_isempty(patterns))
+                return true;
+
+        STRV_FOREACH(p, patterns)
+                if (fnmatch(*p, u->id, FNM_NOESCAPE) == 0)
+                        return true;
+
+        return false;
+}
+
+static int list_units_filtered(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error, char **states, char **patterns) {
         _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
         Manager *m = userdata;
         const char *k;
@@ -801,14 +882,11 @@ static int list_units_filtered(sd_bus *bus, sd_bus_message *message, void *userd
                 if (k != u->id)
                         continue;
 
-                following = unit_following(u);
-
-                if (!strv_isempty(states) &&
-                    !strv_contains(states, unit_load_state_to_string(u->load_state)) &&
-                    !strv_contains(states, unit_active_state_to_string(unit_active_state(u))) &&
-                    !strv_contains(states, unit_sub_state_to_string(u)))
+                if (!unit_matches_filter(u, states, patterns))
                         continue;
 
+                following = unit_following(u);
+
                 unit_path = unit_dbus_path(u);
                 if (!unit_path)
                         return -ENOMEM;
@@ -843,7 +921,7 @@ static int list_units_filtered(sd_bus *bus, sd_bus_message *message, void *userd
 }
 
 static int method_list_units(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
-        return list_units_filtered(bus, message, userdata, error, NULL);
+        return list_units_filtered(bus, message, userdata, error, NULL, NULL);
 }
 
 static int method_list_units_filtered(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -854,7 +932,95 @@ static int method_list_units_filtered(sd_bus *bus, sd_bus_message *message, void
         if (r < 0)
                 return r;
 
-        return list_units_filtered(bus, message, userdata, error, states);
+        return list_units_filtered(bus, message, userdata, error, states, NULL);
+}
+
+static int method_list_units_by_patterns(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_strv_free_ char **states = NULL, **patterns = NULL;
+        int r;
+
+        r = sd_bus_message_read_strv(message, &states);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        return list_units_filtered(bus, message, userdata, error, states, patterns);
+}
+
+static int method_list_unit_properties_by_patterns(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **states = NULL, **patterns = NULL, **properties = NULL;
+        Manager *m = userdata;
+        const char *k;
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(bus);
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = sd_bus_message_read_strv(message, &states);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &properties);
+        if (r < 0)
+                return r;
+
+        r = selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sa{sv})");
+        if (r < 0)
+                return r;
+
+        /* Returns the selected properties of all matching units in
+         * one reply, instead of one GetAll() call per unit */
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i) {
+                if (k != u->id)
+                        continue;
+
+                if (!unit_matches_filter(u, states, patterns))
+                        continue;
+
+                r = sd_bus_message_open_container(reply, 'r', "sa{sv}");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "s", u->id);
+                if (r < 0)
+                        return r;
+
+                r = bus_unit_append_properties(bus, reply, u, properties, error);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(bus, reply, NULL);
 }
 
 static int method_list_jobs(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -1066,8 +1232,7 @@ static int method_remove_snapshot(sd_bus *bus, sd_bus_message *message, void *us
         return bus_snapshot_method_remove(bus, message, u, error);
 }
 
-static int method_reload(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
-        Manager *m = userdata;
+static int reload_common(sd_bus *bus, sd_bus_message *message, Manager *m, ManagerExitCode code, sd_bus_error *error) {
         int r;
 
         assert(bus);
@@ -1095,11 +1260,19 @@ static int method_reload(sd_bus *bus, sd_bus_message *message, void *userdata, s
                 return r;
 
         m->queued_message_bus = sd_bus_ref(bus);
-        m->exit_code = MANAGER_RELOAD;
+        m->exit_code = code;
 
         return 1;
 }
 
+static int method_reload(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        return reload_common(bus, message, userdata, MANAGER_RELOAD, error);
+}
+
+static int method_reload_incremental(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        return reload_common(bus, message, userdata, MANAGER_RELOAD_INCREMENTAL, error);
+}
+
 static int method_reexecute(sd_bus *bus, sd_bus_message *message, void *userdata, sd_bus_error *error) {
         Manager *m = userdata;
         int r;
@@ -1870,6 +2043,13 @@ const sd_bus_vtable bus_manager_vtable[] = {
         BUS_PROPERTY_DUAL_TIMESTAMP("GeneratorsFinishTimestamp", offsetof(Manager, generators_finish_timestamp), SD_BUS_VTABLE_PROPERTY_CONST),
         BUS_PROPERTY_DUAL_TIMESTAMP("UnitsLoadStartTimestamp", offsetof(Manager, units_load_start_timestamp), SD_BUS_VTABLE_PROPERTY_CONST),
         BUS_PROPERTY_DUAL_TIMESTAMP("UnitsLoadFinishTimestamp", offsetof(Manager, units_load_finish_timestamp), SD_BUS_VTABLE_PROPERTY_CONST),
+        BUS_PROPERTY_DUAL_TIMESTAMP("ReloadStartTimestamp", offsetof(Manager, reload_start_timestamp), 0),
+        BUS_PROPERTY_DUAL_TIMESTAMP("ReloadFinishTimestamp", offsetof(Manager, reload_finish_timestamp), 0),
+        SD_BUS_PROPERTY("UnitFileCacheHits", "u", property_get_unit_file_cache, 0, 0),
+        SD_BUS_PROPERTY("UnitFileCacheMisses", "u", property_get_unit_file_cache, 0, 0),
+        SD_BUS_PROPERTY("CGroupAttributeWrites", "t", NULL, offsetof(Manager, n_cgroup_attribute_writes), 0),
+        SD_BUS_PROPERTY("CGroupAttributeWritesSkipped", "t", NULL, offsetof(Manager, n_cgroup_attribute_writes_skipped), 0),
+        SD_BUS_PROPERTY("GeneratorTimings", "a(stttii)", property_get_generator_timings, 0, 0),
         SD_BUS_WRITABLE_PROPERTY("LogLevel", "s", property_get_log_level, property_set_log_level, 0, 0),
         SD_BUS_WRITABLE_PROPERTY("LogTarget", "s", property_get_log_target, property_set_log_target, 0, 0),
         SD_BUS_PROPERTY("NNames", "u", property_get_n_names, 0, 0),
@@ -1910,6 +2090,8 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_METHOD("ResetFailed", NULL, NULL, method_reset_failed, 0),
         SD_BUS_METHOD("ListUnits", NULL, "a(ssssssouso)", method_list_units, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsFiltered", "as", "a(ssssssouso)", method_list_units_filtered, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitsByPatterns", "asas", "a(ssssssouso)", method_list_units_by_patterns, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitPropertiesByPatterns", "asasas", "a(sa{sv})", method_list_unit_properties_by_patterns, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListJobs", NULL, "a(usssoo)", method_list_jobs, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Subscribe", NULL, NULL, method_subscribe, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Unsubscribe", NULL, NULL, method_unsubscribe, SD_BUS_VTABLE_UNPRIVILEGED),
@@ -1917,6 +2099,7 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_METHOD("CreateSnapshot", "sb", "o", method_create_snapshot, 0),
         SD_BUS_METHOD("RemoveSnapshot", "s", NULL, method_remove_snapshot, 0),
         SD_BUS_METHOD("Reload", NULL, NULL, method_reload, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ReloadIncremental", NULL, NULL, method_reload_incremental, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Reexecute", NULL, NULL, method_reexecute, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Exit", NULL, NULL, method_exit, 0),
         SD_BUS_METHOD("Reboot", NULL, NULL, method_reboot, SD_BUS_VTABLE_CAPABILITY(CAP_SYS_BOOT)),
@@ -1953,6 +2136,17 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_VTABLE_END
 };
 
+const sd_bus_vtable bus_manager_batch_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+
+        SD_BUS_PROPERTY("CoalesceUSec", "t", bus_property_get_usec, offsetof(Manager, dbus_coalesce_usec), SD_BUS_VTABLE_PROPERTY_CONST),
+
+        SD_BUS_SIGNAL("UnitsChanged", "a(sosss)", 0),
+        SD_BUS_SIGNAL("JobsChanged", "a(uosss)", 0),
+
+        SD_BUS_VTABLE_END
+};
+
 static int send_finished(sd_bus *bus, void *userdata) {
         _cleanup_bus_message_unref_ sd_bus_message *message = NULL;
         usec_t *times = userdata;
@@ -2028,3 +2222,126 @@ void bus_manager_send_reloading(Manager *m, bool active) {
                 log_debug("Failed to send reloading signal: %s", strerror(-r));
 
 }
+
+typedef struct Batch {
+        Unit **units;
+        unsigned n_units;
+        Job **jobs;
+        unsigned n_jobs;
+} Batch;
+
+static int send_units_changed(sd_bus *bus, const Batch *b) {
+        _cleanup_bus_message_unref_ sd_bus_message *message = NULL;
+        unsigned i;
+        int r;
+
+        r = sd_bus_message_new_signal(bus, &message, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Batch", "UnitsChanged");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(message, 'a', "(sosss)");
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < b->n_units; i++) {
+                _cleanup_free_ char *p = NULL;
+                Unit *u = b->units[i];
+
+                p = unit_dbus_path(u);
+                if (!p)
+                        return -ENOMEM;
+
+                r = sd_bus_message_append(
+                                message, "(sosss)",
+                                u->id,
+                                p,
+                                unit_load_state_to_string(u->load_state),
+                                unit_active_state_to_string(unit_active_state(u)),
+                                unit_sub_state_to_string(u));
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(message);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(bus, message, NULL);
+}
+
+static int send_jobs_changed(sd_bus *bus, const Batch *b) {
+        _cleanup_bus_message_unref_ sd_bus_message *message = NULL;
+        unsigned i;
+        int r;
+
+        r = sd_bus_message_new_signal(bus, &message, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Batch", "JobsChanged");
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(message, 'a', "(uosss)");
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < b->n_jobs; i++) {
+                _cleanup_free_ char *p = NULL;
+                Job *j = b->jobs[i];
+
+                p = job_dbus_path(j);
+                if (!p)
+                        return -ENOMEM;
+
+                r = sd_bus_message_append(
+                                message, "(uosss)",
+                                j->id,
+                                p,
+                                j->unit->id,
+                                job_type_to_string(j->type),
+                                job_state_to_string(j->state));
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(message);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(bus, message, NULL);
+}
+
+static int send_batch(sd_bus *bus, void *userdata) {
+        const Batch *b = userdata;
+        int r;
+
+        assert(bus);
+        assert(b);
+
+        if (b->n_units > 0) {
+                r = send_units_changed(bus, b);
+                if (r < 0)
+                        return r;
+        }
+
+        if (b->n_jobs > 0) {
+                r = send_jobs_changed(bus, b);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+void bus_manager_send_batch(Manager *m, Unit **units, unsigned n_units, Job **jobs, unsigned n_jobs) {
+        Batch b = {
+                .units = units,
+                .n_units = n_units,
+                .jobs = jobs,
+                .n_jobs = n_jobs,
+        };
+        int r;
+
+        assert(m);
+
+        r = bus_foreach_bus(m, NULL, send_batch, &b);
+        if (r < 0)
+                log_debug("Failed to send batched change signal: %s", strerror(-r));
+}
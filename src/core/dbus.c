@@ -42,7 +42,9 @@
 #include "bus-errors.h"
 #include "strxcpyx.h"
 #include "bus-internal.h"
+#include "bus-objects.h"
 #include "selinux-access.h"
+#include "serialize.h"
 
 #define CONNECTIONS_MAX 512
 
@@ -549,6 +551,12 @@ static int bus_setup_api_vtables(Manager *m, sd_bus *bus) {
                 return r;
         }
 
+        r = sd_bus_add_object_vtable(bus, NULL, "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Batch", bus_manager_batch_vtable, m);
+        if (r < 0) {
+                log_error("Failed to register Batch vtable: %s", strerror(-r));
+                return r;
+        }
+
         r = sd_bus_add_fallback_vtable(bus, NULL, "/org/freedesktop/systemd1/job", "org.freedesktop.systemd1.Job", bus_job_vtable, bus_job_find, m);
         if (r < 0) {
                 log_error("Failed to register Job vtable: %s", strerror(-r));
@@ -1164,13 +1172,47 @@ int bus_foreach_bus(
         return ret;
 }
 
-void bus_track_serialize(sd_bus_track *t, FILE *f) {
+void bus_cork_all(Manager *m, bool b) {
+        Iterator i;
+        sd_bus *bus;
+
+        assert(m);
+
+        /* Corks (or uncorks) all our busses, so that bursts of
+         * signals are written out with as few syscalls as
+         * possible */
+
+        SET_FOREACH(bus, m->private_buses, i)
+                sd_bus_cork(bus, b);
+
+        if (m->api_bus)
+                sd_bus_cork(m->api_bus, b);
+}
+
+void bus_invalidate_property_cache(Manager *m, const char *path) {
+        Iterator i;
+        sd_bus *bus;
+
+        assert(m);
+
+        /* Unlike signals, which go to the API bus only if somebody
+         * is subscribed, GetAll() snapshots need to be dropped on
+         * all busses. If path is NULL, everything is dropped. */
+
+        SET_FOREACH(bus, m->private_buses, i)
+                bus_property_cache_invalidate(bus, path, NULL);
+
+        if (m->api_bus)
+                bus_property_cache_invalidate(m->api_bus, path, NULL);
+}
+
+void bus_track_serialize(sd_bus_track *t, SerializeState *st) {
         const char *n;
 
-        assert(f);
+        assert(st);
 
         for (n = sd_bus_track_first(t); n; n = sd_bus_track_next(t))
-                fprintf(f, "subscribed=%s\n", n);
+                serialize_item(st, "subscribed", n);
 }
 
 int bus_track_deserialize_item(char ***l, const char *line) {
@@ -30,11 +30,13 @@ void bus_done(Manager *m);
 
 int bus_fdset_add_all(Manager *m, FDSet *fds);
 
-void bus_track_serialize(sd_bus_track *t, FILE *f);
+void bus_track_serialize(sd_bus_track *t, SerializeState *st);
 int bus_track_deserialize_item(char ***l, const char *line);
 int bus_track_coldplug(Manager *m, sd_bus_track **t, char ***l);
 
 int bus_foreach_bus(Manager *m, sd_bus_track *subscribed2, int (*send_message)(sd_bus *bus, void *userdata), void *userdata);
+void bus_cork_all(Manager *m, bool b);
+void bus_invalidate_property_cache(Manager *m, const char *path);
 
 int bus_verify_manage_unit_async(Manager *m, sd_bus_message *call, sd_bus_error *error);
 int bus_verify_manage_unit_async_for_kill(Manager *m, sd_bus_message *call, sd_bus_error *error);
@@ -0,0 +1,956 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "execute-helper.h"
+#include "serialize.h"
+#include "strv.h"
+#include "util.h"
+#include "log.h"
+
+/* How long we wait for the helper to answer before we consider it
+ * hung, and then for it to go away after killing it */
+#define HELPER_TIMEOUT_USEC (10 * USEC_PER_SEC)
+#define HELPER_KILL_TIMEOUT_USEC (1 * USEC_PER_SEC)
+
+/* The stack the spawned processes start out on. Every child gets its
+ * own copy of it, hence we never touch it ourselves. */
+#define HELPER_STACK_SIZE (8U*1024U*1024U)
+
+/* The kernel's limit on fds passed in one message */
+#define HELPER_FDS_MAX 253U
+
+typedef enum ItemType {
+        ITEM_BOOL,
+        ITEM_INT,
+        ITEM_MODE,
+        ITEM_ULONG,
+        ITEM_UINT64,
+        ITEM_STRING,
+        ITEM_STRV,
+} ItemType;
+
+typedef struct Item {
+        const char *key;
+        ItemType type;
+        size_t offset;
+} Item;
+
+/* The enums below are passed as plain ints */
+assert_cc(sizeof(ExecInput) == sizeof(int));
+assert_cc(sizeof(ExecOutput) == sizeof(int));
+assert_cc(sizeof(ProtectSystem) == sizeof(int));
+assert_cc(sizeof(ProtectHome) == sizeof(int));
+assert_cc(sizeof(CGroupControllerMask) == sizeof(int));
+
+static const Item context_items[] = {
+        { "environment",                 ITEM_STRV,   offsetof(ExecContext, environment)                   },
+        { "working-directory",           ITEM_STRING, offsetof(ExecContext, working_directory)             },
+        { "root-directory",              ITEM_STRING, offsetof(ExecContext, root_directory)                },
+        { "umask",                       ITEM_MODE,   offsetof(ExecContext, umask)                         },
+        { "oom-score-adjust",            ITEM_INT,    offsetof(ExecContext, oom_score_adjust)              },
+        { "nice",                        ITEM_INT,    offsetof(ExecContext, nice)                          },
+        { "ioprio",                      ITEM_INT,    offsetof(ExecContext, ioprio)                        },
+        { "cpu-sched-policy",            ITEM_INT,    offsetof(ExecContext, cpu_sched_policy)              },
+        { "cpu-sched-priority",          ITEM_INT,    offsetof(ExecContext, cpu_sched_priority)            },
+        { "std-input",                   ITEM_INT,    offsetof(ExecContext, std_input)                     },
+        { "std-output",                  ITEM_INT,    offsetof(ExecContext, std_output)                    },
+        { "std-error",                   ITEM_INT,    offsetof(ExecContext, std_error)                     },
+        { "timer-slack-nsec",            ITEM_UINT64, offsetof(ExecContext, timer_slack_nsec)              },
+        { "tty-path",                    ITEM_STRING, offsetof(ExecContext, tty_path)                      },
+        { "tty-reset",                   ITEM_BOOL,   offsetof(ExecContext, tty_reset)                     },
+        { "tty-vhangup",                 ITEM_BOOL,   offsetof(ExecContext, tty_vhangup)                   },
+        { "tty-vt-disallocate",          ITEM_BOOL,   offsetof(ExecContext, tty_vt_disallocate)            },
+        { "ignore-sigpipe",              ITEM_BOOL,   offsetof(ExecContext, ignore_sigpipe)                },
+        { "user",                        ITEM_STRING, offsetof(ExecContext, user)                          },
+        { "group",                       ITEM_STRING, offsetof(ExecContext, group)                         },
+        { "supplementary-groups",        ITEM_STRV,   offsetof(ExecContext, supplementary_groups)          },
+        { "pam-name",                    ITEM_STRING, offsetof(ExecContext, pam_name)                      },
+        { "utmp-id",                     ITEM_STRING, offsetof(ExecContext, utmp_id)                       },
+        { "selinux-context-ignore",      ITEM_BOOL,   offsetof(ExecContext, selinux_context_ignore)        },
+        { "selinux-context",             ITEM_STRING, offsetof(ExecContext, selinux_context)               },
+        { "apparmor-profile-ignore",     ITEM_BOOL,   offsetof(ExecContext, apparmor_profile_ignore)       },
+        { "apparmor-profile",            ITEM_STRING, offsetof(ExecContext, apparmor_profile)              },
+        { "read-write-dirs",             ITEM_STRV,   offsetof(ExecContext, read_write_dirs)               },
+        { "read-only-dirs",              ITEM_STRV,   offsetof(ExecContext, read_only_dirs)                },
+        { "inaccessible-dirs",           ITEM_STRV,   offsetof(ExecContext, inaccessible_dirs)             },
+        { "mount-flags",                 ITEM_ULONG,  offsetof(ExecContext, mount_flags)                   },
+        { "capability-bounding-set-drop",ITEM_UINT64, offsetof(ExecContext, capability_bounding_set_drop)  },
+        { "secure-bits",                 ITEM_INT,    offsetof(ExecContext, secure_bits)                   },
+        { "syslog-priority",             ITEM_INT,    offsetof(ExecContext, syslog_priority)               },
+        { "syslog-identifier",           ITEM_STRING, offsetof(ExecContext, syslog_identifier)             },
+        { "syslog-level-prefix",         ITEM_BOOL,   offsetof(ExecContext, syslog_level_prefix)           },
+        { "cpu-sched-reset-on-fork",     ITEM_BOOL,   offsetof(ExecContext, cpu_sched_reset_on_fork)       },
+        { "non-blocking",                ITEM_BOOL,   offsetof(ExecContext, non_blocking)                  },
+        { "private-tmp",                 ITEM_BOOL,   offsetof(ExecContext, private_tmp)                   },
+        { "private-network",             ITEM_BOOL,   offsetof(ExecContext, private_network)               },
+        { "private-devices",             ITEM_BOOL,   offsetof(ExecContext, private_devices)               },
+        { "protect-system",              ITEM_INT,    offsetof(ExecContext, protect_system)                },
+        { "protect-home",                ITEM_INT,    offsetof(ExecContext, protect_home)                  },
+        { "no-new-privileges",           ITEM_BOOL,   offsetof(ExecContext, no_new_privileges)             },
+        { "same-pgrp",                   ITEM_BOOL,   offsetof(ExecContext, same_pgrp)                     },
+        { "personality",                 ITEM_ULONG,  offsetof(ExecContext, personality)                   },
+        { "syscall-errno",               ITEM_INT,    offsetof(ExecContext, syscall_errno)                 },
+        { "runtime-directory",           ITEM_STRV,   offsetof(ExecContext, runtime_directory)             },
+        { "runtime-directory-mode",      ITEM_MODE,   offsetof(ExecContext, runtime_directory_mode)        },
+};
+
+static const Item params_items[] = {
+        { "params-environment",          ITEM_STRV,   offsetof(ExecParameters, environment)                },
+        { "apply-permissions",           ITEM_BOOL,   offsetof(ExecParameters, apply_permissions)          },
+        { "apply-chroot",                ITEM_BOOL,   offsetof(ExecParameters, apply_chroot)               },
+        { "apply-tty-stdin",             ITEM_BOOL,   offsetof(ExecParameters, apply_tty_stdin)            },
+        { "selinux-context-net",         ITEM_BOOL,   offsetof(ExecParameters, selinux_context_net)        },
+        { "cgroup-supported",            ITEM_INT,    offsetof(ExecParameters, cgroup_supported)           },
+        { "cgroup-path",                 ITEM_STRING, offsetof(ExecParameters, cgroup_path)                },
+        { "runtime-prefix",              ITEM_STRING, offsetof(ExecParameters, runtime_prefix)             },
+        { "unit-id",                     ITEM_STRING, offsetof(ExecParameters, unit_id)                    },
+        { "watchdog-usec",               ITEM_UINT64, offsetof(ExecParameters, watchdog_usec)              },
+};
+
+static const Item runtime_items[] = {
+        { "tmp-dir",                     ITEM_STRING, offsetof(ExecRuntime, tmp_dir)                       },
+        { "var-tmp-dir",                 ITEM_STRING, offsetof(ExecRuntime, var_tmp_dir)                   },
+};
+
+/* Everything the helper needs to fork off one process */
+typedef struct ExecRequest {
+        ExecCommand command;
+        ExecContext context;
+        ExecParameters params;
+        ExecRuntime runtime;
+        bool has_runtime;
+        char **files_env;
+        int idle_pipe[4];
+
+        int *fds;
+        unsigned n_fds;
+} ExecRequest;
+
+static void serialize_items(SerializeState *st, const Item *items, unsigned n, const void *base) {
+        unsigned i;
+
+        for (i = 0; i < n; i++) {
+                const void *p = (const uint8_t*) base + items[i].offset;
+                char **s;
+
+                switch (items[i].type) {
+
+                case ITEM_BOOL:
+                        serialize_item(st, items[i].key, yes_no(*(const bool*) p));
+                        break;
+
+                case ITEM_INT:
+                        serialize_item_format(st, items[i].key, "%i", *(const int*) p);
+                        break;
+
+                case ITEM_MODE:
+                        serialize_item_format(st, items[i].key, "%u", (unsigned) *(const mode_t*) p);
+                        break;
+
+                case ITEM_ULONG:
+                        serialize_item_format(st, items[i].key, "%lu", *(const unsigned long*) p);
+                        break;
+
+                case ITEM_UINT64:
+                        serialize_item_format(st, items[i].key, "%" PRIu64, *(const uint64_t*) p);
+                        break;
+
+                case ITEM_STRING:
+                        if (*(char* const*) p)
+                                serialize_item(st, items[i].key, *(char* const*) p);
+                        break;
+
+                case ITEM_STRV:
+                        STRV_FOREACH(s, *(char** const*) p)
+                                serialize_item(st, items[i].key, *s);
+                        break;
+                }
+        }
+}
+
+static int parse_item(const Item *items, unsigned n, void *base, const char *key, const char *value) {
+        unsigned i;
+        int r;
+
+        /* Returns 0 if the key is not one of the items, 1 if it was
+         * parsed */
+
+        for (i = 0; i < n; i++) {
+                void *p = (uint8_t*) base + items[i].offset;
+                unsigned u;
+                char *s;
+
+                if (!streq(items[i].key, key))
+                        continue;
+
+                switch (items[i].type) {
+
+                case ITEM_BOOL:
+                        r = parse_boolean(value);
+                        if (r < 0)
+                                return r;
+
+                        *(bool*) p = r;
+                        return 1;
+
+                case ITEM_INT:
+                        return safe_atoi(value, p) < 0 ? -EINVAL : 1;
+
+                case ITEM_MODE:
+                        if (safe_atou(value, &u) < 0)
+                                return -EINVAL;
+
+                        *(mode_t*) p = (mode_t) u;
+                        return 1;
+
+                case ITEM_ULONG:
+                        return safe_atolu(value, p) < 0 ? -EINVAL : 1;
+
+                case ITEM_UINT64:
+                        return safe_atou64(value, p) < 0 ? -EINVAL : 1;
+
+                case ITEM_STRING:
+                        s = strdup(value);
+                        if (!s)
+                                return -ENOMEM;
+
+                        free(*(char**) p);
+                        *(char**) p = s;
+                        return 1;
+
+                case ITEM_STRV:
+                        s = strdup(value);
+                        if (!s)
+                                return -ENOMEM;
+
+                        r = strv_consume((char***) p, s);
+                        if (r < 0)
+                                return r;
+
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+static void serialize_set(SerializeState *st, const char *key, Set *s) {
+        Iterator i;
+        void *p;
+
+        /* The sets only contain integers, which we pass as they
+         * are stored */
+        SET_FOREACH(p, s, i)
+                serialize_item_format(st, key, "%lu", PTR_TO_ULONG(p));
+}
+
+static int deserialize_set(Set **s, const char *value) {
+        unsigned long u;
+        int r;
+
+        if (safe_atolu(value, &u) < 0)
+                return -EINVAL;
+
+        r = set_ensure_allocated(s, NULL);
+        if (r < 0)
+                return r;
+
+        r = set_put(*s, ULONG_TO_PTR(u));
+        if (r < 0 && r != -EEXIST)
+                return r;
+
+        return 0;
+}
+
+static int serialize_context(SerializeState *st, const ExecContext *c) {
+        unsigned l;
+
+        serialize_items(st, context_items, ELEMENTSOF(context_items), c);
+
+        for (l = 0; l < ELEMENTSOF(c->rlimit); l++)
+                if (c->rlimit[l])
+                        serialize_item_format(st, "rlimit", "%u %llu %llu", l,
+                                (unsigned long long) c->rlimit[l]->rlim_cur,
+                                (unsigned long long) c->rlimit[l]->rlim_max);
+
+        if (c->cpuset) {
+                unsigned k;
+
+                serialize_item_format(st, "cpu-affinity-ncpus", "%u", c->cpuset_ncpus);
+
+                for (k = 0; k < c->cpuset_ncpus; k++)
+                        if (CPU_ISSET_S(k, CPU_ALLOC_SIZE(c->cpuset_ncpus), c->cpuset))
+                                serialize_item_format(st, "cpu-affinity", "%u", k);
+        }
+
+        if (c->capabilities) {
+                char *t;
+
+                t = cap_to_text(c->capabilities, NULL);
+                if (!t)
+                        return -ENOMEM;
+
+                serialize_item(st, "capabilities", t);
+                cap_free(t);
+        }
+
+        serialize_set(st, "syscall-filter", c->syscall_filter);
+        serialize_set(st, "syscall-arch", c->syscall_archs);
+        serialize_set(st, "address-family", c->address_families);
+
+        serialize_item(st, "syscall-whitelist", yes_no(c->syscall_whitelist));
+        serialize_item(st, "address-families-whitelist", yes_no(c->address_families_whitelist));
+        serialize_item(st, "oom-score-adjust-set", yes_no(c->oom_score_adjust_set));
+        serialize_item(st, "nice-set", yes_no(c->nice_set));
+        serialize_item(st, "ioprio-set", yes_no(c->ioprio_set));
+        serialize_item(st, "cpu-sched-set", yes_no(c->cpu_sched_set));
+        serialize_item(st, "no-new-privileges-set", yes_no(c->no_new_privileges_set));
+
+        return 0;
+}
+
+static int deserialize_context_item(ExecContext *c, const char *key, const char *value) {
+        int r;
+
+        r = parse_item(context_items, ELEMENTSOF(context_items), c, key, value);
+        if (r != 0)
+                return r;
+
+        if (streq(key, "rlimit")) {
+                unsigned long long cur, max;
+                unsigned l;
+
+                if (sscanf(value, "%u %llu %llu", &l, &cur, &max) != 3 || l >= ELEMENTSOF(c->rlimit))
+                        return -EINVAL;
+
+                if (!c->rlimit[l]) {
+                        c->rlimit[l] = new(struct rlimit, 1);
+                        if (!c->rlimit[l])
+                                return -ENOMEM;
+                }
+
+                c->rlimit[l]->rlim_cur = (rlim_t) cur;
+                c->rlimit[l]->rlim_max = (rlim_t) max;
+
+        } else if (streq(key, "cpu-affinity-ncpus")) {
+                unsigned n;
+
+                if (safe_atou(value, &n) < 0 || n == 0 || c->cpuset)
+                        return -EINVAL;
+
+                c->cpuset = CPU_ALLOC(n);
+                if (!c->cpuset)
+                        return -ENOMEM;
+
+                CPU_ZERO_S(CPU_ALLOC_SIZE(n), c->cpuset);
+                c->cpuset_ncpus = n;
+
+        } else if (streq(key, "cpu-affinity")) {
+                unsigned k;
+
+                if (safe_atou(value, &k) < 0 || !c->cpuset || k >= c->cpuset_ncpus)
+                        return -EINVAL;
+
+                CPU_SET_S(k, CPU_ALLOC_SIZE(c->cpuset_ncpus), c->cpuset);
+
+        } else if (streq(key, "capabilities")) {
+                if (c->capabilities)
+                        cap_free(c->capabilities);
+
+                c->capabilities = cap_from_text(value);
+                if (!c->capabilities)
+                        return errno ? -errno : -EINVAL;
+
+        } else if (streq(key, "syscall-filter"))
+                return deserialize_set(&c->syscall_filter, value);
+        else if (streq(key, "syscall-arch"))
+                return deserialize_set(&c->syscall_archs, value);
+        else if (streq(key, "address-family"))
+                return deserialize_set(&c->address_families, value);
+        else {
+                r = parse_boolean(value);
+                if (r < 0)
+                        return -EINVAL;
+
+                if (streq(key, "syscall-whitelist"))
+                        c->syscall_whitelist = r;
+                else if (streq(key, "address-families-whitelist"))
+                        c->address_families_whitelist = r;
+                else if (streq(key, "oom-score-adjust-set"))
+                        c->oom_score_adjust_set = r;
+                else if (streq(key, "nice-set"))
+                        c->nice_set = r;
+                else if (streq(key, "ioprio-set"))
+                        c->ioprio_set = r;
+                else if (streq(key, "cpu-sched-set"))
+                        c->cpu_sched_set = r;
+                else if (streq(key, "no-new-privileges-set"))
+                        c->no_new_privileges_set = r;
+                else
+                        return -EINVAL;
+        }
+
+        return 0;
+}
+
+static int add_fd(int *fds, unsigned *n_fds, int fd) {
+        if (*n_fds >= HELPER_FDS_MAX)
+                return -E2BIG;
+
+        fds[(*n_fds)++] = fd;
+        return (int) *n_fds - 1;
+}
+
+static int serialize_request(
+                SerializeState *st,
+                int *fds, unsigned *n_fds,
+                ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                ExecRuntime *runtime,
+                char **argv,
+                char **files_env) {
+
+        unsigned k;
+        char **s;
+        int r;
+
+        serialize_item(st, "path", command->path);
+
+        STRV_FOREACH(s, argv)
+                serialize_item(st, "argv", *s);
+
+        STRV_FOREACH(s, files_env)
+                serialize_item(st, "files-env", *s);
+
+        r = serialize_context(st, context);
+        if (r < 0)
+                return r;
+
+        serialize_items(st, params_items, ELEMENTSOF(params_items), params);
+
+        /* The fds to pass on go first, in order */
+        for (k = 0; k < params->n_fds; k++) {
+                r = add_fd(fds, n_fds, params->fds[k]);
+                if (r < 0)
+                        return r;
+        }
+        serialize_item_format(st, "n-fds", "%u", params->n_fds);
+
+        if (params->idle_pipe)
+                for (k = 0; k < 4; k++) {
+                        if (params->idle_pipe[k] < 0)
+                                continue;
+
+                        r = add_fd(fds, n_fds, params->idle_pipe[k]);
+                        if (r < 0)
+                                return r;
+
+                        serialize_item_format(st, "idle-pipe", "%u %i", k, r);
+                }
+
+        if (runtime) {
+                serialize_items(st, runtime_items, ELEMENTSOF(runtime_items), runtime);
+
+                for (k = 0; k < 2; k++) {
+                        if (runtime->netns_storage_socket[k] < 0)
+                                continue;
+
+                        r = add_fd(fds, n_fds, runtime->netns_storage_socket[k]);
+                        if (r < 0)
+                                return r;
+
+                        serialize_item_format(st, "netns-socket", "%u %i", k, r);
+                }
+
+                serialize_item(st, "runtime", "yes");
+        }
+
+        return 0;
+}
+
+static int fd_index(ExecRequest *req, const char *value, unsigned *k, int *fd) {
+        unsigned i;
+
+        if (sscanf(value, "%u %u", k, &i) != 2 || i >= req->n_fds)
+                return -EINVAL;
+
+        *fd = req->fds[i];
+        return 0;
+}
+
+static int deserialize_request_item(ExecRequest *req, const char *key, const char *value) {
+        unsigned k;
+        char *s;
+        int r, fd;
+
+        if (streq(key, "path")) {
+                s = strdup(value);
+                if (!s)
+                        return -ENOMEM;
+
+                free(req->command.path);
+                req->command.path = s;
+
+        } else if (streq(key, "argv")) {
+                s = strdup(value);
+                if (!s)
+                        return -ENOMEM;
+
+                return strv_consume(&req->command.argv, s);
+
+        } else if (streq(key, "files-env")) {
+                s = strdup(value);
+                if (!s)
+                        return -ENOMEM;
+
+                return strv_consume(&req->files_env, s);
+
+        } else if (streq(key, "n-fds")) {
+                if (safe_atou(value, &k) < 0 || k > req->n_fds)
+                        return -EINVAL;
+
+                req->params.fds = k > 0 ? req->fds : NULL;
+                req->params.n_fds = k;
+
+        } else if (streq(key, "idle-pipe")) {
+                r = fd_index(req, value, &k, &fd);
+                if (r < 0 || k >= 4)
+                        return -EINVAL;
+
+                req->idle_pipe[k] = fd;
+                req->params.idle_pipe = req->idle_pipe;
+
+        } else if (streq(key, "netns-socket")) {
+                r = fd_index(req, value, &k, &fd);
+                if (r < 0 || k >= 2)
+                        return -EINVAL;
+
+                req->runtime.netns_storage_socket[k] = fd;
+
+        } else if (streq(key, "runtime"))
+                req->has_runtime = true;
+        else {
+                r = parse_item(params_items, ELEMENTSOF(params_items), &req->params, key, value);
+                if (r != 0)
+                        return r;
+
+                r = parse_item(runtime_items, ELEMENTSOF(runtime_items), &req->runtime, key, value);
+                if (r != 0)
+                        return r;
+
+                return deserialize_context_item(&req->context, key, value);
+        }
+
+        return 0;
+}
+
+static void exec_request_init(ExecRequest *req) {
+        zero(*req);
+
+        exec_context_init(&req->context);
+
+        req->params.bus_endpoint_fd = -1;
+        req->runtime.netns_storage_socket[0] = req->runtime.netns_storage_socket[1] = -1;
+        req->idle_pipe[0] = req->idle_pipe[1] = req->idle_pipe[2] = req->idle_pipe[3] = -1;
+}
+
+static void exec_request_done(ExecRequest *req) {
+        exec_command_done(&req->command);
+        exec_context_done(&req->context);
+
+        strv_free(req->params.environment);
+        free((char*) req->params.cgroup_path);
+        free((char*) req->params.runtime_prefix);
+        free((char*) req->params.unit_id);
+
+        free(req->runtime.tmp_dir);
+        free(req->runtime.var_tmp_dir);
+
+        strv_free(req->files_env);
+
+        /* All fds we got are in here, including those referenced
+         * above */
+        close_many(req->fds, req->n_fds);
+}
+
+static int helper_child(void *userdata) {
+        ExecRequest *req = userdata;
+
+        exec_spawn_child(&req->command,
+                         &req->context,
+                         &req->params,
+                         req->has_runtime ? &req->runtime : NULL,
+                         req->command.argv,
+                         req->files_env);
+}
+
+static int helper_handle_request(int fd, void *stack) {
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(int) * HELPER_FDS_MAX)];
+        } control = {};
+        struct msghdr mh = {
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+        };
+        _cleanup_free_ char *buf = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_serialize_state_free_ SerializeState *st = NULL;
+        char *key, *value;
+        int fds[HELPER_FDS_MAX];
+        struct cmsghdr *cmsg;
+        struct iovec iov;
+        ExecRequest req;
+        ssize_t n;
+        int32_t reply;
+        pid_t pid;
+        int r;
+
+        /* Returns 0 on EOF, i.e. when PID 1 went away */
+
+        n = recv(fd, NULL, 0, MSG_PEEK|MSG_TRUNC);
+        if (n < 0)
+                return errno == EINTR ? 1 : -errno;
+        if (n == 0)
+                return 0;
+
+        buf = new(char, n + 1);
+        if (!buf)
+                return -ENOMEM;
+
+        iov.iov_base = buf;
+        iov.iov_len = n;
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+
+        n = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+        if (n < 0)
+                return -errno;
+        buf[n] = 0;
+
+        exec_request_init(&req);
+        req.fds = fds;
+
+        for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg))
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                        req.n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                        memcpy(fds, CMSG_DATA(cmsg), req.n_fds * sizeof(int));
+                }
+
+        f = fmemopen(buf, n, "re");
+        if (!f) {
+                r = -errno;
+                goto finish;
+        }
+
+        r = deserialize_begin(f, &st);
+        if (r < 0)
+                goto finish;
+
+        while ((r = deserialize_item(st, &key, &value)) > 0) {
+                r = deserialize_request_item(&req, key, value);
+                if (r < 0) {
+                        log_error("Failed to parse exec request item %s: %s", key, strerror(-r));
+                        break;
+                }
+        }
+
+        st = serialize_state_free(st);
+        if (r < 0)
+                goto finish;
+
+        if (!req.command.path || strv_isempty(req.command.argv)) {
+                r = -EINVAL;
+                goto finish;
+        }
+
+        /* The child shall be a child of PID 1, not ours, so that it
+         * is notified when it dies */
+        pid = clone(helper_child, (uint8_t*) stack + HELPER_STACK_SIZE, CLONE_PARENT|SIGCHLD, &req);
+        r = pid < 0 ? -errno : (int) pid;
+
+finish:
+        reply = r;
+        exec_request_done(&req);
+
+        if (send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) < 0)
+                return -errno;
+
+        return 1;
+}
+
+static noreturn void helper_main(int fd) {
+        void *stack;
+        int r;
+
+        stack = mmap(NULL, HELPER_STACK_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED) {
+                log_error("Failed to allocate stack for exec helper: %m");
+                _exit(EXIT_FAILURE);
+        }
+
+        do
+                r = helper_handle_request(fd, stack);
+        while (r > 0);
+
+        if (r < 0)
+                log_error("Exec helper failed: %s", strerror(-r));
+
+        _exit(r < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int exec_helper_new(ExecHelper **ret) {
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        ExecHelper *h;
+        pid_t pid;
+
+        assert(ret);
+
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, pair) < 0)
+                return -errno;
+
+        h = new0(ExecHelper, 1);
+        if (!h)
+                return -ENOMEM;
+
+        pid = fork();
+        if (pid < 0) {
+                free(h);
+                return -errno;
+        }
+
+        if (pid == 0) {
+                /* child */
+
+                reset_all_signal_handlers();
+                reset_signal_mask();
+
+                /* Go away with PID 1 */
+                prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+                log_forget_fds();
+                close_all_fds(pair + 1, 1);
+                log_open();
+
+                rename_process("(sd-exec)");
+
+                helper_main(pair[1]);
+        }
+
+        h->pid = pid;
+        h->fd = pair[0];
+        h->timeout = HELPER_TIMEOUT_USEC;
+        pair[0] = -1;
+
+        log_debug("Forked exec helper as "PID_FMT".", pid);
+
+        *ret = h;
+        return 0;
+}
+
+ExecHelper* exec_helper_free(ExecHelper *h) {
+        if (!h)
+                return NULL;
+
+        /* The helper exits as soon as it sees the socket closed, and
+         * is reaped like any other process of ours */
+        safe_close(h->fd);
+        free(h);
+
+        return NULL;
+}
+
+static void exec_helper_kill(ExecHelper *h) {
+        siginfo_t si = {};
+
+        /* Once the helper is reaped its PID might be reused, hence
+         * only kill it if it is not. We reap from this thread only,
+         * so this cannot change in between. */
+        if (waitid(P_PID, h->pid, &si, WEXITED|WNOHANG|WNOWAIT) < 0)
+                return;
+
+        kill(h->pid, SIGKILL);
+}
+
+static void exec_helper_disable(ExecHelper *h, int error) {
+        log_warning("Exec helper "PID_FMT" failed, forking directly from now on: %s", h->pid, strerror(-error));
+
+        h->fd = safe_close(h->fd);
+        exec_helper_kill(h);
+}
+
+static int exec_helper_recv_reply(ExecHelper *h, usec_t timeout, int32_t *reply) {
+        ssize_t n;
+        int r;
+
+        do
+                r = fd_wait_for_event(h->fd, POLLIN, timeout);
+        while (r == -EINTR);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -ETIMEDOUT;
+
+        n = recv(h->fd, reply, sizeof(*reply), MSG_DONTWAIT);
+        if (n < 0)
+                return -errno;
+        if (n == 0)
+                return -ECONNRESET;
+        if (n != sizeof(*reply))
+                return -EIO;
+
+        return 0;
+}
+
+int exec_helper_spawn(ExecHelper *h,
+                      ExecCommand *command,
+                      const ExecContext *context,
+                      const ExecParameters *params,
+                      ExecRuntime *runtime,
+                      char **argv,
+                      char **files_env,
+                      pid_t *ret) {
+
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(int) * HELPER_FDS_MAX)];
+        } control = {};
+        struct msghdr mh = {};
+        _cleanup_free_ char *buf = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_serialize_state_free_ SerializeState *st = NULL;
+        int fds[HELPER_FDS_MAX];
+        unsigned n_fds = 0;
+        struct iovec iov;
+        int32_t reply;
+        size_t size;
+        int r;
+
+        assert(h);
+        assert(command);
+        assert(context);
+        assert(params);
+        assert(ret);
+
+        if (h->fd < 0)
+                return -EOPNOTSUPP;
+
+        /* Asking on the console and setting up bus endpoints needs
+         * state only we have */
+        if (params->confirm_spawn ||
+            params->bus_endpoint_fd >= 0 ||
+            params->bus_endpoint_path ||
+            context->bus_endpoint)
+                return -EOPNOTSUPP;
+
+        f = open_memstream(&buf, &size);
+        if (!f)
+                return -ENOMEM;
+
+        r = serialize_begin(f, SERIALIZATION_BINARY, &st);
+        if (r < 0)
+                return r;
+
+        r = serialize_request(st, fds, &n_fds, command, context, params, runtime, argv, files_env);
+        st = serialize_state_free(st);
+        if (r == -E2BIG)
+                return -EOPNOTSUPP;
+        if (r < 0)
+                return r;
+
+        if (fflush(f) != 0 || ferror(f))
+                return -ENOMEM;
+
+        iov.iov_base = buf;
+        iov.iov_len = size;
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+
+        if (n_fds > 0) {
+                struct cmsghdr *cmsg;
+
+                mh.msg_control = &control;
+                mh.msg_controllen = CMSG_SPACE(sizeof(int) * n_fds);
+
+                cmsg = CMSG_FIRSTHDR(&mh);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int) * n_fds);
+                memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * n_fds);
+        }
+
+        /* Until the request is queued we may still fork ourselves
+         * instead. Never wait for a busy helper to make room. */
+        if (sendmsg(h->fd, &mh, MSG_NOSIGNAL|MSG_DONTWAIT) < 0) {
+                r = -errno;
+
+                /* Too large requests we simply handle ourselves */
+                if (r != -EMSGSIZE)
+                        exec_helper_disable(h, r);
+
+                return -EOPNOTSUPP;
+        }
+
+        /* From now on the helper might already have forked off the
+         * process, hence on failure we must not fork it a second
+         * time. The helper answers right after clone(), it never
+         * waits for the child, so this does not take long unless
+         * the helper is stopped or wedged. */
+        r = exec_helper_recv_reply(h, h->timeout, &reply);
+        if (r == -ETIMEDOUT) {
+                /* Kill it, and wait a moment for it to go away. If
+                 * it got as far as answering, we take the answer,
+                 * otherwise we fork ourselves. Only if it is killed
+                 * right between forking and answering the process
+                 * is started twice. A helper that does not even go
+                 * away is not going to fork anything either. */
+                exec_helper_kill(h);
+
+                r = exec_helper_recv_reply(h, HELPER_KILL_TIMEOUT_USEC, &reply);
+                exec_helper_disable(h, -ETIMEDOUT);
+                if (IN_SET(r, -ETIMEDOUT, -ECONNRESET))
+                        return -EOPNOTSUPP;
+        }
+        if (r < 0) {
+                if (h->fd >= 0)
+                        exec_helper_disable(h, r);
+                return r;
+        }
+
+        if (reply <= 0)
+                return reply < 0 ? reply : -EIO;
+
+        *ret = (pid_t) reply;
+        return 0;
+}
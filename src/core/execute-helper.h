@@ -0,0 +1,54 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "execute.h"
+
+/* A small process forked off early, while we are still small
+ * ourselves. It receives the serialized execution parameters and
+ * the fds to pass over a socket, and forks off the actual service
+ * process on our behalf, with us as its parent. This way spawning
+ * does not need to copy the page tables of a large PID 1. */
+
+struct ExecHelper {
+        pid_t pid;
+        int fd;
+
+        /* How long to wait for an answer before giving up on it */
+        usec_t timeout;
+};
+
+int exec_helper_new(ExecHelper **ret);
+ExecHelper* exec_helper_free(ExecHelper *h);
+
+/* Returns -EOPNOTSUPP if the helper was not asked, or hung and was
+ * killed without answering, in which case the caller should fork
+ * itself. Any other error means the helper might have received the
+ * request, and the spawn must be considered failed. */
+int exec_helper_spawn(ExecHelper *h,
+                      ExecCommand *command,
+                      const ExecContext *context,
+                      const ExecParameters *params,
+                      ExecRuntime *runtime,
+                      char **argv,
+                      char **files_env,
+                      pid_t *ret);
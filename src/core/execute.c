@@ -78,6 +78,7 @@
 #include "fileio.h"
 #include "unit.h"
 #include "async.h"
+#include "execute-helper.h"
 #include "selinux-util.h"
 #include "errno-list.h"
 #include "af-list.h"
@@ -1752,6 +1753,70 @@ static int exec_child(ExecCommand *command,
         return -errno;
 }
 
+static int exec_split_fds(const ExecContext *context,
+                          const ExecParameters *params,
+                          int *socket_fd,
+                          int **fds, unsigned *n_fds) {
+
+        if (context->std_input == EXEC_INPUT_SOCKET ||
+            context->std_output == EXEC_OUTPUT_SOCKET ||
+            context->std_error == EXEC_OUTPUT_SOCKET) {
+
+                if (params->n_fds != 1)
+                        return -EINVAL;
+
+                *socket_fd = params->fds[0];
+                *fds = NULL;
+                *n_fds = 0;
+        } else {
+                *socket_fd = -1;
+                *fds = params->fds;
+                *n_fds = params->n_fds;
+        }
+
+        return 0;
+}
+
+void exec_spawn_child(ExecCommand *command,
+                      const ExecContext *context,
+                      const ExecParameters *params,
+                      ExecRuntime *runtime,
+                      char **argv,
+                      char **files_env) {
+
+        int *fds, socket_fd;
+        unsigned n_fds;
+        int r = EXIT_FDS, err;
+
+        /* Runs in the freshly forked child, either of ourselves or
+         * of the exec helper, and never returns */
+
+        err = exec_split_fds(context, params, &socket_fd, &fds, &n_fds);
+        if (err >= 0)
+                err = exec_child(command,
+                                 context,
+                                 params,
+                                 runtime,
+                                 argv,
+                                 socket_fd,
+                                 fds, n_fds,
+                                 files_env,
+                                 &r);
+        if (r != 0) {
+                log_open();
+                log_struct(LOG_ERR, MESSAGE_ID(SD_MESSAGE_SPAWN_FAILED),
+                           "EXECUTABLE=%s", command->path,
+                           "MESSAGE=Failed at step %s spawning %s: %s",
+                                  exit_status_to_string(r, EXIT_STATUS_SYSTEMD),
+                                  command->path, strerror(-err),
+                           "ERRNO=%d", -err,
+                           NULL);
+                log_close();
+        }
+
+        _exit(r);
+}
+
 int exec_spawn(ExecCommand *command,
                const ExecContext *context,
                const ExecParameters *params,
@@ -1759,10 +1824,10 @@ int exec_spawn(ExecCommand *command,
                pid_t *ret) {
 
         _cleanup_strv_free_ char **files_env = NULL;
-        int *fds = NULL; unsigned n_fds = 0;
+        int *fds, socket_fd;
+        unsigned n_fds;
         char *line, **argv;
-        int socket_fd;
-        pid_t pid;
+        pid_t pid = 0;
         int err;
 
         assert(command);
@@ -1771,19 +1836,9 @@ int exec_spawn(ExecCommand *command,
         assert(params);
         assert(params->fds || params->n_fds <= 0);
 
-        if (context->std_input == EXEC_INPUT_SOCKET ||
-            context->std_output == EXEC_OUTPUT_SOCKET ||
-            context->std_error == EXEC_OUTPUT_SOCKET) {
-
-                if (params->n_fds != 1)
-                        return -EINVAL;
-
-                socket_fd = params->fds[0];
-        } else {
-                socket_fd = -1;
-                fds = params->fds;
-                n_fds = params->n_fds;
-        }
+        err = exec_split_fds(context, params, &socket_fd, &fds, &n_fds);
+        if (err < 0)
+                return err;
 
         err = exec_context_load_environment(context, params->unit_id, &files_env);
         if (err < 0) {
@@ -1808,35 +1863,30 @@ int exec_spawn(ExecCommand *command,
                         NULL);
         free(line);
 
-        pid = fork();
-        if (pid < 0)
-                return -errno;
+        /* Forking off a large PID 1 is expensive, hence let the exec
+         * helper do it if we have one and it can handle this
+         * context. We fork ourselves only if the helper never got
+         * the request, as otherwise the process might end up being
+         * started twice. */
+        if (params->exec_helper) {
+                err = exec_helper_spawn(params->exec_helper, command, context, params, runtime, argv, files_env, &pid);
+                if (err == -EOPNOTSUPP)
+                        pid = 0;
+                else if (err < 0) {
+                        log_warning_unit(params->unit_id,
+                                         "Failed to spawn %s via exec helper: %s",
+                                         command->path, strerror(-err));
+                        return err;
+                }
+        }
 
         if (pid == 0) {
-                int r;
-
-                err = exec_child(command,
-                                 context,
-                                 params,
-                                 runtime,
-                                 argv,
-                                 socket_fd,
-                                 fds, n_fds,
-                                 files_env,
-                                 &r);
-                if (r != 0) {
-                        log_open();
-                        log_struct(LOG_ERR, MESSAGE_ID(SD_MESSAGE_SPAWN_FAILED),
-                                   "EXECUTABLE=%s", command->path,
-                                   "MESSAGE=Failed at step %s spawning %s: %s",
-                                          exit_status_to_string(r, EXIT_STATUS_SYSTEMD),
-                                          command->path, strerror(-err),
-                                   "ERRNO=%d", -err,
-                                   NULL);
-                        log_close();
-                }
+                pid = fork();
+                if (pid < 0)
+                        return -errno;
 
-                _exit(r);
+                if (pid == 0)
+                        exec_spawn_child(command, context, params, runtime, argv, files_env);
         }
 
         log_struct_unit(LOG_DEBUG,
@@ -2664,19 +2714,19 @@ ExecRuntime *exec_runtime_unref(ExecRuntime *r) {
         return NULL;
 }
 
-int exec_runtime_serialize(ExecRuntime *rt, Unit *u, FILE *f, FDSet *fds) {
+int exec_runtime_serialize(ExecRuntime *rt, Unit *u, SerializeState *st, FDSet *fds) {
         assert(u);
-        assert(f);
+        assert(st);
         assert(fds);
 
         if (!rt)
                 return 0;
 
         if (rt->tmp_dir)
-                unit_serialize_item(u, f, "tmp-dir", rt->tmp_dir);
+                unit_serialize_item(u, st, "tmp-dir", rt->tmp_dir);
 
         if (rt->var_tmp_dir)
-                unit_serialize_item(u, f, "var-tmp-dir", rt->var_tmp_dir);
+                unit_serialize_item(u, st, "var-tmp-dir", rt->var_tmp_dir);
 
         if (rt->netns_storage_socket[0] >= 0) {
                 int copy;
@@ -2685,7 +2735,7 @@ int exec_runtime_serialize(ExecRuntime *rt, Unit *u, FILE *f, FDSet *fds) {
                 if (copy < 0)
                         return copy;
 
-                unit_serialize_item_format(u, f, "netns-socket-0", "%i", copy);
+                unit_serialize_item_format(u, st, "netns-socket-0", "%i", copy);
         }
 
         if (rt->netns_storage_socket[1] >= 0) {
@@ -2695,7 +2745,7 @@ int exec_runtime_serialize(ExecRuntime *rt, Unit *u, FILE *f, FDSet *fds) {
                 if (copy < 0)
                         return copy;
 
-                unit_serialize_item_format(u, f, "netns-socket-1", "%i", copy);
+                unit_serialize_item_format(u, st, "netns-socket-1", "%i", copy);
         }
 
         return 0;
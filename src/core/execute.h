@@ -26,6 +26,7 @@ typedef struct ExecCommand ExecCommand;
 typedef struct ExecContext ExecContext;
 typedef struct ExecRuntime ExecRuntime;
 typedef struct ExecParameters ExecParameters;
+typedef struct ExecHelper ExecHelper;
 
 #include <linux/types.h>
 #include <sys/time.h>
@@ -39,6 +40,7 @@ typedef struct ExecParameters ExecParameters;
 #include "util.h"
 #include "set.h"
 #include "fdset.h"
+#include "serialize.h"
 #include "missing.h"
 #include "namespace.h"
 #include "bus-endpoint.h"
@@ -213,6 +215,7 @@ struct ExecParameters {
         int *idle_pipe;
         char *bus_endpoint_path;
         int bus_endpoint_fd;
+        ExecHelper *exec_helper;
 };
 
 int exec_spawn(ExecCommand *command,
@@ -221,6 +224,13 @@ int exec_spawn(ExecCommand *command,
                ExecRuntime *runtime,
                pid_t *ret);
 
+noreturn void exec_spawn_child(ExecCommand *command,
+                               const ExecContext *context,
+                               const ExecParameters *params,
+                               ExecRuntime *runtime,
+                               char **argv,
+                               char **files_env);
+
 void exec_command_done(ExecCommand *c);
 void exec_command_done_array(ExecCommand *c, unsigned n);
 
@@ -253,7 +263,7 @@ int exec_runtime_make(ExecRuntime **rt, ExecContext *c, const char *id);
 ExecRuntime *exec_runtime_ref(ExecRuntime *r);
 ExecRuntime *exec_runtime_unref(ExecRuntime *r);
 
-int exec_runtime_serialize(ExecRuntime *rt, Unit *u, FILE *f, FDSet *fds);
+int exec_runtime_serialize(ExecRuntime *rt, Unit *u, SerializeState *st, FDSet *fds);
 int exec_runtime_deserialize_item(ExecRuntime **rt, Unit *u, const char *key, const char *value, FDSet *fds);
 
 void exec_runtime_destroy(ExecRuntime *rt);
@@ -38,6 +38,7 @@
 #include "async.h"
 #include "virt.h"
 #include "dbus.h"
+#include "serialize.h"
 
 Job* job_new_raw(Unit *unit) {
         Job *j;
@@ -112,6 +113,8 @@ void job_uninstall(Job *j) {
 
         *pj = NULL;
 
+        /* The unit's Job property changed */
+        unit_add_to_dbus_queue(j->unit);
         unit_add_to_gc_queue(j->unit);
 
         hashmap_remove(j->manager->jobs, UINT32_TO_PTR(j->id));
@@ -192,6 +195,7 @@ Job* job_install(Job *j) {
         *pj = j;
         j->installed = true;
         j->manager->n_installed_jobs ++;
+        unit_add_to_dbus_queue(j->unit);
         log_debug_unit(j->unit->id,
                        "Installed new job %s/%s as %u",
                        j->unit->id, job_type_to_string(j->type), (unsigned) j->id);
@@ -393,7 +397,7 @@ int job_type_merge_and_collapse(JobType *a, JobType b, Unit *u) {
 }
 
 static bool job_is_runnable(Job *j) {
-        Iterator i;
+        unsigned i;
         Unit *other;
 
         assert(j);
@@ -425,7 +429,7 @@ static bool job_is_runnable(Job *j) {
                  * dependencies, regardless whether they are
                  * starting or stopping something. */
 
-                SET_FOREACH(other, j->unit->dependencies[UNIT_AFTER], i)
+                UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER, i)
                         if (other->job)
                                 return false;
         }
@@ -433,7 +437,7 @@ static bool job_is_runnable(Job *j) {
         /* Also, if something else is being stopped and we should
          * change state after it, then lets wait. */
 
-        SET_FOREACH(other, j->unit->dependencies[UNIT_BEFORE], i)
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE, i)
                 if (other->job &&
                     (other->job->type == JOB_STOP ||
                      other->job->type == JOB_RESTART))
@@ -748,7 +752,7 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive) {
         Unit *u;
         Unit *other;
         JobType t;
-        Iterator i;
+        unsigned i;
 
         assert(j);
         assert(j->installed);
@@ -793,19 +797,19 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive) {
                 if (t == JOB_START ||
                     t == JOB_VERIFY_ACTIVE) {
 
-                        SET_FOREACH(other, u->dependencies[UNIT_REQUIRED_BY], i)
+                        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRED_BY, i)
                                 if (other->job &&
                                     (other->job->type == JOB_START ||
                                      other->job->type == JOB_VERIFY_ACTIVE))
                                         job_finish_and_invalidate(other->job, JOB_DEPENDENCY, true);
 
-                        SET_FOREACH(other, u->dependencies[UNIT_BOUND_BY], i)
+                        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BOUND_BY, i)
                                 if (other->job &&
                                     (other->job->type == JOB_START ||
                                      other->job->type == JOB_VERIFY_ACTIVE))
                                         job_finish_and_invalidate(other->job, JOB_DEPENDENCY, true);
 
-                        SET_FOREACH(other, u->dependencies[UNIT_REQUIRED_BY_OVERRIDABLE], i)
+                        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRED_BY_OVERRIDABLE, i)
                                 if (other->job &&
                                     !other->job->override &&
                                     (other->job->type == JOB_START ||
@@ -814,7 +818,7 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive) {
 
                 } else if (t == JOB_STOP) {
 
-                        SET_FOREACH(other, u->dependencies[UNIT_CONFLICTED_BY], i)
+                        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTED_BY, i)
                                 if (other->job &&
                                     (other->job->type == JOB_START ||
                                      other->job->type == JOB_VERIFY_ACTIVE))
@@ -844,10 +848,10 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive) {
 
 finish:
         /* Try to start the next jobs that can be started */
-        SET_FOREACH(other, u->dependencies[UNIT_AFTER], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_AFTER, i)
                 if (other->job)
                         job_add_to_run_queue(other->job);
-        SET_FOREACH(other, u->dependencies[UNIT_BEFORE], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BEFORE, i)
                 if (other->job)
                         job_add_to_run_queue(other->job);
 
@@ -932,53 +936,40 @@ char *job_dbus_path(Job *j) {
         return p;
 }
 
-int job_serialize(Job *j, FILE *f, FDSet *fds) {
-        fprintf(f, "job-id=%u\n", j->id);
-        fprintf(f, "job-type=%s\n", job_type_to_string(j->type));
-        fprintf(f, "job-state=%s\n", job_state_to_string(j->state));
-        fprintf(f, "job-override=%s\n", yes_no(j->override));
-        fprintf(f, "job-irreversible=%s\n", yes_no(j->irreversible));
-        fprintf(f, "job-sent-dbus-new-signal=%s\n", yes_no(j->sent_dbus_new_signal));
-        fprintf(f, "job-ignore-order=%s\n", yes_no(j->ignore_order));
+int job_serialize(Job *j, SerializeState *st, FDSet *fds) {
+        serialize_item_format(st, "job-id", "%u", j->id);
+        serialize_item(st, "job-type", job_type_to_string(j->type));
+        serialize_item(st, "job-state", job_state_to_string(j->state));
+        serialize_item(st, "job-override", yes_no(j->override));
+        serialize_item(st, "job-irreversible", yes_no(j->irreversible));
+        serialize_item(st, "job-sent-dbus-new-signal", yes_no(j->sent_dbus_new_signal));
+        serialize_item(st, "job-ignore-order", yes_no(j->ignore_order));
 
         if (j->begin_usec > 0)
-                fprintf(f, "job-begin="USEC_FMT"\n", j->begin_usec);
+                serialize_item_format(st, "job-begin", USEC_FMT, j->begin_usec);
 
-        bus_track_serialize(j->clients, f);
+        bus_track_serialize(j->clients, st);
 
         /* End marker */
-        fputc('\n', f);
+        serialize_section_end(st);
         return 0;
 }
 
-int job_deserialize(Job *j, FILE *f, FDSet *fds) {
+int job_deserialize(Job *j, SerializeState *st, FDSet *fds) {
         assert(j);
 
         for (;;) {
-                char line[LINE_MAX], *l, *v;
-                size_t k;
+                char *l, *v;
+                int r;
 
-                if (!fgets(line, sizeof(line), f)) {
-                        if (feof(f))
-                                return 0;
-                        return -errno;
-                }
-
-                char_array_0(line);
-                l = strstrip(line);
+                r = deserialize_item(st, &l, &v);
+                if (r <= 0)
+                        return r;
 
                 /* End marker */
                 if (l[0] == 0)
                         return 0;
 
-                k = strcspn(l, "=");
-
-                if (l[k] == '=') {
-                        l[k] = 0;
-                        v = l+k+1;
-                } else
-                        v = l+k;
-
                 if (streq(l, "job-id")) {
 
                         if (safe_atou32(v, &j->id) < 0)
@@ -30,11 +30,14 @@
 #include "conf-parser.h"
 #include "load-fragment.h"
 #include "conf-files.h"
+#include "siphash24.h"
 
 static int iterate_dir(
                 Unit *u,
                 const char *path,
                 UnitDependency dependency,
+                bool add,
+                uint64_t *hash,
                 char ***strv) {
 
         _cleanup_closedir_ DIR *d = NULL;
@@ -85,6 +88,18 @@ static int iterate_dir(
                 if (!f)
                         return log_oom();
 
+                if (hash) {
+                        static const uint8_t key[16] = {};
+                        uint64_t h;
+
+                        /* Order independent, since readdir() is */
+                        siphash24((uint8_t*) &h, f, strlen(f), key);
+                        *hash += h;
+                }
+
+                if (!add)
+                        continue;
+
                 r = unit_add_dependency_by_name(u, dependency, de->d_name, f, true);
                 if (r < 0)
                         log_error("Cannot add dependency %s to %s, ignoring: %s", de->d_name, u->id, strerror(-r));
@@ -99,6 +114,8 @@ static int process_dir(
                 const char *name,
                 const char *suffix,
                 UnitDependency dependency,
+                bool add,
+                uint64_t *hash,
                 char ***strv) {
 
         _cleanup_free_ char *path = NULL;
@@ -113,7 +130,7 @@ static int process_dir(
                 return log_oom();
 
         if (!u->manager->unit_path_cache || set_get(u->manager->unit_path_cache, path))
-                iterate_dir(u, path, dependency, strv);
+                iterate_dir(u, path, dependency, add, hash, strv);
 
         if (u->instance) {
                 _cleanup_free_ char *template = NULL, *p = NULL;
@@ -128,7 +145,7 @@ static int process_dir(
                         return log_oom();
 
                 if (!u->manager->unit_path_cache || set_get(u->manager->unit_path_cache, p))
-                        iterate_dir(u, p, dependency, strv);
+                        iterate_dir(u, p, dependency, add, hash, strv);
         }
 
         return 0;
@@ -147,7 +164,7 @@ char **unit_find_dropin_paths(Unit *u) {
                 char **p;
 
                 STRV_FOREACH(p, u->manager->lookup_paths.unit_path)
-                        process_dir(u, *p, t, ".d", _UNIT_DEPENDENCY_INVALID, &strv);
+                        process_dir(u, *p, t, ".d", _UNIT_DEPENDENCY_INVALID, false, NULL, &strv);
         }
 
         if (strv_isempty(strv))
@@ -163,32 +180,51 @@ char **unit_find_dropin_paths(Unit *u) {
         return configs;
 }
 
-int unit_load_dropin(Unit *u) {
+static uint64_t dropin_dirs_process(Unit *u, bool add) {
+        uint64_t hash = 0;
         Iterator i;
-        char *t, **f;
-
-        assert(u);
-
-        /* Load dependencies from supplementary drop-in directories */
+        char *t;
 
         SET_FOREACH(t, u->names, i) {
                 char **p;
 
                 STRV_FOREACH(p, u->manager->lookup_paths.unit_path) {
-                        process_dir(u, *p, t, ".wants", UNIT_WANTS, NULL);
-                        process_dir(u, *p, t, ".requires", UNIT_REQUIRES, NULL);
+                        process_dir(u, *p, t, ".wants", UNIT_WANTS, add, &hash, NULL);
+                        process_dir(u, *p, t, ".requires", UNIT_REQUIRES, add, &hash, NULL);
                 }
         }
 
+        return hash;
+}
+
+uint64_t unit_dropin_dirs_hash(Unit *u) {
+        assert(u);
+
+        /* Hashes the contents of the .wants/ and .requires/
+         * directories, without adding any dependencies */
+
+        return dropin_dirs_process(u, false);
+}
+
+int unit_load_dropin(Unit *u) {
+        char **f;
+
+        assert(u);
+
+        /* Load dependencies from supplementary drop-in directories */
+
+        u->dropin_dirs_hash = dropin_dirs_process(u, true);
+
         u->dropin_paths = unit_find_dropin_paths(u);
         if (!u->dropin_paths)
                 return 0;
 
         STRV_FOREACH(f, u->dropin_paths) {
-                config_parse(u->id, *f, NULL,
-                             UNIT_VTABLE(u)->sections,
-                             config_item_perf_lookup, load_fragment_gperf_lookup,
-                             false, false, false, u);
+                config_parse_cached(u->manager->unit_file_cache,
+                                    u->id, *f, NULL,
+                                    UNIT_VTABLE(u)->sections,
+                                    config_item_perf_lookup, load_fragment_gperf_lookup,
+                                    false, false, false, u);
         }
 
         u->dropin_mtime = now(CLOCK_REALTIME);
@@ -27,3 +27,4 @@
 
 char **unit_find_dropin_paths(Unit *u);
 int unit_load_dropin(Unit *u);
+uint64_t unit_dropin_dirs_hash(Unit *u);
@@ -1401,7 +1401,7 @@ int config_parse_trigger_unit(
         assert(rvalue);
         assert(data);
 
-        if (!set_isempty(u->dependencies[UNIT_TRIGGERS])) {
+        if (!unit_dependency_count(u, UNIT_TRIGGERS) == 0) {
                 log_syntax(unit, LOG_ERR, filename, line, EINVAL,
                            "Multiple units to trigger specified, ignoring: %s", rvalue);
                 return 0;
@@ -3292,8 +3292,6 @@ int config_parse_protect_system(
         return 0;
 }
 
-#define FOLLOW_MAX 8
-
 static int open_follow(char **filename, FILE **_f, Set *names, char **_final) {
         unsigned c = 0;
         int fd, r;
@@ -3496,10 +3494,11 @@ static int load_from_path(Unit *u, const char *path) {
                 u->load_state = UNIT_LOADED;
 
                 /* Now, parse the file contents */
-                r = config_parse(u->id, filename, f,
-                                 UNIT_VTABLE(u)->sections,
-                                 config_item_perf_lookup, load_fragment_gperf_lookup,
-                                 false, true, false, u);
+                r = config_parse_cached(u->manager->unit_file_cache,
+                                        u->id, filename, f,
+                                        UNIT_VTABLE(u)->sections,
+                                        config_item_perf_lookup, load_fragment_gperf_lookup,
+                                        false, true, false, u);
                 if (r < 0)
                         return r;
         }
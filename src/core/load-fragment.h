@@ -25,6 +25,9 @@
 
 /* Read service data from .desktop file style configuration fragments */
 
+/* How many symlinks are followed to find a fragment */
+#define FOLLOW_MAX 8
+
 int unit_load_fragment(Unit *u);
 
 void unit_dump_config_items(FILE *f);
@@ -111,8 +111,11 @@ static struct rlimit *arg_default_rlimit[_RLIMIT_MAX] = {};
 static uint64_t arg_capability_bounding_set_drop = 0;
 static nsec_t arg_timer_slack_nsec = NSEC_INFINITY;
 static usec_t arg_default_timer_accuracy_usec = 1 * USEC_PER_MINUTE;
+static usec_t arg_dbus_coalesce_usec = 0;
+static bool arg_exec_helper = false;
 static Set* arg_syscall_archs = NULL;
 static FILE* arg_serialization = NULL;
+static SerializationFormat arg_serialization_format = SERIALIZATION_TEXT;
 static bool arg_default_cpu_accounting = false;
 static bool arg_default_blockio_accounting = false;
 static bool arg_default_memory_accounting = false;
@@ -350,6 +353,14 @@ static int parse_proc_cmdline_item(const char *key, const char *value) {
                 else
                         arg_default_std_error = r;
 
+        } else if (streq(key, "systemd.serialization_format") && value) {
+
+                r = serialization_format_from_string(value);
+                if (r < 0)
+                        log_warning("Failed to parse serialization format %s. Ignoring.", value);
+                else
+                        arg_serialization_format = r;
+
         } else if (streq(key, "systemd.setenv") && value) {
 
                 if (env_assignment_is_valid(value)) {
@@ -646,6 +657,8 @@ static int parse_config_file(void) {
 #endif
                 { "Manager", "TimerSlackNSec",            config_parse_nsec,             0, &arg_timer_slack_nsec                  },
                 { "Manager", "DefaultTimerAccuracySec",   config_parse_sec,              0, &arg_default_timer_accuracy_usec       },
+                { "Manager", "DBusSignalCoalesceSec",     config_parse_sec,              0, &arg_dbus_coalesce_usec                },
+                { "Manager", "ExecHelper",                config_parse_bool,             0, &arg_exec_helper                       },
                 { "Manager", "DefaultStandardOutput",     config_parse_output,           0, &arg_default_std_output                },
                 { "Manager", "DefaultStandardError",      config_parse_output,           0, &arg_default_std_error                 },
                 { "Manager", "DefaultTimeoutStartSec",    config_parse_sec,              0, &arg_default_timeout_start_usec        },
@@ -1623,6 +1636,9 @@ int main(int argc, char *argv[]) {
 
         m->confirm_spawn = arg_confirm_spawn;
         m->default_timer_accuracy_usec = arg_default_timer_accuracy_usec;
+        m->dbus_coalesce_usec = arg_dbus_coalesce_usec;
+        m->use_exec_helper = arg_exec_helper;
+        m->serialization_format = arg_serialization_format;
         m->default_std_output = arg_default_std_output;
         m->default_std_error = arg_default_std_error;
         m->default_restart_usec = arg_default_restart_usec;
@@ -1757,6 +1773,13 @@ int main(int argc, char *argv[]) {
                                 log_error("Failed to reload: %s", strerror(-r));
                         break;
 
+                case MANAGER_RELOAD_INCREMENTAL:
+                        log_info("Reloading changed units.");
+                        r = manager_reload_incremental(m);
+                        if (r < 0)
+                                log_error("Failed to reload: %s", strerror(-r));
+                        break;
+
                 case MANAGER_REEXECUTE:
 
                         if (prepare_reexecute(m, &arg_serialization, &fds, false) < 0)
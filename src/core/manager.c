@@ -35,6 +35,7 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <sys/timerfd.h>
+#include <sys/prctl.h>
 
 #ifdef HAVE_AUDIT
 #include <libaudit.h>
@@ -46,6 +47,7 @@
 
 #include "manager.h"
 #include "transaction.h"
+#include "execute-helper.h"
 #include "hashmap.h"
 #include "macro.h"
 #include "strv.h"
@@ -76,6 +78,7 @@
 #include "dbus-manager.h"
 #include "bus-kernel.h"
 #include "time-util.h"
+#include "serialize.h"
 
 /* As soon as 5s passed since a unit was added to our GC queue, make sure to run a gc sweep */
 #define GC_QUEUE_USEC_MAX (10*USEC_PER_SEC)
@@ -85,6 +88,9 @@
 #define JOBS_IN_PROGRESS_PERIOD_USEC (USEC_PER_SEC / 3)
 #define JOBS_IN_PROGRESS_PERIOD_DIVISOR 3
 
+/* Where the pre-split unit file contents are stored between re-executions */
+#define UNIT_FILE_CACHE_PATH "/run/systemd/unit-cache"
+
 static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_signal_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_time_change_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
@@ -464,7 +470,7 @@ int manager_new(SystemdRunningAs running_as, bool test_run, Manager **_m) {
 
         m->idle_pipe[0] = m->idle_pipe[1] = m->idle_pipe[2] = m->idle_pipe[3] = -1;
 
-        m->pin_cgroupfs_fd = m->notify_fd = m->signal_fd = m->time_change_fd = m->dev_autofs_fd = m->private_listen_fd = m->kdbus_fd = -1;
+        m->pin_cgroupfs_fd = m->cgroup_inotify_fd = m->notify_fd = m->signal_fd = m->time_change_fd = m->dev_autofs_fd = m->private_listen_fd = m->kdbus_fd = -1;
         m->current_job_id = 1; /* start as id #1, so that we can leave #0 around as "null-like" value */
 
         m->test_run = test_run;
@@ -497,6 +503,14 @@ int manager_new(SystemdRunningAs running_as, bool test_run, Manager **_m) {
         if (r < 0)
                 goto fail;
 
+        m->serialization_format = SERIALIZATION_TEXT;
+
+        m->unit_file_cache = conf_cache_new();
+        if (!m->unit_file_cache) {
+                r = -ENOMEM;
+                goto fail;
+        }
+
         r = sd_event_default(&m->event);
         if (r < 0)
                 goto fail;
@@ -707,7 +721,7 @@ enum {
 };
 
 static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
-        Iterator i;
+        unsigned i;
         Unit *other;
         bool is_bad;
 
@@ -728,7 +742,7 @@ static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
 
         is_bad = true;
 
-        SET_FOREACH(other, u->dependencies[UNIT_REFERENCED_BY], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REFERENCED_BY, i) {
                 unit_gc_sweep(other, gc_marker);
 
                 if (other->gc_marker == gc_marker + GC_OFFSET_GOOD)
@@ -812,6 +826,7 @@ static void manager_clear_jobs_and_units(Manager *m) {
         assert(!m->dbus_job_queue);
         assert(!m->cleanup_queue);
         assert(!m->gc_queue);
+        assert(!m->cgroup_empty_queue);
 
         assert(hashmap_isempty(m->jobs));
         assert(hashmap_isempty(m->units));
@@ -855,6 +870,9 @@ void manager_free(Manager *m) {
         sd_event_source_unref(m->jobs_in_progress_event_source);
         sd_event_source_unref(m->idle_pipe_event_source);
         sd_event_source_unref(m->run_queue_event_source);
+        sd_event_source_unref(m->dbus_coalesce_event_source);
+
+        exec_helper_free(m->exec_helper);
 
         safe_close(m->signal_fd);
         safe_close(m->notify_fd);
@@ -875,7 +893,9 @@ void manager_free(Manager *m) {
         strv_free(m->environment);
 
         hashmap_free(m->cgroup_unit);
+        hashmap_free(m->cgroup_inotify_wd_unit);
         set_free_free(m->unit_path_cache);
+        conf_cache_free(m->unit_file_cache);
 
         free(m->switch_root);
         free(m->switch_root_init);
@@ -990,6 +1010,40 @@ fail:
         m->unit_path_cache = NULL;
 }
 
+static void manager_load_unit_file_cache(Manager *m) {
+        int r;
+
+        assert(m);
+
+        /* The cache survives daemon-reload in memory anyway, but is
+         * also written to /run so that it survives daemon-reexec and
+         * switch-root */
+        if (m->running_as != SYSTEMD_SYSTEM || m->test_run)
+                return;
+
+        r = conf_cache_load(m->unit_file_cache, UNIT_FILE_CACHE_PATH);
+        if (r < 0 && r != -ENOENT)
+                log_debug("Failed to load unit file cache, ignoring: %s", strerror(-r));
+}
+
+static void manager_save_unit_file_cache(Manager *m) {
+        int r;
+
+        assert(m);
+
+        log_debug("Unit file cache: %u hits, %u misses.",
+                  m->unit_file_cache->n_hits, m->unit_file_cache->n_misses);
+
+        conf_cache_gc(m->unit_file_cache);
+
+        if (m->running_as != SYSTEMD_SYSTEM || m->test_run)
+                return;
+
+        r = conf_cache_save(m->unit_file_cache, UNIT_FILE_CACHE_PATH);
+        if (r < 0)
+                log_debug("Failed to save unit file cache, ignoring: %s", strerror(-r));
+}
+
 
 static int manager_distribute_fds(Manager *m, FDSet *fds) {
         Unit *u;
@@ -1032,6 +1086,14 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
 
         assert(m);
 
+        /* Fork off the exec helper first, while we are still small,
+         * since that is the whole point of it */
+        if (m->use_exec_helper && !m->exec_helper && !m->test_run) {
+                r = exec_helper_new(&m->exec_helper);
+                if (r < 0)
+                        log_warning("Failed to fork off exec helper, ignoring: %s", strerror(-r));
+        }
+
         dual_timestamp_get(&m->generators_start_timestamp);
         manager_run_generators(m);
         dual_timestamp_get(&m->generators_finish_timestamp);
@@ -1046,6 +1108,8 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
                 return r;
 
         manager_build_unit_path_cache(m);
+        manager_load_unit_file_cache(m);
+        m->unit_file_cache->n_hits = m->unit_file_cache->n_misses = 0;
 
         /* If we will deserialize make sure that during enumeration
          * this is already known, so we increase the counter here
@@ -1058,6 +1122,8 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
         r = manager_enumerate(m);
         dual_timestamp_get(&m->units_load_finish_timestamp);
 
+        manager_save_unit_file_cache(m);
+
         /* Second, deserialize if there is something to deserialize */
         if (serialization)
                 r = manager_deserialize(m, serialization, fds);
@@ -1379,21 +1445,35 @@ static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         return 1;
 }
 
-static unsigned manager_dispatch_dbus_queue(Manager *m) {
+static unsigned manager_flush_dbus_queue(Manager *m) {
+        _cleanup_free_ Unit **units = NULL;
+        _cleanup_free_ Job **jobs = NULL;
+        size_t n_units = 0, n_jobs = 0, allocated_units = 0, allocated_jobs = 0;
+        bool batch;
         Job *j;
         Unit *u;
         unsigned n = 0;
 
         assert(m);
 
-        if (m->dispatching_dbus_queue)
-                return 0;
-
         m->dispatching_dbus_queue = true;
+        bus_cork_all(m, true);
+
+        /* When coalescing, everything sent in this round is also
+         * announced in one go, for clients that prefer a single
+         * wakeup over a signal per object */
+        batch = m->dbus_coalesce_usec > 0;
 
         while ((u = m->dbus_unit_queue)) {
                 assert(u->in_dbus_queue);
 
+                if (batch && u->id) {
+                        if (GREEDY_REALLOC(units, allocated_units, n_units + 1))
+                                units[n_units++] = u;
+                        else
+                                batch = false;
+                }
+
                 bus_unit_send_change_signal(u);
                 n++;
         }
@@ -1401,10 +1481,20 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
         while ((j = m->dbus_job_queue)) {
                 assert(j->in_dbus_queue);
 
+                if (batch) {
+                        if (GREEDY_REALLOC(jobs, allocated_jobs, n_jobs + 1))
+                                jobs[n_jobs++] = j;
+                        else
+                                batch = false;
+                }
+
                 bus_job_send_change_signal(j);
                 n++;
         }
 
+        if (batch && n > 0)
+                bus_manager_send_batch(m, units, n_units, jobs, n_jobs);
+
         m->dispatching_dbus_queue = false;
 
         if (m->send_reloading_done) {
@@ -1416,9 +1506,55 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
         if (m->queued_message)
                 bus_send_queued_message(m);
 
+        bus_cork_all(m, false);
+
         return n;
 }
 
+static int manager_dispatch_dbus_coalesce(sd_event_source *source, usec_t usec, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        m->dbus_coalesce_event_source = sd_event_source_unref(m->dbus_coalesce_event_source);
+
+        if (!m->dispatching_dbus_queue)
+                manager_flush_dbus_queue(m);
+
+        return 0;
+}
+
+static unsigned manager_dispatch_dbus_queue(Manager *m) {
+        int r;
+
+        assert(m);
+
+        if (m->dispatching_dbus_queue)
+                return 0;
+
+        /* If a coalescing window is configured, we let changes pile
+         * up until it elapsed, so that units that change state
+         * repeatedly in the meantime are announced only once. */
+        if (m->dbus_coalesce_usec > 0 && (m->dbus_unit_queue || m->dbus_job_queue)) {
+
+                if (m->dbus_coalesce_event_source)
+                        return 0;
+
+                r = sd_event_add_time(
+                                m->event,
+                                &m->dbus_coalesce_event_source,
+                                CLOCK_MONOTONIC,
+                                now(CLOCK_MONOTONIC) + m->dbus_coalesce_usec, 0,
+                                manager_dispatch_dbus_coalesce, m);
+                if (r >= 0)
+                        return 0;
+
+                log_warning("Failed to add D-Bus coalescing timer, sending changes right-away: %s", strerror(-r));
+        }
+
+        return manager_flush_dbus_queue(m);
+}
+
 static void manager_invoke_notify_message(Manager *m, Unit *u, pid_t pid, char *buf, size_t n) {
         _cleanup_strv_free_ char **tags = NULL;
 
@@ -1559,29 +1695,41 @@ static int manager_dispatch_sigchld(Manager *m) {
                         break;
 
                 if (si.si_code == CLD_EXITED || si.si_code == CLD_KILLED || si.si_code == CLD_DUMPED) {
-                        _cleanup_free_ char *name = NULL;
-                        Unit *u1, *u2, *u3;
-
-                        get_process_comm(si.si_pid, &name);
-
-                        log_debug("Child "PID_FMT" (%s) died (code=%s, status=%i/%s)",
-                                  si.si_pid, strna(name),
-                                  sigchld_code_to_string(si.si_code),
-                                  si.si_status,
-                                  strna(si.si_code == CLD_EXITED
-                                        ? exit_status_to_string(si.si_status, EXIT_STATUS_FULL)
-                                        : signal_to_string(si.si_status)));
+                        Unit *u1, *u2, *u3 = NULL;
+
+                        /* Reading the name from /proc is costly,
+                         * hence don't bother unless it is logged */
+                        if (log_get_max_level() >= LOG_DEBUG) {
+                                _cleanup_free_ char *name = NULL;
+
+                                get_process_comm(si.si_pid, &name);
+
+                                log_debug("Child "PID_FMT" (%s) died (code=%s, status=%i/%s)",
+                                          si.si_pid, strna(name),
+                                          sigchld_code_to_string(si.si_code),
+                                          si.si_status,
+                                          strna(si.si_code == CLD_EXITED
+                                                ? exit_status_to_string(si.si_status, EXIT_STATUS_FULL)
+                                                : signal_to_string(si.si_status)));
+                        }
 
                         /* And now figure out the unit this belongs
-                         * to, it might be multiple... */
-                        u1 = manager_get_unit_by_pid(m, si.si_pid);
+                         * to, it might be multiple... All processes
+                         * we fork off are watched by the unit they
+                         * are forked for, hence we only need to
+                         * look at the cgroup of the process, which
+                         * means reading /proc, for the ones that
+                         * got reparented to us. */
+                        u1 = hashmap_get(m->watch_pids1, LONG_TO_PTR(si.si_pid));
+                        u2 = hashmap_get(m->watch_pids2, LONG_TO_PTR(si.si_pid));
+                        if (!u1 && !u2)
+                                u3 = manager_get_unit_by_pid(m, si.si_pid);
+
                         if (u1)
                                 invoke_sigchld_event(m, u1, &si);
-                        u2 = hashmap_get(m->watch_pids1, LONG_TO_PTR(si.si_pid));
                         if (u2 && u2 != u1)
                                 invoke_sigchld_event(m, u2, &si);
-                        u3 = hashmap_get(m->watch_pids2, LONG_TO_PTR(si.si_pid));
-                        if (u3 && u3 != u2 && u3 != u1)
+                        if (u3)
                                 invoke_sigchld_event(m, u3, &si);
                 }
 
@@ -1934,6 +2082,9 @@ int manager_loop(Manager *m) {
                 if (manager_dispatch_cgroup_queue(m) > 0)
                         continue;
 
+                if (manager_dispatch_cgroup_empty_queue(m) > 0)
+                        continue;
+
                 if (manager_dispatch_dbus_queue(m) > 0)
                         continue;
 
@@ -2136,7 +2287,7 @@ int manager_open_serialization(Manager *m, FILE **_f) {
         return 0;
 }
 
-int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
+static int manager_serialize_state(Manager *m, SerializeState *st, FDSet *fds, bool switching_root) {
         Iterator i;
         Unit *u;
         const char *t;
@@ -2144,30 +2295,30 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
         int r;
 
         assert(m);
-        assert(f);
+        assert(st);
         assert(fds);
 
         m->n_reloading ++;
 
-        fprintf(f, "current-job-id=%i\n", m->current_job_id);
-        fprintf(f, "taint-usr=%s\n", yes_no(m->taint_usr));
-        fprintf(f, "n-installed-jobs=%u\n", m->n_installed_jobs);
-        fprintf(f, "n-failed-jobs=%u\n", m->n_failed_jobs);
+        serialize_item_format(st, "current-job-id", "%i", m->current_job_id);
+        serialize_item(st, "taint-usr", yes_no(m->taint_usr));
+        serialize_item_format(st, "n-installed-jobs", "%u", m->n_installed_jobs);
+        serialize_item_format(st, "n-failed-jobs", "%u", m->n_failed_jobs);
 
-        dual_timestamp_serialize(f, "firmware-timestamp", &m->firmware_timestamp);
-        dual_timestamp_serialize(f, "loader-timestamp", &m->loader_timestamp);
-        dual_timestamp_serialize(f, "kernel-timestamp", &m->kernel_timestamp);
-        dual_timestamp_serialize(f, "initrd-timestamp", &m->initrd_timestamp);
+        dual_timestamp_serialize(st, "firmware-timestamp", &m->firmware_timestamp);
+        dual_timestamp_serialize(st, "loader-timestamp", &m->loader_timestamp);
+        dual_timestamp_serialize(st, "kernel-timestamp", &m->kernel_timestamp);
+        dual_timestamp_serialize(st, "initrd-timestamp", &m->initrd_timestamp);
 
         if (!in_initrd()) {
-                dual_timestamp_serialize(f, "userspace-timestamp", &m->userspace_timestamp);
-                dual_timestamp_serialize(f, "finish-timestamp", &m->finish_timestamp);
-                dual_timestamp_serialize(f, "security-start-timestamp", &m->security_start_timestamp);
-                dual_timestamp_serialize(f, "security-finish-timestamp", &m->security_finish_timestamp);
-                dual_timestamp_serialize(f, "generators-start-timestamp", &m->generators_start_timestamp);
-                dual_timestamp_serialize(f, "generators-finish-timestamp", &m->generators_finish_timestamp);
-                dual_timestamp_serialize(f, "units-load-start-timestamp", &m->units_load_start_timestamp);
-                dual_timestamp_serialize(f, "units-load-finish-timestamp", &m->units_load_finish_timestamp);
+                dual_timestamp_serialize(st, "userspace-timestamp", &m->userspace_timestamp);
+                dual_timestamp_serialize(st, "finish-timestamp", &m->finish_timestamp);
+                dual_timestamp_serialize(st, "security-start-timestamp", &m->security_start_timestamp);
+                dual_timestamp_serialize(st, "security-finish-timestamp", &m->security_finish_timestamp);
+                dual_timestamp_serialize(st, "generators-start-timestamp", &m->generators_start_timestamp);
+                dual_timestamp_serialize(st, "generators-finish-timestamp", &m->generators_finish_timestamp);
+                dual_timestamp_serialize(st, "units-load-start-timestamp", &m->units_load_start_timestamp);
+                dual_timestamp_serialize(st, "units-load-finish-timestamp", &m->units_load_finish_timestamp);
         }
 
         if (!switching_root) {
@@ -2178,7 +2329,7 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
                         if (!ce)
                                 return -ENOMEM;
 
-                        fprintf(f, "env=%s\n", *e);
+                        serialize_item(st, "env", *e);
                 }
         }
 
@@ -2189,8 +2340,8 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
                 if (copy < 0)
                         return copy;
 
-                fprintf(f, "notify-fd=%i\n", copy);
-                fprintf(f, "notify-socket=%s\n", m->notify_socket);
+                serialize_item_format(st, "notify-fd", "%i", copy);
+                serialize_item(st, "notify-socket", m->notify_socket);
         }
 
         if (m->kdbus_fd >= 0) {
@@ -2200,22 +2351,21 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
                 if (copy < 0)
                         return copy;
 
-                fprintf(f, "kdbus-fd=%i\n", copy);
+                serialize_item_format(st, "kdbus-fd", "%i", copy);
         }
 
-        bus_track_serialize(m->subscribed, f);
+        bus_track_serialize(m->subscribed, st);
 
-        fputc('\n', f);
+        serialize_section_end(st);
 
         HASHMAP_FOREACH_KEY(u, t, m->units, i) {
                 if (u->id != t)
                         continue;
 
                 /* Start marker */
-                fputs(u->id, f);
-                fputc('\n', f);
+                serialize_marker(st, u->id);
 
-                r = unit_serialize(u, f, fds, !switching_root);
+                r = unit_serialize(u, st, fds, !switching_root);
                 if (r < 0) {
                         m->n_reloading --;
                         return r;
@@ -2225,9 +2375,6 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
         assert(m->n_reloading > 0);
         m->n_reloading --;
 
-        if (ferror(f))
-                return -EIO;
-
         r = bus_fdset_add_all(m, fds);
         if (r < 0)
                 return r;
@@ -2235,7 +2382,37 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
         return 0;
 }
 
+static int manager_serialize_format(Manager *m, FILE *f, FDSet *fds, bool switching_root, SerializationFormat format) {
+        _cleanup_serialize_state_free_ SerializeState *st = NULL;
+        int r;
+
+        assert(m);
+        assert(f);
+
+        r = serialize_begin(f, format, &st);
+        if (r < 0)
+                return r;
+
+        r = manager_serialize_state(m, st, fds, switching_root);
+        if (r < 0)
+                return r;
+
+        if (ferror(f))
+                return -EIO;
+
+        return 0;
+}
+
+int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root) {
+
+        /* This is for reexecution, possibly of an older version,
+         * which might not be able to read anything but text */
+
+        return manager_serialize_format(m, f, fds, switching_root, m->serialization_format);
+}
+
 int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
+        _cleanup_serialize_state_free_ SerializeState *st = NULL;
         int r = 0;
 
         assert(m);
@@ -2243,22 +2420,18 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
 
         log_debug("Deserializing state...");
 
+        r = deserialize_begin(f, &st);
+        if (r < 0)
+                return r;
+
         m->n_reloading ++;
 
         for (;;) {
-                char line[LINE_MAX], *l;
-
-                if (!fgets(line, sizeof(line), f)) {
-                        if (feof(f))
-                                r = 0;
-                        else
-                                r = -errno;
+                char *l;
 
+                r = deserialize_line(st, &l);
+                if (r <= 0)
                         goto finish;
-                }
-
-                char_array_0(line);
-                l = strstrip(line);
 
                 if (l[0] == 0)
                         break;
@@ -2378,25 +2551,18 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
 
         for (;;) {
                 Unit *u;
-                char name[UNIT_NAME_MAX+2];
+                char *name, *v;
 
                 /* Start marker */
-                if (!fgets(name, sizeof(name), f)) {
-                        if (feof(f))
-                                r = 0;
-                        else
-                                r = -errno;
-
+                r = deserialize_item(st, &name, &v);
+                if (r <= 0)
                         goto finish;
-                }
 
-                char_array_0(name);
-
-                r = manager_load_unit(m, strstrip(name), NULL, NULL, &u);
+                r = manager_load_unit(m, name, NULL, NULL, &u);
                 if (r < 0)
                         goto finish;
 
-                r = unit_deserialize(u, f, fds);
+                r = unit_deserialize(u, st, fds);
                 if (r < 0)
                         goto finish;
         }
@@ -2411,13 +2577,15 @@ finish:
         return r;
 }
 
-int manager_reload(Manager *m) {
+static int manager_reload_pending(Manager *m, const char *pending, SerializeState *pending_st, FDSet *pending_fds) {
         int r, q;
         _cleanup_fclose_ FILE *f = NULL;
         _cleanup_fdset_free_ FDSet *fds = NULL;
 
         assert(m);
 
+        dual_timestamp_get(&m->reload_start_timestamp);
+
         r = manager_open_serialization(m, &f);
         if (r < 0)
                 return r;
@@ -2431,7 +2599,9 @@ int manager_reload(Manager *m) {
                 return -ENOMEM;
         }
 
-        r = manager_serialize(m, f, fds, false);
+        /* We read this back ourselves, hence can always use the
+         * binary format */
+        r = manager_serialize_format(m, f, fds, false, SERIALIZATION_BINARY);
         if (r < 0) {
                 m->n_reloading --;
                 return r;
@@ -2444,6 +2614,7 @@ int manager_reload(Manager *m) {
 
         /* From here on there is no way back. */
         manager_clear_jobs_and_units(m);
+        bus_invalidate_property_cache(m, NULL);
         manager_undo_generators(m);
         lookup_paths_free(&m->lookup_paths);
 
@@ -2460,17 +2631,32 @@ int manager_reload(Manager *m) {
                 r = q;
 
         manager_build_unit_path_cache(m);
+        m->unit_file_cache->n_hits = m->unit_file_cache->n_misses = 0;
 
         /* First, enumerate what we can from all config files */
         q = manager_enumerate(m);
         if (q < 0)
                 r = q;
 
+        manager_save_unit_file_cache(m);
+
         /* Second, deserialize our stored data */
         q = manager_deserialize(m, f, fds);
         if (q < 0)
                 r = q;
 
+        /* The rest of the state of a unit that an incremental
+         * reload failed to replace */
+        if (pending) {
+                Unit *u;
+
+                q = manager_load_unit(m, pending, NULL, NULL, &u);
+                if (q >= 0)
+                        q = unit_deserialize(u, pending_st, pending_fds);
+                if (q < 0)
+                        r = q;
+        }
+
         fclose(f);
         f = NULL;
 
@@ -2489,6 +2675,237 @@ int manager_reload(Manager *m) {
 
         m->send_reloading_done = true;
 
+        dual_timestamp_get(&m->reload_finish_timestamp);
+
+        return r;
+}
+
+int manager_reload(Manager *m) {
+        return manager_reload_pending(m, NULL, NULL, NULL);
+}
+
+static int manager_reload_unit_in_place(Manager *m, Unit *u, SerializeState *st, FDSet *fds, Unit **ret, char **ret_pending) {
+        _cleanup_(unit_dependency_backup_done) UnitDependencyBackup b = {};
+        char *name, *v;
+        bool full = false;
+        Unit *n;
+        int r;
+
+        /* Replaces the unit by a freshly loaded one, carrying over
+         * its runtime state and the dependencies other units have on
+         * it. Returns > 0 if this worked but a full reload is needed
+         * to get everything right, in which case no further units
+         * may be replaced. Everything that might fail is done before
+         * the old unit is freed, except for loading the new one and
+         * restoring its state. If either fails, the rest of the
+         * state is left unread in st, and the name of the unit is
+         * returned in ret_pending, for the full reload to pick it
+         * up. */
+
+        r = deserialize_item(st, &name, &v);
+        if (r < 0)
+                return r;
+        if (r == 0 || !streq(name, u->id))
+                return -EBADMSG;
+
+        r = unit_backup_dependencies(u, &b);
+        if (r < 0)
+                return r;
+
+        unit_free(u);
+
+        m->reload_backup = &b;
+        r = manager_load_unit(m, b.id, NULL, NULL, &n);
+        m->reload_backup = NULL;
+        if (r < 0) {
+                *ret_pending = b.id;
+                b.id = NULL;
+                return r;
+        }
+
+        if (!streq(n->id, b.id)) {
+                log_debug("%s is now an alias of %s.", b.id, n->id);
+                full = true;
+        } else if (n->load_state == UNIT_NOT_FOUND) {
+                /* Might get merged into units loaded later on */
+                log_debug("%s is gone.", n->id);
+                full = true;
+        } else if (n->dependency_hash - b.added_hash != b.dependency_hash) {
+                log_debug("%s dropped dependencies.", n->id);
+                full = true;
+        }
+
+        unit_restore_dependencies(n, &b);
+
+        r = unit_deserialize(n, st, fds);
+        if (r < 0) {
+                *ret_pending = b.id;
+                b.id = NULL;
+                return r;
+        }
+
+        *ret = n;
+        return full;
+}
+
+int manager_reload_incremental(Manager *m) {
+        _cleanup_serialize_state_free_ SerializeState *st = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_free_ Unit **changed = NULL;
+        _cleanup_free_ char *pending = NULL;
+        size_t n_changed = 0, n_allocated = 0, k;
+        unsigned n_units = 0;
+        bool full = false;
+        Iterator i;
+        Unit *u;
+        char *t;
+        int r = 0, q;
+
+        assert(m);
+
+        /* Reloads only the units whose configuration changed, by
+         * replacing them one by one, and leaves everything else
+         * alone. Generators are not run again. Whenever this cannot
+         * be done safely we fall back to a full reload. */
+
+        dual_timestamp_get(&m->reload_start_timestamp);
+
+        manager_build_unit_path_cache(m);
+
+        HASHMAP_FOREACH_KEY(u, t, m->units, i) {
+                if (u->id != t)
+                        continue;
+
+                n_units++;
+
+                q = unit_config_changed(u);
+                if (q == 0)
+                        continue;
+                if (q < 0) {
+                        log_debug("Cannot tell whether %s changed, doing full reload: %s", u->id, strerror(-q));
+                        full = true;
+                        goto finish;
+                }
+
+                if (!unit_can_reload_in_place(u)) {
+                        log_debug("%s changed and cannot be reloaded in place, doing full reload.", u->id);
+                        full = true;
+                        goto finish;
+                }
+
+                /* Loading might merge units, including ones we
+                 * are about to replace, so decide that before
+                 * anything is freed */
+                q = unit_config_aliased(u);
+                if (q != 0) {
+                        log_debug("%s changed and has aliases, doing full reload.", u->id);
+                        full = true;
+                        goto finish;
+                }
+
+                if (!GREEDY_REALLOC(changed, n_allocated, n_changed + 1)) {
+                        r = -ENOMEM;
+                        goto finish;
+                }
+
+                changed[n_changed++] = u;
+        }
+
+        /* If a large part changed there's little to gain */
+        if (n_changed > 8 && n_changed > n_units / 4) {
+                log_debug("%zu of %u units changed, doing full reload.", n_changed, n_units);
+                full = true;
+                goto finish;
+        }
+
+        log_debug("%zu of %u units changed.", n_changed, n_units);
+
+        if (n_changed == 0)
+                goto finish;
+
+        r = manager_open_serialization(m, &f);
+        if (r < 0)
+                goto finish;
+
+        fds = fdset_new();
+        if (!fds) {
+                r = -ENOMEM;
+                goto finish;
+        }
+
+        /* We read this back ourselves */
+        r = serialize_begin(f, SERIALIZATION_BINARY, &st);
+        if (r < 0)
+                goto finish;
+
+        m->n_reloading ++;
+        bus_manager_send_reloading(m, true);
+
+        for (k = 0; k < n_changed; k++) {
+                serialize_marker(st, changed[k]->id);
+
+                r = unit_serialize(changed[k], st, fds, true);
+                if (r < 0)
+                        break;
+        }
+
+        st = serialize_state_free(st);
+
+        fflush(f);
+        if (r >= 0 && ferror(f))
+                r = -EIO;
+        if (r >= 0 && fseeko(f, 0, SEEK_SET) < 0)
+                r = -errno;
+        if (r >= 0)
+                r = deserialize_begin(f, &st);
+        if (r < 0) {
+                m->n_reloading --;
+                goto finish;
+        }
+
+        /* From here on there is no way back. */
+        bus_invalidate_property_cache(m, NULL);
+
+        for (k = 0; k < n_changed; k++) {
+                Unit *n = NULL;
+
+                q = manager_reload_unit_in_place(m, changed[k], st, fds, &n, &pending);
+                if (q < 0) {
+                        log_error("Failed to reload %s in place: %s", pending ?: changed[k]->id, strerror(-q));
+                        r = q;
+                }
+                if (q != 0) {
+                        /* The remaining units are left alone,
+                         * the full reload takes care of them */
+                        full = true;
+                        break;
+                }
+
+                changed[k] = n;
+        }
+
+        if (!full)
+                for (k = 0; k < n_changed; k++) {
+                        q = unit_coldplug(changed[k]);
+                        if (q < 0)
+                                r = q;
+                }
+
+        assert(m->n_reloading > 0);
+        m->n_reloading--;
+
+        m->send_reloading_done = true;
+
+finish:
+        set_free_free(m->unit_path_cache);
+        m->unit_path_cache = NULL;
+
+        dual_timestamp_get(&m->reload_finish_timestamp);
+
+        if (full)
+                return manager_reload_pending(m, pending, st, fds);
+
         return r;
 }
 
@@ -2616,7 +3033,7 @@ void manager_check_finished(Manager *m) {
 
         SET_FOREACH(u, m->startup_units, i)
                 if (u->cgroup_path)
-                        cgroup_context_apply(unit_get_cgroup_context(u), unit_get_cgroup_mask(u), u->cgroup_path, manager_state(m));
+                        unit_apply_cgroup_attributes(u, unit_get_cgroup_mask(u), manager_state(m));
 
         bus_manager_send_finished(m, firmware_usec, loader_usec, kernel_usec, initrd_usec, userspace_usec, total_usec);
 
@@ -2702,10 +3119,233 @@ static void trim_generator_dir(Manager *m, char **generator) {
         return;
 }
 
+/* Sent from the executor to us for each generator that finished,
+ * followed by the name of the generator */
+struct GeneratorRecord {
+        uint64_t wall_usec;
+        uint64_t user_usec;
+        uint64_t system_usec;
+        int32_t code;
+        int32_t status;
+        uint32_t name_size;
+};
+
+typedef struct RunningGenerator {
+        char *name;
+        usec_t start;
+} RunningGenerator;
+
+static unsigned generator_parallelism(void) {
+        long n;
+
+        /* Generators are mostly waiting for I/O, hence run at least
+         * two at a time even on a single CPU */
+
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n < 2)
+                return 2;
+
+        return (unsigned) n;
+}
+
+static void generator_reap(Hashmap *running, int fd) {
+        _cleanup_free_ RunningGenerator *g = NULL;
+        _cleanup_free_ char *name = NULL;
+        struct GeneratorRecord rec = {};
+        struct rusage ru;
+        int status;
+        pid_t pid;
+
+        for (;;) {
+                pid = wait4(-1, &status, 0, &ru);
+                if (pid >= 0)
+                        break;
+
+                if (errno != EINTR) {
+                        log_error("Failed to wait for generators: %m");
+                        _exit(EXIT_FAILURE);
+                }
+        }
+
+        g = hashmap_remove(running, UINT_TO_PTR(pid));
+        if (!g)
+                return;
+
+        name = g->name;
+
+        rec.wall_usec = now(CLOCK_MONOTONIC) - g->start;
+        rec.user_usec = timeval_load(&ru.ru_utime);
+        rec.system_usec = timeval_load(&ru.ru_stime);
+        rec.name_size = strlen(name);
+
+        if (WIFEXITED(status)) {
+                rec.code = CLD_EXITED;
+                rec.status = WEXITSTATUS(status);
+
+                if (rec.status != 0)
+                        log_warning("%s failed with error code %i.", name, rec.status);
+        } else {
+                rec.code = WCOREDUMP(status) ? CLD_DUMPED : CLD_KILLED;
+                rec.status = WTERMSIG(status);
+
+                log_warning("%s terminated by signal %s.", name, signal_to_string(rec.status));
+        }
+
+        log_debug("%s finished after %llu ms.", name, (unsigned long long) (rec.wall_usec / USEC_PER_MSEC));
+
+        if (loop_write(fd, &rec, sizeof(rec), false) != sizeof(rec) ||
+            loop_write(fd, name, rec.name_size, false) != (ssize_t) rec.name_size)
+                log_debug("Failed to report timing of %s: %m", name);
+}
+
+noreturn static void generator_executor(const char *directory, DIR *d, char **argv, int fd) {
+        _cleanup_hashmap_free_ Hashmap *running = NULL;
+        unsigned n_max;
+        struct dirent *de;
+
+        /* Runs in a child process of its own, so that we can wait for
+         * any child without reaping processes of PID 1, and make use
+         * of SIGALRM to enforce the time limit. Runs up to
+         * n_max generators at the same time. */
+
+        reset_all_signal_handlers();
+        reset_signal_mask();
+
+        assert_se(prctl(PR_SET_PDEATHSIG, SIGTERM) == 0);
+
+        running = hashmap_new(NULL);
+        if (!running) {
+                log_oom();
+                _exit(EXIT_FAILURE);
+        }
+
+        n_max = generator_parallelism();
+
+        /* We simply rely on SIGALRM as default action terminating the
+         * process, which makes the kernel kill the generators still
+         * running. The ones that finished are reported already. */
+        alarm((DEFAULT_TIMEOUT_USEC + USEC_PER_SEC - 1) / USEC_PER_SEC);
+
+        FOREACH_DIRENT(de, d, break) {
+                _cleanup_free_ RunningGenerator *g = NULL;
+                _cleanup_free_ char *path = NULL;
+                pid_t pid;
+
+                if (!dirent_is_file(de))
+                        continue;
+
+                while (hashmap_size(running) >= n_max)
+                        generator_reap(running, fd);
+
+                path = strjoin(directory, "/", de->d_name, NULL);
+                g = new0(RunningGenerator, 1);
+                if (!path || !g) {
+                        log_oom();
+                        _exit(EXIT_FAILURE);
+                }
+
+                g->start = now(CLOCK_MONOTONIC);
+
+                pid = fork();
+                if (pid < 0) {
+                        log_error("Failed to fork: %m");
+                        continue;
+                } else if (pid == 0) {
+                        assert_se(prctl(PR_SET_PDEATHSIG, SIGTERM) == 0);
+
+                        argv[0] = path;
+                        execv(path, argv);
+                        log_error("Failed to execute %s: %m", path);
+                        _exit(EXIT_FAILURE);
+                }
+
+                log_debug("Spawned %s as " PID_FMT ".", path, pid);
+
+                g->name = path;
+                if (hashmap_put(running, UINT_TO_PTR(pid), g) < 0) {
+                        log_oom();
+                        _exit(EXIT_FAILURE);
+                }
+
+                path = NULL;
+                g = NULL;
+        }
+
+        while (!hashmap_isempty(running))
+                generator_reap(running, fd);
+
+        _exit(EXIT_SUCCESS);
+}
+
+static void generator_timings_free(Manager *m) {
+        unsigned i;
+
+        assert(m);
+
+        for (i = 0; i < m->n_generator_timings; i++)
+                free(m->generator_timings[i].name);
+
+        free(m->generator_timings);
+        m->generator_timings = NULL;
+        m->n_generator_timings = 0;
+}
+
+static int generator_timings_read(Manager *m, int fd) {
+        size_t allocated = 0;
+
+        assert(m);
+        assert(fd >= 0);
+
+        for (;;) {
+                struct GeneratorRecord rec;
+                _cleanup_free_ char *name = NULL;
+                GeneratorTiming *t;
+                ssize_t l;
+
+                l = loop_read(fd, &rec, sizeof(rec), true);
+                if (l == 0)
+                        return 0;
+                if (l < 0)
+                        return (int) l;
+                if (l != sizeof(rec) || rec.name_size > PATH_MAX)
+                        return -EBADMSG;
+
+                name = new(char, rec.name_size + 1);
+                if (!name)
+                        return -ENOMEM;
+
+                l = loop_read(fd, name, rec.name_size, true);
+                if (l < 0)
+                        return (int) l;
+                if ((size_t) l != rec.name_size)
+                        return -EBADMSG;
+
+                name[rec.name_size] = 0;
+
+                if (!GREEDY_REALLOC(m->generator_timings, allocated, m->n_generator_timings + 1))
+                        return -ENOMEM;
+
+                t = m->generator_timings + m->n_generator_timings++;
+                t->name = strdup(basename(name));
+                if (!t->name) {
+                        m->n_generator_timings--;
+                        return -ENOMEM;
+                }
+
+                t->wall_usec = rec.wall_usec;
+                t->user_usec = rec.user_usec;
+                t->system_usec = rec.system_usec;
+                t->code = rec.code;
+                t->status = rec.status;
+        }
+}
+
 void manager_run_generators(Manager *m) {
         _cleanup_closedir_ DIR *d = NULL;
+        _cleanup_close_pair_ int pipefd[2] = { -1, -1 };
         const char *generator_path;
         const char *argv[5];
+        pid_t executor_pid;
         int r;
 
         assert(m);
@@ -2736,14 +3376,36 @@ void manager_run_generators(Manager *m) {
         if (r < 0)
                 goto finish;
 
-        argv[0] = NULL; /* Leave this empty, execute_directory() will fill something in */
+        argv[0] = NULL; /* Leave this empty, the executor will fill something in */
         argv[1] = m->generator_unit_path;
         argv[2] = m->generator_unit_path_early;
         argv[3] = m->generator_unit_path_late;
         argv[4] = NULL;
 
-        RUN_WITH_UMASK(0022)
-                execute_directory(generator_path, d, DEFAULT_TIMEOUT_USEC, (char**) argv);
+        if (pipe2(pipefd, O_CLOEXEC) < 0) {
+                log_error("Failed to create timing pipe: %m");
+                goto finish;
+        }
+
+        executor_pid = fork();
+        if (executor_pid < 0) {
+                log_error("Failed to fork: %m");
+                goto finish;
+        } else if (executor_pid == 0) {
+                pipefd[0] = safe_close(pipefd[0]);
+                umask(0022);
+                generator_executor(generator_path, d, (char**) argv, pipefd[1]);
+        }
+
+        pipefd[1] = safe_close(pipefd[1]);
+
+        /* Reads until the executor and with it all generators are
+         * gone, since the pipe is not passed on to the latter */
+        r = generator_timings_read(m, pipefd[0]);
+        if (r < 0)
+                log_warning("Failed to read generator timings: %s", strerror(-r));
+
+        wait_for_terminate_and_warn(generator_path, executor_pid);
 
 finish:
         trim_generator_dir(m, &m->generator_unit_path);
@@ -2771,6 +3433,8 @@ void manager_undo_generators(Manager *m) {
         remove_generator_dir(m, &m->generator_unit_path);
         remove_generator_dir(m, &m->generator_unit_path_early);
         remove_generator_dir(m, &m->generator_unit_path_late);
+
+        generator_timings_free(m);
 }
 
 int manager_environment_add(Manager *m, char **minus, char **plus) {
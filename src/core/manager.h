@@ -52,6 +52,7 @@ typedef enum ManagerExitCode {
         MANAGER_OK,
         MANAGER_EXIT,
         MANAGER_RELOAD,
+        MANAGER_RELOAD_INCREMENTAL,
         MANAGER_REEXECUTE,
         MANAGER_REBOOT,
         MANAGER_POWEROFF,
@@ -73,6 +74,21 @@ typedef enum ManagerExitCode {
 #include "exit-status.h"
 #include "show-status.h"
 #include "failure-action.h"
+#include "conf-cache.h"
+#include "serialize.h"
+
+typedef struct GeneratorTiming {
+        char *name;
+
+        /* Wall clock time from fork to exit, and CPU time */
+        usec_t wall_usec;
+        usec_t user_usec;
+        usec_t system_usec;
+
+        /* CLD_EXITED, CLD_KILLED or CLD_DUMPED, plus exit status or signal */
+        int code;
+        int status;
+} GeneratorTiming;
 
 struct Manager {
         /* Note that the set of units we know of is allowed to be
@@ -109,6 +125,9 @@ struct Manager {
         /* Units that should be realized */
         LIST_HEAD(Unit, cgroup_queue);
 
+        /* Units whose cgroup ran empty */
+        LIST_HEAD(Unit, cgroup_empty_queue);
+
         sd_event *event;
 
         /* We use two hash tables here, since the same PID might be
@@ -140,11 +159,27 @@ struct Manager {
 
         sd_event_source *jobs_in_progress_event_source;
 
+        /* While set, changes are collected before being announced on the bus */
+        usec_t dbus_coalesce_usec;
+        sd_event_source *dbus_coalesce_event_source;
+
         unsigned n_snapshots;
 
         LookupPaths lookup_paths;
         Set *unit_path_cache;
 
+        /* Pre-split unit file contents, kept across reloads */
+        ConfCache *unit_file_cache;
+
+        /* How to pass on our state across reexecution, reloads
+         * always use the binary format */
+        SerializationFormat serialization_format;
+
+        /* The unit whose configuration is being loaded right now,
+         * and the backup of the unit being reloaded in place */
+        Unit *loading_unit;
+        UnitDependencyBackup *reload_backup;
+
         char **environment;
 
         usec_t runtime_watchdog;
@@ -163,11 +198,17 @@ struct Manager {
         dual_timestamp generators_finish_timestamp;
         dual_timestamp units_load_start_timestamp;
         dual_timestamp units_load_finish_timestamp;
+        dual_timestamp reload_start_timestamp;
+        dual_timestamp reload_finish_timestamp;
 
         char *generator_unit_path;
         char *generator_unit_path_early;
         char *generator_unit_path_late;
 
+        /* How long each generator took on the last run */
+        GeneratorTiming *generator_timings;
+        unsigned n_generator_timings;
+
         struct udev* udev;
 
         /* Data specific to the device subsystem */
@@ -225,6 +266,18 @@ struct Manager {
          * file system */
         int pin_cgroupfs_fd;
 
+        /* Watches the populated state of the cgroups, where the
+         * kernel exposes it, instead of relying on the release
+         * agent */
+        int cgroup_inotify_fd;
+        sd_event_source *cgroup_inotify_event_source;
+        Hashmap *cgroup_inotify_wd_unit;
+
+        /* Attribute writes to cgroups done, and skipped since the
+         * value was written already */
+        uint64_t n_cgroup_attribute_writes;
+        uint64_t n_cgroup_attribute_writes_skipped;
+
         /* Flags */
         SystemdRunningAs running_as;
         ManagerExitCode exit_code:5;
@@ -241,6 +294,10 @@ struct Manager {
         bool confirm_spawn;
         bool no_console_output;
 
+        /* Forks off processes on our behalf, if enabled */
+        bool use_exec_helper;
+        ExecHelper *exec_helper;
+
         ExecOutput default_std_output, default_std_error;
 
         usec_t default_restart_usec, default_timeout_start_usec, default_timeout_stop_usec;
@@ -332,6 +389,7 @@ int manager_serialize(Manager *m, FILE *f, FDSet *fds, bool switching_root);
 int manager_deserialize(Manager *m, FILE *f, FDSet *fds);
 
 int manager_reload(Manager *m);
+int manager_reload_incremental(Manager *m);
 
 bool manager_is_reloading_or_reexecuting(Manager *m) _pure_;
 
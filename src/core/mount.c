@@ -543,11 +543,11 @@ static int mount_load(Unit *u) {
 static int mount_notify_automount(Mount *m, int status) {
         Unit *p;
         int r;
-        Iterator i;
+        unsigned i;
 
         assert(m);
 
-        SET_FOREACH(p, UNIT(m)->dependencies[UNIT_TRIGGERED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(p, UNIT(m), UNIT_TRIGGERED_BY, i)
                 if (p->type == UNIT_AUTOMOUNT) {
                          r = automount_send_ready(AUTOMOUNT(p), status);
                          if (r < 0)
@@ -695,6 +695,7 @@ static int mount_spawn(Mount *m, ExecCommand *c, pid_t *_pid) {
                 .apply_permissions = true,
                 .apply_chroot      = true,
                 .apply_tty_stdin   = true,
+                .bus_endpoint_fd   = -1,
         };
 
         assert(m);
@@ -713,6 +714,7 @@ static int mount_spawn(Mount *m, ExecCommand *c, pid_t *_pid) {
 
         exec_params.environment = UNIT(m)->manager->environment;
         exec_params.confirm_spawn = UNIT(m)->manager->confirm_spawn;
+        exec_params.exec_helper = UNIT(m)->manager->exec_helper;
         exec_params.cgroup_supported = UNIT(m)->manager->cgroup_supported;
         exec_params.cgroup_path = UNIT(m)->cgroup_path;
         exec_params.runtime_prefix = manager_get_runtime_prefix(UNIT(m)->manager);
@@ -1045,22 +1047,22 @@ static int mount_reload(Unit *u) {
         return 0;
 }
 
-static int mount_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int mount_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Mount *m = MOUNT(u);
 
         assert(m);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", mount_state_to_string(m->state));
-        unit_serialize_item(u, f, "result", mount_result_to_string(m->result));
-        unit_serialize_item(u, f, "reload-result", mount_result_to_string(m->reload_result));
+        unit_serialize_item(u, st, "state", mount_state_to_string(m->state));
+        unit_serialize_item(u, st, "result", mount_result_to_string(m->result));
+        unit_serialize_item(u, st, "reload-result", mount_result_to_string(m->reload_result));
 
         if (m->control_pid > 0)
-                unit_serialize_item_format(u, f, "control-pid", PID_FMT, m->control_pid);
+                unit_serialize_item_format(u, st, "control-pid", PID_FMT, m->control_pid);
 
         if (m->control_command_id >= 0)
-                unit_serialize_item(u, f, "control-command", mount_exec_command_to_string(m->control_command_id));
+                unit_serialize_item(u, st, "control-command", mount_exec_command_to_string(m->control_command_id));
 
         return 0;
 }
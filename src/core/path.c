@@ -362,7 +362,7 @@ static int path_load(Unit *u) {
 
         if (u->load_state == UNIT_LOADED) {
 
-                if (set_isempty(u->dependencies[UNIT_TRIGGERS])) {
+                if (unit_dependency_count(u, UNIT_TRIGGERS) == 0) {
                         Unit *x;
 
                         r = unit_load_related_unit(u, ".service", &x);
@@ -606,15 +606,15 @@ static int path_stop(Unit *u) {
         return 0;
 }
 
-static int path_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int path_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Path *p = PATH(u);
 
         assert(u);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", path_state_to_string(p->state));
-        unit_serialize_item(u, f, "result", path_result_to_string(p->result));
+        unit_serialize_item(u, st, "state", path_state_to_string(p->state));
+        unit_serialize_item(u, st, "result", path_result_to_string(p->result));
 
         return 0;
 }
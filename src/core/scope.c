@@ -349,14 +349,14 @@ static int scope_get_timeout(Unit *u, uint64_t *timeout) {
         return 1;
 }
 
-static int scope_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int scope_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Scope *s = SCOPE(u);
 
         assert(s);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", scope_state_to_string(s->state));
+        unit_serialize_item(u, st, "state", scope_state_to_string(s->state));
         return 0;
 }
 
@@ -811,7 +811,7 @@ static int service_coldplug(Unit *u) {
 }
 
 static int service_collect_fds(Service *s, int **fds, unsigned *n_fds) {
-        Iterator i;
+        unsigned i;
         int r;
         int *rfds = NULL;
         unsigned rn_fds = 0;
@@ -824,7 +824,7 @@ static int service_collect_fds(Service *s, int **fds, unsigned *n_fds) {
         if (s->socket_fd >= 0)
                 return 0;
 
-        SET_FOREACH(u, UNIT(s)->dependencies[UNIT_TRIGGERED_BY], i) {
+        UNIT_FOREACH_DEPENDENCY(u, UNIT(s), UNIT_TRIGGERED_BY, i) {
                 int *cfds;
                 unsigned cn_fds;
                 Socket *sock;
@@ -996,6 +996,7 @@ static int service_spawn(
         exec_params.n_fds = n_fds;
         exec_params.environment = final_env;
         exec_params.confirm_spawn = UNIT(s)->manager->confirm_spawn;
+        exec_params.exec_helper = UNIT(s)->manager->exec_helper;
         exec_params.cgroup_supported = UNIT(s)->manager->cgroup_supported;
         exec_params.cgroup_path = path;
         exec_params.runtime_prefix = manager_get_runtime_prefix(UNIT(s)->manager);
@@ -1744,34 +1745,34 @@ _pure_ static bool service_can_reload(Unit *u) {
         return !!s->exec_command[SERVICE_EXEC_RELOAD];
 }
 
-static int service_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int service_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Service *s = SERVICE(u);
 
         assert(u);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", service_state_to_string(s->state));
-        unit_serialize_item(u, f, "result", service_result_to_string(s->result));
-        unit_serialize_item(u, f, "reload-result", service_result_to_string(s->reload_result));
+        unit_serialize_item(u, st, "state", service_state_to_string(s->state));
+        unit_serialize_item(u, st, "result", service_result_to_string(s->result));
+        unit_serialize_item(u, st, "reload-result", service_result_to_string(s->reload_result));
 
         if (s->control_pid > 0)
-                unit_serialize_item_format(u, f, "control-pid", PID_FMT,
+                unit_serialize_item_format(u, st, "control-pid", PID_FMT,
                                            s->control_pid);
 
         if (s->main_pid_known && s->main_pid > 0)
-                unit_serialize_item_format(u, f, "main-pid", PID_FMT, s->main_pid);
+                unit_serialize_item_format(u, st, "main-pid", PID_FMT, s->main_pid);
 
-        unit_serialize_item(u, f, "main-pid-known", yes_no(s->main_pid_known));
+        unit_serialize_item(u, st, "main-pid-known", yes_no(s->main_pid_known));
 
         if (s->status_text)
-                unit_serialize_item(u, f, "status-text", s->status_text);
+                unit_serialize_item(u, st, "status-text", s->status_text);
 
         /* FIXME: There's a minor uncleanliness here: if there are
          * multiple commands attached here, we will start from the
          * first one again */
         if (s->control_command_id >= 0)
-                unit_serialize_item(u, f, "control-command",
+                unit_serialize_item(u, st, "control-command",
                                     service_exec_command_to_string(s->control_command_id));
 
         if (s->socket_fd >= 0) {
@@ -1780,7 +1781,7 @@ static int service_serialize(Unit *u, FILE *f, FDSet *fds) {
                 if ((copy = fdset_put_dup(fds, s->socket_fd)) < 0)
                         return copy;
 
-                unit_serialize_item_format(u, f, "socket-fd", "%i", copy);
+                unit_serialize_item_format(u, st, "socket-fd", "%i", copy);
         }
 
         if (s->bus_endpoint_fd >= 0) {
@@ -1789,29 +1790,29 @@ static int service_serialize(Unit *u, FILE *f, FDSet *fds) {
                 if ((copy = fdset_put_dup(fds, s->bus_endpoint_fd)) < 0)
                         return copy;
 
-                unit_serialize_item_format(u, f, "endpoint-fd", "%i", copy);
+                unit_serialize_item_format(u, st, "endpoint-fd", "%i", copy);
         }
 
         if (s->main_exec_status.pid > 0) {
-                unit_serialize_item_format(u, f, "main-exec-status-pid", PID_FMT,
+                unit_serialize_item_format(u, st, "main-exec-status-pid", PID_FMT,
                                            s->main_exec_status.pid);
-                dual_timestamp_serialize(f, "main-exec-status-start",
+                dual_timestamp_serialize(st, "main-exec-status-start",
                                          &s->main_exec_status.start_timestamp);
-                dual_timestamp_serialize(f, "main-exec-status-exit",
+                dual_timestamp_serialize(st, "main-exec-status-exit",
                                          &s->main_exec_status.exit_timestamp);
 
                 if (dual_timestamp_is_set(&s->main_exec_status.exit_timestamp)) {
-                        unit_serialize_item_format(u, f, "main-exec-status-code", "%i",
+                        unit_serialize_item_format(u, st, "main-exec-status-code", "%i",
                                                    s->main_exec_status.code);
-                        unit_serialize_item_format(u, f, "main-exec-status-status", "%i",
+                        unit_serialize_item_format(u, st, "main-exec-status-status", "%i",
                                                    s->main_exec_status.status);
                 }
         }
         if (dual_timestamp_is_set(&s->watchdog_timestamp))
-                dual_timestamp_serialize(f, "watchdog-timestamp", &s->watchdog_timestamp);
+                dual_timestamp_serialize(st, "watchdog-timestamp", &s->watchdog_timestamp);
 
         if (s->forbid_restart)
-                unit_serialize_item(u, f, "forbid-restart", yes_no(s->forbid_restart));
+                unit_serialize_item(u, st, "forbid-restart", yes_no(s->forbid_restart));
 
         return 0;
 }
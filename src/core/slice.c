@@ -207,14 +207,14 @@ static int slice_kill(Unit *u, KillWho who, int signo, sd_bus_error *error) {
         return unit_kill_common(u, who, signo, -1, -1, error);
 }
 
-static int slice_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int slice_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Slice *s = SLICE(u);
 
         assert(s);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", slice_state_to_string(s->state));
+        unit_serialize_item(u, st, "state", slice_state_to_string(s->state));
         return 0;
 }
 
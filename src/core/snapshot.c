@@ -124,19 +124,19 @@ static int snapshot_stop(Unit *u) {
         return 0;
 }
 
-static int snapshot_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int snapshot_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Snapshot *s = SNAPSHOT(u);
         Unit *other;
-        Iterator i;
+        unsigned i;
 
         assert(s);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", snapshot_state_to_string(s->state));
-        unit_serialize_item(u, f, "cleanup", yes_no(s->cleanup));
-        SET_FOREACH(other, u->dependencies[UNIT_WANTS], i)
-                unit_serialize_item(u, f, "wants", other->id);
+        unit_serialize_item(u, st, "state", snapshot_state_to_string(s->state));
+        unit_serialize_item(u, st, "cleanup", yes_no(s->cleanup));
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_WANTS, i)
+                unit_serialize_item(u, st, "wants", other->id);
 
         return 0;
 }
@@ -1389,6 +1389,7 @@ static int socket_spawn(Socket *s, ExecCommand *c, pid_t *_pid) {
                 .apply_permissions = true,
                 .apply_chroot      = true,
                 .apply_tty_stdin   = true,
+                .bus_endpoint_fd   = -1,
         };
 
         assert(s);
@@ -1412,6 +1413,7 @@ static int socket_spawn(Socket *s, ExecCommand *c, pid_t *_pid) {
         exec_params.argv = argv;
         exec_params.environment = UNIT(s)->manager->environment;
         exec_params.confirm_spawn = UNIT(s)->manager->confirm_spawn;
+        exec_params.exec_helper = UNIT(s)->manager->exec_helper;
         exec_params.cgroup_supported = UNIT(s)->manager->cgroup_supported;
         exec_params.cgroup_path = UNIT(s)->cgroup_path;
         exec_params.runtime_prefix = manager_get_runtime_prefix(UNIT(s)->manager);
@@ -1774,13 +1776,13 @@ static void socket_enter_running(Socket *s, int cfd) {
         }
 
         if (cfd < 0) {
-                Iterator i;
+                unsigned i;
                 Unit *other;
                 bool pending = false;
 
                 /* If there's already a start pending don't bother to
                  * do anything */
-                SET_FOREACH(other, UNIT(s)->dependencies[UNIT_TRIGGERS], i)
+                UNIT_FOREACH_DEPENDENCY(other, UNIT(s), UNIT_TRIGGERS, i)
                         if (unit_active_or_pending(other)) {
                                 pending = true;
                                 break;
@@ -1985,24 +1987,24 @@ static int socket_stop(Unit *u) {
         return 0;
 }
 
-static int socket_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int socket_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Socket *s = SOCKET(u);
         SocketPort *p;
         int r;
 
         assert(u);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", socket_state_to_string(s->state));
-        unit_serialize_item(u, f, "result", socket_result_to_string(s->result));
-        unit_serialize_item_format(u, f, "n-accepted", "%u", s->n_accepted);
+        unit_serialize_item(u, st, "state", socket_state_to_string(s->state));
+        unit_serialize_item(u, st, "result", socket_result_to_string(s->result));
+        unit_serialize_item_format(u, st, "n-accepted", "%u", s->n_accepted);
 
         if (s->control_pid > 0)
-                unit_serialize_item_format(u, f, "control-pid", PID_FMT, s->control_pid);
+                unit_serialize_item_format(u, st, "control-pid", PID_FMT, s->control_pid);
 
         if (s->control_command_id >= 0)
-                unit_serialize_item(u, f, "control-command", socket_exec_command_to_string(s->control_command_id));
+                unit_serialize_item(u, st, "control-command", socket_exec_command_to_string(s->control_command_id));
 
         LIST_FOREACH(port, p, s->ports) {
                 int copy;
@@ -2022,17 +2024,17 @@ static int socket_serialize(Unit *u, FILE *f, FDSet *fds) {
                                 return r;
 
                         if (socket_address_family(&p->address) == AF_NETLINK)
-                                unit_serialize_item_format(u, f, "netlink", "%i %s", copy, t);
+                                unit_serialize_item_format(u, st, "netlink", "%i %s", copy, t);
                         else
-                                unit_serialize_item_format(u, f, "socket", "%i %i %s", copy, p->address.type, t);
+                                unit_serialize_item_format(u, st, "socket", "%i %i %s", copy, p->address.type, t);
 
                 } else if (p->type == SOCKET_SPECIAL)
-                        unit_serialize_item_format(u, f, "special", "%i %s", copy, p->path);
+                        unit_serialize_item_format(u, st, "special", "%i %s", copy, p->path);
                 else if (p->type == SOCKET_MQUEUE)
-                        unit_serialize_item_format(u, f, "mqueue", "%i %s", copy, p->path);
+                        unit_serialize_item_format(u, st, "mqueue", "%i %s", copy, p->path);
                 else {
                         assert(p->type == SOCKET_FIFO);
-                        unit_serialize_item_format(u, f, "fifo", "%i %s", copy, p->path);
+                        unit_serialize_item_format(u, st, "fifo", "%i %s", copy, p->path);
                 }
         }
 
@@ -630,6 +630,7 @@ static int swap_spawn(Swap *s, ExecCommand *c, pid_t *_pid) {
                 .apply_permissions = true,
                 .apply_chroot      = true,
                 .apply_tty_stdin   = true,
+                .bus_endpoint_fd   = -1,
         };
 
         assert(s);
@@ -648,6 +649,7 @@ static int swap_spawn(Swap *s, ExecCommand *c, pid_t *_pid) {
 
         exec_params.environment = UNIT(s)->manager->environment;
         exec_params.confirm_spawn = UNIT(s)->manager->confirm_spawn;
+        exec_params.exec_helper = UNIT(s)->manager->exec_helper;
         exec_params.cgroup_supported = UNIT(s)->manager->cgroup_supported;
         exec_params.cgroup_path = UNIT(s)->cgroup_path;
         exec_params.runtime_prefix = manager_get_runtime_prefix(UNIT(s)->manager);
@@ -884,21 +886,21 @@ static int swap_stop(Unit *u) {
         return 0;
 }
 
-static int swap_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int swap_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Swap *s = SWAP(u);
 
         assert(s);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", swap_state_to_string(s->state));
-        unit_serialize_item(u, f, "result", swap_result_to_string(s->result));
+        unit_serialize_item(u, st, "state", swap_state_to_string(s->state));
+        unit_serialize_item(u, st, "result", swap_result_to_string(s->result));
 
         if (s->control_pid > 0)
-                unit_serialize_item_format(u, f, "control-pid", PID_FMT, s->control_pid);
+                unit_serialize_item_format(u, st, "control-pid", PID_FMT, s->control_pid);
 
         if (s->control_command_id >= 0)
-                unit_serialize_item(u, f, "control-command", swap_exec_command_to_string(s->control_command_id));
+                unit_serialize_item(u, st, "control-command", swap_exec_command_to_string(s->control_command_id));
 
         return 0;
 }
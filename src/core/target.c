@@ -64,7 +64,7 @@ static int target_add_default_dependencies(Target *t) {
                 UNIT_PART_OF
         };
 
-        Iterator i;
+        unsigned i;
         Unit *other;
         int r;
         unsigned k;
@@ -77,7 +77,7 @@ static int target_add_default_dependencies(Target *t) {
          * sure we don't create a loop. */
 
         for (k = 0; k < ELEMENTSOF(deps); k++)
-                SET_FOREACH(other, UNIT(t)->dependencies[deps[k]], i) {
+                UNIT_FOREACH_DEPENDENCY(other, UNIT(t), deps[k], i) {
                         r = unit_add_default_target_dependency(other, UNIT(t));
                         if (r < 0)
                                 return r;
@@ -150,14 +150,14 @@ static int target_stop(Unit *u) {
         return 0;
 }
 
-static int target_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int target_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Target *s = TARGET(u);
 
         assert(s);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", target_state_to_string(s->state));
+        unit_serialize_item(u, st, "state", target_state_to_string(s->state));
         return 0;
 }
 
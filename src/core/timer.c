@@ -175,7 +175,7 @@ static int timer_load(Unit *u) {
 
         if (u->load_state == UNIT_LOADED) {
 
-                if (set_isempty(u->dependencies[UNIT_TRIGGERS])) {
+                if (unit_dependency_count(u, UNIT_TRIGGERS) == 0) {
                         Unit *x;
 
                         r = unit_load_related_unit(u, ".service", &x);
@@ -557,21 +557,21 @@ static int timer_stop(Unit *u) {
         return 0;
 }
 
-static int timer_serialize(Unit *u, FILE *f, FDSet *fds) {
+static int timer_serialize(Unit *u, SerializeState *st, FDSet *fds) {
         Timer *t = TIMER(u);
 
         assert(u);
-        assert(f);
+        assert(st);
         assert(fds);
 
-        unit_serialize_item(u, f, "state", timer_state_to_string(t->state));
-        unit_serialize_item(u, f, "result", timer_result_to_string(t->result));
+        unit_serialize_item(u, st, "state", timer_state_to_string(t->state));
+        unit_serialize_item(u, st, "result", timer_result_to_string(t->result));
 
         if (t->last_trigger.realtime > 0)
-                unit_serialize_item_format(u, f, "last-trigger-realtime", "%" PRIu64, t->last_trigger.realtime);
+                unit_serialize_item_format(u, st, "last-trigger-realtime", "%" PRIu64, t->last_trigger.realtime);
 
         if (t->last_trigger.monotonic > 0)
-                unit_serialize_item_format(u, f, "last-trigger-monotonic", "%" PRIu64, t->last_trigger.monotonic);
+                unit_serialize_item_format(u, st, "last-trigger-monotonic", "%" PRIu64, t->last_trigger.monotonic);
 
         return 0;
 }
@@ -62,27 +62,41 @@ void transaction_abort(Transaction *tr) {
 }
 
 static void transaction_find_jobs_that_matter_to_anchor(Job *j, unsigned generation) {
-        JobDependency *l;
+        Job *stack;
 
-        /* A recursive sweep through the graph that marks all units
-         * that matter to the anchor job, i.e. are directly or
-         * indirectly a dependency of the anchor job via paths that
-         * are fully marked as mattering. */
+        /* A sweep through the graph that marks all units that matter
+         * to the anchor job, i.e. are directly or indirectly a
+         * dependency of the anchor job via paths that are fully
+         * marked as mattering. The jobs still to look at are chained
+         * up through their markers, so that deep graphs need neither
+         * deep recursion nor memory allocation. */
 
         j->matters_to_anchor = true;
         j->generation = generation;
+        j->marker = NULL;
+        stack = j;
 
-        LIST_FOREACH(subject, l, j->subject_list) {
+        while ((j = stack)) {
+                JobDependency *l;
 
-                /* This link does not matter */
-                if (!l->matters)
-                        continue;
+                stack = j->marker;
+                j->marker = NULL;
 
-                /* This unit has already been marked */
-                if (l->object->generation == generation)
-                        continue;
+                LIST_FOREACH(subject, l, j->subject_list) {
+
+                        /* This link does not matter */
+                        if (!l->matters)
+                                continue;
+
+                        /* This unit has already been marked */
+                        if (l->object->generation == generation)
+                                continue;
 
-                transaction_find_jobs_that_matter_to_anchor(l->object, generation);
+                        l->object->matters_to_anchor = true;
+                        l->object->generation = generation;
+                        l->object->marker = stack;
+                        stack = l->object;
+                }
         }
 }
 
@@ -308,9 +322,8 @@ static void transaction_drop_redundant(Transaction *tr) {
 
         assert(tr);
 
-rescan:
         HASHMAP_FOREACH(j, tr->jobs, i) {
-                Job *k;
+                Job *k, *n;
 
                 LIST_FOREACH(transaction, k, j) {
 
@@ -320,9 +333,14 @@ rescan:
                                 goto next_unit;
                 }
 
-                /* log_debug("Found redundant job %s/%s, dropping.", j->unit->id, job_type_to_string(j->type)); */
-                transaction_delete_job(tr, j, false);
-                goto rescan;
+                /* Deleting jobs without their dependencies only
+                 * touches the entry of this unit, hence neither the
+                 * iterator nor the verdict on the other units is
+                 * affected, and a single pass suffices. */
+                LIST_FOREACH_SAFE(transaction, k, n, j) {
+                        /* log_debug("Found redundant job %s/%s, dropping.", k->unit->id, job_type_to_string(k->type)); */
+                        transaction_delete_job(tr, k, false);
+                }
         next_unit:;
         }
 }
@@ -341,17 +359,20 @@ _pure_ static bool unit_matters_to_anchor(Unit *u, Job *j) {
         return false;
 }
 
-static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsigned generation, sd_bus_error *e) {
-        Iterator i;
-        Unit *u;
-        int r;
+typedef struct OrderFrame {
+        Job *job;
+        unsigned i;
+} OrderFrame;
 
+static int transaction_verify_order_visit(Transaction *tr, Job *j, Job *from, unsigned generation, sd_bus_error *e) {
         assert(tr);
         assert(j);
         assert(!j->transaction_prev);
 
-        /* Does a recursive sweep through the ordering graph, looking
-         * for a cycle. If we find a cycle we try to break it. */
+        /* Enters a job during the sweep through the ordering
+         * graph. Returns > 0 if it needs to be descended into, 0 if
+         * it is known to be loop-free already, and < 0 if we found a
+         * cycle, in which case we try to break it. */
 
         /* Have we seen this before? */
         if (j->generation == generation) {
@@ -424,11 +445,47 @@ static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsi
         j->marker = from ? from : j;
         j->generation = generation;
 
-        /* We assume that the dependencies are bidirectional, and
-         * hence can ignore UNIT_AFTER */
-        SET_FOREACH(u, j->unit->dependencies[UNIT_BEFORE], i) {
+        return 1;
+}
+
+static int transaction_verify_order_one(Transaction *tr, Job *j, unsigned generation,
+                                        OrderFrame **stack, size_t *n_allocated, sd_bus_error *e) {
+        size_t n = 0;
+        int r;
+
+        assert(tr);
+        assert(stack);
+        assert(n_allocated);
+
+        /* Does a depth-first sweep through the ordering graph,
+         * looking for a cycle. The path is kept on an explicit stack,
+         * so that long chains of units do not translate into deep
+         * recursion. */
+
+        r = transaction_verify_order_visit(tr, j, NULL, generation, e);
+        if (r <= 0)
+                return r;
+
+        if (!GREEDY_REALLOC(*stack, *n_allocated, 1))
+                return -ENOMEM;
+
+        (*stack)[n++] = (OrderFrame) { j, 0 };
+
+        while (n > 0) {
+                OrderFrame *f = *stack + n - 1;
+                Unit *u;
                 Job *o;
 
+                /* We assume that the dependencies are bidirectional,
+                 * and hence can ignore UNIT_AFTER */
+                if (!unit_dependencies_next(&f->job->unit->dependencies, UNIT_BEFORE, &f->i, &u)) {
+                        /* Ok, let's backtrack, and remember that
+                         * this entry is not on our path anymore. */
+                        f->job->marker = NULL;
+                        n--;
+                        continue;
+                }
+
                 /* Is there a job for this unit? */
                 o = hashmap_get(tr->jobs, u);
                 if (!o) {
@@ -440,19 +497,24 @@ static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsi
                                 continue;
                 }
 
-                r = transaction_verify_order_one(tr, o, j, generation, e);
+                r = transaction_verify_order_visit(tr, o, f->job, generation, e);
                 if (r < 0)
                         return r;
-        }
+                if (r == 0)
+                        continue;
 
-        /* Ok, let's backtrack, and remember that this entry is not on
-         * our path anymore. */
-        j->marker = NULL;
+                if (!GREEDY_REALLOC(*stack, *n_allocated, n + 1))
+                        return -ENOMEM;
+
+                (*stack)[n++] = (OrderFrame) { o, 0 };
+        }
 
         return 0;
 }
 
 static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bus_error *e) {
+        _cleanup_free_ OrderFrame *stack = NULL;
+        size_t n_allocated = 0;
         Job *j;
         int r;
         Iterator i;
@@ -462,18 +524,22 @@ static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bu
         assert(generation);
 
         /* Check if the ordering graph is cyclic. If it is, try to fix
-         * that up by dropping one of the jobs. */
+         * that up by dropping one of the jobs. Every job is descended
+         * into at most once per generation, hence this is linear in
+         * the size of the graph. */
 
         g = (*generation)++;
 
         HASHMAP_FOREACH(j, tr->jobs, i)
-                if ((r = transaction_verify_order_one(tr, j, NULL, g, e)) < 0)
+                if ((r = transaction_verify_order_one(tr, j, g, &stack, &n_allocated, e)) < 0)
                         return r;
 
         return 0;
 }
 
-static void transaction_collect_garbage(Transaction *tr) {
+static int transaction_collect_garbage(Transaction *tr) {
+        _cleanup_free_ Unit **queue = NULL;
+        size_t n_allocated = 0, n = 0;
         Iterator i;
         Job *j;
 
@@ -481,8 +547,25 @@ static void transaction_collect_garbage(Transaction *tr) {
 
         /* Drop jobs that are not required by any other job */
 
-rescan:
+        /* Dropping a job only ever makes the jobs it pulled in and
+         * the next job of its own unit candidates for removal, hence
+         * we collect the units to look at in a queue, instead of
+         * rescanning the whole transaction after each drop. */
         HASHMAP_FOREACH(j, tr->jobs, i) {
+                if (!GREEDY_REALLOC(queue, n_allocated, n + 1))
+                        return -ENOMEM;
+
+                queue[n++] = j->unit;
+        }
+
+        while (n > 0) {
+                JobDependency *l;
+                Unit *u = queue[--n];
+
+                j = hashmap_get(tr->jobs, u);
+                if (!j)
+                        continue;
+
                 if (tr->anchor_job == j || j->object_list) {
                         /* log_debug("Keeping job %s/%s because of %s/%s", */
                         /*           j->unit->id, job_type_to_string(j->type), */
@@ -491,10 +574,23 @@ rescan:
                         continue;
                 }
 
+                if (!GREEDY_REALLOC(queue, n_allocated, n + 1))
+                        return -ENOMEM;
+
+                queue[n++] = u;
+
+                LIST_FOREACH(subject, l, j->subject_list) {
+                        if (!GREEDY_REALLOC(queue, n_allocated, n + 1))
+                                return -ENOMEM;
+
+                        queue[n++] = l->object->unit;
+                }
+
                 /* log_debug("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type)); */
                 transaction_delete_job(tr, j, true);
-                goto rescan;
         }
+
+        return 0;
 }
 
 static int transaction_is_destructive(Transaction *tr, JobMode mode, sd_bus_error *e) {
@@ -675,8 +771,11 @@ int transaction_activate(Transaction *tr, Manager *m, JobMode mode, sd_bus_error
         for (;;) {
                 /* Fourth step: Let's remove unneeded jobs that might
                  * be lurking. */
-                if (mode != JOB_ISOLATE)
-                        transaction_collect_garbage(tr);
+                if (mode != JOB_ISOLATE) {
+                        r = transaction_collect_garbage(tr);
+                        if (r < 0)
+                                return r;
+                }
 
                 /* Fifth step: verify order makes sense and correct
                  * cycles if necessary and possible */
@@ -708,8 +807,11 @@ int transaction_activate(Transaction *tr, Manager *m, JobMode mode, sd_bus_error
 
                 /* Seventh step: an entry got dropped, let's garbage
                  * collect its dependencies. */
-                if (mode != JOB_ISOLATE)
-                        transaction_collect_garbage(tr);
+                if (mode != JOB_ISOLATE) {
+                        r = transaction_collect_garbage(tr);
+                        if (r < 0)
+                                return r;
+                }
 
                 /* Let's see if the resulting transaction still has
                  * unmergeable entries ... */
@@ -845,7 +947,7 @@ int transaction_add_job_and_dependencies(
                 bool ignore_order,
                 sd_bus_error *e) {
         Job *ret;
-        Iterator i;
+        unsigned i;
         Unit *dep;
         int r;
         bool is_new;
@@ -924,11 +1026,12 @@ int transaction_add_job_and_dependencies(
 
         if (is_new && !ignore_requirements && type != JOB_NOP) {
                 Set *following;
+                Iterator j;
 
                 /* If we are following some other unit, make sure we
                  * add all dependencies of everybody following. */
                 if (unit_following_set(ret->unit, &following) > 0) {
-                        SET_FOREACH(dep, following, i) {
+                        SET_FOREACH(dep, following, j) {
                                 r = transaction_add_job_and_dependencies(tr, type, dep, ret, false, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_warning_unit(dep->id,
@@ -945,7 +1048,7 @@ int transaction_add_job_and_dependencies(
 
                 /* Finally, recursively add in all dependencies. */
                 if (type == JOB_START || type == JOB_RESTART) {
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_REQUIRES], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUIRES, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, true, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR)
@@ -956,7 +1059,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_BINDS_TO], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_BINDS_TO, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, true, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR)
@@ -967,7 +1070,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_REQUIRES_OVERRIDABLE], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUIRES_OVERRIDABLE, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, !override, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_full_unit(r == -EADDRNOTAVAIL ? LOG_DEBUG : LOG_WARNING, dep->id,
@@ -979,7 +1082,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_WANTS], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_WANTS, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, false, false, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_full_unit(r == -EADDRNOTAVAIL ? LOG_DEBUG : LOG_WARNING, dep->id,
@@ -991,7 +1094,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_REQUISITE], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUISITE, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_VERIFY_ACTIVE, dep, ret, true, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR)
@@ -1002,7 +1105,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_REQUISITE_OVERRIDABLE], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUISITE_OVERRIDABLE, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_VERIFY_ACTIVE, dep, ret, !override, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_full_unit(r == -EADDRNOTAVAIL ? LOG_DEBUG : LOG_WARNING, dep->id,
@@ -1014,7 +1117,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_CONFLICTS], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_CONFLICTS, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, true, override, true, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR)
@@ -1025,7 +1128,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_CONFLICTED_BY], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_CONFLICTED_BY, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, false, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_warning_unit(dep->id,
@@ -1041,7 +1144,7 @@ int transaction_add_job_and_dependencies(
 
                 if (type == JOB_STOP || type == JOB_RESTART) {
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_REQUIRED_BY], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUIRED_BY, i) {
                                 r = transaction_add_job_and_dependencies(tr, type, dep, ret, true, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR)
@@ -1052,7 +1155,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_BOUND_BY], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_BOUND_BY, i) {
                                 r = transaction_add_job_and_dependencies(tr, type, dep, ret, true, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR)
@@ -1063,7 +1166,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_CONSISTS_OF], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_CONSISTS_OF, i) {
                                 r = transaction_add_job_and_dependencies(tr, type, dep, ret, true, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR)
@@ -1078,7 +1181,7 @@ int transaction_add_job_and_dependencies(
 
                 if (type == JOB_RELOAD) {
 
-                        SET_FOREACH(dep, ret->unit->dependencies[UNIT_PROPAGATES_RELOAD_TO], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_PROPAGATES_RELOAD_TO, i) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_RELOAD, dep, ret, false, override, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_warning_unit(dep->id,
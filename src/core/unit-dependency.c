@@ -0,0 +1,318 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "util.h"
+#include "unit-dependency.h"
+
+/* Up to this many slots we simply scan the entries */
+#define INDEX_MIN 8U
+
+#define INDEX_NONE ((unsigned) -1)
+
+static unsigned index_hash(const UnitDependencies *deps, const struct Unit *other) {
+        uint64_t h;
+
+        /* Fibonacci hashing of the pointer, the upper bits are the
+         * well mixed ones */
+        h = (uint64_t) (uintptr_t) other * UINT64_C(0x9E3779B97F4A7C15);
+
+        return (unsigned) (h >> 32) & (deps->index_size - 1);
+}
+
+static unsigned find_entry(const UnitDependencies *deps, const struct Unit *other) {
+        unsigned i;
+
+        assert(deps);
+        assert(other);
+
+        if (!deps->index) {
+                for (i = 0; i < deps->n_entries; i++)
+                        if (deps->entries[i].other == other)
+                                return i;
+
+                return INDEX_NONE;
+        }
+
+        for (i = index_hash(deps, other);; i = (i + 1) & (deps->index_size - 1)) {
+                unsigned k = deps->index[i];
+
+                if (k == 0)
+                        return INDEX_NONE;
+
+                if (deps->entries[k - 1].other == other)
+                        return k - 1;
+        }
+}
+
+static void index_insert(UnitDependencies *deps, unsigned k) {
+        unsigned i;
+
+        for (i = index_hash(deps, deps->entries[k].other);
+             deps->index[i] != 0;
+             i = (i + 1) & (deps->index_size - 1))
+                ;
+
+        deps->index[i] = k + 1;
+}
+
+static void index_remove(UnitDependencies *deps, unsigned k) {
+        unsigned i, j;
+
+        for (i = index_hash(deps, deps->entries[k].other);
+             deps->index[i] != k + 1;
+             i = (i + 1) & (deps->index_size - 1))
+                assert(deps->index[i] != 0);
+
+        /* Shift back the following entries of the run that would
+         * not be found anymore otherwise */
+        for (j = (i + 1) & (deps->index_size - 1);
+             deps->index[j] != 0;
+             j = (j + 1) & (deps->index_size - 1)) {
+                unsigned h;
+
+                h = index_hash(deps, deps->entries[deps->index[j] - 1].other);
+
+                /* Is h cyclically in (i, j]? Then the entry is fine
+                 * where it is */
+                if (i <= j ? (i < h && h <= j) : (i < h || h <= j))
+                        continue;
+
+                deps->index[i] = deps->index[j];
+                i = j;
+        }
+
+        deps->index[i] = 0;
+}
+
+static int index_resize(UnitDependencies *deps, unsigned n) {
+        unsigned size, k;
+        unsigned *index;
+
+        /* Keeps the index at most half full */
+        size = 16;
+        while (size < n * 2)
+                size *= 2;
+
+        if (size <= deps->index_size)
+                return 0;
+
+        index = new0(unsigned, size);
+        if (!index)
+                return -ENOMEM;
+
+        free(deps->index);
+        deps->index = index;
+        deps->index_size = size;
+
+        for (k = 0; k < deps->n_entries; k++)
+                if (deps->entries[k].other)
+                        index_insert(deps, k);
+
+        return 0;
+}
+
+int unit_dependencies_reserve(UnitDependencies *deps, unsigned n) {
+        unsigned total;
+
+        assert(deps);
+
+        total = deps->n_used + n;
+
+        if (!GREEDY_REALLOC(deps->entries, deps->n_allocated, total))
+                return -ENOMEM;
+
+        if (total > INDEX_MIN)
+                return index_resize(deps, total);
+
+        return 0;
+}
+
+int unit_dependencies_add(UnitDependencies *deps, struct Unit *other, UnitDependency d) {
+        unsigned k;
+        int r;
+
+        assert(deps);
+        assert(other);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+
+        /* Returns 0 if the dependency existed already, 1 if it was
+         * added */
+
+        k = find_entry(deps, other);
+        if (k != INDEX_NONE) {
+                if (deps->entries[k].mask & UNIT_DEPENDENCY_BIT(d))
+                        return 0;
+
+                deps->entries[k].mask |= UNIT_DEPENDENCY_BIT(d);
+                deps->count[d]++;
+                return 1;
+        }
+
+        r = unit_dependencies_reserve(deps, 1);
+        if (r < 0)
+                return r;
+
+        if (deps->free_slot > 0) {
+                k = deps->free_slot - 1;
+                deps->free_slot = deps->entries[k].mask;
+        } else
+                k = deps->n_entries++;
+
+        deps->entries[k].other = other;
+        deps->entries[k].mask = UNIT_DEPENDENCY_BIT(d);
+        deps->n_used++;
+        deps->count[d]++;
+
+        if (deps->index)
+                index_insert(deps, k);
+
+        return 1;
+}
+
+static void release_entry(UnitDependencies *deps, unsigned k) {
+        if (deps->index)
+                index_remove(deps, k);
+
+        deps->entries[k].other = NULL;
+        deps->entries[k].mask = deps->free_slot;
+        deps->free_slot = k + 1;
+        deps->n_used--;
+}
+
+bool unit_dependencies_remove(UnitDependencies *deps, struct Unit *other, UnitDependency d) {
+        unsigned k;
+
+        assert(deps);
+        assert(other);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+
+        k = find_entry(deps, other);
+        if (k == INDEX_NONE || !(deps->entries[k].mask & UNIT_DEPENDENCY_BIT(d)))
+                return false;
+
+        deps->entries[k].mask &= ~UNIT_DEPENDENCY_BIT(d);
+        deps->count[d]--;
+
+        if (deps->entries[k].mask == 0)
+                release_entry(deps, k);
+
+        return true;
+}
+
+uint32_t unit_dependencies_remove_all(UnitDependencies *deps, struct Unit *other) {
+        UnitDependency d;
+        uint32_t mask;
+        unsigned k;
+
+        assert(deps);
+        assert(other);
+
+        /* Drops all dependencies on other, and returns which they
+         * were */
+
+        k = find_entry(deps, other);
+        if (k == INDEX_NONE)
+                return 0;
+
+        mask = deps->entries[k].mask;
+        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
+                if (mask & UNIT_DEPENDENCY_BIT(d))
+                        deps->count[d]--;
+
+        release_entry(deps, k);
+
+        return mask;
+}
+
+uint32_t unit_dependencies_get(const UnitDependencies *deps, const struct Unit *other) {
+        unsigned k;
+
+        assert(deps);
+
+        if (!other)
+                return 0;
+
+        k = find_entry(deps, other);
+        if (k == INDEX_NONE)
+                return 0;
+
+        return deps->entries[k].mask;
+}
+
+void unit_dependencies_done(UnitDependencies *deps) {
+        assert(deps);
+
+        free(deps->entries);
+        free(deps->index);
+        zero(*deps);
+}
+
+bool unit_dependencies_next(const UnitDependencies *deps, UnitDependency d, unsigned *i, struct Unit **ret) {
+        assert(deps);
+        assert(d >= 0 && d < _UNIT_DEPENDENCY_MAX);
+        assert(i);
+        assert(ret);
+
+        if (deps->count[d] == 0)
+                return false;
+
+        for (; *i < deps->n_entries; (*i)++) {
+                const UnitDependencyEntry *e = deps->entries + *i;
+
+                if (e->other && (e->mask & UNIT_DEPENDENCY_BIT(d))) {
+                        *ret = e->other;
+                        (*i)++;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+bool unit_dependencies_next_any(const UnitDependencies *deps, unsigned *i, struct Unit **ret, uint32_t *mask) {
+        assert(deps);
+        assert(i);
+        assert(ret);
+        assert(mask);
+
+        for (; *i < deps->n_entries; (*i)++) {
+                const UnitDependencyEntry *e = deps->entries + *i;
+
+                if (e->other) {
+                        *ret = e->other;
+                        *mask = e->mask;
+                        (*i)++;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+size_t unit_dependencies_memory(const UnitDependencies *deps) {
+        assert(deps);
+
+        return deps->n_allocated * sizeof(UnitDependencyEntry) +
+                deps->index_size * sizeof(unsigned);
+}
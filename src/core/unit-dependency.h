@@ -0,0 +1,81 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "macro.h"
+#include "unit-name.h"
+
+/* The dependencies of a unit, of all types. There is one entry per
+ * other unit, with a bit set for each type of dependency on it, so
+ * that most units get away with a single small array. Lookups by unit
+ * are linear until there are more than a few entries, after which an
+ * open addressing index is kept alongside.
+ *
+ * Entries never move, and slots of removed ones are reused, hence it
+ * is safe to add and remove dependencies while iterating. */
+
+typedef struct UnitDependencyEntry {
+        struct Unit *other;
+
+        /* Bits of UnitDependency, or the next free slot plus one
+         * while the slot is unused */
+        uint32_t mask;
+} UnitDependencyEntry;
+
+typedef struct UnitDependencies {
+        UnitDependencyEntry *entries;
+        unsigned n_entries;
+        size_t n_allocated;
+        unsigned n_used;
+
+        /* First unused slot plus one */
+        unsigned free_slot;
+
+        /* Entry plus one, or 0 */
+        unsigned *index;
+        unsigned index_size;
+
+        unsigned count[_UNIT_DEPENDENCY_MAX];
+} UnitDependencies;
+
+#define UNIT_DEPENDENCY_BIT(d) (UINT32_C(1) << (d))
+
+int unit_dependencies_add(UnitDependencies *deps, struct Unit *other, UnitDependency d);
+bool unit_dependencies_remove(UnitDependencies *deps, struct Unit *other, UnitDependency d);
+uint32_t unit_dependencies_remove_all(UnitDependencies *deps, struct Unit *other);
+uint32_t unit_dependencies_get(const UnitDependencies *deps, const struct Unit *other) _pure_;
+int unit_dependencies_reserve(UnitDependencies *deps, unsigned n);
+void unit_dependencies_done(UnitDependencies *deps);
+
+bool unit_dependencies_next(const UnitDependencies *deps, UnitDependency d, unsigned *i, struct Unit **ret);
+bool unit_dependencies_next_any(const UnitDependencies *deps, unsigned *i, struct Unit **ret, uint32_t *mask);
+
+size_t unit_dependencies_memory(const UnitDependencies *deps) _pure_;
+
+#define UNIT_DEPENDENCIES_FOREACH(other, deps, d, i)                    \
+        for ((i) = 0; unit_dependencies_next((deps), (d), &(i), &(other)); )
+
+#define UNIT_DEPENDENCIES_FOREACH_ANY(other, mask, deps, i)             \
+        for ((i) = 0; unit_dependencies_next_any((deps), &(i), &(other), &(mask)); )
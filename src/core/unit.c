@@ -52,6 +52,10 @@
 #include "execute.h"
 #include "virt.h"
 #include "dropin.h"
+#include "siphash24.h"
+#include "conf-parser.h"
+#include "conf-cache.h"
+#include "serialize.h"
 
 const UnitVTable * const unit_vtable[_UNIT_TYPE_MAX] = {
         [UNIT_SERVICE] = &service_vtable,
@@ -72,6 +76,7 @@ const UnitVTable * const unit_vtable[_UNIT_TYPE_MAX] = {
 static int maybe_warn_about_dependency(const char *id, const char *other, UnitDependency dependency);
 
 Unit *unit_new(Manager *m, size_t size) {
+        unsigned i;
         Unit *u;
 
         assert(m);
@@ -93,6 +98,10 @@ Unit *unit_new(Manager *m, size_t size) {
         u->default_dependencies = true;
         u->unit_file_state = _UNIT_FILE_STATE_INVALID;
         u->on_failure_job_mode = JOB_REPLACE;
+        u->cgroup_inotify_wd = -1;
+
+        for (i = 0; i < _CGROUP_CONTROLLER_MAX; i++)
+                u->cgroup_fds[i] = -1;
 
         return u;
 }
@@ -344,6 +353,11 @@ void unit_add_to_dbus_queue(Unit *u) {
         assert(u);
         assert(u->type != _UNIT_TYPE_INVALID);
 
+        /* GetAll() snapshots go stale right away, not only when the
+         * queue is dispatched, which might be delayed by signal
+         * coalescing or not happen at all if nobody is subscribed */
+        bus_unit_invalidate_property_cache(u);
+
         if (u->load_state == UNIT_STUB || u->in_dbus_queue)
                 return;
 
@@ -358,25 +372,25 @@ void unit_add_to_dbus_queue(Unit *u) {
         u->in_dbus_queue = true;
 }
 
-static void bidi_set_free(Unit *u, Set *s) {
-        Iterator i;
+static void unit_free_dependencies(Unit *u) {
+        unsigned i;
+        uint32_t mask;
         Unit *other;
 
         assert(u);
 
-        /* Frees the set and makes sure we are dropped from the
-         * inverse pointers */
-
-        SET_FOREACH(other, s, i) {
-                UnitDependency d;
-
-                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                        set_remove(other->dependencies[d], u);
+        /* Frees the dependencies and makes sure we are dropped from
+         * the inverse pointers */
 
+        UNIT_DEPENDENCIES_FOREACH_ANY(other, mask, &u->dependencies, i) {
+                unit_dependencies_remove_all(&other->dependencies, u);
                 unit_add_to_gc_queue(other);
+
+                /* Its dependency lists changed too */
+                unit_add_to_dbus_queue(other);
         }
 
-        set_free(s);
+        unit_dependencies_done(&u->dependencies);
 }
 
 static void unit_remove_transient(Unit *u) {
@@ -452,7 +466,6 @@ static void unit_done(Unit *u) {
 }
 
 void unit_free(Unit *u) {
-        UnitDependency d;
         Iterator i;
         char *t;
 
@@ -482,8 +495,7 @@ void unit_free(Unit *u) {
                 job_free(j);
         }
 
-        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                bidi_set_free(u, u->dependencies[d]);
+        unit_free_dependencies(u);
 
         if (u->type != _UNIT_TYPE_INVALID)
                 LIST_REMOVE(units_by_type, u->manager->units_by_type[u->type], u);
@@ -505,6 +517,12 @@ void unit_free(Unit *u) {
         if (u->in_cgroup_queue)
                 LIST_REMOVE(cgroup_queue, u->manager->cgroup_queue, u);
 
+        if (u->in_cgroup_empty_queue)
+                LIST_REMOVE(cgroup_empty_queue, u->manager->cgroup_empty_queue, u);
+
+        unit_unwatch_cgroup(u);
+        unit_release_cgroup_attributes(u, 0);
+
         if (u->cgroup_path) {
                 hashmap_remove(u->manager->cgroup_unit, u->cgroup_path);
                 free(u->cgroup_path);
@@ -596,69 +614,50 @@ static int merge_names(Unit *u, Unit *other) {
         return 0;
 }
 
-static int reserve_dependencies(Unit *u, Unit *other, UnitDependency d) {
-        unsigned n_reserve;
+static void merge_dependencies(Unit *u, Unit *other, const char *other_id) {
+        unsigned i;
+        uint32_t mask;
+        Unit *back;
 
         assert(u);
         assert(other);
-        assert(d < _UNIT_DEPENDENCY_MAX);
-
-        /*
-         * If u does not have this dependency set allocated, there is no need
-         * to reserve anything. In that case other's set will be transfered
-         * as a whole to u by complete_move().
-         */
-        if (!u->dependencies[d])
-                return 0;
 
-        /* merge_dependencies() will skip a u-on-u dependency */
-        n_reserve = set_size(other->dependencies[d]) - !!set_get(other->dependencies[d], u);
-
-        return set_reserve(u->dependencies[d], n_reserve);
-}
-
-static void merge_dependencies(Unit *u, Unit *other, const char *other_id, UnitDependency d) {
-        Iterator i;
-        Unit *back;
-        int r;
+        UNIT_DEPENDENCIES_FOREACH_ANY(back, mask, &other->dependencies, i) {
+                UnitDependency d;
+                uint32_t back_mask;
 
-        assert(u);
-        assert(other);
-        assert(d < _UNIT_DEPENDENCY_MAX);
+                /* Fix backwards pointers. This cannot fail, since
+                 * the slot of other is reused for u. */
+                back_mask = unit_dependencies_remove_all(&back->dependencies, other);
 
-        /* Fix backwards pointers */
-        SET_FOREACH(back, other->dependencies[d], i) {
-                UnitDependency k;
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
 
-                for (k = 0; k < _UNIT_DEPENDENCY_MAX; k++) {
                         /* Do not add dependencies between u and itself */
                         if (back == u) {
-                                if (set_remove(back->dependencies[k], other))
-                                        maybe_warn_about_dependency(u->id, other_id, k);
-                        } else {
-                                r = set_remove_and_put(back->dependencies[k], other, u);
-                                if (r == -EEXIST)
-                                        set_remove(back->dependencies[k], other);
-                                else
-                                        assert(r >= 0 || r == -ENOENT);
+                                if (back_mask & UNIT_DEPENDENCY_BIT(d))
+                                        maybe_warn_about_dependency(u->id, other_id, d);
+                                if (mask & UNIT_DEPENDENCY_BIT(d))
+                                        maybe_warn_about_dependency(u->id, other_id, d);
+                                continue;
                         }
+
+                        if (back_mask & UNIT_DEPENDENCY_BIT(d))
+                                assert_se(unit_dependencies_add(&back->dependencies, u, d) >= 0);
+
+                        /* The caller must have performed a reservation */
+                        if (mask & UNIT_DEPENDENCY_BIT(d))
+                                assert_se(unit_dependencies_add(&u->dependencies, back, d) >= 0);
                 }
-        }
 
-        /* Also do not move dependencies on u to itself */
-        back = set_remove(other->dependencies[d], u);
-        if (back)
-                maybe_warn_about_dependency(u->id, other_id, d);
+                unit_add_to_dbus_queue(back);
+        }
 
-        /* The move cannot fail. The caller must have performed a reservation. */
-        assert_se(complete_move(&u->dependencies[d], &other->dependencies[d]) == 0);
+        unit_dependencies_done(&other->dependencies);
 
-        set_free(other->dependencies[d]);
-        other->dependencies[d] = NULL;
+        unit_add_to_dbus_queue(u);
 }
 
 int unit_merge(Unit *u, Unit *other) {
-        UnitDependency d;
         const char *other_id = NULL;
         int r;
 
@@ -694,16 +693,12 @@ int unit_merge(Unit *u, Unit *other) {
         if (other->id)
                 other_id = strdupa(other->id);
 
-        /* Make reservations to ensure merge_dependencies() won't fail */
-        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
-                r = reserve_dependencies(u, other, d);
-                /*
-                 * We don't rollback reservations if we fail. We don't have
-                 * a way to undo reservations. A reservation is not a leak.
-                 */
-                if (r < 0)
-                        return r;
-        }
+        /* Make reservations to ensure merge_dependencies() won't
+         * fail. We don't rollback reservations if we fail. A
+         * reservation is not a leak. */
+        r = unit_dependencies_reserve(&u->dependencies, other->dependencies.n_used);
+        if (r < 0)
+                return r;
 
         /* Merge names */
         r = merge_names(u, other);
@@ -715,8 +710,7 @@ int unit_merge(Unit *u, Unit *other) {
                 unit_ref_set(other->refs, u);
 
         /* Merge dependencies */
-        for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                merge_dependencies(u, other, other_id, d);
+        merge_dependencies(u, other, other_id);
 
         other->load_state = UNIT_MERGED;
         other->merged_into = u;
@@ -932,8 +926,9 @@ void unit_dump(Unit *u, FILE *f, const char *prefix) {
 
         for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
                 Unit *other;
+                unsigned k;
 
-                SET_FOREACH(other, u->dependencies[d], i)
+                UNIT_FOREACH_DEPENDENCY(other, u, d, k)
                         fprintf(f, "%s\t%s: %s\n", prefix, unit_dependency_to_string(d), other->id);
         }
 
@@ -1051,7 +1046,7 @@ int unit_add_default_target_dependency(Unit *u, Unit *target) {
                 return 0;
 
         /* Don't create loops */
-        if (set_get(target->dependencies[UNIT_BEFORE], u))
+        if (unit_has_dependency(target, UNIT_BEFORE, u))
                 return 0;
 
         return unit_add_dependency(target, UNIT_AFTER, u, true);
@@ -1067,14 +1062,14 @@ static int unit_add_target_dependencies(Unit *u) {
         };
 
         Unit *target;
-        Iterator i;
+        unsigned i;
         unsigned k;
         int r = 0;
 
         assert(u);
 
         for (k = 0; k < ELEMENTSOF(deps); k++)
-                SET_FOREACH(target, u->dependencies[deps[k]], i) {
+                UNIT_FOREACH_DEPENDENCY(target, u, deps[k], i) {
                         r = unit_add_default_target_dependency(u, target);
                         if (r < 0)
                                 return r;
@@ -1155,7 +1150,58 @@ static int unit_add_startup_units(Unit *u) {
         return r;
 }
 
+static int config_hash_file(ConfCache *cache, const char *path, bool contents, bool refresh, uint64_t *h) {
+        static const uint8_t key[16] = {};
+        ConfCacheEntry *e;
+        uint64_t v;
+        int r;
+
+        siphash24((uint8_t*) &v, path, strlen(path), key);
+        *h = (*h ^ v) * UINT64_C(0x100000001b3);
+
+        if (!contents)
+                return 0;
+
+        if (refresh) {
+                r = config_cache_file(cache, path, &e);
+                if (r < 0)
+                        return r;
+        } else
+                e = conf_cache_peek(cache, path);
+        if (!e)
+                return -ENOENT;
+
+        *h = (*h ^ conf_cache_entry_hash(e)) * UINT64_C(0x100000001b3);
+        return 0;
+}
+
+static uint64_t unit_config_hash(Unit *u, bool refresh) {
+        ConfCache *cache = u->manager->unit_file_cache;
+        uint64_t h = UINT64_C(0xcbf29ce484222325);
+        char **p;
+
+        /* Hashes the significant lines of the fragment and the
+         * drop-ins, in the order they are applied. If refresh is
+         * true the cache entries are brought up to date first,
+         * otherwise we rely on them having just been used for
+         * loading. Returns 0 if the contents are not known. */
+
+        if (!cache)
+                return 0;
+
+        if (u->fragment_path &&
+            config_hash_file(cache, u->fragment_path, u->load_state != UNIT_MASKED, refresh, &h) < 0)
+                return 0;
+
+        STRV_FOREACH(p, u->dropin_paths)
+                if (config_hash_file(cache, *p, true, refresh, &h) < 0)
+                        return 0;
+
+        return h ?: 1;
+}
+
 int unit_load(Unit *u) {
+        Unit *loading;
         int r;
 
         assert(u);
@@ -1171,6 +1217,12 @@ int unit_load(Unit *u) {
         if (u->load_state != UNIT_STUB)
                 return 0;
 
+        loading = u->manager->loading_unit;
+        u->manager->loading_unit = u;
+
+        u->load_timestamp = now(CLOCK_REALTIME);
+        u->dependency_hash = 0;
+
         if (UNIT_VTABLE(u)->load) {
                 r = UNIT_VTABLE(u)->load(u);
                 if (r < 0)
@@ -1182,9 +1234,15 @@ int unit_load(Unit *u) {
                 goto fail;
         }
 
+        u->config_hash = unit_config_hash(u, false);
+
         if (u->load_state == UNIT_LOADED) {
 
+                /* Which targets want us depends on the load
+                 * order, hence don't account for these */
+                u->manager->loading_unit = NULL;
                 r = unit_add_target_dependencies(u);
+                u->manager->loading_unit = u;
                 if (r < 0)
                         goto fail;
 
@@ -1200,7 +1258,7 @@ int unit_load(Unit *u) {
                 if (r < 0)
                         goto fail;
 
-                if (u->on_failure_job_mode == JOB_ISOLATE && set_size(u->dependencies[UNIT_ON_FAILURE]) > 1) {
+                if (u->on_failure_job_mode == JOB_ISOLATE && unit_dependency_count(u, UNIT_ON_FAILURE) > 1) {
                         log_error_unit(u->id, "More than one OnFailure= dependencies specified for %s but OnFailureJobMode=isolate set. Refusing.", u->id);
                         r = -EINVAL;
                         goto fail;
@@ -1211,12 +1269,16 @@ int unit_load(Unit *u) {
 
         assert((u->load_state != UNIT_MERGED) == !u->merged_into);
 
+        u->manager->loading_unit = loading;
+
         unit_add_to_dbus_queue(unit_follow_merge(u));
         unit_add_to_gc_queue(u);
 
         return 0;
 
 fail:
+        u->manager->loading_unit = loading;
+
         u->load_state = u->load_state == UNIT_STUB ? UNIT_NOT_FOUND : UNIT_ERROR;
         u->load_error = r;
         unit_add_to_dbus_queue(u);
@@ -1234,6 +1296,8 @@ static bool unit_condition_test(Unit *u) {
         dual_timestamp_get(&u->condition_timestamp);
         u->condition_result = condition_test_list(u->id, u->conditions);
 
+        unit_add_to_dbus_queue(u);
+
         return u->condition_result;
 }
 
@@ -1485,7 +1549,7 @@ bool unit_can_reload(Unit *u) {
 }
 
 static void unit_check_unneeded(Unit *u) {
-        Iterator i;
+        unsigned i;
         Unit *other;
 
         assert(u);
@@ -1499,19 +1563,19 @@ static void unit_check_unneeded(Unit *u) {
         if (!UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(u)))
                 return;
 
-        SET_FOREACH(other, u->dependencies[UNIT_REQUIRED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRED_BY, i)
                 if (unit_active_or_pending(other))
                         return;
 
-        SET_FOREACH(other, u->dependencies[UNIT_REQUIRED_BY_OVERRIDABLE], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRED_BY_OVERRIDABLE, i)
                 if (unit_active_or_pending(other))
                         return;
 
-        SET_FOREACH(other, u->dependencies[UNIT_WANTED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_WANTED_BY, i)
                 if (unit_active_or_pending(other))
                         return;
 
-        SET_FOREACH(other, u->dependencies[UNIT_BOUND_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BOUND_BY, i)
                 if (unit_active_or_pending(other))
                         return;
 
@@ -1524,7 +1588,7 @@ static void unit_check_unneeded(Unit *u) {
 static void unit_check_binds_to(Unit *u) {
         bool stop = false;
         Unit *other;
-        Iterator i;
+        unsigned i;
 
         assert(u);
 
@@ -1534,7 +1598,7 @@ static void unit_check_binds_to(Unit *u) {
         if (unit_active_state(u) != UNIT_ACTIVE)
                 return;
 
-        SET_FOREACH(other, u->dependencies[UNIT_BINDS_TO], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO, i) {
                 if (other->job)
                         continue;
 
@@ -1554,94 +1618,94 @@ static void unit_check_binds_to(Unit *u) {
 }
 
 static void retroactively_start_dependencies(Unit *u) {
-        Iterator i;
+        unsigned i;
         Unit *other;
 
         assert(u);
         assert(UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(u)));
 
-        SET_FOREACH(other, u->dependencies[UNIT_REQUIRES], i)
-                if (!set_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRES, i)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, true, NULL, NULL);
 
-        SET_FOREACH(other, u->dependencies[UNIT_BINDS_TO], i)
-                if (!set_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO, i)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, true, NULL, NULL);
 
-        SET_FOREACH(other, u->dependencies[UNIT_REQUIRES_OVERRIDABLE], i)
-                if (!set_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRES_OVERRIDABLE, i)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_FAIL, false, NULL, NULL);
 
-        SET_FOREACH(other, u->dependencies[UNIT_WANTS], i)
-                if (!set_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_WANTS, i)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_FAIL, false, NULL, NULL);
 
-        SET_FOREACH(other, u->dependencies[UNIT_CONFLICTS], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTS, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, true, NULL, NULL);
 
-        SET_FOREACH(other, u->dependencies[UNIT_CONFLICTED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTED_BY, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, true, NULL, NULL);
 }
 
 static void retroactively_stop_dependencies(Unit *u) {
-        Iterator i;
+        unsigned i;
         Unit *other;
 
         assert(u);
         assert(UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(u)));
 
         /* Pull down units which are bound to us recursively if enabled */
-        SET_FOREACH(other, u->dependencies[UNIT_BOUND_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BOUND_BY, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, true, NULL, NULL);
 }
 
 static void check_unneeded_dependencies(Unit *u) {
-        Iterator i;
+        unsigned i;
         Unit *other;
 
         assert(u);
         assert(UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(u)));
 
         /* Garbage collect services that might not be needed anymore, if enabled */
-        SET_FOREACH(other, u->dependencies[UNIT_REQUIRES], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRES, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         unit_check_unneeded(other);
-        SET_FOREACH(other, u->dependencies[UNIT_REQUIRES_OVERRIDABLE], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRES_OVERRIDABLE, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         unit_check_unneeded(other);
-        SET_FOREACH(other, u->dependencies[UNIT_WANTS], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_WANTS, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         unit_check_unneeded(other);
-        SET_FOREACH(other, u->dependencies[UNIT_REQUISITE], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUISITE, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         unit_check_unneeded(other);
-        SET_FOREACH(other, u->dependencies[UNIT_REQUISITE_OVERRIDABLE], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUISITE_OVERRIDABLE, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         unit_check_unneeded(other);
-        SET_FOREACH(other, u->dependencies[UNIT_BINDS_TO], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO, i)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         unit_check_unneeded(other);
 }
 
 void unit_start_on_failure(Unit *u) {
         Unit *other;
-        Iterator i;
+        unsigned i;
 
         assert(u);
 
-        if (set_size(u->dependencies[UNIT_ON_FAILURE]) <= 0)
+        if (unit_dependency_count(u, UNIT_ON_FAILURE) <= 0)
                 return;
 
         log_info_unit(u->id, "Triggering OnFailure= dependencies of %s.", u->id);
 
-        SET_FOREACH(other, u->dependencies[UNIT_ON_FAILURE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_ON_FAILURE, i) {
                 int r;
 
                 r = manager_add_job(u->manager, JOB_START, other, u->on_failure_job_mode, true, NULL, NULL);
@@ -1652,11 +1716,11 @@ void unit_start_on_failure(Unit *u) {
 
 void unit_trigger_notify(Unit *u) {
         Unit *other;
-        Iterator i;
+        unsigned i;
 
         assert(u);
 
-        SET_FOREACH(other, u->dependencies[UNIT_TRIGGERED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_TRIGGERED_BY, i)
                 if (UNIT_VTABLE(other)->trigger_notify)
                         UNIT_VTABLE(other)->trigger_notify(other, u);
 }
@@ -2088,6 +2152,57 @@ static int maybe_warn_about_dependency(const char *id, const char *other, UnitDe
         assert_not_reached("Invalid dependency type");
 }
 
+static uint64_t dependency_hash(unsigned bit, const char *id) {
+        uint8_t key[16] = { bit };
+        uint64_t h;
+
+        siphash24((uint8_t*) &h, id, strlen(id), key);
+        return h;
+}
+
+static bool dependency_backup_has(UnitDependencyBackup *b, Unit *other, unsigned bit) {
+        unsigned k;
+
+        k = PTR_TO_UINT(hashmap_get(b->others, other));
+        if (k == 0)
+                return false;
+
+        return b->items[k-1].mask & (UINT64_C(1) << bit);
+}
+
+static void unit_track_dependency(Unit *u, UnitDependency d, Unit *other, UnitDependency inverse) {
+        Unit *loading = u->manager->loading_unit;
+        UnitDependencyBackup *b;
+        unsigned bit;
+        uint64_t h;
+        Unit *x;
+
+        /* Accounts for the dependencies a unit adds while it is
+         * loaded, from its own point of view, so that we can tell
+         * later on whether they changed */
+
+        if (!loading)
+                return;
+
+        if (loading == u) {
+                bit = d;
+                x = other;
+        } else if (loading == other) {
+                bit = inverse != _UNIT_DEPENDENCY_INVALID ? inverse : 32 + d;
+                x = u;
+        } else
+                return;
+
+        h = dependency_hash(bit, x->id);
+        loading->dependency_hash += h;
+
+        /* When reloading in place, also sum up what we did not
+         * have before */
+        b = u->manager->reload_backup;
+        if (b && streq(b->id, loading->id) && !dependency_backup_has(b, x, bit))
+                b->added_hash += h;
+}
+
 int unit_add_dependency(Unit *u, UnitDependency d, Unit *other, bool add_reference) {
 
         static const UnitDependency inverse_table[_UNIT_DEPENDENCY_MAX] = {
@@ -2133,32 +2248,12 @@ int unit_add_dependency(Unit *u, UnitDependency d, Unit *other, bool add_referen
                 return 0;
         }
 
-        r = set_ensure_allocated(&u->dependencies[d], NULL);
-        if (r < 0)
-                return r;
-
-        if (inverse_table[d] != _UNIT_DEPENDENCY_INVALID) {
-                r = set_ensure_allocated(&other->dependencies[inverse_table[d]], NULL);
-                if (r < 0)
-                        return r;
-        }
-
-        if (add_reference) {
-                r = set_ensure_allocated(&u->dependencies[UNIT_REFERENCES], NULL);
-                if (r < 0)
-                        return r;
-
-                r = set_ensure_allocated(&other->dependencies[UNIT_REFERENCED_BY], NULL);
-                if (r < 0)
-                        return r;
-        }
-
-        q = set_put(u->dependencies[d], other);
+        q = unit_dependencies_add(&u->dependencies, other, d);
         if (q < 0)
                 return q;
 
         if (inverse_table[d] != _UNIT_DEPENDENCY_INVALID && inverse_table[d] != d) {
-                v = set_put(other->dependencies[inverse_table[d]], u);
+                v = unit_dependencies_add(&other->dependencies, u, inverse_table[d]);
                 if (v < 0) {
                         r = v;
                         goto fail;
@@ -2166,29 +2261,32 @@ int unit_add_dependency(Unit *u, UnitDependency d, Unit *other, bool add_referen
         }
 
         if (add_reference) {
-                w = set_put(u->dependencies[UNIT_REFERENCES], other);
+                w = unit_dependencies_add(&u->dependencies, other, UNIT_REFERENCES);
                 if (w < 0) {
                         r = w;
                         goto fail;
                 }
 
-                r = set_put(other->dependencies[UNIT_REFERENCED_BY], u);
+                r = unit_dependencies_add(&other->dependencies, u, UNIT_REFERENCED_BY);
                 if (r < 0)
                         goto fail;
         }
 
+        unit_track_dependency(u, d, other, inverse_table[d]);
+
         unit_add_to_dbus_queue(u);
+        unit_add_to_dbus_queue(other);
         return 0;
 
 fail:
         if (q > 0)
-                set_remove(u->dependencies[d], other);
+                unit_dependencies_remove(&u->dependencies, other, d);
 
         if (v > 0)
-                set_remove(other->dependencies[inverse_table[d]], u);
+                unit_dependencies_remove(&other->dependencies, u, inverse_table[d]);
 
         if (w > 0)
-                set_remove(u->dependencies[UNIT_REFERENCES], other);
+                unit_dependencies_remove(&u->dependencies, other, UNIT_REFERENCES);
 
         return r;
 }
@@ -2467,93 +2565,88 @@ bool unit_can_serialize(Unit *u) {
         return UNIT_VTABLE(u)->serialize && UNIT_VTABLE(u)->deserialize_item;
 }
 
-int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
+int unit_serialize(Unit *u, SerializeState *st, FDSet *fds, bool serialize_jobs) {
         int r;
 
         assert(u);
-        assert(f);
+        assert(st);
         assert(fds);
 
         if (unit_can_serialize(u)) {
                 ExecRuntime *rt;
 
-                r = UNIT_VTABLE(u)->serialize(u, f, fds);
+                r = UNIT_VTABLE(u)->serialize(u, st, fds);
                 if (r < 0)
                         return r;
 
                 rt = unit_get_exec_runtime(u);
                 if (rt) {
-                        r = exec_runtime_serialize(rt, u, f, fds);
+                        r = exec_runtime_serialize(rt, u, st, fds);
                         if (r < 0)
                                 return r;
                 }
         }
 
-        dual_timestamp_serialize(f, "inactive-exit-timestamp", &u->inactive_exit_timestamp);
-        dual_timestamp_serialize(f, "active-enter-timestamp", &u->active_enter_timestamp);
-        dual_timestamp_serialize(f, "active-exit-timestamp", &u->active_exit_timestamp);
-        dual_timestamp_serialize(f, "inactive-enter-timestamp", &u->inactive_enter_timestamp);
-        dual_timestamp_serialize(f, "condition-timestamp", &u->condition_timestamp);
+        dual_timestamp_serialize(st, "inactive-exit-timestamp", &u->inactive_exit_timestamp);
+        dual_timestamp_serialize(st, "active-enter-timestamp", &u->active_enter_timestamp);
+        dual_timestamp_serialize(st, "active-exit-timestamp", &u->active_exit_timestamp);
+        dual_timestamp_serialize(st, "inactive-enter-timestamp", &u->inactive_enter_timestamp);
+        dual_timestamp_serialize(st, "condition-timestamp", &u->condition_timestamp);
 
         if (dual_timestamp_is_set(&u->condition_timestamp))
-                unit_serialize_item(u, f, "condition-result", yes_no(u->condition_result));
+                unit_serialize_item(u, st, "condition-result", yes_no(u->condition_result));
 
-        unit_serialize_item(u, f, "transient", yes_no(u->transient));
+        unit_serialize_item(u, st, "transient", yes_no(u->transient));
 
         if (u->cgroup_path)
-                unit_serialize_item(u, f, "cgroup", u->cgroup_path);
+                unit_serialize_item(u, st, "cgroup", u->cgroup_path);
 
         if (serialize_jobs) {
                 if (u->job) {
-                        fprintf(f, "job\n");
-                        job_serialize(u->job, f, fds);
+                        serialize_marker(st, "job");
+                        job_serialize(u->job, st, fds);
                 }
 
                 if (u->nop_job) {
-                        fprintf(f, "job\n");
-                        job_serialize(u->nop_job, f, fds);
+                        serialize_marker(st, "job");
+                        job_serialize(u->nop_job, st, fds);
                 }
         }
 
         /* End marker */
-        fputc('\n', f);
+        serialize_section_end(st);
         return 0;
 }
 
-void unit_serialize_item_format(Unit *u, FILE *f, const char *key, const char *format, ...) {
+void unit_serialize_item_format(Unit *u, SerializeState *st, const char *key, const char *format, ...) {
         va_list ap;
 
         assert(u);
-        assert(f);
+        assert(st);
         assert(key);
         assert(format);
 
-        fputs(key, f);
-        fputc('=', f);
-
         va_start(ap, format);
-        vfprintf(f, format, ap);
+        serialize_item_formatv(st, key, format, ap);
         va_end(ap);
-
-        fputc('\n', f);
 }
 
-void unit_serialize_item(Unit *u, FILE *f, const char *key, const char *value) {
+void unit_serialize_item(Unit *u, SerializeState *st, const char *key, const char *value) {
         assert(u);
-        assert(f);
+        assert(st);
         assert(key);
         assert(value);
 
-        fprintf(f, "%s=%s\n", key, value);
+        serialize_item(st, key, value);
 }
 
-int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
+int unit_deserialize(Unit *u, SerializeState *st, FDSet *fds) {
         ExecRuntime **rt = NULL;
         size_t offset;
         int r;
 
         assert(u);
-        assert(f);
+        assert(st);
         assert(fds);
 
         offset = UNIT_VTABLE(u)->exec_runtime_offset;
@@ -2561,30 +2654,16 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                 rt = (ExecRuntime**) ((uint8_t*) u + offset);
 
         for (;;) {
-                char line[LINE_MAX], *l, *v;
-                size_t k;
+                char *l, *v;
 
-                if (!fgets(line, sizeof(line), f)) {
-                        if (feof(f))
-                                return 0;
-                        return -errno;
-                }
-
-                char_array_0(line);
-                l = strstrip(line);
+                r = deserialize_item(st, &l, &v);
+                if (r <= 0)
+                        return r;
 
                 /* End marker */
                 if (l[0] == 0)
                         return 0;
 
-                k = strcspn(l, "=");
-
-                if (l[k] == '=') {
-                        l[k] = 0;
-                        v = l+k+1;
-                } else
-                        v = l+k;
-
                 if (streq(l, "job")) {
                         if (v[0] == '\0') {
                                 /* new-style serialized job */
@@ -2592,7 +2671,7 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                                 if (!j)
                                         return -ENOMEM;
 
-                                r = job_deserialize(j, f, fds);
+                                r = job_deserialize(j, st, fds);
                                 if (r < 0) {
                                         job_free(j);
                                         return r;
@@ -2677,6 +2756,8 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                         u->cgroup_path = s;
                         assert(hashmap_put(u->manager->cgroup_unit, s, u) == 1);
 
+                        unit_watch_cgroup(u);
+
                         continue;
                 }
 
@@ -2819,6 +2900,236 @@ bool unit_need_daemon_reload(Unit *u) {
                 return true;
 }
 
+static int unit_find_fragment_name(Unit *u, const char *name, struct stat *st, char **ret) {
+        char **p;
+
+        STRV_FOREACH(p, u->manager->lookup_paths.unit_path) {
+                _cleanup_free_ char *path = NULL;
+
+                path = strjoin(*p, "/", name, NULL);
+                if (!path)
+                        return -ENOMEM;
+
+                if (u->manager->unit_path_cache &&
+                    !set_get(u->manager->unit_path_cache, path))
+                        continue;
+
+                /* Follows symlinks, like the loader does */
+                if (stat(path, st) >= 0) {
+                        if (ret) {
+                                *ret = path;
+                                path = NULL;
+                        }
+
+                        return 1;
+                }
+
+                if (errno != ENOENT)
+                        return -errno;
+        }
+
+        return 0;
+}
+
+static int unit_find_fragment(Unit *u, struct stat *st, char **ret) {
+        Iterator i;
+        char *t;
+        int r;
+
+        /* Looks for the fragment the same way
+         * unit_load_fragment() does, but only stat()s it */
+
+        r = unit_find_fragment_name(u, u->id, st, ret);
+        if (r != 0)
+                return r;
+
+        SET_FOREACH(t, u->names, i) {
+                if (t == u->id)
+                        continue;
+
+                r = unit_find_fragment_name(u, t, st, ret);
+                if (r != 0)
+                        return r;
+        }
+
+        if (u->instance) {
+                _cleanup_free_ char *k = NULL;
+
+                k = unit_name_template(u->id);
+                if (!k)
+                        return -ENOMEM;
+
+                return unit_find_fragment_name(u, k, st, ret);
+        }
+
+        return 0;
+}
+
+static bool config_file_racy(Unit *u, const char *path, const struct stat *st) {
+
+        /* A file modified in the same second it was loaded in might
+         * have been modified again without its mtime changing */
+
+        if (timespec_load(&st->st_mtim) + USEC_PER_SEC <= u->load_timestamp)
+                return false;
+
+        if (u->manager->unit_file_cache)
+                conf_cache_remove(u->manager->unit_file_cache, path);
+
+        return true;
+}
+
+int unit_config_changed(Unit *u) {
+        _cleanup_strv_free_ char **t = NULL;
+        bool stale = false;
+        struct stat st;
+        char **path;
+        uint64_t h;
+        int r;
+
+        assert(u);
+
+        /* Checks whether the unit would be loaded differently now
+         * than the last time. Returns > 0 if so, 0 if not, and
+         * -EOPNOTSUPP if this cannot be determined without running
+         * the generators again. Cheap checks on the file metadata
+         * come first, the contents are only compared if any of
+         * the files was touched. */
+
+        /* Fragments generated from some other file */
+        if (u->source_path && u->fragment_path) {
+                if (stat(u->source_path, &st) < 0 ||
+                    timespec_load(&st.st_mtim) != u->source_mtime)
+                        return -EOPNOTSUPP;
+        }
+
+        /* Always retry loading units that failed to load */
+        if (u->load_state == UNIT_ERROR)
+                return 1;
+
+        r = unit_find_fragment(u, &st, NULL);
+        if (r < 0)
+                return r;
+        if ((r > 0) != !!u->fragment_path)
+                return 1;
+
+        /* Nothing else is looked at if there is no fragment */
+        if (u->load_state == UNIT_NOT_FOUND)
+                return 0;
+
+        if (u->fragment_path) {
+                struct stat loaded;
+
+                if (stat(u->fragment_path, &loaded) < 0)
+                        return 1;
+
+                if (st.st_dev != loaded.st_dev || st.st_ino != loaded.st_ino)
+                        return 1;
+
+                if (timespec_load(&st.st_mtim) != u->fragment_mtime ||
+                    config_file_racy(u, u->fragment_path, &st))
+                        stale = true;
+        }
+
+        t = unit_find_dropin_paths(u);
+        if (!strv_equal(t, u->dropin_paths))
+                return 1;
+
+        STRV_FOREACH(path, u->dropin_paths) {
+                if (stat(*path, &st) < 0)
+                        return 1;
+
+                if (timespec_load(&st.st_mtim) > u->dropin_mtime ||
+                    config_file_racy(u, *path, &st))
+                        stale = true;
+        }
+
+        if (unit_dropin_dirs_hash(u) != u->dropin_dirs_hash)
+                return 1;
+
+        if (!stale)
+                return 0;
+
+        if (u->load_state == UNIT_MASKED)
+                return 1;
+
+        /* The files were touched, let's see if their significant
+         * contents actually changed */
+        h = unit_config_hash(u, true);
+        if (h == 0 || h != u->config_hash)
+                return 1;
+
+        if (u->fragment_path && stat(u->fragment_path, &st) >= 0)
+                u->fragment_mtime = timespec_load(&st.st_mtim);
+        u->dropin_mtime = now(CLOCK_REALTIME);
+
+        return 0;
+}
+
+int unit_config_aliased(Unit *u) {
+        _cleanup_free_ char *path = NULL;
+        const char *expected;
+        struct stat st;
+        unsigned c;
+        int r;
+
+        assert(u);
+
+        /* Checks whether loading the unit now would involve any
+         * other unit names, either because it has some already or
+         * because its fragment is reached through a symlink with a
+         * different name. Loading such a unit might merge other
+         * units into it, or it into another one. */
+
+        if (set_size(u->names) > 1)
+                return 1;
+
+        r = unit_find_fragment(u, &st, &path);
+        if (r <= 0)
+                return r;
+
+        /* This is the unit name, or the template name for instances */
+        expected = strdupa(basename(path));
+
+        /* Follow the symlinks manually, like the loader does */
+        for (c = 0; c < FOLLOW_MAX; c++) {
+                char *target, *name;
+
+                r = readlink_and_make_absolute(path, &target);
+                if (r == -EINVAL)
+                        return 0;
+                if (r < 0)
+                        return r;
+
+                free(path);
+                path = target;
+
+                name = basename(path);
+                if (unit_name_is_valid(name, TEMPLATE_VALID) && !streq(name, expected))
+                        return 1;
+        }
+
+        return -ELOOP;
+}
+
+bool unit_can_reload_in_place(Unit *u) {
+        assert(u);
+
+        /* Only unit types whose complete state survives
+         * serialization and which are not created from the outside
+         * may be replaced individually */
+
+        if (!IN_SET(u->type, UNIT_SERVICE, UNIT_SOCKET, UNIT_TARGET, UNIT_TIMER, UNIT_PATH, UNIT_SLICE))
+                return false;
+
+        if (u->transient)
+                return false;
+
+        /* Units that were not found may be merged into others while
+         * loading, so they can't be kept track of individually */
+        return IN_SET(u->load_state, UNIT_LOADED, UNIT_ERROR, UNIT_MASKED);
+}
+
 void unit_reset_failed(Unit *u) {
         assert(u);
 
@@ -3015,6 +3326,109 @@ void unit_ref_unset(UnitRef *ref) {
         ref->unit = NULL;
 }
 
+int unit_backup_dependencies(Unit *u, UnitDependencyBackup *b) {
+        UnitRef *ref;
+        uint32_t mask;
+        unsigned i;
+        Unit *other;
+        int r;
+
+        assert_cc(_UNIT_DEPENDENCY_MAX <= 32);
+
+        assert(u);
+        assert(b);
+
+        /* Saves the dependencies between the unit and all others,
+         * in both directions, as well as the references to it, so
+         * that they can be restored after the unit has been freed
+         * and loaded again. Since dependencies are bidirectional or
+         * come with a reference, all units pointing to us are found
+         * among our own dependencies. */
+
+        zero(*b);
+
+        b->id = strdup(u->id);
+        if (!b->id)
+                return -ENOMEM;
+
+        b->dependency_hash = u->dependency_hash;
+
+        b->others = hashmap_new(NULL);
+        if (!b->others)
+                return -ENOMEM;
+
+        if (u->dependencies.n_used > 0) {
+                b->items = new(typeof(*b->items), u->dependencies.n_used);
+                if (!b->items)
+                        return -ENOMEM;
+        }
+
+        UNIT_DEPENDENCIES_FOREACH_ANY(other, mask, &u->dependencies, i) {
+                r = hashmap_put(b->others, other, UINT_TO_PTR(b->n_items + 1));
+                if (r < 0)
+                        return r;
+
+                b->items[b->n_items].other = other;
+                b->items[b->n_items].mask =
+                        (uint64_t) mask |
+                        (uint64_t) unit_dependencies_get(&other->dependencies, u) << 32;
+                b->n_items++;
+        }
+
+        LIST_FOREACH(refs, ref, u->refs) {
+                if (!GREEDY_REALLOC(b->refs, b->n_refs_allocated, b->n_refs + 1))
+                        return -ENOMEM;
+
+                b->refs[b->n_refs++] = ref;
+        }
+
+        return 0;
+}
+
+void unit_restore_dependencies(Unit *u, UnitDependencyBackup *b) {
+        size_t k;
+
+        assert(u);
+        assert(b);
+
+        /* Puts back what unit_backup_dependencies() saved. Failing
+         * allocations are not fatal here, we'd just lose an edge. */
+
+        for (k = 0; k < b->n_items; k++) {
+                Unit *other = unit_follow_merge(b->items[k].other);
+                UnitDependency d;
+
+                if (other == u)
+                        continue;
+
+                for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
+                        if (b->items[k].mask & (UINT64_C(1) << d))
+                                unit_dependencies_add(&u->dependencies, other, d);
+
+                        if (b->items[k].mask & (UINT64_C(1) << (32 + d)))
+                                unit_dependencies_add(&other->dependencies, u, d);
+                }
+
+                unit_add_to_dbus_queue(other);
+        }
+
+        for (k = 0; k < b->n_refs; k++)
+                unit_ref_set(b->refs[k], u);
+
+        unit_add_to_dbus_queue(u);
+}
+
+void unit_dependency_backup_done(UnitDependencyBackup *b) {
+        assert(b);
+
+        free(b->id);
+        hashmap_free(b->others);
+        free(b->items);
+        free(b->refs);
+
+        zero(*b);
+}
+
 int unit_patch_contexts(Unit *u) {
         CGroupContext *cc;
         ExecContext *ec;
@@ -3470,7 +3884,7 @@ int unit_require_mounts_for(Unit *u, const char *path) {
 int unit_setup_exec_runtime(Unit *u) {
         ExecRuntime **rt;
         size_t offset;
-        Iterator i;
+        unsigned i;
         Unit *other;
 
         offset = UNIT_VTABLE(u)->exec_runtime_offset;
@@ -3482,7 +3896,7 @@ int unit_setup_exec_runtime(Unit *u) {
                 return 0;
 
         /* Try to get it from somebody else */
-        SET_FOREACH(other, u->dependencies[UNIT_JOINS_NAMESPACE_OF], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_JOINS_NAMESPACE_OF, i) {
 
                 *rt = unit_get_exec_runtime(other);
                 if (*rt) {
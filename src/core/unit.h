@@ -30,6 +30,7 @@ typedef struct UnitVTable UnitVTable;
 typedef enum UnitActiveState UnitActiveState;
 typedef struct UnitRef UnitRef;
 typedef struct UnitStatusMessageFormats UnitStatusMessageFormats;
+typedef struct UnitDependencyBackup UnitDependencyBackup;
 
 #include "sd-event.h"
 #include "set.h"
@@ -41,6 +42,8 @@ typedef struct UnitStatusMessageFormats UnitStatusMessageFormats;
 #include "condition.h"
 #include "install.h"
 #include "unit-name.h"
+#include "unit-dependency.h"
+#include "serialize.h"
 
 enum UnitActiveState {
         UNIT_ACTIVE,
@@ -81,6 +84,26 @@ struct UnitRef {
         LIST_FIELDS(UnitRef, refs);
 };
 
+/* The dependencies of and references to a unit, saved while it is
+ * reloaded in place */
+struct UnitDependencyBackup {
+        char *id;
+
+        uint64_t dependency_hash;
+        uint64_t added_hash;
+
+        /* Maps the other unit to an index into items, plus one */
+        Hashmap *others;
+        struct {
+                Unit *other;
+                uint64_t mask; /* bit d: we depend on other, bit 32+d: other depends on us */
+        } *items;
+        size_t n_items;
+
+        UnitRef **refs;
+        size_t n_refs, n_refs_allocated;
+};
+
 struct Unit {
         Manager *manager;
 
@@ -92,7 +115,7 @@ struct Unit {
         char *instance;
 
         Set *names;
-        Set *dependencies[_UNIT_DEPENDENCY_MAX];
+        UnitDependencies dependencies;
 
         char **requires_mounts_for;
 
@@ -106,6 +129,16 @@ struct Unit {
         usec_t source_mtime;
         usec_t dropin_mtime;
 
+        /* When the configuration was last loaded, and hashes of
+         * the fragment and drop-in contents, and of the .wants/ and
+         * .requires/ directories, to detect changes on reload */
+        usec_t load_timestamp;
+        uint64_t config_hash;
+        uint64_t dropin_dirs_hash;
+
+        /* Hash over the dependencies added while we were loaded */
+        uint64_t dependency_hash;
+
         /* If there is something to do with this unit, then this is the installed job for it */
         Job *job;
 
@@ -150,6 +183,9 @@ struct Unit {
         /* CGroup realize members queue */
         LIST_FIELDS(Unit, cgroup_queue);
 
+        /* CGroup empty queue */
+        LIST_FIELDS(Unit, cgroup_empty_queue);
+
         /* PIDs we keep an eye on. Note that a unit might have many
          * more, but these are the ones we care enough about to
          * process SIGCHLD for */
@@ -175,6 +211,13 @@ struct Unit {
         CGroupControllerMask cgroup_realized_mask;
         CGroupControllerMask cgroup_subtree_mask;
         CGroupControllerMask cgroup_members_mask;
+        int cgroup_inotify_wd;
+
+        /* The attribute values last written to the cgroup, and the
+         * cgroup directories in the controller hierarchies, open
+         * only while the attributes are applied */
+        Hashmap *cgroup_attributes;
+        int cgroup_fds[_CGROUP_CONTROLLER_MAX];
 
         /* How to start OnFailure units */
         JobMode on_failure_job_mode;
@@ -211,6 +254,7 @@ struct Unit {
         bool in_cleanup_queue:1;
         bool in_gc_queue:1;
         bool in_cgroup_queue:1;
+        bool in_cgroup_empty_queue:1;
 
         bool sent_dbus_new_signal:1;
 
@@ -308,7 +352,7 @@ struct UnitVTable {
 
         /* Write all data that cannot be restored from other sources
          * away using unit_serialize_item() */
-        int (*serialize)(Unit *u, FILE *f, FDSet *fds);
+        int (*serialize)(Unit *u, SerializeState *st, FDSet *fds);
 
         /* Restore one item from the serialization */
         int (*deserialize_item)(Unit *u, const char *key, const char *data, FDSet *fds);
@@ -420,7 +464,25 @@ extern const UnitVTable * const unit_vtable[_UNIT_TYPE_MAX];
 /* For casting the various unit types into a unit */
 #define UNIT(u) (&(u)->meta)
 
-#define UNIT_TRIGGER(u) ((Unit*) set_first((u)->dependencies[UNIT_TRIGGERS]))
+#define UNIT_FOREACH_DEPENDENCY(other, u, d, i)                         \
+        UNIT_DEPENDENCIES_FOREACH(other, &(u)->dependencies, d, i)
+
+static inline bool unit_has_dependency(Unit *u, UnitDependency d, Unit *other) {
+        return !!(unit_dependencies_get(&u->dependencies, other) & UNIT_DEPENDENCY_BIT(d));
+}
+
+static inline unsigned unit_dependency_count(Unit *u, UnitDependency d) {
+        return u->dependencies.count[d];
+}
+
+static inline Unit *unit_first_dependency(Unit *u, UnitDependency d) {
+        Unit *other;
+        unsigned i = 0;
+
+        return unit_dependencies_next(&u->dependencies, d, &i, &other) ? other : NULL;
+}
+
+#define UNIT_TRIGGER(u) unit_first_dependency((u), UNIT_TRIGGERS)
 
 DEFINE_CAST(SERVICE, Service);
 DEFINE_CAST(SOCKET, Socket);
@@ -515,10 +577,10 @@ char *unit_dbus_path(Unit *u);
 int unit_load_related_unit(Unit *u, const char *type, Unit **_found);
 
 bool unit_can_serialize(Unit *u) _pure_;
-int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs);
-void unit_serialize_item_format(Unit *u, FILE *f, const char *key, const char *value, ...) _printf_(4,5);
-void unit_serialize_item(Unit *u, FILE *f, const char *key, const char *value);
-int unit_deserialize(Unit *u, FILE *f, FDSet *fds);
+int unit_serialize(Unit *u, SerializeState *st, FDSet *fds, bool serialize_jobs);
+void unit_serialize_item_format(Unit *u, SerializeState *st, const char *key, const char *value, ...) _printf_(4,5);
+void unit_serialize_item(Unit *u, SerializeState *st, const char *key, const char *value);
+int unit_deserialize(Unit *u, SerializeState *st, FDSet *fds);
 
 int unit_add_node_link(Unit *u, const char *what, bool wants);
 
@@ -527,6 +589,13 @@ int unit_coldplug(Unit *u);
 void unit_status_printf(Unit *u, const char *status, const char *unit_status_msg_format) _printf_(3, 0);
 
 bool unit_need_daemon_reload(Unit *u);
+int unit_config_changed(Unit *u);
+int unit_config_aliased(Unit *u);
+bool unit_can_reload_in_place(Unit *u);
+
+int unit_backup_dependencies(Unit *u, UnitDependencyBackup *b);
+void unit_restore_dependencies(Unit *u, UnitDependencyBackup *b);
+void unit_dependency_backup_done(UnitDependencyBackup *b);
 
 void unit_reset_failed(Unit *u);
 
@@ -204,6 +204,7 @@ global:
         sd_bus_process_priority;
         sd_bus_wait;
         sd_bus_flush;
+        sd_bus_cork;
         sd_bus_get_current_message;
         sd_bus_get_current_slot;
         sd_bus_get_tid;
@@ -111,11 +111,27 @@ struct node_vtable {
         const sd_bus_vtable *vtable;
         sd_bus_object_find_t find;
 
+        char *introspection;
+
         unsigned last_iteration;
 
         LIST_FIELDS(struct node_vtable, vtables);
 };
 
+struct property_snapshot {
+        struct node_vtable *vtable;
+        void *userdata;
+        sd_bus_message *message;
+
+        LIST_FIELDS(struct property_snapshot, snapshots);
+};
+
+struct property_cache {
+        char *path;
+
+        LIST_HEAD(struct property_snapshot, snapshots);
+};
+
 struct vtable_member {
         const char *path;
         const char *interface;
@@ -208,11 +224,13 @@ struct sd_bus {
         bool manual_peer_interface:1;
         bool is_system:1;
         bool is_user:1;
+        bool corked:1;
 
         int use_memfd;
 
         void *rbuffer;
         size_t rbuffer_size;
+        size_t rbuffer_allocated;
 
         sd_bus_message **rqueue;
         unsigned rqueue_size;
@@ -236,6 +254,7 @@ struct sd_bus {
         Hashmap *nodes;
         Hashmap *vtable_methods;
         Hashmap *vtable_properties;
+        Hashmap *property_cache;
 
         union sockaddr_union sockaddr;
         socklen_t sockaddr_size;
@@ -171,6 +171,43 @@ int introspect_write_interface(struct introspect *i, const sd_bus_vtable *v) {
         return 0;
 }
 
+int introspect_format_interface(const sd_bus_vtable *v, bool trusted, char **ret) {
+        struct introspect i = {
+                .trusted = trusted,
+        };
+        int r;
+
+        assert(v);
+        assert(ret);
+
+        /* Formats the XML for a single vtable into a standalone
+         * string, so that it can be cached and reused verbatim */
+
+        i.f = open_memstream(&i.introspection, &i.size);
+        if (!i.f)
+                return -ENOMEM;
+
+        r = introspect_write_interface(&i, v);
+        if (r < 0)
+                goto fail;
+
+        fflush(i.f);
+        if (ferror(i.f)) {
+                r = -ENOMEM;
+                goto fail;
+        }
+
+        fclose(i.f);
+        i.f = NULL;
+
+        *ret = i.introspection;
+        return 0;
+
+fail:
+        introspect_free(&i);
+        return r;
+}
+
 int introspect_finish(struct introspect *i, sd_bus *bus, sd_bus_message *m, sd_bus_message **reply) {
         sd_bus_message *q;
         int r;
@@ -67,8 +67,7 @@ static inline bool BUS_MATCH_IS_COMPARE(enum bus_match_node_type t) {
 }
 
 static inline bool BUS_MATCH_CAN_HASH(enum bus_match_node_type t) {
-        return (t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_PATH) ||
-                (t >= BUS_MATCH_ARG && t <= BUS_MATCH_ARG_LAST);
+        return t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_ARG_NAMESPACE_LAST;
 }
 
 static void bus_match_node_free(struct bus_match_node *node) {
@@ -230,6 +229,142 @@ static bool value_node_same(
         }
 }
 
+static int bus_match_run_prefix(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *prefix,
+                sd_bus_message *m) {
+
+        struct bus_match_node *found;
+
+        found = hashmap_get(node->compare.children, prefix);
+        if (!found)
+                return 0;
+
+        return bus_match_run(bus, found, m);
+}
+
+static int bus_match_run_simple_prefixes(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                char separator,
+                const char *test_str,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *prefix = NULL;
+        size_t i;
+        int r;
+
+        /* A namespace match matches the string itself and
+         * everything below it. Hence, instead of testing every
+         * value node, look up the string and each of its prefixes
+         * ending right before a separator in the hash table. */
+
+        if (!test_str)
+                return 0;
+
+        prefix = strdup(test_str);
+        if (!prefix)
+                return -ENOMEM;
+
+        for (i = 0;; i++) {
+                if (test_str[i] != separator && test_str[i] != 0)
+                        continue;
+
+                prefix[i] = 0;
+
+                r = bus_match_run_prefix(bus, node, prefix, m);
+                if (r != 0)
+                        return r;
+
+                if (bus && bus->match_callbacks_modified)
+                        return 0;
+
+                if (test_str[i] == 0)
+                        return 0;
+
+                prefix[i] = separator;
+        }
+}
+
+static int bus_match_run_complex_prefixes(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                char separator,
+                const char *test_str,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *prefix = NULL;
+        size_t i, l;
+        int r;
+
+        /* An argNpath match matches if the string equals the
+         * match, if the match is a prefix of the string ending in
+         * a separator, or vice versa. If the string ends in a
+         * separator, any match below it applies, hence let's just
+         * test them all. Otherwise, look up the string itself,
+         * the string with a separator appended, and all of its
+         * prefixes ending in a separator. */
+
+        if (!test_str)
+                return 0;
+
+        l = strlen(test_str);
+        if (l > 0 && test_str[l-1] == separator) {
+                struct bus_match_node *c;
+                Iterator j;
+
+                HASHMAP_FOREACH(c, node->compare.children, j) {
+                        if (!value_node_test(c, node->type, 0, test_str, m))
+                                continue;
+
+                        r = bus_match_run(bus, c, m);
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+
+                return 0;
+        }
+
+        prefix = new(char, l + 2);
+        if (!prefix)
+                return -ENOMEM;
+
+        memcpy(prefix, test_str, l);
+        prefix[l] = separator;
+        prefix[l+1] = 0;
+
+        r = bus_match_run_prefix(bus, node, prefix, m);
+        if (r != 0)
+                return r;
+
+        for (i = 0; i < l; i++) {
+
+                if (bus && bus->match_callbacks_modified)
+                        return 0;
+
+                if (test_str[i] != separator)
+                        continue;
+
+                prefix[i+1] = 0;
+
+                r = bus_match_run_prefix(bus, node, prefix, m);
+                if (r != 0)
+                        return r;
+
+                prefix[i+1] = test_str[i+1];
+        }
+
+        if (bus && bus->match_callbacks_modified)
+                return 0;
+
+        prefix[l] = 0;
+        return bus_match_run_prefix(bus, node, prefix, m);
+}
+
 int bus_match_run(
                 sd_bus *bus,
                 struct bus_match_node *node,
@@ -358,7 +493,32 @@ int bus_match_run(
                 assert_not_reached("Unknown match type.");
         }
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (!BUS_MATCH_CAN_HASH(node->type)) {
+                struct bus_match_node *c;
+
+                /* No hash table, so let's iterate manually... */
+
+                for (c = node->child; c; c = c->next) {
+                        if (!value_node_test(c, node->type, test_u8, test_str, m))
+                                continue;
+
+                        r = bus_match_run(bus, c, m);
+                        if (r != 0)
+                                return r;
+                }
+        } else if (node->type == BUS_MATCH_PATH_NAMESPACE) {
+                r = bus_match_run_simple_prefixes(bus, node, '/', test_str, m);
+                if (r != 0)
+                        return r;
+        } else if (node->type >= BUS_MATCH_ARG_NAMESPACE && node->type <= BUS_MATCH_ARG_NAMESPACE_LAST) {
+                r = bus_match_run_simple_prefixes(bus, node, '.', test_str, m);
+                if (r != 0)
+                        return r;
+        } else if (node->type >= BUS_MATCH_ARG_PATH && node->type <= BUS_MATCH_ARG_PATH_LAST) {
+                r = bus_match_run_complex_prefixes(bus, node, '/', test_str, m);
+                if (r != 0)
+                        return r;
+        } else {
                 struct bus_match_node *found;
 
                 /* Lookup via hash table, nice! So let's jump directly. */
@@ -375,19 +535,6 @@ int bus_match_run(
                         if (r != 0)
                                 return r;
                 }
-        } else {
-                struct bus_match_node *c;
-
-                /* No hash table, so let's iterate manually... */
-
-                for (c = node->child; c; c = c->next) {
-                        if (!value_node_test(c, node->type, test_u8, test_str, m))
-                                continue;
-
-                        r = bus_match_run(bus, c, m);
-                        if (r != 0)
-                                return r;
-                }
         }
 
         if (bus && bus->match_callbacks_modified)
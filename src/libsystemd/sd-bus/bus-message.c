@@ -29,6 +29,7 @@
 #include "time-util.h"
 #include "cgroup-util.h"
 #include "memfd.h"
+#include "mempool.h"
 
 #include "sd-bus.h"
 #include "bus-message.h"
@@ -40,6 +41,57 @@
 
 static int message_append_basic(sd_bus_message *m, char type, const void *p, const void **stored);
 
+/* Messages created or received in the main thread are allocated from
+ * pools, together with their additional body parts and small header
+ * and body buffers, so that the common case of short messages needs
+ * no malloc() at all once the pools are warm. */
+
+#define MESSAGE_BUFFER_SIZE 512
+
+struct message_tile {
+        sd_bus_message message;
+        struct bus_header header;
+};
+
+struct message_buffer_tile {
+        uint8_t data[MESSAGE_BUFFER_SIZE];
+};
+
+static DEFINE_MEMPOOL(message_pool, struct message_tile, 16);
+static DEFINE_MEMPOOL(message_part_pool, struct bus_body_part, 16);
+static DEFINE_MEMPOOL(message_buffer_pool, struct message_buffer_tile, 16);
+
+#ifdef VALGRIND
+
+__attribute__((destructor)) static void cleanup_pools(void) {
+        /* Be nice to valgrind */
+
+        mempool_drop(&message_buffer_pool);
+        mempool_drop(&message_part_pool);
+        mempool_drop(&message_pool);
+}
+
+#endif
+
+static sd_bus_message *message_alloc(size_t size) {
+        struct message_tile *t;
+        sd_bus_message *m;
+
+        if (size > sizeof(struct message_tile) || !is_main_thread())
+                return malloc0(size);
+
+        t = mempool_alloc_tile(&message_pool);
+        if (!t)
+                return NULL;
+
+        memzero(t, sizeof(struct message_tile));
+
+        m = &t->message;
+        m->from_pool = true;
+
+        return m;
+}
+
 static void *adjust_pointer(const void *p, void *old_base, size_t sz, void *new_base) {
 
         if (p == NULL)
@@ -76,11 +128,17 @@ static void message_free_part(sd_bus_message *m, struct bus_body_part *part) {
 
         } else if (part->munmap_this)
                 munmap(part->data, part->mapped);
+        else if (part->pool_this)
+                mempool_free_tile(&message_buffer_pool, part->data);
         else if (part->free_this)
                 free(part->data);
 
-        if (part != &m->body)
-                free(part);
+        if (part != &m->body) {
+                if (m->from_pool)
+                        mempool_free_tile(&message_part_pool, part);
+                else
+                        free(part);
+        }
 }
 
 static void message_reset_parts(sd_bus_message *m) {
@@ -124,6 +182,8 @@ static void message_free(sd_bus_message *m) {
 
         if (m->free_header)
                 free(m->header);
+        else if (m->pool_header)
+                mempool_free_tile(&message_buffer_pool, m->header);
 
         message_reset_parts(m);
 
@@ -155,7 +215,11 @@ static void message_free(sd_bus_message *m) {
         free(m->root_container.peeked_signature);
 
         bus_creds_done(&m->creds);
-        free(m);
+
+        if (m->from_pool)
+                mempool_free_tile(&message_pool, container_of(m, struct message_tile, message));
+        else
+                free(m);
 }
 
 static void *message_extend_fields(sd_bus_message *m, size_t align, size_t sz, bool add_offset) {
@@ -181,12 +245,25 @@ static void *message_extend_fields(sd_bus_message *m, size_t align, size_t sz, b
                 np = realloc(m->header, ALIGN8(new_size));
                 if (!np)
                         goto poison;
+        } else if (m->pool_header && ALIGN8(new_size) <= MESSAGE_BUFFER_SIZE)
+                np = m->header;
+        else if (m->pool_header) {
+                /* Outgrew the pooled buffer, move to dynamic data */
+
+                np = malloc(ALIGN8(new_size));
+                if (!np)
+                        goto poison;
+
+                memcpy(np, m->header, old_size);
         } else {
                 /* Initially, the header is allocated as part of of
                  * the sd_bus_message itself, let's replace it by
-                 * dynamic data */
+                 * dynamic data, pooled if it is small enough */
 
-                np = malloc(ALIGN8(new_size));
+                if (m->from_pool && ALIGN8(new_size) <= MESSAGE_BUFFER_SIZE)
+                        np = mempool_alloc_tile(&message_buffer_pool);
+                else
+                        np = malloc(ALIGN8(new_size));
                 if (!np)
                         goto poison;
 
@@ -209,7 +286,13 @@ static void *message_extend_fields(sd_bus_message *m, size_t align, size_t sz, b
         m->sender = adjust_pointer(m->sender, op, old_size, m->header);
         m->error.name = adjust_pointer(m->error.name, op, old_size, m->header);
 
-        m->free_header = true;
+        if (np != op) {
+                if (m->pool_header)
+                        mempool_free_tile(&message_buffer_pool, op);
+
+                m->pool_header = m->from_pool && ALIGN8(new_size) <= MESSAGE_BUFFER_SIZE;
+                m->free_header = !m->pool_header;
+        }
 
         if (add_offset) {
                 if (m->n_header_offsets >= ELEMENTSOF(m->header_offsets))
@@ -404,7 +487,7 @@ int bus_message_from_header(
                 a += label_sz + 1;
         }
 
-        m = malloc0(a);
+        m = message_alloc(a);
         if (!m)
                 return -ENOMEM;
 
@@ -492,12 +575,16 @@ static sd_bus_message *message_new(sd_bus *bus, uint8_t type) {
 
         assert(bus);
 
-        m = malloc0(ALIGN(sizeof(sd_bus_message)) + sizeof(struct bus_header));
+        m = message_alloc(ALIGN(sizeof(sd_bus_message)) + sizeof(struct bus_header));
         if (!m)
                 return NULL;
 
         m->n_ref = 1;
-        m->header = (struct bus_header*) ((uint8_t*) m + ALIGN(sizeof(struct sd_bus_message)));
+
+        if (m->from_pool)
+                m->header = &container_of(m, struct message_tile, message)->header;
+        else
+                m->header = (struct bus_header*) ((uint8_t*) m + ALIGN(sizeof(struct sd_bus_message)));
         m->header->endian = BUS_NATIVE_ENDIAN;
         m->header->type = type;
         m->header->version = bus ? bus->message_version : 1;
@@ -1042,12 +1129,17 @@ struct bus_body_part *message_append_part(sd_bus_message *m) {
         } else {
                 assert(m->body_end);
 
-                part = new0(struct bus_body_part, 1);
+                if (m->from_pool)
+                        part = mempool_alloc_tile(&message_part_pool);
+                else
+                        part = malloc(sizeof(struct bus_body_part));
                 if (!part) {
                         m->poisoned = true;
                         return NULL;
                 }
 
+                zero(*part);
+
                 m->body_end->next = part;
         }
 
@@ -1130,15 +1222,42 @@ static int part_make_space(
                         size_t new_allocated;
 
                         new_allocated = sz > 0 ? 2 * sz : 64;
-                        n = realloc(part->data, new_allocated);
-                        if (!n) {
-                                m->poisoned = true;
-                                return -ENOMEM;
+
+                        if (!part->data && m->from_pool && new_allocated <= MESSAGE_BUFFER_SIZE) {
+                                n = mempool_alloc_tile(&message_buffer_pool);
+                                if (!n) {
+                                        m->poisoned = true;
+                                        return -ENOMEM;
+                                }
+
+                                new_allocated = MESSAGE_BUFFER_SIZE;
+                                part->pool_this = true;
+
+                        } else if (part->pool_this) {
+                                n = malloc(new_allocated);
+                                if (!n) {
+                                        m->poisoned = true;
+                                        return -ENOMEM;
+                                }
+
+                                memcpy(n, part->data, part->size);
+                                mempool_free_tile(&message_buffer_pool, part->data);
+
+                                part->pool_this = false;
+                                part->free_this = true;
+
+                        } else {
+                                n = realloc(part->data, new_allocated);
+                                if (!n) {
+                                        m->poisoned = true;
+                                        return -ENOMEM;
+                                }
+
+                                part->free_this = true;
                         }
 
                         part->data = n;
                         part->allocated = new_allocated;
-                        part->free_this = true;
                 }
         }
 
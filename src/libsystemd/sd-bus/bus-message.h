@@ -74,6 +74,7 @@ struct bus_body_part {
         size_t allocated;
         int memfd;
         bool free_this:1;
+        bool pool_this:1;
         bool munmap_this:1;
         bool sealed:1;
         bool is_zero:1;
@@ -109,6 +110,8 @@ struct sd_bus_message {
         bool free_fds:1;
         bool release_kdbus:1;
         bool poisoned:1;
+        bool from_pool:1;
+        bool pool_header:1;
 
         struct bus_header *header;
         struct bus_body_part body;
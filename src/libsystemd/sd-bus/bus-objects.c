@@ -640,6 +640,8 @@ static int property_get_set_callbacks_run(
                 if (r < 0)
                         return bus_maybe_reply_error(m, r, &error);
 
+                bus_property_cache_invalidate(bus, m->path, c->interface);
+
                 if (bus->nodes_modified)
                         return 0;
 
@@ -704,6 +706,228 @@ static int vtable_append_one_property(
         return 0;
 }
 
+static bool vtable_property_is_cacheable(const struct node_vtable *c, const sd_bus_vtable *v) {
+        assert(c);
+        assert(v);
+
+        /* Only properties whose value is either constant or
+         * announced on change may be served from a snapshot, and
+         * only if the vtable opted in. File descriptors are never
+         * cached. */
+
+        if (!(c->vtable[0].flags & SD_BUS_VTABLE_PROPERTY_CACHE))
+                return false;
+
+        if (!(v->flags & (SD_BUS_VTABLE_PROPERTY_CONST|SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE|SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION)))
+                return false;
+
+        return !strchr(v->x.property.signature, SD_BUS_TYPE_UNIX_FD);
+}
+
+static void property_cache_free(struct property_cache *pc) {
+        struct property_snapshot *s;
+
+        if (!pc)
+                return;
+
+        while ((s = pc->snapshots)) {
+                LIST_REMOVE(snapshots, pc->snapshots, s);
+                sd_bus_message_unref(s->message);
+                free(s);
+        }
+
+        free(pc->path);
+        free(pc);
+}
+
+static struct property_snapshot *property_cache_find(sd_bus *bus, const char *path, struct node_vtable *c, void *userdata) {
+        struct property_cache *pc;
+        struct property_snapshot *s;
+
+        assert(bus);
+        assert(path);
+        assert(c);
+
+        pc = hashmap_get(bus->property_cache, path);
+        if (!pc)
+                return NULL;
+
+        /* The object a path resolves to might depend on the caller,
+         * hence match on the userdata too */
+        LIST_FOREACH(snapshots, s, pc->snapshots)
+                if (s->vtable == c && s->userdata == userdata)
+                        return s;
+
+        return NULL;
+}
+
+static int property_cache_put(sd_bus *bus, const char *path, struct node_vtable *c, void *userdata, sd_bus_message *m) {
+        struct property_cache *pc;
+        struct property_snapshot *s;
+        int r;
+
+        assert(bus);
+        assert(path);
+        assert(c);
+        assert(m);
+
+        r = hashmap_ensure_allocated(&bus->property_cache, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        pc = hashmap_get(bus->property_cache, path);
+        if (!pc) {
+                pc = new0(struct property_cache, 1);
+                if (!pc)
+                        return -ENOMEM;
+
+                pc->path = strdup(path);
+                if (!pc->path) {
+                        free(pc);
+                        return -ENOMEM;
+                }
+
+                r = hashmap_put(bus->property_cache, pc->path, pc);
+                if (r < 0) {
+                        property_cache_free(pc);
+                        return r;
+                }
+        }
+
+        s = new0(struct property_snapshot, 1);
+        if (!s)
+                return -ENOMEM;
+
+        s->vtable = c;
+        s->userdata = userdata;
+        s->message = sd_bus_message_ref(m);
+        LIST_PREPEND(snapshots, pc->snapshots, s);
+
+        return 0;
+}
+
+void bus_property_cache_invalidate(sd_bus *bus, const char *path, const char *interface) {
+        struct property_snapshot *s, *n;
+        struct property_cache *pc;
+
+        assert(bus);
+
+        /* Drops the GetAll() snapshots of the specified interface
+         * on the specified path. If interface is NULL all snapshots
+         * of the path are dropped, if path is NULL the whole cache
+         * is flushed. */
+
+        if (!path) {
+                while ((pc = hashmap_steal_first(bus->property_cache)))
+                        property_cache_free(pc);
+
+                return;
+        }
+
+        pc = hashmap_get(bus->property_cache, path);
+        if (!pc)
+                return;
+
+        LIST_FOREACH_SAFE(snapshots, s, n, pc->snapshots) {
+                if (interface && !streq(s->vtable->interface, interface))
+                        continue;
+
+                LIST_REMOVE(snapshots, pc->snapshots, s);
+                sd_bus_message_unref(s->message);
+                free(s);
+        }
+
+        if (!pc->snapshots) {
+                hashmap_remove(bus->property_cache, pc->path);
+                property_cache_free(pc);
+        }
+}
+
+static int vtable_get_property_snapshot(
+                sd_bus *bus,
+                const char *path,
+                struct node_vtable *c,
+                void *userdata,
+                sd_bus_error *error,
+                sd_bus_message **ret) {
+
+        _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+        struct property_snapshot *snapshot;
+        const sd_bus_vtable *v;
+        int r;
+
+        assert(bus);
+        assert(path);
+        assert(c);
+        assert(ret);
+
+        /* Returns the snapshot of the cacheable properties, in
+         * vtable order, positioned at its first property */
+
+        snapshot = property_cache_find(bus, path, c, userdata);
+        if (snapshot)
+                m = sd_bus_message_ref(snapshot->message);
+        else {
+                /* Nothing cached yet, hence collect the cacheable
+                 * properties into a message of their own, which is
+                 * then sealed and kept around for later calls. */
+
+                r = sd_bus_message_new_signal(bus, &m, path, "org.freedesktop.DBus.Properties", "PropertiesChanged");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_open_container(m, 'a', "{sv}");
+                if (r < 0)
+                        return r;
+
+                for (v = c->vtable+1; v->type != _SD_BUS_VTABLE_END; v++) {
+                        if (v->type != _SD_BUS_VTABLE_PROPERTY && v->type != _SD_BUS_VTABLE_WRITABLE_PROPERTY)
+                                continue;
+
+                        if (v->flags & SD_BUS_VTABLE_HIDDEN)
+                                continue;
+
+                        if (!vtable_property_is_cacheable(c, v))
+                                continue;
+
+                        r = vtable_append_one_property(bus, m, path, c, v, userdata, error);
+                        if (r < 0)
+                                return r;
+                        if (bus->nodes_modified)
+                                return 0;
+                }
+
+                r = sd_bus_message_close_container(m);
+                if (r < 0)
+                        return r;
+
+                r = bus_message_seal(m, 0xFFFFFFFFULL, 0);
+                if (r < 0)
+                        return r;
+
+                /* The snapshot is owned by the bus, make sure it
+                 * doesn't keep the bus alive in turn */
+                m->bus = sd_bus_unref(m->bus);
+
+                r = property_cache_put(bus, path, c, userdata, m);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_rewind(m, true);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_enter_container(m, 'a', "{sv}");
+        if (r < 0)
+                return r;
+
+        *ret = m;
+        m = NULL;
+
+        return 0;
+}
+
 static int vtable_append_all_properties(
                 sd_bus *bus,
                 sd_bus_message *reply,
@@ -712,6 +936,7 @@ static int vtable_append_all_properties(
                 void *userdata,
                 sd_bus_error *error) {
 
+        _cleanup_bus_message_unref_ sd_bus_message *snapshot = NULL;
         const sd_bus_vtable *v;
         int r;
 
@@ -723,6 +948,14 @@ static int vtable_append_all_properties(
         if (c->vtable[0].flags & SD_BUS_VTABLE_HIDDEN)
                 return 1;
 
+        if (c->vtable[0].flags & SD_BUS_VTABLE_PROPERTY_CACHE) {
+                r = vtable_get_property_snapshot(bus, path, c, userdata, error, &snapshot);
+                if (r < 0)
+                        return r;
+                if (bus->nodes_modified)
+                        return 0;
+        }
+
         for (v = c->vtable+1; v->type != _SD_BUS_VTABLE_END; v++) {
                 if (v->type != _SD_BUS_VTABLE_PROPERTY && v->type != _SD_BUS_VTABLE_WRITABLE_PROPERTY)
                         continue;
@@ -730,6 +963,18 @@ static int vtable_append_all_properties(
                 if (v->flags & SD_BUS_VTABLE_HIDDEN)
                         continue;
 
+                if (snapshot && vtable_property_is_cacheable(c, v)) {
+                        /* The snapshot is in vtable order too,
+                         * hence its next entry is this property */
+                        r = sd_bus_message_copy(reply, snapshot, false);
+                        if (r < 0)
+                                return r;
+                        if (r == 0)
+                                return -EBADMSG;
+
+                        continue;
+                }
+
                 r = vtable_append_one_property(bus, reply, path, c, v, userdata, error);
                 if (r < 0)
                         return r;
@@ -929,9 +1174,17 @@ static int process_introspect(
                         fprintf(intro.f, " <interface name=\"%s\">\n", c->interface);
                 }
 
-                r = introspect_write_interface(&intro, c->vtable);
-                if (r < 0)
-                        goto finish;
+                /* The XML of a vtable only depends on the vtable
+                 * itself and the trust level of the bus, so format
+                 * it only once and reuse it for every path it is
+                 * served on. */
+                if (!c->introspection) {
+                        r = introspect_format_interface(c->vtable, bus->trusted, &c->introspection);
+                        if (r < 0)
+                                goto finish;
+                }
+
+                fputs(c->introspection, intro.f);
 
                 previous_interface = c->interface;
         }
@@ -2051,6 +2304,8 @@ _public_ int sd_bus_emit_properties_changed_strv(
         if (names && names[0] == NULL)
                 return 0;
 
+        bus_property_cache_invalidate(bus, path, interface);
+
         do {
                 bus->nodes_modified = false;
 
@@ -2215,6 +2470,8 @@ _public_ int sd_bus_emit_interfaces_added_strv(sd_bus *bus, const char *path, ch
         if (strv_isempty(interfaces))
                 return 0;
 
+        bus_property_cache_invalidate(bus, path, NULL);
+
         do {
                 bus->nodes_modified = false;
                 m = sd_bus_message_unref(m);
@@ -2291,6 +2548,8 @@ _public_ int sd_bus_emit_interfaces_removed_strv(sd_bus *bus, const char *path,
         if (strv_isempty(interfaces))
                 return 0;
 
+        bus_property_cache_invalidate(bus, path, NULL);
+
         r = sd_bus_message_new_signal(bus, &m, path, "org.freedesktop.DBus.ObjectManager", "InterfacesRemoved");
         if (r < 0)
                 return r;
@@ -25,3 +25,5 @@
 
 int bus_process_object(sd_bus *bus, sd_bus_message *m);
 void bus_node_gc(sd_bus *b, struct node *n);
+
+void bus_property_cache_invalidate(sd_bus *bus, const char *path, const char *interface);
@@ -171,6 +171,11 @@ void bus_slot_disconnect(sd_bus_slot *slot) {
                 }
 
                 free(slot->node_vtable.interface);
+                free(slot->node_vtable.introspection);
+
+                /* Snapshots refer to the vtable, hence drop them
+                 * all. Removing vtables is rare enough. */
+                bus_property_cache_invalidate(slot->bus, NULL, NULL);
 
                 if (slot->node_vtable.node) {
                         LIST_REMOVE(vtables, slot->node_vtable.node->vtables, &slot->node_vtable);
@@ -37,9 +37,19 @@
 #include "bus-socket.h"
 #include "bus-internal.h"
 #include "bus-message.h"
+#include "bus-type.h"
 
 #define SNDBUF_SIZE (8*1024*1024)
 
+/* Minimum size of the read buffer, so that we can pick up many
+ * small messages with a single read */
+#define RBUFFER_SIZE_MIN (64*1024)
+
+/* Limits for how much we try to write out of the write queue with a
+ * single syscall */
+#define WRITE_IOVEC_MAX 128
+#define WRITE_SIZE_MAX (128*1024)
+
 static void iovec_advance(struct iovec iov[], unsigned *idx, size_t size) {
 
         while (size > 0) {
@@ -529,6 +539,7 @@ static int bus_socket_read_auth(sd_bus *b) {
                 return -ENOMEM;
 
         b->rbuffer = p;
+        b->rbuffer_allocated = n;
 
         zero(iov);
         iov.iov_base = (uint8_t*) b->rbuffer + b->rbuffer_size;
@@ -783,76 +794,117 @@ int bus_socket_take_fd(sd_bus *b) {
         return bus_socket_start_auth(b);
 }
 
-int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+int bus_socket_write_messages(sd_bus *bus, sd_bus_message **m, unsigned n, size_t idx, size_t *written) {
         struct iovec *iov;
+        unsigned n_iov = 0, n_messages, i;
+        size_t sum = 0;
         ssize_t k;
-        size_t n;
-        unsigned j;
         int r;
 
         assert(bus);
         assert(m);
-        assert(idx);
+        assert(n > 0);
+        assert(written);
         assert(bus->state == BUS_RUNNING || bus->state == BUS_HELLO);
 
-        if (*idx >= BUS_MESSAGE_SIZE(m))
+        if (idx >= BUS_MESSAGE_SIZE(m[0]))
                 return 0;
 
-        r = bus_message_setup_iovec(m);
-        if (r < 0)
-                return r;
+        /* Gathers the iovecs of as many queued messages as
+         * possible into a single write. The kernel attaches fds
+         * to the beginning of a write, hence a message carrying
+         * fds always starts a new write. */
 
-        n = m->n_iovec * sizeof(struct iovec);
-        iov = alloca(n);
-        memcpy(iov, m->iovec, n);
+        for (n_messages = 0; n_messages < n; n_messages++) {
+                sd_bus_message *q = m[n_messages];
 
-        j = 0;
-        iovec_advance(iov, &j, *idx);
+                if (n_messages > 0 && (q->n_fds > 0 || sum >= WRITE_SIZE_MAX))
+                        break;
+
+                r = bus_message_setup_iovec(q);
+                if (r < 0)
+                        return r;
+
+                if (n_messages > 0 && n_iov + q->n_iovec > WRITE_IOVEC_MAX)
+                        break;
+
+                n_iov += q->n_iovec;
+                sum += BUS_MESSAGE_SIZE(q);
+        }
+
+        iov = alloca(sizeof(struct iovec) * n_iov);
+        for (i = 0, n_iov = 0; i < n_messages; i++) {
+                memcpy(iov + n_iov, m[i]->iovec, sizeof(struct iovec) * m[i]->n_iovec);
+                n_iov += m[i]->n_iovec;
+        }
+
+        i = 0;
+        iovec_advance(iov, &i, idx);
 
         if (bus->prefer_writev)
-                k = writev(bus->output_fd, iov, m->n_iovec);
+                k = writev(bus->output_fd, iov + i, n_iov - i);
         else {
                 struct msghdr mh;
                 zero(mh);
 
-                if (m->n_fds > 0) {
+                /* Only send the fds along with the first chunk of
+                 * the message they belong to */
+                if (m[0]->n_fds > 0 && idx == 0) {
                         struct cmsghdr *control;
-                        control = alloca(CMSG_SPACE(sizeof(int) * m->n_fds));
+                        control = alloca(CMSG_SPACE(sizeof(int) * m[0]->n_fds));
 
                         mh.msg_control = control;
                         control->cmsg_level = SOL_SOCKET;
                         control->cmsg_type = SCM_RIGHTS;
-                        mh.msg_controllen = control->cmsg_len = CMSG_LEN(sizeof(int) * m->n_fds);
-                        memcpy(CMSG_DATA(control), m->fds, sizeof(int) * m->n_fds);
+                        mh.msg_controllen = control->cmsg_len = CMSG_LEN(sizeof(int) * m[0]->n_fds);
+                        memcpy(CMSG_DATA(control), m[0]->fds, sizeof(int) * m[0]->n_fds);
                 }
 
-                mh.msg_iov = iov;
-                mh.msg_iovlen = m->n_iovec;
+                mh.msg_iov = iov + i;
+                mh.msg_iovlen = n_iov - i;
 
                 k = sendmsg(bus->output_fd, &mh, MSG_DONTWAIT|MSG_NOSIGNAL);
                 if (k < 0 && errno == ENOTSOCK) {
                         bus->prefer_writev = true;
-                        k = writev(bus->output_fd, iov, m->n_iovec);
+                        k = writev(bus->output_fd, iov + i, n_iov - i);
                 }
         }
 
         if (k < 0)
                 return errno == EAGAIN ? 0 : -errno;
 
-        *idx += (size_t) k;
+        *written = (size_t) k;
+        return 1;
+}
+
+int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
+        size_t k;
+        int r;
+
+        assert(bus);
+        assert(m);
+        assert(idx);
+
+        r = bus_socket_write_messages(bus, &m, 1, *idx, &k);
+        if (r <= 0)
+                return r;
+
+        *idx += k;
         return 1;
 }
 
-static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
+static int bus_socket_read_message_need(sd_bus *bus, size_t offset, size_t *need) {
+        const uint8_t *p;
         uint32_t a, b;
         uint8_t e;
         uint64_t sum;
 
         assert(bus);
         assert(need);
+        assert(offset <= bus->rbuffer_size);
         assert(bus->state == BUS_RUNNING || bus->state == BUS_HELLO);
 
-        if (bus->rbuffer_size < sizeof(struct bus_header)) {
+        if (bus->rbuffer_size - offset < sizeof(struct bus_header)) {
                 *need = sizeof(struct bus_header) + 8;
 
                 /* Minimum message size:
@@ -874,10 +926,13 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
                 return 0;
         }
 
-        a = ((const uint32_t*) bus->rbuffer)[1];
-        b = ((const uint32_t*) bus->rbuffer)[3];
+        /* Messages are packed back to back in the buffer, hence
+         * the header might not be aligned */
+        p = (const uint8_t*) bus->rbuffer + offset;
+        memcpy(&a, p + 4, sizeof(a));
+        memcpy(&b, p + 12, sizeof(b));
 
-        e = ((const uint8_t*) bus->rbuffer)[0];
+        e = p[0];
         if (e == BUS_LITTLE_ENDIAN) {
                 a = le32toh(a);
                 b = le32toh(b);
@@ -895,47 +950,237 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         return 0;
 }
 
-static int bus_socket_make_message(sd_bus *bus, size_t size) {
+static unsigned bus_socket_peek_unix_fds(sd_bus *bus, const void *buffer, size_t size) {
+        const struct bus_header *h = buffer;
+        const uint8_t *p = buffer;
+        uint32_t fields_size;
+        size_t ri, end;
+
+        assert(bus);
+        assert(buffer);
+        assert(size >= sizeof(struct bus_header));
+
+        /* Figures out how many of the pending fds belong to the
+         * message in the specified (aligned) buffer, by looking for
+         * the UNIX_FDS header field. Only dbus1 headers made of
+         * basic types are understood here, for anything else we
+         * fall back to handing all pending fds to the message, and
+         * let bus_message_parse_fields() refuse it if that doesn't
+         * match. */
+
+        if (bus->n_fds <= 0)
+                return 0;
+
+        if (h->version != 1)
+                return bus->n_fds;
+
+        fields_size = h->endian == BUS_NATIVE_ENDIAN ? h->fields_size : bswap_32(h->fields_size);
+
+        ri = sizeof(struct bus_header);
+        end = ri + fields_size;
+        if (end > size)
+                return bus->n_fds;
+
+        for (;;) {
+                uint8_t code;
+                uint32_t u;
+                char t;
+                int sz, al;
+
+                ri = ALIGN_TO(ri, 8);
+                if (ri >= end)
+                        return 0;
+
+                /* Field code, and a single-character signature */
+                if (ri + 4 > end || p[ri+1] != 1 || p[ri+3] != 0)
+                        return bus->n_fds;
+
+                code = p[ri];
+                t = (char) p[ri+2];
+                ri += 4;
+
+                switch (t) {
+
+                case SD_BUS_TYPE_STRING:
+                case SD_BUS_TYPE_OBJECT_PATH:
+                        ri = ALIGN_TO(ri, 4);
+                        if (ri + 4 > end)
+                                return bus->n_fds;
+
+                        memcpy(&u, p + ri, 4);
+                        if (h->endian != BUS_NATIVE_ENDIAN)
+                                u = bswap_32(u);
+
+                        ri += 4 + (size_t) u + 1;
+                        break;
+
+                case SD_BUS_TYPE_SIGNATURE:
+                        if (ri + 1 > end)
+                                return bus->n_fds;
+
+                        ri += 1 + (size_t) p[ri] + 1;
+                        break;
+
+                default:
+                        sz = bus_type_get_size(t);
+                        al = bus_type_get_alignment(t);
+                        if (sz <= 0 || al <= 0)
+                                return bus->n_fds;
+
+                        ri = ALIGN_TO(ri, al);
+                        if (ri + sz > end)
+                                return bus->n_fds;
+
+                        if (code == BUS_MESSAGE_HEADER_UNIX_FDS) {
+                                if (t != SD_BUS_TYPE_UINT32)
+                                        return bus->n_fds;
+
+                                memcpy(&u, p + ri, 4);
+                                if (h->endian != BUS_NATIVE_ENDIAN)
+                                        u = bswap_32(u);
+
+                                return MIN(u, bus->n_fds);
+                        }
+
+                        ri += sz;
+                }
+        }
+}
+
+static int bus_socket_make_message(sd_bus *bus, size_t *offset, size_t size) {
         sd_bus_message *t;
-        void *b;
+        unsigned n_fds;
+        int *fds;
+        void *b, *rest = NULL;
+        bool take;
         int r;
 
         assert(bus);
-        assert(bus->rbuffer_size >= size);
+        assert(offset);
+        assert(bus->rbuffer_size >= *offset + size);
         assert(bus->state == BUS_RUNNING || bus->state == BUS_HELLO);
 
         r = bus_rqueue_make_room(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size > size) {
-                b = memdup((const uint8_t*) bus->rbuffer + size,
-                           bus->rbuffer_size - size);
+        /* Large messages that start at the beginning of the buffer
+         * get the buffer handed over, everything else is copied
+         * out, so that the buffer can be reused for the next read
+         * and small messages don't pin a large allocation. */
+        take = *offset == 0 && size >= RBUFFER_SIZE_MIN;
+        if (take) {
+                if (bus->rbuffer_size > size) {
+                        rest = memdup((const uint8_t*) bus->rbuffer + size,
+                                      bus->rbuffer_size - size);
+                        if (!rest)
+                                return -ENOMEM;
+                }
+
+                b = bus->rbuffer;
+        } else {
+                b = memdup((const uint8_t*) bus->rbuffer + *offset, size);
                 if (!b)
                         return -ENOMEM;
-        } else
-                b = NULL;
+        }
+
+        /* The fds we got are queued up in the order they were
+         * received, hand the ones this message declares over to
+         * it, and keep the rest for the following messages */
+        n_fds = bus_socket_peek_unix_fds(bus, b, size);
+        if (n_fds <= 0)
+                fds = NULL;
+        else if (n_fds == bus->n_fds)
+                fds = bus->fds;
+        else {
+                fds = newdup(int, bus->fds, n_fds);
+                if (!fds) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+        }
 
         r = bus_message_from_malloc(bus,
-                                    bus->rbuffer, size,
-                                    bus->fds, bus->n_fds,
+                                    b, size,
+                                    fds, n_fds,
                                     !bus->bus_client && bus->ucred_valid ? &bus->ucred : NULL,
                                     !bus->bus_client && bus->label[0] ? bus->label : NULL,
                                     &t);
         if (r < 0) {
-                free(b);
-                return r;
+                if (fds != bus->fds)
+                        free(fds);
+                goto fail;
         }
 
-        bus->rbuffer = b;
-        bus->rbuffer_size -= size;
+        if (n_fds == bus->n_fds) {
+                bus->fds = NULL;
+                bus->n_fds = 0;
+        } else if (n_fds > 0) {
+                bus->n_fds -= n_fds;
+                memmove(bus->fds, bus->fds + n_fds, sizeof(int) * bus->n_fds);
+        }
 
-        bus->fds = NULL;
-        bus->n_fds = 0;
+        if (take) {
+                bus->rbuffer = rest;
+                bus->rbuffer_size -= size;
+                bus->rbuffer_allocated = bus->rbuffer_size;
+        } else
+                *offset += size;
 
         bus->rqueue[bus->rqueue_size++] = t;
 
         return 1;
+
+fail:
+        if (take)
+                free(rest);
+        else
+                free(b);
+
+        return r;
+}
+
+static int bus_socket_split_messages(sd_bus *bus) {
+        size_t offset = 0;
+        int r, ret = 0;
+
+        assert(bus);
+
+        /* Moves all complete messages from the read buffer into the
+         * read queue in one go, and keeps the trailing partial
+         * message in the buffer for the next read. */
+
+        for (;;) {
+                size_t need;
+
+                r = bus_socket_read_message_need(bus, offset, &need);
+                if (r < 0)
+                        break;
+
+                if (bus->rbuffer_size - offset < need) {
+                        r = 0;
+                        break;
+                }
+
+                r = bus_socket_make_message(bus, &offset, need);
+                if (r == -ENOBUFS && ret > 0) {
+                        /* The read queue is full, leave the rest
+                         * for later */
+                        r = 0;
+                        break;
+                }
+                if (r < 0)
+                        break;
+
+                ret = 1;
+        }
+
+        if (offset > 0) {
+                bus->rbuffer_size -= offset;
+                memmove(bus->rbuffer, (uint8_t*) bus->rbuffer + offset, bus->rbuffer_size);
+        }
+
+        return r < 0 ? r : ret;
 }
 
 int bus_socket_read_message(sd_bus *bus) {
@@ -944,7 +1189,6 @@ int bus_socket_read_message(sd_bus *bus) {
         ssize_t k;
         size_t need;
         int r;
-        void *b;
         union {
                 struct cmsghdr cmsghdr;
                 uint8_t buf[CMSG_SPACE(sizeof(int) * BUS_FDS_MAX) +
@@ -957,22 +1201,35 @@ int bus_socket_read_message(sd_bus *bus) {
         assert(bus);
         assert(bus->state == BUS_RUNNING || bus->state == BUS_HELLO);
 
-        r = bus_socket_read_message_need(bus, &need);
+        /* First, dispatch what we already have */
+        r = bus_socket_split_messages(bus);
+        if (r != 0)
+                return r;
+
+        r = bus_socket_read_message_need(bus, 0, &need);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
+        /* Read as much as we can, at least the rest of the current
+         * message, so that a burst of small messages is picked up
+         * with a single syscall */
+        if (bus->rbuffer_allocated < MAX(need, (size_t) RBUFFER_SIZE_MIN)) {
+                size_t n;
+                void *b;
 
-        b = realloc(bus->rbuffer, need);
-        if (!b)
-                return -ENOMEM;
+                n = MAX(need, (size_t) RBUFFER_SIZE_MIN);
+
+                b = realloc(bus->rbuffer, n);
+                if (!b)
+                        return -ENOMEM;
 
-        bus->rbuffer = b;
+                bus->rbuffer = b;
+                bus->rbuffer_allocated = n;
+        }
 
         zero(iov);
         iov.iov_base = (uint8_t*) bus->rbuffer + bus->rbuffer_size;
-        iov.iov_len = need - bus->rbuffer_size;
+        iov.iov_len = bus->rbuffer_allocated - bus->rbuffer_size;
 
         if (bus->prefer_readv)
                 k = readv(bus->input_fd, &iov, 1);
@@ -1014,7 +1271,7 @@ int bus_socket_read_message(sd_bus *bus) {
                                         return -EIO;
                                 }
 
-                                f = realloc(bus->fds, sizeof(int) + (bus->n_fds + n));
+                                f = realloc(bus->fds, sizeof(int) * (bus->n_fds + n));
                                 if (!f) {
                                         close_many((int*) CMSG_DATA(cmsg), n);
                                         return -ENOMEM;
@@ -1047,13 +1304,10 @@ int bus_socket_read_message(sd_bus *bus) {
                 }
         }
 
-        r = bus_socket_read_message_need(bus, &need);
+        r = bus_socket_split_messages(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
-
         return 1;
 }
 
@@ -31,6 +31,7 @@ int bus_socket_take_fd(sd_bus *b);
 int bus_socket_start_auth(sd_bus *b);
 
 int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx);
+int bus_socket_write_messages(sd_bus *bus, sd_bus_message **m, unsigned n, size_t idx, size_t *written);
 int bus_socket_read_message(sd_bus *bus);
 
 int bus_socket_process_opening(sd_bus *b);
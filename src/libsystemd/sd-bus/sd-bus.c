@@ -148,6 +148,9 @@ static void bus_free(sd_bus *b) {
         hashmap_free_free(b->vtable_methods);
         hashmap_free_free(b->vtable_properties);
 
+        bus_property_cache_invalidate(b, NULL, NULL);
+        hashmap_free(b->property_cache);
+
         assert(hashmap_isempty(b->nodes));
         hashmap_free(b->nodes);
 
@@ -1486,6 +1489,21 @@ int bus_seal_synthetic_message(sd_bus *b, sd_bus_message *m) {
         return bus_message_seal(m, 0xFFFFFFFFULL, 0);
 }
 
+static void log_sent_message(sd_bus_message *m) {
+        assert(m);
+
+        log_debug("Sent message type=%s sender=%s destination=%s object=%s interface=%s member=%s cookie=%" PRIu64 " reply_cookie=%" PRIu64 " error=%s",
+                  bus_message_type_to_string(m->header->type),
+                  strna(sd_bus_message_get_sender(m)),
+                  strna(sd_bus_message_get_destination(m)),
+                  strna(sd_bus_message_get_path(m)),
+                  strna(sd_bus_message_get_interface(m)),
+                  strna(sd_bus_message_get_member(m)),
+                  BUS_MESSAGE_COOKIE(m),
+                  m->reply_cookie,
+                  strna(m->error.message));
+}
+
 static int bus_write_message(sd_bus *bus, sd_bus_message *m, bool hint_sync_call, size_t *idx) {
         int r;
 
@@ -1501,26 +1519,62 @@ static int bus_write_message(sd_bus *bus, sd_bus_message *m, bool hint_sync_call
                 return r;
 
         if (bus->is_kernel || *idx >= BUS_MESSAGE_SIZE(m))
-                log_debug("Sent message type=%s sender=%s destination=%s object=%s interface=%s member=%s cookie=%" PRIu64 " reply_cookie=%" PRIu64 " error=%s",
-                          bus_message_type_to_string(m->header->type),
-                          strna(sd_bus_message_get_sender(m)),
-                          strna(sd_bus_message_get_destination(m)),
-                          strna(sd_bus_message_get_path(m)),
-                          strna(sd_bus_message_get_interface(m)),
-                          strna(sd_bus_message_get_member(m)),
-                          BUS_MESSAGE_COOKIE(m),
-                          m->reply_cookie,
-                          strna(m->error.message));
+                log_sent_message(m);
 
         return r;
 }
 
+static int dispatch_wqueue_socket(sd_bus *bus) {
+        int r, ret = 0;
+
+        assert(bus);
+        assert(!bus->is_kernel);
+
+        /* On socket transports we write out as many queued
+         * messages as we can with a single syscall */
+
+        while (bus->wqueue_size > 0) {
+                size_t written;
+                unsigned n = 0;
+
+                r = bus_socket_write_messages(bus, bus->wqueue, bus->wqueue_size, bus->windex, &written);
+                if (r <= 0)
+                        return r < 0 ? r : ret;
+
+                /* Drop all entries that have been fully written
+                 * now, and remember how much of the next one we
+                 * managed to write. */
+                written += bus->windex;
+                while (n < bus->wqueue_size && written >= BUS_MESSAGE_SIZE(bus->wqueue[n])) {
+                        written -= BUS_MESSAGE_SIZE(bus->wqueue[n]);
+
+                        log_sent_message(bus->wqueue[n]);
+                        sd_bus_message_unref(bus->wqueue[n]);
+                        n++;
+                }
+
+                bus->windex = written;
+
+                if (n > 0) {
+                        bus->wqueue_size -= n;
+                        memmove(bus->wqueue, bus->wqueue + n, sizeof(sd_bus_message*) * bus->wqueue_size);
+
+                        ret = 1;
+                }
+        }
+
+        return ret;
+}
+
 static int dispatch_wqueue(sd_bus *bus) {
         int r, ret = 0;
 
         assert(bus);
         assert(bus->state == BUS_RUNNING || bus->state == BUS_HELLO);
 
+        if (!bus->is_kernel)
+                return dispatch_wqueue_socket(bus);
+
         while (bus->wqueue_size > 0) {
 
                 r = bus_write_message(bus, bus->wqueue[0], false, &bus->windex);
@@ -1529,7 +1583,7 @@ static int dispatch_wqueue(sd_bus *bus) {
                 else if (r == 0)
                         /* Didn't do anything this time */
                         return ret;
-                else if (bus->is_kernel || bus->windex >= BUS_MESSAGE_SIZE(bus->wqueue[0])) {
+                else {
                         /* Fully written. Let's drop the entry from
                          * the queue.
                          *
@@ -1645,7 +1699,7 @@ static int bus_send_internal(sd_bus *bus, sd_bus_message *_m, uint64_t *cookie,
         if (m->dont_send && !cookie)
                 return 1;
 
-        if ((bus->state == BUS_RUNNING || bus->state == BUS_HELLO) && bus->wqueue_size <= 0) {
+        if ((bus->state == BUS_RUNNING || bus->state == BUS_HELLO) && bus->wqueue_size <= 0 && !bus->corked) {
                 size_t idx = 0;
 
                 r = bus_write_message(bus, m, hint_sync_call, &idx);
@@ -2782,6 +2836,39 @@ _public_ int sd_bus_flush(sd_bus *bus) {
         }
 }
 
+_public_ int sd_bus_cork(sd_bus *bus, int b) {
+        int r;
+
+        assert_return(bus, -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        /* While corked, outgoing messages are only queued, and
+         * written out together on the next iteration or once the
+         * bus is uncorked again */
+
+        if (bus->corked == !!b)
+                return 0;
+
+        bus->corked = !!b;
+        if (bus->corked)
+                return 0;
+
+        if (bus->state != BUS_RUNNING && bus->state != BUS_HELLO)
+                return 0;
+
+        r = dispatch_wqueue(bus);
+        if (r < 0) {
+                if (r == -ENOTCONN || r == -ECONNRESET || r == -EPIPE || r == -ESHUTDOWN) {
+                        bus_enter_closing(bus);
+                        return -ECONNRESET;
+                }
+
+                return r;
+        }
+
+        return 0;
+}
+
 _public_ int sd_bus_add_filter(
                 sd_bus *bus,
                 sd_bus_slot **slot,
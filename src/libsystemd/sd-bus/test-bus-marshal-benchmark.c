@@ -0,0 +1,150 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "log.h"
+#include "util.h"
+#include "time-util.h"
+
+#include "sd-bus.h"
+#include "bus-message.h"
+#include "bus-util.h"
+
+/* Builds, seals, serializes and parses a typical property Get() call,
+ * and reports the time per message. The number of messages may be
+ * given as argument.
+ *
+ * When built with -DCOUNT_ALLOCATIONS heap allocations are counted
+ * too, by interposing glibc's allocator. Such a build does not work
+ * under valgrind or the address sanitizer. */
+
+#define N_MESSAGES 100000U
+
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+static bool count_allocations = false;
+static unsigned long n_allocations = 0;
+
+void *malloc(size_t size) {
+        if (count_allocations)
+                n_allocations++;
+
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+        if (count_allocations)
+                n_allocations++;
+
+        return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *p, size_t size) {
+        if (count_allocations)
+                n_allocations++;
+
+        return __libc_realloc(p, size);
+}
+
+static void counting(bool b) {
+        if (b)
+                n_allocations = 0;
+
+        count_allocations = b;
+}
+
+static void log_result(unsigned n, usec_t t) {
+        log_info("Marshalled and demarshalled %u messages: %.2f allocations/message, %llu ns/message",
+                 n, (double) n_allocations / n, (unsigned long long) (t * NSEC_PER_USEC / n));
+}
+
+#else
+
+static void counting(bool b) {
+}
+
+static void log_result(unsigned n, usec_t t) {
+        log_info("Marshalled and demarshalled %u messages: %llu ns/message",
+                 n, (unsigned long long) (t * NSEC_PER_USEC / n));
+}
+
+#endif
+
+static void benchmark(sd_bus *bus, unsigned n) {
+        unsigned i;
+        usec_t t;
+
+        counting(true);
+        t = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < n; i++) {
+                _cleanup_bus_message_unref_ sd_bus_message *m = NULL, *reply = NULL;
+                const char *interface, *property;
+                void *buffer;
+                size_t sz;
+
+                assert_se(sd_bus_message_new_method_call(bus, &m, "org.freedesktop.systemd1", "/org/freedesktop/systemd1/unit/foobar_2eservice", "org.freedesktop.DBus.Properties", "Get") >= 0);
+                assert_se(sd_bus_message_append(m, "ss", "org.freedesktop.systemd1.Unit", "ActiveState") >= 0);
+                assert_se(bus_message_seal(m, i + 1, 0) >= 0);
+
+                assert_se(bus_message_get_blob(m, &buffer, &sz) >= 0);
+                assert_se(bus_message_from_malloc(bus, buffer, sz, NULL, 0, NULL, NULL, &reply) >= 0);
+
+                assert_se(sd_bus_message_read(reply, "ss", &interface, &property) > 0);
+                assert_se(streq(property, "ActiveState"));
+        }
+
+        t = now(CLOCK_MONOTONIC) - t;
+        counting(false);
+
+        log_result(n, t);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_bus_unref_ sd_bus *bus = NULL;
+        unsigned n = N_MESSAGES;
+        int pair[2];
+
+        log_set_max_level(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &n) >= 0 && n > 0);
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, pair) >= 0);
+
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, pair[0], pair[0]) >= 0);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        /* The first round warms up the allocator and the pools */
+        benchmark(bus, n);
+        benchmark(bus, n);
+
+        safe_close(pair[1]);
+
+        return 0;
+}
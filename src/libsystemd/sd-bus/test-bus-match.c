@@ -25,6 +25,7 @@
 #include "util.h"
 #include "macro.h"
 
+#include "bus-internal.h"
 #include "bus-match.h"
 #include "bus-message.h"
 #include "bus-util.h"
@@ -79,6 +80,200 @@ static int match_add(sd_bus_slot *slots, struct bus_match_node *root, const char
         return r;
 }
 
+static const char* const prefix_rules[] = {
+        /* argNpath, with and without trailing separator */
+        "arg0path='/'",
+        "arg0path='/aa/'",
+        "arg0path='/aa/bb'",
+        "arg0path='/aa/bb/'",
+        "arg0path='/aa/bbb/'",
+        "arg0path='/aa/bb/cc'",
+        "arg0path='/aa/b'",
+        /* path_namespace */
+        "path_namespace='/aa'",
+        "path_namespace='/aa/bb'",
+        "path_namespace='/aa/b'",
+        "path_namespace='/aa/bb/cc'",
+        /* argNnamespace */
+        "arg1namespace='org.aa'",
+        "arg1namespace='org.aa.bb'",
+        "arg1namespace='org.a'",
+};
+
+static bool prefix_rule_matches(const char *rule, const char *path, const char *arg0, const char *arg1) {
+        _cleanup_free_ char *value = NULL;
+        const char *e;
+
+        e = strchr(rule, '\'');
+        assert_se(e);
+        value = strndup(e + 1, strlen(e + 1) - 1);
+        assert_se(value);
+
+        if (startswith(rule, "arg0path="))
+                return path_complex_pattern(value, arg0);
+        if (startswith(rule, "path_namespace="))
+                return path_simple_pattern(value, path);
+
+        return namespace_simple_pattern(value, arg1);
+}
+
+static void run_prefixes(sd_bus *bus, struct bus_match_node *root, const char *path, const char *arg0, const char *arg1) {
+        _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+        unsigned i;
+
+        assert_se(sd_bus_message_new_signal(bus, &m, path, "bar.x", "waldo") >= 0);
+        assert_se(sd_bus_message_append(m, "ss", arg0, arg1) >= 0);
+        assert_se(bus_message_seal(m, 1, 0) >= 0);
+
+        zero(mask);
+        assert_se(bus_match_run(NULL, root, m) == 0);
+
+        /* The hash lookups must find exactly what testing every
+         * rule one by one would */
+        for (i = 0; i < ELEMENTSOF(prefix_rules); i++)
+                assert_se(mask[i] == prefix_rule_matches(prefix_rules[i], path, arg0, arg1));
+}
+
+static void test_prefixes(sd_bus *bus) {
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        sd_bus_slot slots[ELEMENTSOF(prefix_rules)];
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(prefix_rules); i++)
+                assert_se(match_add(slots, &root, prefix_rules[i], i) >= 0);
+
+        /* A trailing separator matches everything below */
+        run_prefixes(bus, &root, "/aa/bb/cc", "/aa/bb/", "org.aa.bb.cc");
+        assert_se(mask[1] && mask[3] && mask[5]);
+        assert_se(!mask[4]);
+        assert_se(mask[7] && mask[8] && mask[10]);
+        assert_se(mask[11] && mask[12]);
+
+        /* A child matches its parent only if either ends in a
+         * separator, and a parent namespace matches its children */
+        run_prefixes(bus, &root, "/aa/bb", "/aa/bb/cc", "org.aa.bb");
+        assert_se(mask[0] && mask[1] && mask[3] && mask[5]);
+        assert_se(!mask[2]);
+        assert_se(mask[7] && mask[8] && !mask[10]);
+
+        /* A sibling sharing a prefix but not a separator matches
+         * nothing */
+        run_prefixes(bus, &root, "/aa/bbb", "/aa/bbb", "org.aab");
+        assert_se(mask[0] && mask[1] && mask[4]);
+        assert_se(!mask[2] && !mask[3] && !mask[5] && !mask[6]);
+        assert_se(mask[7] && !mask[8] && !mask[9]);
+        assert_se(!mask[11] && !mask[12] && !mask[13]);
+
+        run_prefixes(bus, &root, "/", "/", "org");
+        run_prefixes(bus, &root, "/aa", "/aa", "org.aa");
+        run_prefixes(bus, &root, "/aa/b", "/aa/b/", "org.a");
+
+        bus_match_free(&root);
+}
+
+#define BENCHMARK_RULES 10000U
+#define BENCHMARK_MESSAGES 1000U
+#define BENCHMARK_ROUNDS 10U
+
+static unsigned n_hits = 0;
+
+static int count_filter(sd_bus *b, sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        n_hits++;
+        return 0;
+}
+
+static void benchmark(sd_bus *bus) {
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        _cleanup_free_ sd_bus_slot *slots = NULL;
+        sd_bus_message *messages[BENCHMARK_MESSAGES];
+        char ts[FORMAT_TIMESPAN_MAX];
+        unsigned i, j;
+        usec_t t;
+
+        /* Installs a large number of rules like those clients
+         * typically register, and measures how fast we can
+         * dispatch messages against them. Every message is built
+         * to match exactly one rule. */
+
+        slots = new0(sd_bus_slot, BENCHMARK_RULES);
+        assert_se(slots);
+
+        for (i = 0; i < BENCHMARK_RULES; i++) {
+                struct bus_match_component *components = NULL;
+                unsigned n_components = 0;
+                _cleanup_free_ char *match = NULL;
+
+                switch (i % 4) {
+
+                case 0:
+                        assert_se(asprintf(&match, "type='signal',interface='org.freedesktop.DBus.Properties',member='PropertiesChanged',path='/org/freedesktop/systemd1/unit/u%u'", i) >= 0);
+                        break;
+
+                case 1:
+                        assert_se(asprintf(&match, "type='signal',path_namespace='/org/freedesktop/systemd1/unit/u%u'", i) >= 0);
+                        break;
+
+                case 2:
+                        assert_se(asprintf(&match, "type='signal',interface='org.freedesktop.DBus',member='NameOwnerChanged',arg0='org.example.n%u'", i) >= 0);
+                        break;
+
+                case 3:
+                        assert_se(asprintf(&match, "type='signal',interface='org.freedesktop.DBus',member='NameOwnerChanged',arg0namespace='org.example.n%u'", i) >= 0);
+                        break;
+                }
+
+                assert_se(bus_match_parse(match, &components, &n_components) >= 0);
+
+                slots[i].match_callback.callback = count_filter;
+                assert_se(bus_match_add(&root, components, n_components, &slots[i].match_callback) >= 0);
+                bus_match_parse_free(components, n_components);
+        }
+
+        for (i = 0; i < BENCHMARK_MESSAGES; i++) {
+                unsigned k = i * (BENCHMARK_RULES / BENCHMARK_MESSAGES) + i % 4;
+                char buf[128];
+
+                if (k % 4 < 2) {
+                        snprintf(buf, sizeof(buf), "/org/freedesktop/systemd1/unit/u%u%s", k, k % 4 == 1 ? "/sub" : "");
+
+                        assert_se(sd_bus_message_new_signal(bus, &messages[i], buf, "org.freedesktop.DBus.Properties", "PropertiesChanged") >= 0);
+                        assert_se(sd_bus_message_append(messages[i], "sa{sv}as", "org.freedesktop.systemd1.Unit", 0, 0) >= 0);
+                } else {
+                        snprintf(buf, sizeof(buf), "org.example.n%u%s", k, k % 4 == 3 ? ".sub" : "");
+
+                        assert_se(sd_bus_message_new_signal(bus, &messages[i], "/org/freedesktop/DBus", "org.freedesktop.DBus", "NameOwnerChanged") >= 0);
+                        assert_se(sd_bus_message_append(messages[i], "sss", buf, "", ":1.1") >= 0);
+                }
+
+                assert_se(bus_message_seal(messages[i], i + 1, 0) >= 0);
+        }
+
+        n_hits = 0;
+        t = now(CLOCK_MONOTONIC);
+
+        for (j = 0; j < BENCHMARK_ROUNDS; j++)
+                for (i = 0; i < BENCHMARK_MESSAGES; i++)
+                        assert_se(bus_match_run(NULL, &root, messages[i]) == 0);
+
+        t = now(CLOCK_MONOTONIC) - t;
+
+        assert_se(n_hits == BENCHMARK_ROUNDS * BENCHMARK_MESSAGES);
+
+        log_info("Dispatched %u messages against %u rules in %s, %llu ns/message",
+                 BENCHMARK_ROUNDS * BENCHMARK_MESSAGES, BENCHMARK_RULES,
+                 format_timespan(ts, sizeof(ts), t, 1),
+                 (unsigned long long) (t * NSEC_PER_USEC / (BENCHMARK_ROUNDS * BENCHMARK_MESSAGES)));
+
+        for (i = 0; i < BENCHMARK_MESSAGES; i++)
+                sd_bus_message_unref(messages[i]);
+
+        bus_match_free(&root);
+}
+
 int main(int argc, char *argv[]) {
         struct bus_match_node root = {
                 .type = BUS_MATCH_ROOT,
@@ -140,5 +335,8 @@ int main(int argc, char *argv[]) {
 
         bus_match_free(&root);
 
+        test_prefixes(bus);
+        benchmark(bus);
+
         return 0;
 }
@@ -42,6 +42,7 @@ struct context {
         char *something;
         char *automatic_string_property;
         uint32_t automatic_integer_property;
+        unsigned n_cached_gets;
 };
 
 static int something_handler(sd_bus *bus, sd_bus_message *m, void *userdata, sd_bus_error *error) {
@@ -176,6 +177,29 @@ static int emit_interfaces_removed(sd_bus *bus, sd_bus_message *m, void *userdat
         return 1;
 }
 
+static int cached_value_handler(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+        int r;
+
+        c->n_cached_gets++;
+
+        r = sd_bus_message_append(reply, "s", property);
+        assert_se(r >= 0);
+
+        return 1;
+}
+
+static int notify_cached(sd_bus *bus, sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        int r;
+
+        assert_se(sd_bus_emit_properties_changed(bus, m->path, "org.freedesktop.systemd.CacheTest", "Changing", NULL) >= 0);
+
+        r = sd_bus_reply_method_return(m, NULL);
+        assert_se(r >= 0);
+
+        return 1;
+}
+
 static const sd_bus_vtable vtable[] = {
         SD_BUS_VTABLE_START(0),
         SD_BUS_METHOD("AlterSomething", "s", "s", something_handler, 0),
@@ -200,6 +224,15 @@ static const sd_bus_vtable vtable2[] = {
         SD_BUS_VTABLE_END
 };
 
+static const sd_bus_vtable vtable3[] = {
+        SD_BUS_VTABLE_START(SD_BUS_VTABLE_PROPERTY_CACHE),
+        SD_BUS_METHOD("NotifyCached", "", "", notify_cached, 0),
+        SD_BUS_PROPERTY("Const", "s", cached_value_handler, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Changing", "s", cached_value_handler, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Volatile", "s", cached_value_handler, 0, 0),
+        SD_BUS_VTABLE_END
+};
+
 static int enumerator_callback(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
 
         if (object_path_startswith("/value", path))
@@ -227,6 +260,7 @@ static void *server(void *p) {
         assert_se(sd_bus_add_fallback_vtable(bus, NULL, "/value", "org.freedesktop.systemd.ValueTest", vtable2, NULL, UINT_TO_PTR(20)) >= 0);
         assert_se(sd_bus_add_node_enumerator(bus, NULL, "/value", enumerator_callback, NULL) >= 0);
         assert_se(sd_bus_add_object_manager(bus, NULL, "/value") >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/cached", "org.freedesktop.systemd.CacheTest", vtable3, c) >= 0);
 
         assert_se(sd_bus_start(bus) >= 0);
 
@@ -268,6 +302,7 @@ static int client(struct context *c) {
         _cleanup_bus_unref_ sd_bus *bus = NULL;
         _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
         const char *s;
+        unsigned i, n;
         int r;
 
         assert_se(sd_bus_new(&bus) >= 0);
@@ -456,6 +491,50 @@ static int client(struct context *c) {
         sd_bus_message_unref(reply);
         reply = NULL;
 
+        /* The first GetAll() fills the cache, the second one only
+         * needs to call the getter of the uncacheable property */
+        for (i = 0; i < 2; i++) {
+                r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cached", "org.freedesktop.DBus.Properties", "GetAll", &error, &reply, "s", "org.freedesktop.systemd.CacheTest");
+                assert_se(r >= 0);
+
+                assert_se(sd_bus_message_enter_container(reply, 'a', "{sv}") >= 0);
+                n = 0;
+                while ((r = sd_bus_message_enter_container(reply, 'e', "sv")) > 0) {
+                        const char *name, *value;
+
+                        assert_se(sd_bus_message_read(reply, "s", &name) >= 0);
+                        assert_se(sd_bus_message_read(reply, "v", "s", &value) >= 0);
+                        assert_se(streq(name, value));
+                        assert_se(sd_bus_message_exit_container(reply) >= 0);
+                        n++;
+                }
+                assert_se(r >= 0);
+                assert_se(n == 3);
+
+                sd_bus_message_unref(reply);
+                reply = NULL;
+        }
+
+        assert_se(c->n_cached_gets == 4);
+
+        r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cached", "org.freedesktop.systemd.CacheTest", "NotifyCached", &error, NULL, "");
+        assert_se(r >= 0);
+
+        r = sd_bus_process(bus, &reply);
+        assert_se(r > 0);
+
+        assert_se(sd_bus_message_is_signal(reply, "org.freedesktop.DBus.Properties", "PropertiesChanged"));
+
+        sd_bus_message_unref(reply);
+        reply = NULL;
+
+        /* PropertiesChanged read the changed value once and
+         * invalidated the snapshot */
+        r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cached", "org.freedesktop.DBus.Properties", "GetAll", &error, NULL, "s", "org.freedesktop.systemd.CacheTest");
+        assert_se(r >= 0);
+
+        assert_se(c->n_cached_gets == 8);
+
         r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/foo", "org.freedesktop.systemd.test", "Exit", &error, NULL, "");
         assert_se(r >= 0);
 
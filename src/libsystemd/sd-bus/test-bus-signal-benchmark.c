@@ -0,0 +1,176 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "log.h"
+#include "util.h"
+#include "time-util.h"
+
+#include "sd-bus.h"
+#include "bus-util.h"
+
+/* Floods a direct connection with small signals, some of them
+ * carrying fds, once sent one by one and once in corked bursts, and
+ * reports how many are received per second. The number of signals
+ * may be given as argument. */
+
+#define N_SIGNALS 100000U
+#define BENCHMARK_FD_EVERY 97U
+#define BENCHMARK_BURST 64U
+
+struct benchmark_context {
+        int fds[2];
+        bool cork;
+        unsigned n_signals;
+};
+
+static void* benchmark_client(void *p) {
+        struct benchmark_context *c = p;
+        sd_bus *bus = NULL;
+        unsigned i;
+
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, c->fds[1], c->fds[1]) >= 0);
+        assert_se(sd_bus_negotiate_fds(bus, true) >= 0);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        for (i = 0; i < c->n_signals; i++) {
+                _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+
+                /* Optionally, send the signals in corked bursts */
+                if (c->cork && i % BENCHMARK_BURST == 0)
+                        assert_se(sd_bus_cork(bus, true) >= 0);
+
+                assert_se(sd_bus_message_new_signal(bus, &m, "/", "org.freedesktop.systemd.test", "Tick") >= 0);
+
+                if (i % BENCHMARK_FD_EVERY == 0) {
+                        _cleanup_close_pair_ int pipe_fds[2] = { -1, -1 };
+                        uint8_t x = (uint8_t) i;
+
+                        /* Pass along a pipe with the counter in
+                         * it, so that the receiver can verify
+                         * that fds end up on the right message */
+                        assert_se(pipe2(pipe_fds, O_CLOEXEC) >= 0);
+                        assert_se(write(pipe_fds[1], &x, 1) == 1);
+                        assert_se(sd_bus_message_append(m, "uh", i, pipe_fds[0]) >= 0);
+                } else
+                        assert_se(sd_bus_message_append(m, "u", i) >= 0);
+
+                assert_se(sd_bus_send(bus, m, NULL) >= 0);
+
+                if (c->cork && (i % BENCHMARK_BURST == BENCHMARK_BURST - 1 || i == c->n_signals - 1))
+                        assert_se(sd_bus_cork(bus, false) >= 0);
+        }
+
+        assert_se(sd_bus_flush(bus) >= 0);
+        sd_bus_unref(bus);
+
+        return NULL;
+}
+
+static void benchmark(unsigned n_signals, bool cork) {
+        _cleanup_bus_unref_ sd_bus *bus = NULL;
+        struct benchmark_context c = {
+                .cork = cork,
+                .n_signals = n_signals,
+        };
+        char ts[FORMAT_TIMESPAN_MAX];
+        pthread_t t_client;
+        sd_id128_t id;
+        unsigned n = 0;
+        usec_t t = 0;
+
+        /* Floods a direct connection with small signals, and
+         * measures how many we can receive per second */
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, c.fds) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, c.fds[0], c.fds[0]) >= 0);
+        assert_se(sd_bus_set_server(bus, 1, id) >= 0);
+        assert_se(sd_bus_set_anonymous(bus, true) >= 0);
+        assert_se(sd_bus_negotiate_fds(bus, true) >= 0);
+
+        assert_se(pthread_create(&t_client, NULL, benchmark_client, &c) == 0);
+
+        assert_se(sd_bus_start(bus) >= 0);
+
+        while (n < c.n_signals) {
+                _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+                uint32_t i;
+                int r;
+
+                r = sd_bus_process(bus, &m);
+                assert_se(r >= 0);
+
+                if (r == 0) {
+                        assert_se(sd_bus_wait(bus, (uint64_t) -1) >= 0);
+                        continue;
+                }
+
+                if (!m || !sd_bus_message_is_signal(m, "org.freedesktop.systemd.test", "Tick"))
+                        continue;
+
+                if (n == 0)
+                        t = now(CLOCK_MONOTONIC);
+
+                if (n % BENCHMARK_FD_EVERY == 0) {
+                        uint8_t x;
+                        int fd;
+
+                        assert_se(sd_bus_message_read(m, "uh", &i, &fd) > 0);
+                        assert_se(read(fd, &x, 1) == 1);
+                        assert_se(x == (uint8_t) i);
+                } else
+                        assert_se(sd_bus_message_read(m, "u", &i) > 0);
+
+                assert_se(i == n);
+                n++;
+        }
+
+        t = now(CLOCK_MONOTONIC) - t;
+        log_info("Received %u signals%s in %s, %llu signals/s",
+                 n, cork ? " (corked)" : "",
+                 format_timespan(ts, sizeof(ts), t, USEC_PER_MSEC),
+                 (unsigned long long) (t > 0 ? n * USEC_PER_SEC / t : 0));
+
+        assert_se(pthread_join(t_client, NULL) == 0);
+}
+
+int main(int argc, char *argv[]) {
+        unsigned n = N_SIGNALS;
+
+        log_set_max_level(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &n) >= 0 && n > 0);
+
+        benchmark(n, false);
+        benchmark(n, true);
+
+        return 0;
+}
@@ -20,6 +20,8 @@
 ***/
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
 #include <signal.h>
 #include <string.h>
@@ -148,32 +150,212 @@ int cg_rmdir(const char *controller, const char *path) {
         return 0;
 }
 
-int cg_kill(const char *controller, const char *path, int sig, bool sigcont, bool ignore_self, Set *s) {
-        _cleanup_set_free_ Set *allocated_set = NULL;
-        bool done = false;
-        int r, ret = 0;
-        pid_t my_pid;
+static int pid_compare(const void *a, const void *b) {
+        const pid_t *x = a, *y = b;
 
-        assert(sig >= 0);
+        return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
 
-        /* This goes through the tasks list and kills them all. This
-         * is repeated until no further processes are added to the
-         * tasks list, to properly handle forking processes */
+int cg_read_pids_at(int dfd, pid_t **pids, size_t *allocated, size_t *ret_n) {
+        _cleanup_close_ int fd = -1;
+        char buf[16384];
+        unsigned long ul = 0;
+        bool number = false;
+        size_t n = 0, i, j;
+
+        assert(pids);
+        assert(allocated);
+        assert(ret_n);
+
+        /* Reads all pids in the cgroup.procs file of the cgroup
+         * directory referred to by dfd, in large chunks rather than
+         * one by one. They are returned sorted and with duplicates
+         * removed, see cg_read_pid(). The array is reused across
+         * calls. */
+
+        fd = openat(dfd, "cgroup.procs", O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        for (;;) {
+                ssize_t k, l;
+
+                k = read(fd, buf, sizeof(buf));
+                if (k < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+                if (k == 0)
+                        break;
+
+                for (l = 0; l < k; l++) {
+                        if (buf[l] >= '0' && buf[l] <= '9') {
+                                ul = ul * 10 + (buf[l] - '0');
+                                if (ul > INT_MAX)
+                                        return -EIO;
 
-        if (!s) {
-                s = allocated_set = set_new(NULL);
-                if (!s)
+                                number = true;
+                                continue;
+                        }
+
+                        if (buf[l] != '\n')
+                                return -EIO;
+
+                        if (!number)
+                                continue;
+
+                        if (ul <= 0)
+                                return -EIO;
+
+                        if (!GREEDY_REALLOC(*pids, *allocated, n + 1))
+                                return -ENOMEM;
+
+                        (*pids)[n++] = (pid_t) ul;
+                        ul = 0;
+                        number = false;
+                }
+        }
+
+        if (number) {
+                if (ul <= 0)
+                        return -EIO;
+
+                if (!GREEDY_REALLOC(*pids, *allocated, n + 1))
                         return -ENOMEM;
+
+                (*pids)[n++] = (pid_t) ul;
+        }
+
+        qsort_safe(*pids, n, sizeof(pid_t), pid_compare);
+
+        for (i = 0, j = 0; i < n; i++)
+                if (j == 0 || (*pids)[j-1] != (*pids)[i])
+                        (*pids)[j++] = (*pids)[i];
+
+        *ret_n = j;
+        return 0;
+}
+
+/* State shared while killing or migrating the processes of a cgroup
+ * and its subgroups */
+typedef struct CGroupPidWalk {
+        pid_t my_pid;
+        bool ignore_self;
+
+        /* Pids not to touch, supplied by the caller */
+        Set *skip;
+
+        /* The pids handled already, sorted. This is kept as a plain
+         * array rather than a set, since we might see a lot of
+         * them. */
+        pid_t *done;
+        size_t n_done, n_done_allocated;
+
+        /* Buffer for reading cgroup.procs */
+        pid_t *pids;
+        size_t n_pids_allocated;
+
+        /* When migrating, the destination, and its cgroup.procs
+         * once we need it */
+        const char *cto, *pto;
+        int to;
+} CGroupPidWalk;
+
+static void cg_pid_walk_done(CGroupPidWalk *w) {
+        free(w->done);
+        free(w->pids);
+        safe_close(w->to);
+}
+
+/* Reads the pids of the cgroup and leaves those in w->pids that
+ * still need to be handled, in *n. */
+static int cg_pid_walk_read(CGroupPidWalk *w, int dfd, size_t *n) {
+        size_t i, j = 0, k = 0, m;
+        int r;
+
+        r = cg_read_pids_at(dfd, &w->pids, &w->n_pids_allocated, &m);
+        if (r < 0)
+                return r;
+
+        /* Both lists are sorted, so walk them side by side */
+        for (i = 0; i < m; i++) {
+                pid_t pid = w->pids[i];
+
+                while (j < w->n_done && w->done[j] < pid)
+                        j++;
+
+                if (j < w->n_done && w->done[j] == pid)
+                        continue;
+
+                if (w->ignore_self && pid == w->my_pid)
+                        continue;
+
+                if (set_get(w->skip, LONG_TO_PTR(pid)) == LONG_TO_PTR(pid))
+                        continue;
+
+                w->pids[k++] = pid;
         }
 
-        my_pid = getpid();
+        *n = k;
+        return 0;
+}
+
+/* Adds the first n pids in w->pids, which are sorted, to the ones
+ * handled. */
+static int cg_pid_walk_add(CGroupPidWalk *w, size_t n) {
+        size_t i, j, k;
+
+        if (n == 0)
+                return 0;
+
+        if (!GREEDY_REALLOC(w->done, w->n_done_allocated, w->n_done + n))
+                return -ENOMEM;
+
+        /* Merge from the back, so that this works in place */
+        i = w->n_done;
+        j = n;
+        k = w->n_done + n;
 
-        do {
-                _cleanup_fclose_ FILE *f = NULL;
-                pid_t pid = 0;
-                done = true;
+        while (j > 0) {
+                if (i > 0 && w->done[i-1] > w->pids[j-1])
+                        w->done[--k] = w->done[--i];
+                else
+                        w->done[--k] = w->pids[--j];
+        }
 
-                r = cg_enumerate_processes(controller, path, &f);
+        w->n_done += n;
+        return 0;
+}
+
+static int cg_open(const char *controller, const char *path, int *ret) {
+        _cleanup_free_ char *fs = NULL;
+        int fd, r;
+
+        r = cg_get_path(controller, path, NULL, &fs);
+        if (r < 0)
+                return r;
+
+        fd = open(fs, O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        *ret = fd;
+        return 0;
+}
+
+static int cg_kill_at(int dfd, int sig, bool sigcont, CGroupPidWalk *w) {
+        int r, ret = 0;
+
+        /* This goes through the tasks list and kills them all. This
+         * is repeated until no further processes are added to the
+         * tasks list, to properly handle forking processes */
+
+        for (;;) {
+                size_t n, i;
+
+                r = cg_pid_walk_read(w, dfd, &n);
                 if (r < 0) {
                         if (ret >= 0 && r != -ENOENT)
                                 return r;
@@ -181,94 +363,141 @@ int cg_kill(const char *controller, const char *path, int sig, bool sigcont, boo
                         return ret;
                 }
 
-                while ((r = cg_read_pid(f, &pid)) > 0) {
-
-                        if (ignore_self && pid == my_pid)
-                                continue;
-
-                        if (set_get(s, LONG_TO_PTR(pid)) == LONG_TO_PTR(pid))
-                                continue;
+                /* To avoid racing against processes which fork
+                 * quicker than we can kill them we repeat this until
+                 * no new pids need to be killed. */
+                if (n == 0)
+                        return ret;
 
+                for (i = 0; i < n; i++) {
                         /* If we haven't killed this process yet, kill
                          * it */
-                        if (kill(pid, sig) < 0) {
+                        if (kill(w->pids[i], sig) < 0) {
                                 if (ret >= 0 && errno != ESRCH)
                                         ret = -errno;
                         } else {
                                 if (sigcont)
-                                        kill(pid, SIGCONT);
+                                        kill(w->pids[i], SIGCONT);
 
                                 if (ret == 0)
                                         ret = 1;
                         }
-
-                        done = false;
-
-                        r = set_put(s, LONG_TO_PTR(pid));
-                        if (r < 0) {
-                                if (ret >= 0)
-                                        return r;
-
-                                return ret;
-                        }
                 }
 
+                r = cg_pid_walk_add(w, n);
                 if (r < 0) {
                         if (ret >= 0)
                                 return r;
 
                         return ret;
                 }
+        }
+}
 
-                /* To avoid racing against processes which fork
-                 * quicker than we can kill them we repeat this until
-                 * no new pids need to be killed. */
+int cg_kill(const char *controller, const char *path, int sig, bool sigcont, bool ignore_self, Set *s) {
+        _cleanup_close_ int dfd = -1;
+        CGroupPidWalk w = {
+                .my_pid = getpid(),
+                .ignore_self = ignore_self,
+                .skip = s,
+                .to = -1,
+        };
+        int r;
 
-        } while (!done);
+        assert(sig >= 0);
 
-        return ret;
+        r = cg_open(controller, path, &dfd);
+        if (r < 0)
+                return r == -ENOENT ? 0 : r;
+
+        r = cg_kill_at(dfd, sig, sigcont, &w);
+        cg_pid_walk_done(&w);
+
+        return r;
 }
 
-int cg_kill_recursive(const char *controller, const char *path, int sig, bool sigcont, bool ignore_self, bool rem, Set *s) {
-        _cleanup_set_free_ Set *allocated_set = NULL;
+static int cg_kill_recursive_at(int dfd, int sig, bool sigcont, bool rem, CGroupPidWalk *w) {
         _cleanup_closedir_ DIR *d = NULL;
-        int r, ret = 0;
-        char *fn;
+        struct dirent *de;
+        int fd, r, ret;
 
-        assert(path);
-        assert(sig >= 0);
+        ret = cg_kill_at(dfd, sig, sigcont, w);
 
-        if (!s) {
-                s = allocated_set = set_new(NULL);
-                if (!s)
-                        return -ENOMEM;
+        /* The subgroups are opened relative to their parent, instead
+         * of looking up the full path again for each */
+        fd = openat(dfd, ".", O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY);
+        if (fd < 0) {
+                if (ret >= 0 && errno != ENOENT)
+                        return -errno;
+
+                return ret;
         }
 
-        ret = cg_kill(controller, path, sig, sigcont, ignore_self, s);
+        d = fdopendir(fd);
+        if (!d) {
+                safe_close(fd);
 
-        r = cg_enumerate_subgroups(controller, path, &d);
-        if (r < 0) {
-                if (ret >= 0 && r != -ENOENT)
-                        return r;
+                if (ret >= 0)
+                        return -errno;
 
                 return ret;
         }
 
-        while ((r = cg_read_subgroup(d, &fn)) > 0) {
-                _cleanup_free_ char *p = NULL;
+        FOREACH_DIRENT(de, d, goto fail) {
+                _cleanup_close_ int cfd = -1;
 
-                p = strjoin(path, "/", fn, NULL);
-                free(fn);
-                if (!p)
-                        return -ENOMEM;
+                if (de->d_type != DT_DIR)
+                        continue;
 
-                r = cg_kill_recursive(controller, p, sig, sigcont, ignore_self, rem, s);
+                if (streq(de->d_name, ".") ||
+                    streq(de->d_name, ".."))
+                        continue;
+
+                cfd = openat(dirfd(d), de->d_name, O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY|O_NOFOLLOW);
+                if (cfd < 0) {
+                        if (ret >= 0 && errno != ENOENT)
+                                ret = -errno;
+
+                        continue;
+                }
+
+                r = cg_kill_recursive_at(cfd, sig, sigcont, rem, w);
                 if (ret >= 0 && r != 0)
                         ret = r;
+
+                if (rem)
+                        if (unlinkat(dirfd(d), de->d_name, AT_REMOVEDIR) < 0 && ret >= 0 && errno != ENOENT && errno != EBUSY)
+                                ret = -errno;
         }
 
-        if (ret >= 0 && r < 0)
-                ret = r;
+        return ret;
+
+fail:
+        if (ret >= 0)
+                return -errno;
+
+        return ret;
+}
+
+int cg_kill_recursive(const char *controller, const char *path, int sig, bool sigcont, bool ignore_self, bool rem, Set *s) {
+        _cleanup_close_ int dfd = -1;
+        CGroupPidWalk w = {
+                .my_pid = getpid(),
+                .ignore_self = ignore_self,
+                .skip = s,
+                .to = -1,
+        };
+        int r, ret;
+
+        assert(path);
+        assert(sig >= 0);
+
+        r = cg_open(controller, path, &dfd);
+        if (r < 0)
+                return r == -ENOENT ? 0 : r;
+
+        ret = cg_kill_recursive_at(dfd, sig, sigcont, rem, &w);
+        cg_pid_walk_done(&w);
 
         if (rem) {
                 r = cg_rmdir(controller, path);
@@ -279,29 +508,35 @@ int cg_kill_recursive(const char *controller, const char *path, int sig, bool si
         return ret;
 }
 
-int cg_migrate(const char *cfrom, const char *pfrom, const char *cto, const char *pto, bool ignore_self) {
-        bool done = false;
-        _cleanup_set_free_ Set *s = NULL;
-        int r, ret = 0;
-        pid_t my_pid;
+static int cg_open_procs(CGroupPidWalk *w) {
+        _cleanup_free_ char *fs = NULL;
+        int r;
 
-        assert(cfrom);
-        assert(pfrom);
-        assert(cto);
-        assert(pto);
+        /* The pids to migrate are all written to the same fd of the
+         * destination cgroup.procs, which is opened only once there
+         * is something to migrate */
 
-        s = set_new(NULL);
-        if (!s)
-                return -ENOMEM;
+        if (w->to >= 0)
+                return 0;
 
-        my_pid = getpid();
+        r = cg_get_path_and_check(w->cto, w->pto, "cgroup.procs", &fs);
+        if (r < 0)
+                return r;
 
-        do {
-                _cleanup_fclose_ FILE *f = NULL;
-                pid_t pid = 0;
-                done = true;
+        w->to = open(fs, O_WRONLY|O_CLOEXEC|O_NOCTTY);
+        if (w->to < 0)
+                return -errno;
 
-                r = cg_enumerate_processes(cfrom, pfrom, &f);
+        return 0;
+}
+
+static int cg_migrate_at(int dfd, CGroupPidWalk *w) {
+        int r, ret = 0;
+
+        for (;;) {
+                size_t n, i;
+
+                r = cg_pid_walk_read(w, dfd, &n);
                 if (r < 0) {
                         if (ret >= 0 && r != -ENOENT)
                                 return r;
@@ -309,92 +544,156 @@ int cg_migrate(const char *cfrom, const char *pfrom, const char *cto, const char
                         return ret;
                 }
 
-                while ((r = cg_read_pid(f, &pid)) > 0) {
-
-                        /* This might do weird stuff if we aren't a
-                         * single-threaded program. However, we
-                         * luckily know we are not */
-                        if (ignore_self && pid == my_pid)
-                                continue;
-
-                        if (set_get(s, LONG_TO_PTR(pid)) == LONG_TO_PTR(pid))
-                                continue;
-
-                        r = cg_attach(cto, pto, pid);
-                        if (r < 0) {
-                                if (ret >= 0 && r != -ESRCH)
-                                        ret = r;
-                        } else if (ret == 0)
-                                ret = 1;
-
-                        done = false;
-
-                        r = set_put(s, LONG_TO_PTR(pid));
-                        if (r < 0) {
-                                if (ret >= 0)
-                                        return r;
+                if (n == 0)
+                        return ret;
 
-                                return ret;
+                r = cg_open_procs(w);
+                if (r < 0) {
+                        if (ret >= 0)
+                                ret = r;
+                } else
+                        for (i = 0; i < n; i++) {
+                                char c[DECIMAL_STR_MAX(pid_t) + 2];
+
+                                /* This might do weird stuff if we
+                                 * aren't a single-threaded
+                                 * program. However, we luckily know
+                                 * we are not */
+                                snprintf(c, sizeof(c), PID_FMT "\n", w->pids[i]);
+
+                                if (write(w->to, c, strlen(c)) < 0) {
+                                        if (ret >= 0 && errno != ESRCH)
+                                                ret = -errno;
+                                } else if (ret == 0)
+                                        ret = 1;
                         }
-                }
 
+                r = cg_pid_walk_add(w, n);
                 if (r < 0) {
                         if (ret >= 0)
                                 return r;
 
                         return ret;
                 }
-        } while (!done);
-
-        return ret;
+        }
 }
 
-int cg_migrate_recursive(
-                const char *cfrom,
-                const char *pfrom,
-                const char *cto,
-                const char *pto,
-                bool ignore_self,
-                bool rem) {
-
-        _cleanup_closedir_ DIR *d = NULL;
-        int r, ret = 0;
-        char *fn;
+int cg_migrate(const char *cfrom, const char *pfrom, const char *cto, const char *pto, bool ignore_self) {
+        _cleanup_close_ int dfd = -1;
+        CGroupPidWalk w = {
+                .my_pid = getpid(),
+                .ignore_self = ignore_self,
+                .cto = cto,
+                .pto = pto,
+                .to = -1,
+        };
+        int r;
 
         assert(cfrom);
         assert(pfrom);
         assert(cto);
         assert(pto);
 
-        ret = cg_migrate(cfrom, pfrom, cto, pto, ignore_self);
+        r = cg_open(cfrom, pfrom, &dfd);
+        if (r < 0)
+                return r == -ENOENT ? 0 : r;
 
-        r = cg_enumerate_subgroups(cfrom, pfrom, &d);
-        if (r < 0) {
-                if (ret >= 0 && r != -ENOENT)
-                        return r;
+        r = cg_migrate_at(dfd, &w);
+        cg_pid_walk_done(&w);
+
+        return r;
+}
+
+static int cg_migrate_recursive_at(int dfd, bool rem, CGroupPidWalk *w) {
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        int fd, r, ret;
+
+        ret = cg_migrate_at(dfd, w);
+
+        fd = openat(dfd, ".", O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY);
+        if (fd < 0) {
+                if (ret >= 0 && errno != ENOENT)
+                        return -errno;
 
                 return ret;
         }
 
-        while ((r = cg_read_subgroup(d, &fn)) > 0) {
-                _cleanup_free_ char *p = NULL;
+        d = fdopendir(fd);
+        if (!d) {
+                safe_close(fd);
 
-                p = strjoin(pfrom, "/", fn, NULL);
-                free(fn);
-                if (!p) {
-                        if (ret >= 0)
-                                return -ENOMEM;
+                if (ret >= 0)
+                        return -errno;
 
-                        return ret;
+                return ret;
+        }
+
+        FOREACH_DIRENT(de, d, goto fail) {
+                _cleanup_close_ int cfd = -1;
+
+                if (de->d_type != DT_DIR)
+                        continue;
+
+                if (streq(de->d_name, ".") ||
+                    streq(de->d_name, ".."))
+                        continue;
+
+                cfd = openat(dirfd(d), de->d_name, O_RDONLY|O_CLOEXEC|O_DIRECTORY|O_NOCTTY|O_NOFOLLOW);
+                if (cfd < 0) {
+                        if (ret >= 0 && errno != ENOENT)
+                                ret = -errno;
+
+                        continue;
                 }
 
-                r = cg_migrate_recursive(cfrom, p, cto, pto, ignore_self, rem);
+                r = cg_migrate_recursive_at(cfd, rem, w);
                 if (r != 0 && ret >= 0)
                         ret = r;
+
+                if (rem)
+                        if (unlinkat(dirfd(d), de->d_name, AT_REMOVEDIR) < 0 && ret >= 0 && errno != ENOENT && errno != EBUSY)
+                                ret = -errno;
         }
 
-        if (r < 0 && ret >= 0)
-                ret = r;
+        return ret;
+
+fail:
+        if (ret >= 0)
+                return -errno;
+
+        return ret;
+}
+
+int cg_migrate_recursive(
+                const char *cfrom,
+                const char *pfrom,
+                const char *cto,
+                const char *pto,
+                bool ignore_self,
+                bool rem) {
+
+        _cleanup_close_ int dfd = -1;
+        CGroupPidWalk w = {
+                .my_pid = getpid(),
+                .ignore_self = ignore_self,
+                .cto = cto,
+                .pto = pto,
+                .to = -1,
+        };
+        int r, ret;
+
+        assert(cfrom);
+        assert(pfrom);
+        assert(cto);
+        assert(pto);
+
+        r = cg_open(cfrom, pfrom, &dfd);
+        if (r < 0)
+                return r == -ENOENT ? 0 : r;
+
+        ret = cg_migrate_recursive_at(dfd, rem, &w);
+        cg_pid_walk_done(&w);
 
         if (rem) {
                 r = cg_rmdir(cfrom, pfrom);
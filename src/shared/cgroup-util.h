@@ -37,6 +37,9 @@ typedef enum CGroupControllerMask {
         CGROUP_DEVICE = 16
 } CGroupControllerMask;
 
+/* The number of controllers in the mask above */
+#define _CGROUP_CONTROLLER_MAX 5
+
 /*
  * General rules:
  *
@@ -54,6 +57,7 @@ typedef enum CGroupControllerMask {
 
 int cg_enumerate_processes(const char *controller, const char *path, FILE **_f);
 int cg_read_pid(FILE *f, pid_t *_pid);
+int cg_read_pids_at(int dfd, pid_t **pids, size_t *allocated, size_t *n);
 
 int cg_enumerate_subgroups(const char *controller, const char *path, DIR **_d);
 int cg_read_subgroup(DIR *d, char **fn);
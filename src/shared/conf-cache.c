@@ -0,0 +1,409 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "util.h"
+#include "siphash24.h"
+#include "conf-cache.h"
+
+/* On-disk format, in native endianess, since the cache never leaves
+ * the machine it was written on:
+ *
+ *   struct ConfCacheHeader
+ *   n_entries * (struct ConfCacheEntryHeader, path, data)
+ *
+ * with the path and the data each padded to 8 bytes. */
+
+#define CONF_CACHE_SIGNATURE { 'S', 'D', 'C', 'F', 'C', 'C', 'H', '1' }
+
+struct ConfCacheHeader {
+        uint8_t signature[8];
+        uint64_t n_entries;
+};
+
+struct ConfCacheEntryHeader {
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t size;
+        uint64_t mtime;
+        uint32_t path_size;
+        uint32_t data_size;
+};
+
+static void conf_cache_entry_free(ConfCacheEntry *e) {
+        if (!e)
+                return;
+
+        if (!e->mapped) {
+                free(e->path);
+                free(e->data);
+        }
+
+        free(e);
+}
+
+ConfCache *conf_cache_new(void) {
+        ConfCache *c;
+
+        c = new0(ConfCache, 1);
+        if (!c)
+                return NULL;
+
+        c->entries = hashmap_new(&string_hash_ops);
+        if (!c->entries) {
+                free(c);
+                return NULL;
+        }
+
+        return c;
+}
+
+ConfCache *conf_cache_free(ConfCache *c) {
+        ConfCacheEntry *e;
+
+        if (!c)
+                return NULL;
+
+        while ((e = hashmap_steal_first(c->entries)))
+                conf_cache_entry_free(e);
+
+        hashmap_free(c->entries);
+
+        if (c->map)
+                munmap(c->map, c->map_size);
+
+        free(c);
+        return NULL;
+}
+
+ConfCacheEntry *conf_cache_get(ConfCache *c, const char *path, const struct stat *st) {
+        ConfCacheEntry *e;
+
+        assert(c);
+        assert(path);
+        assert(st);
+
+        e = hashmap_get(c->entries, path);
+        if (!e ||
+            e->dev != st->st_dev ||
+            e->ino != st->st_ino ||
+            e->size != (uint64_t) st->st_size ||
+            e->mtime != timespec_load(&st->st_mtim))
+                return NULL;
+
+        e->used = true;
+
+        return e;
+}
+
+ConfCacheEntry *conf_cache_peek(ConfCache *c, const char *path) {
+        assert(c);
+        assert(path);
+
+        /* Returns the entry for the path without validating it
+         * against the file, i.e. possibly for an older version */
+
+        return hashmap_get(c->entries, path);
+}
+
+void conf_cache_remove(ConfCache *c, const char *path) {
+        assert(c);
+        assert(path);
+
+        conf_cache_entry_free(hashmap_remove(c->entries, path));
+}
+
+uint64_t conf_cache_entry_hash(ConfCacheEntry *e) {
+        static const uint8_t key[16] = {};
+
+        assert(e);
+
+        /* Hashes the text of the significant lines only, hence
+         * changes to comments or whitespace do not alter the hash,
+         * even though they shift the line numbers */
+
+        if (!e->hashed) {
+                const ConfCacheLine *l;
+                uint64_t h = 0;
+
+                CONF_CACHE_LINE_FOREACH(l, e->data, e->data_size) {
+                        uint64_t v;
+
+                        /* Includes the terminating NUL, to separate lines */
+                        siphash24((uint8_t*) &v, l->text, l->length + 1, key);
+                        h = (h ^ v) * UINT64_C(0x100000001b3);
+                }
+
+                e->hash = h;
+                e->hashed = true;
+        }
+
+        return e->hash;
+}
+
+int conf_cache_put(ConfCache *c, const char *path, const struct stat *st, void *data, size_t data_size, ConfCacheEntry **ret) {
+        ConfCacheEntry *e, *old;
+        int r;
+
+        assert(c);
+        assert(path);
+        assert(st);
+        assert(data || data_size == 0);
+
+        /* Takes possession of data, on success only */
+
+        e = new0(ConfCacheEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->path = strdup(path);
+        if (!e->path) {
+                free(e);
+                return -ENOMEM;
+        }
+
+        e->dev = st->st_dev;
+        e->ino = st->st_ino;
+        e->size = st->st_size;
+        e->mtime = timespec_load(&st->st_mtim);
+        e->data = data;
+        e->data_size = data_size;
+        e->used = true;
+
+        old = hashmap_remove(c->entries, path);
+        conf_cache_entry_free(old);
+
+        r = hashmap_put(c->entries, e->path, e);
+        if (r < 0) {
+                e->data = NULL;
+                conf_cache_entry_free(e);
+                return r;
+        }
+
+        if (ret)
+                *ret = e;
+
+        return 0;
+}
+
+void conf_cache_gc(ConfCache *c) {
+        ConfCacheEntry *e;
+        Iterator i;
+
+        assert(c);
+
+        /* Drops all entries that have not been looked up or added
+         * since the last invocation, i.e. files that went away or
+         * are no longer used. */
+
+        HASHMAP_FOREACH(e, c->entries, i) {
+                if (e->used) {
+                        e->used = false;
+                        continue;
+                }
+
+                hashmap_remove(c->entries, e->path);
+                conf_cache_entry_free(e);
+        }
+}
+
+static bool data_is_valid(const uint8_t *data, size_t size) {
+        const uint8_t *p = data;
+
+        while (p < data + size) {
+                const ConfCacheLine *l = (const ConfCacheLine*) p;
+                size_t left = data + size - p;
+
+                if (left < offsetof(ConfCacheLine, text))
+                        return false;
+
+                if (l->length >= left - offsetof(ConfCacheLine, text))
+                        return false;
+
+                if (CONF_CACHE_LINE_SIZE(l->length) > left)
+                        return false;
+
+                if (l->text[l->length] != 0)
+                        return false;
+
+                p += CONF_CACHE_LINE_SIZE(l->length);
+        }
+
+        return true;
+}
+
+int conf_cache_load(ConfCache *c, const char *path) {
+        static const uint8_t signature[] = CONF_CACHE_SIGNATURE;
+        const struct ConfCacheHeader *h;
+        _cleanup_close_ int fd = -1;
+        uint64_t n;
+        size_t offset;
+        struct stat st;
+        void *map;
+        int r;
+
+        assert(c);
+        assert(path);
+
+        if (c->map)
+                return -EBUSY;
+
+        fd = open(path, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if ((size_t) st.st_size < sizeof(struct ConfCacheHeader))
+                return -EBADMSG;
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+                return -errno;
+
+        c->map = map;
+        c->map_size = st.st_size;
+
+        h = map;
+        if (memcmp(h->signature, signature, sizeof(signature)) != 0)
+                return -EBADMSG;
+
+        offset = sizeof(struct ConfCacheHeader);
+
+        for (n = 0; n < h->n_entries; n++) {
+                const struct ConfCacheEntryHeader *eh;
+                ConfCacheEntry *e;
+                char *p;
+                uint8_t *d;
+
+                if (offset + sizeof(struct ConfCacheEntryHeader) > c->map_size)
+                        return -EBADMSG;
+
+                eh = (const struct ConfCacheEntryHeader*) ((uint8_t*) map + offset);
+                offset += sizeof(struct ConfCacheEntryHeader);
+
+                if (eh->path_size <= 1 ||
+                    offset + ALIGN8(eh->path_size) + ALIGN8(eh->data_size) > c->map_size)
+                        return -EBADMSG;
+
+                p = (char*) map + offset;
+                offset += ALIGN8(eh->path_size);
+
+                d = (uint8_t*) map + offset;
+                offset += ALIGN8(eh->data_size);
+
+                if (p[eh->path_size - 1] != 0 || strlen(p) != eh->path_size - 1)
+                        return -EBADMSG;
+
+                if (!data_is_valid(d, eh->data_size))
+                        return -EBADMSG;
+
+                e = new0(ConfCacheEntry, 1);
+                if (!e)
+                        return -ENOMEM;
+
+                e->path = p;
+                e->dev = eh->dev;
+                e->ino = eh->ino;
+                e->size = eh->size;
+                e->mtime = eh->mtime;
+                e->data = d;
+                e->data_size = eh->data_size;
+                e->mapped = true;
+
+                r = hashmap_put(c->entries, e->path, e);
+                if (r < 0) {
+                        free(e);
+
+                        if (r != -EEXIST)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+int conf_cache_save(ConfCache *c, const char *path) {
+        static const uint8_t zeroes[8] = {};
+        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        struct ConfCacheHeader h = {
+                .signature = CONF_CACHE_SIGNATURE,
+        };
+        ConfCacheEntry *e;
+        Iterator i;
+        int r;
+
+        assert(c);
+        assert(path);
+
+        r = fopen_temporary(path, &f, &temp_path);
+        if (r < 0)
+                return r;
+
+        fchmod(fileno(f), 0600);
+
+        h.n_entries = hashmap_size(c->entries);
+        fwrite(&h, sizeof(h), 1, f);
+
+        HASHMAP_FOREACH(e, c->entries, i) {
+                struct ConfCacheEntryHeader eh = {
+                        .dev = e->dev,
+                        .ino = e->ino,
+                        .size = e->size,
+                        .mtime = e->mtime,
+                        .path_size = strlen(e->path) + 1,
+                        .data_size = e->data_size,
+                };
+
+                fwrite(&eh, sizeof(eh), 1, f);
+
+                fwrite(e->path, 1, eh.path_size, f);
+                fwrite(zeroes, 1, ALIGN8(eh.path_size) - eh.path_size, f);
+
+                fwrite(e->data, 1, eh.data_size, f);
+                fwrite(zeroes, 1, ALIGN8(eh.data_size) - eh.data_size, f);
+        }
+
+        fflush(f);
+
+        if (ferror(f)) {
+                r = -EIO;
+                goto fail;
+        }
+
+        /* The entries of an existing mapping stay valid, since we
+         * replace the file rather than overwrite it */
+        if (rename(temp_path, path) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        unlink(temp_path);
+        return r;
+}
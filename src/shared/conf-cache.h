@@ -0,0 +1,95 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "hashmap.h"
+#include "time-util.h"
+
+/* A cache of the significant lines of configuration files, keyed by
+ * path and validated against the file's device, inode, size and
+ * mtime. It can be written to disk in a compact binary format and
+ * mmap()ed back in, in which case the entries point right into the
+ * mapping. */
+
+typedef struct ConfCacheLine {
+        uint32_t line;
+        uint32_t length;
+        char text[];
+} ConfCacheLine;
+
+#define CONF_CACHE_LINE_SIZE(length) ALIGN_TO(offsetof(ConfCacheLine, text) + (length) + 1, 4)
+
+#define CONF_CACHE_LINE_FOREACH(l, data, size)                          \
+        for ((l) = (const ConfCacheLine*) (data);                       \
+             (const uint8_t*) (l) < (const uint8_t*) (data) + (size);   \
+             (l) = (const ConfCacheLine*) ((const uint8_t*) (l) + CONF_CACHE_LINE_SIZE((l)->length)))
+
+typedef struct ConfCacheEntry {
+        char *path;
+
+        dev_t dev;
+        ino_t ino;
+        uint64_t size;
+        usec_t mtime;
+
+        void *data;
+        size_t data_size;
+
+        uint64_t hash;
+
+        bool mapped:1;
+        bool used:1;
+        bool hashed:1;
+} ConfCacheEntry;
+
+typedef struct ConfCache {
+        Hashmap *entries;
+
+        void *map;
+        size_t map_size;
+
+        unsigned n_hits;
+        unsigned n_misses;
+} ConfCache;
+
+ConfCache *conf_cache_new(void);
+ConfCache *conf_cache_free(ConfCache *c);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(ConfCache*, conf_cache_free);
+#define _cleanup_conf_cache_free_ _cleanup_(conf_cache_freep)
+
+ConfCacheEntry *conf_cache_get(ConfCache *c, const char *path, const struct stat *st);
+ConfCacheEntry *conf_cache_peek(ConfCache *c, const char *path);
+void conf_cache_remove(ConfCache *c, const char *path);
+int conf_cache_put(ConfCache *c, const char *path, const struct stat *st, void *data, size_t data_size, ConfCacheEntry **ret);
+
+uint64_t conf_cache_entry_hash(ConfCacheEntry *e);
+
+void conf_cache_gc(ConfCache *c);
+
+int conf_cache_load(ConfCache *c, const char *path);
+int conf_cache_save(ConfCache *c, const char *path);
@@ -27,7 +27,9 @@
 #include <netinet/ether.h>
 
 #include "conf-parser.h"
+#include "conf-cache.h"
 #include "util.h"
+#include "fileio.h"
 #include "macro.h"
 #include "strv.h"
 #include "log.h"
@@ -130,14 +132,29 @@ int config_item_perf_lookup(
         if (!section)
                 p = lookup(lvalue, strlen(lvalue));
         else {
-                char *key;
+                _cleanup_free_ char *allocated = NULL;
+                size_t a, b;
+                char buf[256], *key;
+
+                /* This is called for every single assignment, hence
+                 * avoid allocating the key for all the usual
+                 * section and variable names */
+                a = strlen(section);
+                b = strlen(lvalue);
+
+                if (a + 1 + b < sizeof(buf))
+                        key = buf;
+                else {
+                        key = allocated = new(char, a + 1 + b + 1);
+                        if (!key)
+                                return -ENOMEM;
+                }
 
-                key = strjoin(section, ".", lvalue, NULL);
-                if (!key)
-                        return -ENOMEM;
+                memcpy(key, section, a);
+                key[a] = '.';
+                memcpy(key + a + 1, lvalue, b + 1);
 
-                p = lookup(key, strlen(key));
-                free(key);
+                p = lookup(key, a + 1 + b);
         }
 
         if (!p)
@@ -317,96 +334,153 @@ static int parse_line(const char* unit,
                                userdata);
 }
 
-/* Go through the file and parse each line */
-int config_parse(const char *unit,
-                 const char *filename,
-                 FILE *f,
-                 const char *sections,
-                 ConfigItemLookup lookup,
-                 const void *table,
-                 bool relaxed,
-                 bool allow_include,
-                 bool warn,
-                 void *userdata) {
-
-        _cleanup_free_ char *section = NULL, *continuation = NULL;
-        _cleanup_fclose_ FILE *ours = NULL;
-        unsigned line = 0, section_line = 0;
-        bool section_ignored = false;
+/* Read the file, and collect all lines that are not empty or
+ * comments, with continuation lines joined. The file is read in one
+ * go and split up in place, so that nothing needs to be allocated per
+ * line. */
+static int config_read_lines(const char *filename,
+                             FILE *f,
+                             bool warn,
+                             void **ret_data,
+                             size_t *ret_size,
+                             bool *ret_cacheable) {
+
+        _cleanup_free_ char *contents = NULL;
+        _cleanup_free_ uint8_t *data = NULL;
+        size_t size = 0, allocated = 0, n;
+        bool cacheable = true;
+        unsigned line = 0;
+        char *p, *end;
         int r;
 
         assert(filename);
-        assert(lookup);
-
-        if (!f) {
-                f = ours = fopen(filename, "re");
-                if (!f) {
-                        /* Only log on request, except for ENOENT,
-                         * since we return 0 to the caller. */
-                        if (warn || errno == ENOENT)
-                                log_full(errno == ENOENT ? LOG_DEBUG : LOG_ERR,
-                                         "Failed to open configuration file '%s': %m", filename);
-                        return errno == ENOENT ? 0 : -errno;
-                }
+        assert(f);
+        assert(ret_data);
+        assert(ret_size);
+        assert(ret_cacheable);
+
+        r = read_full_stream(f, &contents, &n);
+        if (r < 0) {
+                log_error("Failed to read configuration file '%s': %s", filename, strerror(-r));
+                return r;
         }
 
-        fd_warn_permissions(filename, fileno(f));
+        p = contents;
+        end = contents + n;
+
+        while (p < end) {
+                char *start = p, *w = p, *e;
+                bool escaped;
+                ConfCacheLine *k;
+                size_t m;
+
+                /* Continuation lines are moved up right after the
+                 * line they continue, which never overtakes the
+                 * line still to be looked at */
+                for (;;) {
+                        char *nl;
+
+                        m = strcspn(p, NEWLINE);
+                        nl = memchr(p + m, '\n', end - p - m);
+
+                        memmove(w, p, m);
+                        p = nl ? nl + 1 : end;
+
+                        escaped = false;
+                        for (e = w; e < w + m; e++) {
+                                if (escaped)
+                                        escaped = false;
+                                else if (*e == '\\')
+                                        escaped = true;
+                        }
 
-        while (!feof(f)) {
-                char l[LINE_MAX], *p, *c = NULL, *e;
-                bool escaped = false;
+                        w += m;
 
-                if (!fgets(l, sizeof(l), f)) {
-                        if (feof(f))
+                        if (!escaped)
                                 break;
 
-                        log_error("Failed to read configuration file '%s': %m", filename);
-                        return -errno;
+                        w[-1] = ' ';
+
+                        if (p >= end)
+                                break;
                 }
 
-                truncate_nl(l);
+                /* A continuation at the end of the file is
+                 * dropped */
+                if (escaped)
+                        break;
 
-                if (continuation) {
-                        c = strappend(continuation, l);
-                        if (!c) {
-                                if (warn)
-                                        log_oom();
-                                return -ENOMEM;
-                        }
+                *w = 0;
+                line++;
+
+                start = strstrip(start);
+                if (!*start || strchr(COMMENTS "\n", *start))
+                        continue;
+
+                /* We cannot track changes to included files, hence
+                 * never cache files that include others */
+                if (startswith(start, ".include "))
+                        cacheable = false;
 
-                        free(continuation);
-                        continuation = NULL;
-                        p = c;
-                } else
-                        p = l;
-
-                for (e = p; *e; e++) {
-                        if (escaped)
-                                escaped = false;
-                        else if (*e == '\\')
-                                escaped = true;
+                m = strlen(start);
+                if (m > UINT32_MAX || !GREEDY_REALLOC0(data, allocated, size + CONF_CACHE_LINE_SIZE(m))) {
+                        if (warn)
+                                log_oom();
+                        return -ENOMEM;
                 }
 
-                if (escaped) {
-                        *(e-1) = ' ';
-
-                        if (c)
-                                continuation = c;
-                        else {
-                                continuation = strdup(l);
-                                if (!continuation) {
-                                        if (warn)
-                                                log_oom();
-                                        return -ENOMEM;
-                                }
-                        }
+                k = (ConfCacheLine*) (data + size);
+                k->line = line;
+                k->length = m;
+                memcpy(k->text, start, m + 1);
+                size += CONF_CACHE_LINE_SIZE(m);
+        }
 
-                        continue;
+        *ret_data = data;
+        *ret_size = size;
+        *ret_cacheable = cacheable;
+        data = NULL;
+
+        return 0;
+}
+
+static int config_parse_lines(const char *unit,
+                              const char *filename,
+                              const void *data,
+                              size_t size,
+                              const char *sections,
+                              ConfigItemLookup lookup,
+                              const void *table,
+                              bool relaxed,
+                              bool allow_include,
+                              bool warn,
+                              void *userdata) {
+
+        _cleanup_free_ char *section = NULL, *buffer = NULL;
+        unsigned section_line = 0;
+        bool section_ignored = false;
+        const ConfCacheLine *l;
+        size_t allocated = 0;
+        int r;
+
+        assert(filename);
+        assert(data || size == 0);
+
+        CONF_CACHE_LINE_FOREACH(l, data, size) {
+
+                /* parse_line() modifies the line, and the data
+                 * might be shared or read-only, hence copy */
+                if (!GREEDY_REALLOC(buffer, allocated, l->length + 1)) {
+                        if (warn)
+                                log_oom();
+                        return -ENOMEM;
                 }
 
+                memcpy(buffer, l->text, l->length + 1);
+
                 r = parse_line(unit,
                                filename,
-                               ++line,
+                               l->line,
                                sections,
                                lookup,
                                table,
@@ -415,10 +489,8 @@ int config_parse(const char *unit,
                                &section,
                                &section_line,
                                &section_ignored,
-                               p,
+                               buffer,
                                userdata);
-                free(c);
-
                 if (r < 0) {
                         if (warn)
                                 log_warning("Failed to parse file '%s': %s",
@@ -430,6 +502,157 @@ int config_parse(const char *unit,
         return 0;
 }
 
+static int config_read_cached(ConfCache *cache,
+                              const char *filename,
+                              FILE *f,
+                              bool warn,
+                              ConfCacheEntry **ret_entry,
+                              void **ret_data,
+                              size_t *ret_size) {
+
+        _cleanup_free_ void *data = NULL;
+        ConfCacheEntry *e = NULL;
+        bool cacheable;
+        struct stat st;
+        size_t size;
+        int r;
+
+        assert(filename);
+        assert(f);
+
+        /* Returns the split up file contents either as cache entry
+         * or, if that is not possible, as plain buffer. Returns > 0
+         * if the cache could be used, 0 otherwise. */
+
+        if (cache && fstat(fileno(f), &st) < 0)
+                cache = NULL;
+
+        if (cache) {
+                e = conf_cache_get(cache, filename, &st);
+                if (e) {
+                        *ret_entry = e;
+                        *ret_data = NULL;
+                        *ret_size = 0;
+                        return 1;
+                }
+        }
+
+        r = config_read_lines(filename, f, warn, &data, &size, &cacheable);
+        if (r < 0)
+                return r;
+
+        if (cache) {
+                if (cacheable &&
+                    conf_cache_put(cache, filename, &st, data, size, &e) >= 0)
+                        data = NULL;
+                else
+                        /* Make sure nobody looks at an outdated version */
+                        conf_cache_remove(cache, filename);
+        }
+
+        *ret_entry = e;
+        *ret_data = data;
+        *ret_size = size;
+        data = NULL;
+
+        return 0;
+}
+
+int config_cache_file(ConfCache *cache, const char *filename, ConfCacheEntry **ret) {
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ void *data = NULL;
+        ConfCacheEntry *e;
+        size_t size;
+        int r;
+
+        assert(cache);
+        assert(filename);
+        assert(ret);
+
+        /* Makes sure the cache has an up-to-date entry for the file,
+         * without parsing it. Returns NULL if the file may not be
+         * cached. */
+
+        f = fopen(filename, "re");
+        if (!f)
+                return -errno;
+
+        r = config_read_cached(cache, filename, f, false, &e, &data, &size);
+        if (r < 0)
+                return r;
+
+        *ret = e;
+        return 0;
+}
+
+/* Go through the file and parse each line, using the cache for the
+ * file contents if one is passed */
+int config_parse_cached(ConfCache *cache,
+                        const char *unit,
+                        const char *filename,
+                        FILE *f,
+                        const char *sections,
+                        ConfigItemLookup lookup,
+                        const void *table,
+                        bool relaxed,
+                        bool allow_include,
+                        bool warn,
+                        void *userdata) {
+
+        _cleanup_fclose_ FILE *ours = NULL;
+        _cleanup_free_ void *data = NULL;
+        ConfCacheEntry *e;
+        size_t size;
+        int r;
+
+        assert(filename);
+        assert(lookup);
+
+        if (!f) {
+                f = ours = fopen(filename, "re");
+                if (!f) {
+                        /* Only log on request, except for ENOENT,
+                         * since we return 0 to the caller. */
+                        if (warn || errno == ENOENT)
+                                log_full(errno == ENOENT ? LOG_DEBUG : LOG_ERR,
+                                         "Failed to open configuration file '%s': %m", filename);
+                        return errno == ENOENT ? 0 : -errno;
+                }
+        }
+
+        fd_warn_permissions(filename, fileno(f));
+
+        r = config_read_cached(cache, filename, f, warn, &e, &data, &size);
+        if (r < 0)
+                return r;
+
+        if (cache) {
+                if (r > 0)
+                        cache->n_hits++;
+                else
+                        cache->n_misses++;
+        }
+
+        if (e)
+                return config_parse_lines(unit, filename, e->data, e->data_size, sections, lookup, table, relaxed, allow_include, warn, userdata);
+
+        return config_parse_lines(unit, filename, data, size, sections, lookup, table, relaxed, allow_include, warn, userdata);
+}
+
+int config_parse(const char *unit,
+                 const char *filename,
+                 FILE *f,
+                 const char *sections,
+                 ConfigItemLookup lookup,
+                 const void *table,
+                 bool relaxed,
+                 bool allow_include,
+                 bool warn,
+                 void *userdata) {
+
+        return config_parse_cached(NULL, unit, filename, f, sections, lookup, table, relaxed, allow_include, warn, userdata);
+}
+
 #define DEFINE_PARSER(type, vartype, conv_func)                         \
         int config_parse_##type(const char *unit,                       \
                                 const char *filename,                   \
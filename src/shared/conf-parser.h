@@ -92,6 +92,23 @@ int config_parse(const char *unit,
                  bool warn,
                  void *userdata);
 
+struct ConfCache;
+struct ConfCacheEntry;
+
+int config_parse_cached(struct ConfCache *cache,
+                        const char *unit,
+                        const char *filename,
+                        FILE *f,
+                        const char *sections,  /* nulstr */
+                        ConfigItemLookup lookup,
+                        const void *table,
+                        bool relaxed,
+                        bool allow_include,
+                        bool warn,
+                        void *userdata);
+
+int config_cache_file(struct ConfCache *cache, const char *filename, struct ConfCacheEntry **ret);
+
 /* Generic parsers */
 int config_parse_int(const char *unit, const char *filename, unsigned line, const char *section, unsigned section_line, const char *lvalue, int ltype, const char *rvalue, void *data, void *userdata);
 int config_parse_unsigned(const char *unit, const char *filename, unsigned line, const char *section, unsigned section_line, const char *lvalue, int ltype, const char *rvalue, void *data, void *userdata);
@@ -382,21 +382,90 @@ static int remove_marked_symlinks(
         return r;
 }
 
-static int find_symlinks_fd(
-                const char *name,
+/* The symlinks in the runtime and the persistent config path, indexed
+ * by the names of the units they refer to. The directories are walked
+ * only once, after which the state of any number of units may be
+ * looked up, instead of walking them again for each unit. */
+typedef struct SymlinkIndex {
+        bool loaded;
+
+        /* Unit name → UnitFileState + 1 */
+        Hashmap *states;
+
+        /* The first errors encountered while walking the runtime
+         * and the persistent config path */
+        int error_runtime;
+        int error;
+} SymlinkIndex;
+
+/* If there are several symlinks for a unit, enablement wins over
+ * same name links, and the runtime over the persistent config path,
+ * matching the order in which they used to be searched */
+static const unsigned symlink_state_priority[_UNIT_FILE_STATE_MAX] = {
+        [UNIT_FILE_ENABLED_RUNTIME] = 4,
+        [UNIT_FILE_ENABLED] = 3,
+        [UNIT_FILE_LINKED_RUNTIME] = 2,
+        [UNIT_FILE_LINKED] = 1,
+};
+
+static void symlink_index_done(SymlinkIndex *index) {
+        char *name;
+
+        assert(index);
+
+        while ((name = hashmap_steal_first_key(index->states)))
+                free(name);
+
+        hashmap_free(index->states);
+        index->states = NULL;
+        index->loaded = false;
+}
+
+static int symlink_index_put(SymlinkIndex *index, const char *name, UnitFileState state) {
+        void *v;
+        char *n;
+        int r;
+
+        assert(index);
+        assert(name);
+
+        v = hashmap_get(index->states, name);
+        if (v) {
+                if (symlink_state_priority[PTR_TO_INT(v) - 1] >= symlink_state_priority[state])
+                        return 0;
+
+                return hashmap_update(index->states, name, INT_TO_PTR(state + 1));
+        }
+
+        n = strdup(name);
+        if (!n)
+                return -ENOMEM;
+
+        r = hashmap_put(index->states, n, INT_TO_PTR(state + 1));
+        if (r < 0) {
+                free(n);
+                return r;
+        }
+
+        return 0;
+}
+
+static int symlink_index_add_fd(
+                SymlinkIndex *index,
                 int fd,
                 const char *path,
                 const char *config_path,
-                bool *same_name_link) {
+                bool runtime,
+                int *error) {
 
-        int r = 0;
         _cleanup_closedir_ DIR *d = NULL;
+        int r;
 
-        assert(name);
+        assert(index);
         assert(fd >= 0);
         assert(path);
         assert(config_path);
-        assert(same_name_link);
+        assert(error);
 
         d = fdopendir(fd);
         if (!d) {
@@ -409,11 +478,14 @@ static int find_symlinks_fd(
 
                 errno = 0;
                 de = readdir(d);
-                if (!de && errno != 0)
-                        return -errno;
+                if (!de && errno != 0) {
+                        if (*error == 0)
+                                *error = -errno;
+                        return 0;
+                }
 
                 if (!de)
-                        return r;
+                        return 0;
 
                 if (ignore_file(de->d_name))
                         continue;
@@ -421,16 +493,16 @@ static int find_symlinks_fd(
                 dirent_ensure_type(d, de);
 
                 if (de->d_type == DT_DIR) {
-                        int nfd, q;
                         _cleanup_free_ char *p = NULL;
+                        int nfd;
 
                         nfd = openat(fd, de->d_name, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW);
                         if (nfd < 0) {
                                 if (errno == ENOENT)
                                         continue;
 
-                                if (r == 0)
-                                        r = -errno;
+                                if (*error == 0)
+                                        *error = -errno;
                                 continue;
                         }
 
@@ -441,16 +513,14 @@ static int find_symlinks_fd(
                         }
 
                         /* This will close nfd, regardless whether it succeeds or not */
-                        q = find_symlinks_fd(name, nfd, p, config_path, same_name_link);
-                        if (q > 0)
-                                return 1;
-                        if (r == 0)
-                                r = q;
+                        r = symlink_index_add_fd(index, nfd, p, config_path, runtime, error);
+                        if (r < 0)
+                                return r;
 
                 } else if (de->d_type == DT_LNK) {
                         _cleanup_free_ char *p = NULL, *dest = NULL;
-                        bool found_path, found_dest, b = false;
-                        int q;
+                        UnitFileState state;
+                        const char *target;
 
                         /* Acquire symlink name */
                         p = path_make_absolute(de->d_name, path);
@@ -458,126 +528,117 @@ static int find_symlinks_fd(
                                 return -ENOMEM;
 
                         /* Acquire symlink destination */
-                        q = readlink_and_canonicalize(p, &dest);
-                        if (q < 0) {
-                                if (q == -ENOENT)
+                        r = readlink_and_canonicalize(p, &dest);
+                        if (r < 0) {
+                                if (r == -ENOENT)
                                         continue;
 
-                                if (r == 0)
-                                        r = q;
+                                if (*error == 0)
+                                        *error = r;
                                 continue;
                         }
 
-                        /* Check if the symlink itself matches what we
-                         * are looking for */
-                        if (path_is_absolute(name))
-                                found_path = path_equal(p, name);
-                        else
-                                found_path = streq(de->d_name, name);
-
-                        /* Check if what the symlink points to
-                         * matches what we are looking for */
-                        if (path_is_absolute(name))
-                                found_dest = path_equal(dest, name);
-                        else
-                                found_dest = streq(basename(dest), name);
+                        state = runtime ? UNIT_FILE_ENABLED_RUNTIME : UNIT_FILE_ENABLED;
+                        target = basename(dest);
 
-                        if (found_path && found_dest) {
-                                _cleanup_free_ char *t = NULL;
+                        if (streq(de->d_name, target)) {
 
-                                /* Filter out same name links in the main
-                                 * config path */
-                                t = path_make_absolute(name, config_path);
-                                if (!t)
-                                        return -ENOMEM;
+                                /* A link of the same name directly
+                                 * in the config path merely links the
+                                 * unit file in */
+                                if (path_equal(path, config_path))
+                                        state = runtime ? UNIT_FILE_LINKED_RUNTIME : UNIT_FILE_LINKED;
 
-                                b = path_equal(t, p);
+                        } else {
+                                /* Both the link and what it points to
+                                 * count as enabled */
+                                r = symlink_index_put(index, target, state);
+                                if (r < 0)
+                                        return r;
                         }
 
-                        if (b)
-                                *same_name_link = true;
-                        else if (found_path || found_dest)
-                                return 1;
+                        r = symlink_index_put(index, de->d_name, state);
+                        if (r < 0)
+                                return r;
                 }
         }
 }
 
-static int find_symlinks(
-                const char *name,
-                const char *config_path,
-                bool *same_name_link) {
-
-        int fd;
-
-        assert(name);
-        assert(config_path);
-        assert(same_name_link);
-
-        fd = open(config_path, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW);
-        if (fd < 0) {
-                if (errno == ENOENT)
-                        return 0;
-                return -errno;
-        }
-
-        /* This takes possession of fd and closes it */
-        return find_symlinks_fd(name, fd, config_path, config_path, same_name_link);
-}
-
-static int find_symlinks_in_scope(
-                UnitFileScope scope,
-                const char *root_dir,
-                const char *name,
-                UnitFileState *state) {
-
+static int symlink_index_load(SymlinkIndex *index, UnitFileScope scope, const char *root_dir) {
+        bool runtime = true;
         int r;
-        _cleanup_free_ char *path = NULL;
-        bool same_name_link_runtime = false, same_name_link = false;
 
+        assert(index);
         assert(scope >= 0);
         assert(scope < _UNIT_FILE_SCOPE_MAX);
-        assert(name);
 
+        if (index->loaded)
+                return 0;
 
-        /* First look in runtime config path */
-        r = get_config_path(scope, true, root_dir, &path);
+        r = hashmap_ensure_allocated(&index->states, &string_hash_ops);
         if (r < 0)
                 return r;
 
-        r = find_symlinks(name, path, &same_name_link_runtime);
-        if (r < 0)
-                return r;
-        else if (r > 0) {
-                *state = UNIT_FILE_ENABLED_RUNTIME;
-                return r;
-        }
+        /* First the runtime, then the normal config path */
+        for (;;) {
+                _cleanup_free_ char *path = NULL;
+                int *error, fd;
 
-        /* Then look in the normal config path */
-        r = get_config_path(scope, false, root_dir, &path);
-        if (r < 0)
-                return r;
+                error = runtime ? &index->error_runtime : &index->error;
 
-        r = find_symlinks(name, path, &same_name_link);
-        if (r < 0)
-                return r;
-        else if (r > 0) {
-                *state = UNIT_FILE_ENABLED;
-                return r;
-        }
+                r = get_config_path(scope, runtime, root_dir, &path);
+                if (r < 0)
+                        return r;
 
-        /* Hmm, we didn't find it, but maybe we found the same name
-         * link? */
-        if (same_name_link_runtime) {
-                *state = UNIT_FILE_LINKED_RUNTIME;
-                return 1;
-        } else if (same_name_link) {
-                *state = UNIT_FILE_LINKED;
-                return 1;
+                fd = open(path, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW);
+                if (fd < 0) {
+                        if (errno != ENOENT && *error == 0)
+                                *error = -errno;
+                } else {
+                        /* This takes possession of fd and closes it */
+                        r = symlink_index_add_fd(index, fd, path, path, runtime, error);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (!runtime)
+                        break;
+
+                runtime = false;
         }
 
+        index->loaded = true;
         return 0;
 }
 
+static int symlink_index_lookup(SymlinkIndex *index, const char *name, UnitFileState *state) {
+        UnitFileState s = _UNIT_FILE_STATE_INVALID;
+        void *v;
+
+        assert(index);
+        assert(index->loaded);
+        assert(name);
+        assert(state);
+
+        v = hashmap_get(index->states, name);
+        if (v)
+                s = PTR_TO_INT(v) - 1;
+
+        /* An error while walking a config path only matters if the
+         * unit could not be found before getting there */
+        if (s != UNIT_FILE_ENABLED_RUNTIME && index->error_runtime < 0)
+                return index->error_runtime;
+
+        if (!IN_SET(s, UNIT_FILE_ENABLED_RUNTIME, UNIT_FILE_ENABLED) && index->error < 0)
+                return index->error;
+
+        if (s < 0)
+                return 0;
+
+        *state = s;
+        return 1;
+}
+
 int unit_file_mask(
                 UnitFileScope scope,
                 bool runtime,
@@ -1193,6 +1254,88 @@ static int unit_file_can_install(
         return r;
 }
 
+static UnitFileState unit_file_lookup_state(
+                UnitFileScope scope,
+                const char *root_dir,
+                LookupPaths *paths,
+                SymlinkIndex *index,
+                const char *name) {
+
+        UnitFileState state = _UNIT_FILE_STATE_INVALID;
+        char **i;
+        _cleanup_free_ char *path = NULL;
+        int r = 0;
+
+        assert(paths);
+        assert(index);
+        assert(name);
+
+        if (!unit_name_is_valid(name, TEMPLATE_VALID))
+                return -EINVAL;
+
+        STRV_FOREACH(i, paths->unit_path) {
+                struct stat st;
+                char *partial;
+
+                free(path);
+                path = NULL;
+
+                path = path_join(root_dir, *i, name);
+                if (!path)
+                        return -ENOMEM;
+
+                if (root_dir)
+                        partial = path + strlen(root_dir);
+                else
+                        partial = path;
+
+                /*
+                 * Search for a unit file in our default paths, to
+                 * be sure, that there are no broken symlinks.
+                 */
+                if (lstat(path, &st) < 0) {
+                        r = -errno;
+                        if (errno != ENOENT)
+                                return r;
+
+                        if (!unit_name_is_instance(name))
+                                continue;
+                } else {
+                        if (!S_ISREG(st.st_mode) && !S_ISLNK(st.st_mode))
+                                return -ENOENT;
+
+                        r = null_or_empty_path(path);
+                        if (r < 0 && r != -ENOENT)
+                                return r;
+                        else if (r > 0) {
+                                state = path_startswith(*i, "/run") ?
+                                        UNIT_FILE_MASKED_RUNTIME : UNIT_FILE_MASKED;
+                                return state;
+                        }
+                }
+
+                r = symlink_index_load(index, scope, root_dir);
+                if (r < 0)
+                        return r;
+
+                r = symlink_index_lookup(index, name, &state);
+                if (r < 0)
+                        return r;
+                else if (r > 0)
+                        return state;
+
+                r = unit_file_can_install(paths, root_dir, partial, true);
+                if (r < 0 && errno != ENOENT)
+                        return r;
+                else if (r > 0)
+                        return UNIT_FILE_DISABLED;
+                else if (r == 0)
+                        return UNIT_FILE_STATIC;
+        }
+
+        return r < 0 ? r : state;
+}
+
 static int create_symlink(
                 const char *old_path,
                 const char *new_path,
@@ -1521,6 +1664,7 @@ int unit_file_add_dependency(
 
         _cleanup_lookup_paths_free_ LookupPaths paths = {};
         _cleanup_(install_context_done) InstallContext c = {};
+        _cleanup_(symlink_index_done) SymlinkIndex index = {};
         _cleanup_free_ char *config_path = NULL;
         char **i;
         int r;
@@ -1540,7 +1684,7 @@ int unit_file_add_dependency(
         STRV_FOREACH(i, files) {
                 UnitFileState state;
 
-                state = unit_file_get_state(scope, root_dir, *i);
+                state = unit_file_lookup_state(scope, root_dir, &paths, &index, *i);
                 if (state < 0) {
                         log_error("Failed to get unit file state for %s: %s", *i, strerror(-state));
                         return state;
@@ -1602,6 +1746,7 @@ int unit_file_enable(
 
         _cleanup_lookup_paths_free_ LookupPaths paths = {};
         _cleanup_(install_context_done) InstallContext c = {};
+        _cleanup_(symlink_index_done) SymlinkIndex index = {};
         char **i;
         _cleanup_free_ char *config_path = NULL;
         int r;
@@ -1620,7 +1765,7 @@ int unit_file_enable(
         STRV_FOREACH(i, files) {
                 UnitFileState state;
 
-                state = unit_file_get_state(scope, root_dir, *i);
+                state = unit_file_lookup_state(scope, root_dir, &paths, &index, *i);
                 if (state < 0) {
                         log_error("Failed to get unit file state for %s: %s", *i, strerror(-state));
                         return state;
@@ -1805,9 +1950,7 @@ UnitFileState unit_file_get_state(
                 const char *name) {
 
         _cleanup_lookup_paths_free_ LookupPaths paths = {};
-        UnitFileState state = _UNIT_FILE_STATE_INVALID;
-        char **i;
-        _cleanup_free_ char *path = NULL;
+        _cleanup_(symlink_index_done) SymlinkIndex index = {};
         int r;
 
         assert(scope >= 0);
@@ -1817,80 +1960,98 @@ UnitFileState unit_file_get_state(
         if (root_dir && scope != UNIT_FILE_SYSTEM)
                 return -EINVAL;
 
-        if (!unit_name_is_valid(name, TEMPLATE_VALID))
-                return -EINVAL;
-
         r = lookup_paths_init_from_scope(&paths, scope, root_dir);
         if (r < 0)
                 return r;
 
-        STRV_FOREACH(i, paths.unit_path) {
-                struct stat st;
-                char *partial;
+        return unit_file_lookup_state(scope, root_dir, &paths, &index, name);
+}
 
-                free(path);
-                path = NULL;
+typedef struct PresetRule {
+        char *pattern;
+        bool enable;
+} PresetRule;
+
+/* The rules of all preset files, parsed once. Rules for a plain unit
+ * name are looked up in a hashmap, only the ones with glob patterns
+ * need to be matched one by one. Since the first matching rule wins,
+ * a glob only needs to be tried if it precedes the rule for the
+ * name. */
+typedef struct Presets {
+        PresetRule *rules;
+        unsigned n_rules;
+        size_t n_allocated;
+
+        /* Unit name → index of its first rule + 1 */
+        Hashmap *names;
+
+        /* Indexes of the rules with globs, in order */
+        unsigned *globs;
+        unsigned n_globs;
+        size_t n_globs_allocated;
+} Presets;
+
+static void presets_done(Presets *p) {
+        unsigned i;
 
-                path = path_join(root_dir, *i, name);
-                if (!path)
-                        return -ENOMEM;
+        assert(p);
 
-                if (root_dir)
-                        partial = path + strlen(root_dir);
-                else
-                        partial = path;
+        for (i = 0; i < p->n_rules; i++)
+                free(p->rules[i].pattern);
 
-                /*
-                 * Search for a unit file in our default paths, to
-                 * be sure, that there are no broken symlinks.
-                 */
-                if (lstat(path, &st) < 0) {
-                        r = -errno;
-                        if (errno != ENOENT)
-                                return r;
+        free(p->rules);
+        free(p->globs);
+        hashmap_free(p->names);
 
-                        if (!unit_name_is_instance(name))
-                                continue;
-                } else {
-                        if (!S_ISREG(st.st_mode) && !S_ISLNK(st.st_mode))
-                                return -ENOENT;
+        zero(*p);
+}
 
-                        r = null_or_empty_path(path);
-                        if (r < 0 && r != -ENOENT)
-                                return r;
-                        else if (r > 0) {
-                                state = path_startswith(*i, "/run") ?
-                                        UNIT_FILE_MASKED_RUNTIME : UNIT_FILE_MASKED;
-                                return state;
-                        }
-                }
+static int presets_add(Presets *p, const char *pattern, bool enable) {
+        PresetRule *rule;
+        int r;
 
-                r = find_symlinks_in_scope(scope, root_dir, name, &state);
-                if (r < 0)
-                        return r;
-                else if (r > 0)
-                        return state;
+        assert(p);
+        assert(pattern);
 
-                r = unit_file_can_install(&paths, root_dir, partial, true);
-                if (r < 0 && errno != ENOENT)
-                        return r;
-                else if (r > 0)
-                        return UNIT_FILE_DISABLED;
-                else if (r == 0)
-                        return UNIT_FILE_STATIC;
+        if (!GREEDY_REALLOC(p->rules, p->n_allocated, p->n_rules + 1))
+                return -ENOMEM;
+
+        rule = p->rules + p->n_rules;
+        rule->enable = enable;
+        rule->pattern = strdup(pattern);
+        if (!rule->pattern)
+                return -ENOMEM;
+
+        p->n_rules++;
+
+        if (string_is_glob(pattern)) {
+                if (!GREEDY_REALLOC(p->globs, p->n_globs_allocated, p->n_globs + 1))
+                        return -ENOMEM;
+
+                p->globs[p->n_globs++] = p->n_rules - 1;
+                return 0;
         }
 
-        return r < 0 ? r : state;
+        r = hashmap_ensure_allocated(&p->names, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        /* Later rules for the same name never apply */
+        r = hashmap_put(p->names, rule->pattern, UINT_TO_PTR(p->n_rules));
+        if (r < 0 && r != -EEXIST)
+                return r;
+
+        return 0;
 }
 
-int unit_file_query_preset(UnitFileScope scope, const char *root_dir, const char *name) {
+static int presets_load(Presets *p, UnitFileScope scope, const char *root_dir) {
         _cleanup_strv_free_ char **files = NULL;
-        char **p;
+        char **i;
         int r;
 
+        assert(p);
         assert(scope >= 0);
         assert(scope < _UNIT_FILE_SCOPE_MAX);
-        assert(name);
 
         if (scope == UNIT_FILE_SYSTEM)
                 r = conf_files_list(&files, ".preset", root_dir,
@@ -1908,15 +2069,15 @@ int unit_file_query_preset(UnitFileScope scope, const char *root_dir, const char
                                     "/usr/lib/systemd/user-preset",
                                     NULL);
         else
-                return 1;
+                return 0;
 
         if (r < 0)
                 return r;
 
-        STRV_FOREACH(p, files) {
+        STRV_FOREACH(i, files) {
                 _cleanup_fclose_ FILE *f;
 
-                f = fopen(*p, "re");
+                f = fopen(*i, "re");
                 if (!f) {
                         if (errno == ENOENT)
                                 continue;
@@ -1941,28 +2102,70 @@ int unit_file_query_preset(UnitFileScope scope, const char *root_dir, const char
                                 l += 6;
                                 l += strspn(l, WHITESPACE);
 
-                                if (fnmatch(l, name, FNM_NOESCAPE) == 0) {
-                                        log_debug("Preset file says enable %s.", name);
-                                        return 1;
-                                }
+                                r = presets_add(p, l, true);
 
                         } else if (first_word(l, "disable")) {
                                 l += 7;
                                 l += strspn(l, WHITESPACE);
 
-                                if (fnmatch(l, name, FNM_NOESCAPE) == 0) {
-                                        log_debug("Preset file says disable %s.", name);
-                                        return 0;
-                                }
+                                r = presets_add(p, l, false);
 
-                        } else
+                        } else {
                                 log_debug("Couldn't parse line '%s'", l);
+                                r = 0;
+                        }
+
+                        if (r < 0)
+                                return r;
                 }
         }
 
-        /* Default is "enable" */
-        log_debug("Preset file doesn't say anything about %s, enabling.", name);
-        return 1;
+        return 0;
+}
+
+static int presets_query(const Presets *p, const char *name) {
+        const PresetRule *rule = NULL;
+        unsigned i, end, k;
+
+        assert(p);
+        assert(name);
+
+        k = PTR_TO_UINT(hashmap_get(p->names, name));
+        if (k > 0) {
+                rule = p->rules + k - 1;
+                end = k - 1;
+        } else
+                end = p->n_rules;
+
+        for (i = 0; i < p->n_globs && p->globs[i] < end; i++)
+                if (fnmatch(p->rules[p->globs[i]].pattern, name, FNM_NOESCAPE) == 0) {
+                        rule = p->rules + p->globs[i];
+                        break;
+                }
+
+        if (!rule) {
+                /* Default is "enable" */
+                log_debug("Preset file doesn't say anything about %s, enabling.", name);
+                return 1;
+        }
+
+        log_debug("Preset file says %s %s.", rule->enable ? "enable" : "disable", name);
+        return rule->enable;
+}
+
+int unit_file_query_preset(UnitFileScope scope, const char *root_dir, const char *name) {
+        _cleanup_(presets_done) Presets presets = {};
+        int r;
+
+        assert(scope >= 0);
+        assert(scope < _UNIT_FILE_SCOPE_MAX);
+        assert(name);
+
+        r = presets_load(&presets, scope, root_dir);
+        if (r < 0)
+                return r;
+
+        return presets_query(&presets, name);
 }
 
 int unit_file_preset(
@@ -1977,6 +2180,7 @@ int unit_file_preset(
 
         _cleanup_(install_context_done) InstallContext plus = {}, minus = {};
         _cleanup_lookup_paths_free_ LookupPaths paths = {};
+        _cleanup_(presets_done) Presets presets = {};
         _cleanup_free_ char *config_path = NULL;
         char **i;
         int r, q;
@@ -1993,12 +2197,16 @@ int unit_file_preset(
         if (r < 0)
                 return r;
 
+        r = presets_load(&presets, scope, root_dir);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, files) {
 
                 if (!unit_name_is_valid(*i, TEMPLATE_VALID))
                         return -EINVAL;
 
-                r = unit_file_query_preset(scope, root_dir, *i);
+                r = presets_query(&presets, *i);
                 if (r < 0)
                         return r;
 
@@ -2045,6 +2253,7 @@ int unit_file_preset_all(
 
         _cleanup_(install_context_done) InstallContext plus = {}, minus = {};
         _cleanup_lookup_paths_free_ LookupPaths paths = {};
+        _cleanup_(presets_done) Presets presets = {};
         _cleanup_free_ char *config_path = NULL;
         char **i;
         int r, q;
@@ -2061,6 +2270,10 @@ int unit_file_preset_all(
         if (r < 0)
                 return r;
 
+        r = presets_load(&presets, scope, root_dir);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, paths.unit_path) {
                 _cleanup_closedir_ DIR *d = NULL;
                 _cleanup_free_ char *units_dir;
@@ -2099,7 +2312,7 @@ int unit_file_preset_all(
                         if (de->d_type != DT_REG)
                                 continue;
 
-                        r = unit_file_query_preset(scope, root_dir, de->d_name);
+                        r = presets_query(&presets, de->d_name);
                         if (r < 0)
                                 return r;
 
@@ -2151,6 +2364,7 @@ int unit_file_get_list(
                 Hashmap *h) {
 
         _cleanup_lookup_paths_free_ LookupPaths paths = {};
+        _cleanup_(symlink_index_done) SymlinkIndex index = {};
         char **i;
         int r;
 
@@ -2171,6 +2385,11 @@ int unit_file_get_list(
         if (r < 0)
                 return r;
 
+        /* Walk the config paths once, instead of once per unit */
+        r = symlink_index_load(&index, scope, root_dir);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, paths.unit_path) {
                 _cleanup_closedir_ DIR *d = NULL;
                 _cleanup_free_ char *units_dir;
@@ -2232,13 +2451,11 @@ int unit_file_get_list(
                                 goto found;
                         }
 
-                        r = find_symlinks_in_scope(scope, root_dir, de->d_name, &f->state);
+                        r = symlink_index_lookup(&index, de->d_name, &f->state);
                         if (r < 0)
                                 return r;
-                        else if (r > 0) {
-                                f->state = UNIT_FILE_ENABLED;
+                        else if (r > 0)
                                 goto found;
-                        }
 
                         path = path_make_absolute(de->d_name, *i);
                         if (!path)
@@ -207,6 +207,10 @@ struct btrfs_ioctl_fs_info_args {
 #define BTRFS_SUPER_MAGIC 0x9123683E
 #endif
 
+#ifndef CGROUP2_SUPER_MAGIC
+#define CGROUP2_SUPER_MAGIC 0x63677270
+#endif
+
 #ifndef MS_MOVE
 #define MS_MOVE 8192
 #endif
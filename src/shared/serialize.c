@@ -0,0 +1,501 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <limits.h>
+
+#include "util.h"
+#include "hashmap.h"
+#include "serialize.h"
+
+/* Binary format, version 1:
+ *
+ *   signature
+ *   records, each one byte of type followed by:
+ *     RECORD_END:    nothing
+ *     RECORD_KEY:    varint length, key; defines the next key number
+ *     RECORD_ITEM:   varint key number, varint length, value
+ *     RECORD_MARKER: varint length, name
+ *
+ * with varints in LEB128 and strings not NUL terminated. The first
+ * byte of the signature can never show up in the text format. */
+
+#define SERIALIZATION_SIGNATURE "\377SDSRL\001\n"
+#define SERIALIZATION_SIGNATURE_SIZE (sizeof(SERIALIZATION_SIGNATURE) - 1)
+
+#define SERIALIZATION_STRING_MAX (16U*1024U*1024U)
+
+enum {
+        RECORD_END,
+        RECORD_KEY,
+        RECORD_ITEM,
+        RECORD_MARKER,
+};
+
+struct SerializeState {
+        FILE *f;
+        SerializationFormat format;
+
+        /* Writing: key => key number plus one */
+        Hashmap *key_numbers;
+        unsigned n_keys_written;
+
+        /* Reading */
+        char **keys;
+        size_t n_keys, n_keys_allocated;
+
+        char *buffer;
+        size_t buffer_allocated;
+
+        char *joined;
+        size_t joined_allocated;
+        bool last_was_item;
+
+        char line[LINE_MAX];
+};
+
+static char empty[1] = "";
+
+static SerializeState *serialize_state_new(FILE *f, SerializationFormat format) {
+        SerializeState *s;
+
+        s = new0(SerializeState, 1);
+        if (!s)
+                return NULL;
+
+        s->f = f;
+        s->format = format;
+
+        return s;
+}
+
+SerializeState *serialize_state_free(SerializeState *s) {
+        size_t i;
+        char *k;
+
+        if (!s)
+                return NULL;
+
+        /* The values are key numbers, only the keys are allocated */
+        while ((k = hashmap_steal_first_key(s->key_numbers)))
+                free(k);
+        hashmap_free(s->key_numbers);
+
+        for (i = 0; i < s->n_keys; i++)
+                free(s->keys[i]);
+        free(s->keys);
+
+        free(s->buffer);
+        free(s->joined);
+        free(s);
+
+        return NULL;
+}
+
+int serialize_begin(FILE *f, SerializationFormat format, SerializeState **ret) {
+        SerializeState *s;
+
+        assert(f);
+        assert(format >= 0 && format < _SERIALIZATION_FORMAT_MAX);
+        assert(ret);
+
+        s = serialize_state_new(f, format);
+        if (!s)
+                return -ENOMEM;
+
+        if (format == SERIALIZATION_BINARY) {
+                s->key_numbers = hashmap_new(&string_hash_ops);
+                if (!s->key_numbers) {
+                        serialize_state_free(s);
+                        return -ENOMEM;
+                }
+
+                fwrite_unlocked(SERIALIZATION_SIGNATURE, 1, SERIALIZATION_SIGNATURE_SIZE, f);
+        }
+
+        *ret = s;
+        return 0;
+}
+
+static void write_varint(FILE *f, uint64_t v) {
+        while (v >= 0x80) {
+                putc_unlocked((int) (v & 0x7f) | 0x80, f);
+                v >>= 7;
+        }
+
+        putc_unlocked((int) v, f);
+}
+
+static void write_string(FILE *f, const char *p, size_t n) {
+        write_varint(f, n);
+        fwrite_unlocked(p, 1, n, f);
+}
+
+static unsigned write_key(SerializeState *s, const char *key) {
+        unsigned n;
+        char *k;
+
+        n = PTR_TO_UINT(hashmap_get(s->key_numbers, key));
+        if (n > 0)
+                return n - 1;
+
+        n = s->n_keys_written++;
+
+        putc_unlocked(RECORD_KEY, s->f);
+        write_string(s->f, key, strlen(key));
+
+        /* If we fail to remember the key, we'll simply define it
+         * again the next time */
+        k = strdup(key);
+        if (k && hashmap_put(s->key_numbers, k, UINT_TO_PTR(n + 1)) < 0)
+                free(k);
+
+        return n;
+}
+
+void serialize_item(SerializeState *s, const char *key, const char *value) {
+        unsigned n;
+
+        assert(s);
+        assert(key);
+        assert(value);
+
+        if (s->format == SERIALIZATION_TEXT) {
+                fputs(key, s->f);
+                fputc('=', s->f);
+                fputs(value, s->f);
+                fputc('\n', s->f);
+                return;
+        }
+
+        /* Might define the key first */
+        n = write_key(s, key);
+
+        putc_unlocked(RECORD_ITEM, s->f);
+        write_varint(s->f, n);
+        write_string(s->f, value, strlen(value));
+}
+
+void serialize_item_formatv(SerializeState *s, const char *key, const char *format, va_list ap) {
+        _cleanup_free_ char *p = NULL;
+        char buf[LINE_MAX];
+        va_list aq;
+        int n;
+
+        assert(s);
+        assert(key);
+        assert(format);
+
+        if (s->format == SERIALIZATION_TEXT) {
+                fputs(key, s->f);
+                fputc('=', s->f);
+                vfprintf(s->f, format, ap);
+                fputc('\n', s->f);
+                return;
+        }
+
+        va_copy(aq, ap);
+        n = vsnprintf(buf, sizeof(buf), format, aq);
+        va_end(aq);
+
+        if (n < 0)
+                return;
+
+        if ((size_t) n < sizeof(buf)) {
+                serialize_item(s, key, buf);
+                return;
+        }
+
+        if (vasprintf(&p, format, ap) >= 0)
+                serialize_item(s, key, p);
+}
+
+void serialize_item_format(SerializeState *s, const char *key, const char *format, ...) {
+        va_list ap;
+
+        va_start(ap, format);
+        serialize_item_formatv(s, key, format, ap);
+        va_end(ap);
+}
+
+void serialize_marker(SerializeState *s, const char *name) {
+        assert(s);
+        assert(name);
+
+        if (s->format == SERIALIZATION_TEXT) {
+                fputs(name, s->f);
+                fputc('\n', s->f);
+                return;
+        }
+
+        putc_unlocked(RECORD_MARKER, s->f);
+        write_string(s->f, name, strlen(name));
+}
+
+void serialize_section_end(SerializeState *s) {
+        assert(s);
+
+        if (s->format == SERIALIZATION_TEXT)
+                fputc('\n', s->f);
+        else
+                putc_unlocked(RECORD_END, s->f);
+}
+
+int deserialize_begin(FILE *f, SerializeState **ret) {
+        char signature[SERIALIZATION_SIGNATURE_SIZE];
+        SerializationFormat format = SERIALIZATION_TEXT;
+        SerializeState *s;
+        int c;
+
+        assert(f);
+        assert(ret);
+
+        c = getc_unlocked(f);
+        if (c == EOF && ferror(f))
+                return -EIO;
+
+        if (c != EOF && ungetc(c, f) == EOF)
+                return -EIO;
+
+        /* Everything that doesn't start with our signature is text */
+        if (c == (uint8_t) SERIALIZATION_SIGNATURE[0]) {
+                if (fread_unlocked(signature, 1, sizeof(signature), f) != sizeof(signature))
+                        return -EBADMSG;
+
+                /* Differing in the version only? */
+                if (memcmp(signature, SERIALIZATION_SIGNATURE, sizeof(signature) - 2) == 0 &&
+                    memcmp(signature, SERIALIZATION_SIGNATURE, sizeof(signature)) != 0)
+                        return -EPROTONOSUPPORT;
+
+                if (memcmp(signature, SERIALIZATION_SIGNATURE, sizeof(signature)) != 0)
+                        return -EBADMSG;
+
+                format = SERIALIZATION_BINARY;
+        }
+
+        s = serialize_state_new(f, format);
+        if (!s)
+                return -ENOMEM;
+
+        *ret = s;
+        return 0;
+}
+
+static int read_varint(FILE *f, uint64_t *ret) {
+        uint64_t v = 0;
+        unsigned shift;
+
+        for (shift = 0; shift < 64; shift += 7) {
+                int c;
+
+                c = getc_unlocked(f);
+                if (c == EOF)
+                        return ferror(f) ? -EIO : -EBADMSG;
+
+                v |= (uint64_t) (c & 0x7f) << shift;
+
+                if (!(c & 0x80)) {
+                        *ret = v;
+                        return 0;
+                }
+        }
+
+        return -EBADMSG;
+}
+
+static int read_string(SerializeState *s, char **ret) {
+        uint64_t n;
+        int r;
+
+        r = read_varint(s->f, &n);
+        if (r < 0)
+                return r;
+
+        if (n > SERIALIZATION_STRING_MAX)
+                return -EBADMSG;
+
+        if (!GREEDY_REALLOC(s->buffer, s->buffer_allocated, n + 1))
+                return -ENOMEM;
+
+        if (fread_unlocked(s->buffer, 1, n, s->f) != n)
+                return ferror(s->f) ? -EIO : -EBADMSG;
+
+        s->buffer[n] = 0;
+        *ret = s->buffer;
+
+        return 0;
+}
+
+static int deserialize_text(SerializeState *s, char **ret) {
+        if (!fgets(s->line, sizeof(s->line), s->f)) {
+                if (feof(s->f))
+                        return 0;
+
+                return errno > 0 ? -errno : -EIO;
+        }
+
+        char_array_0(s->line);
+        *ret = strstrip(s->line);
+
+        return 1;
+}
+
+static int deserialize_binary(SerializeState *s, char **key, char **value) {
+        int r;
+
+        for (;;) {
+                uint64_t number;
+                char *p;
+                int c;
+
+                c = getc_unlocked(s->f);
+                if (c == EOF)
+                        return ferror(s->f) ? -EIO : 0;
+
+                switch (c) {
+
+                case RECORD_END:
+                        *key = *value = empty;
+                        s->last_was_item = false;
+                        return 1;
+
+                case RECORD_KEY:
+                        r = read_string(s, &p);
+                        if (r < 0)
+                                return r;
+
+                        if (!GREEDY_REALLOC(s->keys, s->n_keys_allocated, s->n_keys + 1))
+                                return -ENOMEM;
+
+                        p = strdup(p);
+                        if (!p)
+                                return -ENOMEM;
+
+                        s->keys[s->n_keys++] = p;
+                        break;
+
+                case RECORD_ITEM:
+                        r = read_varint(s->f, &number);
+                        if (r < 0)
+                                return r;
+
+                        if (number >= s->n_keys)
+                                return -EBADMSG;
+
+                        r = read_string(s, value);
+                        if (r < 0)
+                                return r;
+
+                        *key = s->keys[number];
+                        s->last_was_item = true;
+                        return 1;
+
+                case RECORD_MARKER:
+                        r = read_string(s, key);
+                        if (r < 0)
+                                return r;
+
+                        *value = empty;
+                        s->last_was_item = false;
+                        return 1;
+
+                default:
+                        return -EBADMSG;
+                }
+        }
+}
+
+int deserialize_item(SerializeState *s, char **key, char **value) {
+        size_t k;
+        char *l;
+        int r;
+
+        assert(s);
+        assert(key);
+        assert(value);
+
+        /* Returns > 0 and the next item, or a marker with an empty
+         * value, or an empty key at the end of a section. Returns 0
+         * at the end of the stream. The strings stay valid until the
+         * next call. */
+
+        if (s->format == SERIALIZATION_BINARY)
+                return deserialize_binary(s, key, value);
+
+        r = deserialize_text(s, &l);
+        if (r <= 0)
+                return r;
+
+        k = strcspn(l, "=");
+        if (l[k] == '=') {
+                l[k] = 0;
+                *value = l + k + 1;
+        } else
+                *value = l + k;
+
+        *key = l;
+        return 1;
+}
+
+int deserialize_line(SerializeState *s, char **line) {
+        char *key, *value;
+        size_t a, b;
+        int r;
+
+        assert(s);
+        assert(line);
+
+        /* Like deserialize_item(), but returns the item as a single
+         * "key=value" string, as the text format has it */
+
+        if (s->format == SERIALIZATION_TEXT)
+                return deserialize_text(s, line);
+
+        r = deserialize_binary(s, &key, &value);
+        if (r <= 0)
+                return r;
+
+        if (!s->last_was_item) {
+                *line = key;
+                return 1;
+        }
+
+        a = strlen(key);
+        b = strlen(value);
+
+        if (!GREEDY_REALLOC(s->joined, s->joined_allocated, a + 1 + b + 1))
+                return -ENOMEM;
+
+        memcpy(s->joined, key, a);
+        s->joined[a] = '=';
+        memcpy(s->joined + a + 1, value, b + 1);
+
+        *line = s->joined;
+        return 1;
+}
+
+static const char* const serialization_format_table[_SERIALIZATION_FORMAT_MAX] = {
+        [SERIALIZATION_TEXT] = "text",
+        [SERIALIZATION_BINARY] = "binary",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(serialization_format, SerializationFormat);
@@ -0,0 +1,70 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "macro.h"
+#include "util.h"
+
+/* The state passed on across daemon-reload, daemon-reexec and
+ * switch-root is a stream of key/value items, grouped into sections
+ * that are terminated by an empty item, and of markers that open
+ * sections. There are two encodings of it: the traditional text one
+ * with one "key=value" line per item, which is nice for debugging,
+ * and a binary one, in which each key is sent only once and then
+ * referred to by number, and values are length-prefixed. The reader
+ * detects the encoding from the signature at the start of the
+ * stream. Versions that predate the binary encoding only read text.
+ *
+ * The state of the encoder or decoder of a stream is kept in a
+ * SerializeState object, which is returned by serialize_begin() or
+ * deserialize_begin() and passed to all further calls. */
+
+typedef enum SerializationFormat {
+        SERIALIZATION_TEXT,
+        SERIALIZATION_BINARY,
+        _SERIALIZATION_FORMAT_MAX,
+        _SERIALIZATION_FORMAT_INVALID = -1
+} SerializationFormat;
+
+typedef struct SerializeState SerializeState;
+
+int serialize_begin(FILE *f, SerializationFormat format, SerializeState **ret);
+int deserialize_begin(FILE *f, SerializeState **ret);
+SerializeState *serialize_state_free(SerializeState *s);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(SerializeState*, serialize_state_free);
+#define _cleanup_serialize_state_free_ _cleanup_(serialize_state_freep)
+
+void serialize_item(SerializeState *s, const char *key, const char *value);
+void serialize_item_format(SerializeState *s, const char *key, const char *format, ...) _printf_(3,4);
+void serialize_item_formatv(SerializeState *s, const char *key, const char *format, va_list ap) _printf_(3,0);
+void serialize_marker(SerializeState *s, const char *name);
+void serialize_section_end(SerializeState *s);
+
+int deserialize_item(SerializeState *s, char **key, char **value);
+int deserialize_line(SerializeState *s, char **line);
+
+const char* serialization_format_to_string(SerializationFormat f) _const_;
+SerializationFormat serialization_format_from_string(const char *s) _pure_;
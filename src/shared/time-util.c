@@ -27,6 +27,7 @@
 #include "util.h"
 #include "time-util.h"
 #include "strv.h"
+#include "serialize.h"
 
 usec_t now(clockid_t clock_id) {
         struct timespec ts;
@@ -383,19 +384,16 @@ char *format_timespan(char *buf, size_t l, usec_t t, usec_t accuracy) {
         return buf;
 }
 
-void dual_timestamp_serialize(FILE *f, const char *name, dual_timestamp *t) {
+void dual_timestamp_serialize(SerializeState *st, const char *name, dual_timestamp *t) {
 
-        assert(f);
+        assert(st);
         assert(name);
         assert(t);
 
         if (!dual_timestamp_is_set(t))
                 return;
 
-        fprintf(f, "%s="USEC_FMT" "USEC_FMT"\n",
-                name,
-                t->realtime,
-                t->monotonic);
+        serialize_item_format(st, name, USEC_FMT" "USEC_FMT, t->realtime, t->monotonic);
 }
 
 void dual_timestamp_deserialize(const char *value, dual_timestamp *t) {
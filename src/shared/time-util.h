@@ -32,6 +32,8 @@ typedef uint64_t nsec_t;
 
 #include "macro.h"
 
+struct SerializeState;
+
 typedef struct dual_timestamp {
         usec_t realtime;
         usec_t monotonic;
@@ -93,7 +95,7 @@ char *format_timestamp_us_utc(char *buf, size_t l, usec_t t);
 char *format_timestamp_relative(char *buf, size_t l, usec_t t);
 char *format_timespan(char *buf, size_t l, usec_t t, usec_t accuracy);
 
-void dual_timestamp_serialize(FILE *f, const char *name, dual_timestamp *t);
+void dual_timestamp_serialize(struct SerializeState *st, const char *name, dual_timestamp *t);
 void dual_timestamp_deserialize(const char *value, dual_timestamp *t);
 
 int parse_timestamp(const char *t, usec_t *usec);
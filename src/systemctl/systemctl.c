@@ -98,6 +98,7 @@ static bool arg_dry = false;
 static bool arg_quiet = false;
 static bool arg_full = false;
 static bool arg_recursive = false;
+static bool arg_incremental = false;
 static int arg_force = 0;
 static bool arg_ask_password = true;
 static bool arg_runtime = false;
@@ -494,6 +495,7 @@ static int get_unit_list(
         _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
         _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **type_patterns = NULL;
         size_t size = c;
         int r;
         UnitInfo u;
@@ -502,14 +504,31 @@ static int get_unit_list(
         assert(unit_infos);
         assert(_reply);
 
+        /* Let the manager do the filtering, so that only the units
+         * we are going to show are sent over. Unit types are
+         * expressed as patterns on the suffix. */
+        if (strv_isempty(patterns) && arg_types) {
+                char **t;
+
+                STRV_FOREACH(t, arg_types) {
+                        char *p;
+
+                        p = strappend("*.", *t);
+                        if (!p)
+                                return log_oom();
+
+                        if (strv_consume(&type_patterns, p) < 0)
+                                return log_oom();
+                }
+        }
+
         r = sd_bus_message_new_method_call(
                         bus,
                         &m,
                         "org.freedesktop.systemd1",
                         "/org/freedesktop/systemd1",
                         "org.freedesktop.systemd1.Manager",
-                        "ListUnitsFiltered");
-
+                        "ListUnitsByPatterns");
         if (r < 0)
                 return bus_log_create_error(r);
 
@@ -517,7 +536,33 @@ static int get_unit_list(
         if (r < 0)
                 return bus_log_create_error(r);
 
+        r = sd_bus_message_append_strv(m, type_patterns ?: patterns);
+        if (r < 0)
+                return bus_log_create_error(r);
+
         r = sd_bus_call(bus, m, 0, &error, &reply);
+        if (r < 0 && sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+                /* Fall back to filtering everything on our side when
+                 * talking to an older manager */
+                m = sd_bus_message_unref(m);
+                sd_bus_error_free(&error);
+
+                r = sd_bus_message_new_method_call(
+                                bus,
+                                &m,
+                                "org.freedesktop.systemd1",
+                                "/org/freedesktop/systemd1",
+                                "org.freedesktop.systemd1.Manager",
+                                "ListUnitsFiltered");
+                if (r < 0)
+                        return bus_log_create_error(r);
+
+                r = sd_bus_message_append_strv(m, arg_states);
+                if (r < 0)
+                        return bus_log_create_error(r);
+
+                r = sd_bus_call(bus, m, 0, &error, &reply);
+        }
         if (r < 0) {
                 log_error("Failed to list units: %s", bus_error_message(&error, r));
                 return r;
@@ -4755,9 +4800,29 @@ static int delete_snapshot(sd_bus *bus, char **args) {
         return r;
 }
 
+static int call_manager(sd_bus *bus, const char *method, sd_bus_error *error) {
+        _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+        int r;
+
+        r = sd_bus_message_new_method_call(
+                        bus,
+                        &m,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        method);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        r = sd_bus_message_set_allow_interactive_authorization(m, arg_ask_password);
+        if (r < 0)
+                return bus_log_create_error(r);
+
+        return sd_bus_call(bus, m, 0, error, NULL);
+}
+
 static int daemon_reload(sd_bus *bus, char **args) {
         _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
-        _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
         const char *method;
         int r;
 
@@ -4778,24 +4843,21 @@ static int daemon_reload(sd_bus *bus, char **args) {
                         streq(args[0], "reboot")        ? "Reboot" :
                         streq(args[0], "kexec")         ? "KExec" :
                         streq(args[0], "exit")          ? "Exit" :
+                        arg_incremental                 ? "ReloadIncremental" :
                                     /* "daemon-reload" */ "Reload";
         }
 
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &m,
-                        "org.freedesktop.systemd1",
-                        "/org/freedesktop/systemd1",
-                        "org.freedesktop.systemd1.Manager",
-                        method);
-        if (r < 0)
-                return bus_log_create_error(r);
+        r = call_manager(bus, method, &error);
+        if (r < 0 && streq(method, "ReloadIncremental") &&
+            sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD)) {
+                /* Older managers only know how to reload fully */
+                log_debug("Manager does not support incremental reloading, reloading fully.");
 
-        r = sd_bus_message_set_allow_interactive_authorization(m, arg_ask_password);
-        if (r < 0)
-                return bus_log_create_error(r);
+                sd_bus_error_free(&error);
+                method = "Reload";
+                r = call_manager(bus, method, &error);
+        }
 
-        r = sd_bus_call(bus, m, 0, &error, NULL);
         if (r == -ENOENT && arg_action != ACTION_SYSTEMCTL)
                 /* There's always a fallback possible for
                  * legacy actions. */
@@ -5691,7 +5753,8 @@ static void systemctl_help(void) {
                "  -n --lines=INTEGER  Number of journal entries to show\n"
                "  -o --output=STRING  Change journal output mode (short, short-monotonic,\n"
                "                      verbose, export, json, json-pretty, json-sse, cat)\n"
-               "     --plain          Print unit dependencies as a list instead of a tree\n\n"
+               "     --plain          Print unit dependencies as a list instead of a tree\n"
+               "     --incremental    With daemon-reload, only reload changed unit files\n\n"
                "Unit Commands:\n"
                "  list-units [PATTERN...]         List loaded units\n"
                "  list-sockets [PATTERN...]       List loaded sockets ordered by address\n"
@@ -5869,6 +5932,7 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                 ARG_STATE,
                 ARG_JOB_MODE,
                 ARG_PRESET_MODE,
+                ARG_INCREMENTAL,
         };
 
         static const struct option options[] = {
@@ -5911,6 +5975,7 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                 { "state",               required_argument, NULL, ARG_STATE               },
                 { "recursive",           no_argument,       NULL, 'r'                     },
                 { "preset-mode",         required_argument, NULL, ARG_PRESET_MODE         },
+                { "incremental",         no_argument,       NULL, ARG_INCREMENTAL         },
                 {}
         };
 
@@ -6151,6 +6216,10 @@ static int systemctl_parse_argv(int argc, char *argv[]) {
                         arg_plain = true;
                         break;
 
+                case ARG_INCREMENTAL:
+                        arg_incremental = true;
+                        break;
+
                 case ARG_STATE: {
                         const char *word, *state;
                         size_t size;
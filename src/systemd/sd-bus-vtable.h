@@ -47,6 +47,7 @@ enum {
         SD_BUS_VTABLE_PROPERTY_CONST               = 1ULL << 4,
         SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE        = 1ULL << 5,
         SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION  = 1ULL << 6,
+        SD_BUS_VTABLE_PROPERTY_CACHE               = 1ULL << 7,
         _SD_BUS_VTABLE_CAPABILITY_MASK             = 0xFFFFULL << 40
 };
 
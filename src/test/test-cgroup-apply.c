@@ -0,0 +1,131 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "manager.h"
+#include "unit.h"
+#include "util.h"
+#include "fileio.h"
+#include "macro.h"
+
+static void check_attribute(const char *dir, const char *attribute, const char *value) {
+        _cleanup_free_ char *v = NULL;
+        char *p;
+
+        p = strappenda(dir, "/", attribute);
+        assert_se(read_one_line_file(p, &v) >= 0);
+        assert_se(streq(v, value));
+}
+
+static void apply(Unit *u, const char *dir) {
+
+        /* Let the cpu controller directory of the unit point to a
+         * plain directory with the attribute files. It is closed
+         * again once everything is applied. */
+        u->cgroup_fds[0] = open(dir, O_RDONLY|O_CLOEXEC|O_DIRECTORY);
+        assert_se(u->cgroup_fds[0] >= 0);
+
+        unit_apply_cgroup_attributes(u, CGROUP_CPU, MANAGER_RUNNING);
+        assert_se(u->cgroup_fds[0] < 0);
+}
+
+static int test_cgroup_apply(void) {
+        char dir[] = "/tmp/test-cgroup-apply.XXXXXX";
+        CGroupContext *c;
+        Manager *m = NULL;
+        uint64_t n;
+        Unit *son;
+        int r;
+
+        assert_se(set_unit_path(TEST_DIR) >= 0);
+        r = manager_new(SYSTEMD_USER, true, &m);
+        if (r == -EPERM || r == -EACCES) {
+                puts("manager_new: Permission denied. Skipping test.");
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        assert_se(manager_load_unit(m, "son.service", NULL, NULL, &son) >= 0);
+        c = unit_get_cgroup_context(son);
+        assert_se(c);
+
+        assert_se(mkdtemp(dir));
+        assert_se(write_string_file(strappenda(dir, "/cpu.shares"), "1024") >= 0);
+        assert_se(write_string_file(strappenda(dir, "/cpu.cfs_period_us"), "100000") >= 0);
+        assert_se(write_string_file(strappenda(dir, "/cpu.cfs_quota_us"), "-1") >= 0);
+
+        son->cgroup_path = strdup("/test-cgroup-apply.service");
+        assert_se(son->cgroup_path);
+
+        /* All attributes are written the first time */
+        n = m->n_cgroup_attribute_writes;
+        apply(son, dir);
+        assert_se(m->n_cgroup_attribute_writes == n + 3);
+        check_attribute(dir, "cpu.shares", "100");
+
+        /* Nothing changed, so nothing is written */
+        apply(son, dir);
+        assert_se(m->n_cgroup_attribute_writes == n + 3);
+        assert_se(m->n_cgroup_attribute_writes_skipped == 3);
+
+        /* Only what changed is written */
+        c->cpu_shares = 200;
+        apply(son, dir);
+        assert_se(m->n_cgroup_attribute_writes == n + 4);
+        check_attribute(dir, "cpu.shares", "200");
+
+        /* Releasing another controller leaves the cache alone */
+        unit_release_cgroup_attributes(son, CGROUP_CPU);
+        apply(son, dir);
+        assert_se(m->n_cgroup_attribute_writes == n + 4);
+
+        /* Releasing it makes us forget everything, hence
+         * everything is written again */
+        unit_release_cgroup_attributes(son, 0);
+        assert_se(!son->cgroup_attributes);
+        apply(son, dir);
+        assert_se(m->n_cgroup_attribute_writes == n + 7);
+
+        /* A directory that went away is not used anymore */
+        unit_release_cgroup_attributes(son, 0);
+        son->cgroup_fds[0] = open(dir, O_RDONLY|O_CLOEXEC|O_DIRECTORY);
+        assert_se(son->cgroup_fds[0] >= 0);
+        rm_rf_dangerous(dir, false, true, false);
+        unit_apply_cgroup_attributes(son, CGROUP_CPU, MANAGER_RUNNING);
+        assert_se(son->cgroup_fds[0] < 0);
+        assert_se(!son->cgroup_attributes);
+
+        free(son->cgroup_path);
+        son->cgroup_path = NULL;
+
+        manager_free(m);
+
+        return 0;
+}
+
+int main(int argc, char* argv[]) {
+        return test_cgroup_apply();
+}
@@ -0,0 +1,77 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "manager.h"
+#include "unit.h"
+#include "util.h"
+#include "macro.h"
+
+static int test_cgroup_empty_queue(void) {
+        Manager *m = NULL;
+        Unit *son, *daughter;
+        int r;
+
+        assert_se(set_unit_path(TEST_DIR) >= 0);
+        r = manager_new(SYSTEMD_USER, true, &m);
+        if (r == -EPERM || r == -EACCES) {
+                puts("manager_new: Permission denied. Skipping test.");
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        assert_se(manager_load_unit(m, "son.service", NULL, NULL, &son) >= 0);
+        assert_se(manager_load_unit(m, "daughter.service", NULL, NULL, &daughter) >= 0);
+
+        /* A cgroup that does not exist, and hence is empty */
+        son->cgroup_path = strdup("/test-cgroup-empty/son.service");
+        assert_se(son->cgroup_path);
+        assert_se(hashmap_put(m->cgroup_unit, son->cgroup_path, son) == 1);
+
+        /* Notifications are queued, and only once per unit, no
+         * matter which of its subgroups they are about */
+        assert_se(manager_notify_cgroup_empty(m, "/test-cgroup-empty/son.service") >= 0);
+        assert_se(manager_notify_cgroup_empty(m, "/test-cgroup-empty/son.service/foo") >= 0);
+        assert_se(manager_notify_cgroup_empty(m, "/test-cgroup-empty/unknown.service") >= 0);
+        assert_se(son->in_cgroup_empty_queue);
+        assert_se(!daughter->in_cgroup_empty_queue);
+        assert_se(m->cgroup_empty_queue == son);
+        assert_se(!son->cgroup_empty_queue_next);
+
+        /* And handled in one go */
+        assert_se(manager_dispatch_cgroup_empty_queue(m) == 1);
+        assert_se(!son->in_cgroup_empty_queue);
+        assert_se(!m->cgroup_empty_queue);
+
+        assert_se(manager_dispatch_cgroup_empty_queue(m) == 0);
+
+        manager_free(m);
+
+        return 0;
+}
+
+int main(int argc, char* argv[]) {
+        return test_cgroup_empty_queue();
+}
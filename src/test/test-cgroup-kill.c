@@ -0,0 +1,114 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "cgroup-util.h"
+#include "util.h"
+#include "log.h"
+
+#define N_SUBGROUPS 10U
+
+/* Spawns a number of processes, given as argument, spread over a
+ * few subgroups of a test cgroup, then moves them over to another
+ * cgroup and kills them, and reports how long that took. Needs to
+ * be run as root. */
+
+static void spawn(const char *path, unsigned n) {
+        unsigned i;
+
+        assert_se(cg_create_and_attach(SYSTEMD_CGROUP_CONTROLLER, path, 0) >= 0);
+
+        for (i = 0; i < n; i++) {
+                pid_t pid;
+
+                pid = fork();
+                assert_se(pid >= 0);
+
+                if (pid == 0) {
+                        pause();
+                        _exit(EXIT_SUCCESS);
+                }
+        }
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_free_ char *self = NULL;
+        char path[sizeof("/test-cgroup-kill/sub-") + DECIMAL_STR_MAX(unsigned)];
+        unsigned n = 5000, i, killed = 0;
+        usec_t ts;
+        pid_t pid;
+        int status, r;
+
+        log_set_max_level(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &n) >= 0);
+
+        r = cg_pid_get_path(SYSTEMD_CGROUP_CONTROLLER, 0, &self);
+        if (r < 0) {
+                log_error("Failed to determine our cgroup: %s", strerror(-r));
+                return EXIT_TEST_SKIP;
+        }
+
+        r = cg_create(SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill");
+        if (r < 0) {
+                log_error("Failed to create test cgroup: %s", strerror(-r));
+                return EXIT_TEST_SKIP;
+        }
+
+        for (i = 0; i < N_SUBGROUPS; i++) {
+                sprintf(path, "/test-cgroup-kill/sub-%u", i);
+                spawn(path, n / N_SUBGROUPS);
+        }
+
+        assert_se(cg_attach(SYSTEMD_CGROUP_CONTROLLER, self, 0) >= 0);
+        assert_se(cg_create(SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill-to") >= 0);
+
+        log_info("Spawned %u processes.", n / N_SUBGROUPS * N_SUBGROUPS);
+
+        ts = now(CLOCK_MONOTONIC);
+        assert_se(cg_migrate_recursive(SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill",
+                                       SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill-to", true, true) > 0);
+        log_info("Migrated in %.1f ms.", (double) (now(CLOCK_MONOTONIC) - ts) / USEC_PER_MSEC);
+
+        assert_se(cg_is_empty_recursive(SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill", true) > 0);
+
+        ts = now(CLOCK_MONOTONIC);
+        assert_se(cg_kill_recursive(SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill-to", SIGKILL, false, true, false, NULL) > 0);
+        log_info("Killed in %.1f ms.", (double) (now(CLOCK_MONOTONIC) - ts) / USEC_PER_MSEC);
+
+        while ((pid = wait(&status)) > 0) {
+                assert_se(WIFSIGNALED(status));
+                assert_se(WTERMSIG(status) == SIGKILL);
+                killed++;
+        }
+
+        assert_se(killed == n / N_SUBGROUPS * N_SUBGROUPS);
+
+        cg_trim(SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill", true);
+        cg_trim(SYSTEMD_CGROUP_CONTROLLER, "/test-cgroup-kill-to", true);
+
+        return 0;
+}
@@ -20,8 +20,10 @@
 ***/
 
 #include <assert.h>
+#include <fcntl.h>
 
 #include "util.h"
+#include "fileio.h"
 #include "cgroup-util.h"
 #include "test-helper.h"
 
@@ -247,6 +249,51 @@ static void test_shift_path(void) {
         test_shift_path_one("/foobar/waldo", "/fuckfuck", "/foobar/waldo");
 }
 
+static void test_read_pids_at(void) {
+        char dir[] = "/tmp/test-cgroup-util.XXXXXX";
+        _cleanup_close_ int dfd = -1;
+        _cleanup_free_ pid_t *pids = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        size_t allocated = 0, n, i;
+        char *p;
+
+        assert_se(mkdtemp(dir));
+        dfd = open(dir, O_RDONLY|O_CLOEXEC|O_DIRECTORY);
+        assert_se(dfd >= 0);
+
+        p = strappenda(dir, "/cgroup.procs");
+
+        /* Unsorted, with duplicates */
+        assert_se(write_string_file(p, "5\n3\n5\n1") >= 0);
+        assert_se(cg_read_pids_at(dfd, &pids, &allocated, &n) >= 0);
+        assert_se(n == 3);
+        assert_se(pids[0] == 1 && pids[1] == 3 && pids[2] == 5);
+
+        /* More than fits in one read */
+        f = fopen(p, "we");
+        assert_se(f);
+        for (i = 100000; i > 0; i--)
+                fprintf(f, "%zu\n", i);
+        fflush(f);
+
+        assert_se(cg_read_pids_at(dfd, &pids, &allocated, &n) >= 0);
+        assert_se(n == 100000);
+        for (i = 0; i < n; i++)
+                assert_se(pids[i] == (pid_t) i + 1);
+
+        assert_se(write_string_file(p, "1\nfoo\n") >= 0);
+        assert_se(cg_read_pids_at(dfd, &pids, &allocated, &n) == -EIO);
+
+        assert_se(write_string_file(p, "0\n") >= 0);
+        assert_se(cg_read_pids_at(dfd, &pids, &allocated, &n) == -EIO);
+
+        assert_se(write_string_file(p, "") >= 0);
+        assert_se(cg_read_pids_at(dfd, &pids, &allocated, &n) >= 0);
+        assert_se(n == 0);
+
+        rm_rf_dangerous(dir, false, true, false);
+}
+
 int main(void) {
         test_path_decode_unit();
         test_path_get_unit();
@@ -259,6 +306,7 @@ int main(void) {
         test_controller_is_valid();
         test_slice_to_path();
         test_shift_path();
+        test_read_pids_at();
 
         return 0;
 }
@@ -0,0 +1,116 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+
+#include "conf-cache.h"
+#include "conf-parser.h"
+#include "fileio.h"
+#include "macro.h"
+#include "util.h"
+
+static char *foo = NULL, *bar = NULL;
+
+static const ConfigTableItem items[] = {
+        { "Section", "Foo", config_parse_string, 0, &foo },
+        { "Section", "Bar", config_parse_string, 0, &bar },
+        {}
+};
+
+static void parse(ConfCache *c, const char *path) {
+        free(foo);
+        free(bar);
+        foo = bar = NULL;
+
+        assert_se(config_parse_cached(c, NULL, path, NULL, "Section\0",
+                                      config_item_table_lookup, items,
+                                      false, false, true, NULL) == 0);
+}
+
+static void test_conf_cache(void) {
+        char dir[] = "/tmp/test-conf-cache.XXXXXX";
+        _cleanup_free_ char *conf = NULL, *cache = NULL;
+        _cleanup_conf_cache_free_ ConfCache *c = NULL, *d = NULL;
+
+        assert_se(mkdtemp(dir));
+        conf = strappend(dir, "/test.conf");
+        cache = strappend(dir, "/cache");
+        assert_se(conf && cache);
+
+        assert_se(write_string_file(conf,
+                                    "# comment\n"
+                                    "[Section]\n"
+                                    "Foo=a \\\n"
+                                    "    b\n"
+                                    "\n"
+                                    "Bar=c\n") == 0);
+
+        c = conf_cache_new();
+        assert_se(c);
+
+        parse(c, conf);
+        assert_se(streq(foo, "a      b"));
+        assert_se(streq(bar, "c"));
+        assert_se(c->n_hits == 0 && c->n_misses == 1);
+
+        parse(c, conf);
+        assert_se(streq(foo, "a      b"));
+        assert_se(streq(bar, "c"));
+        assert_se(c->n_hits == 1 && c->n_misses == 1);
+
+        assert_se(conf_cache_save(c, cache) == 0);
+
+        d = conf_cache_new();
+        assert_se(d);
+        assert_se(conf_cache_load(d, cache) == 0);
+        assert_se(hashmap_size(d->entries) == 1);
+
+        parse(d, conf);
+        assert_se(streq(foo, "a      b"));
+        assert_se(streq(bar, "c"));
+        assert_se(d->n_hits == 1 && d->n_misses == 0);
+
+        /* Changing the file must invalidate the entry */
+        assert_se(write_string_file(conf, "[Section]\nFoo=x\n") == 0);
+        parse(d, conf);
+        assert_se(streq(foo, "x"));
+        assert_se(!bar);
+        assert_se(d->n_hits == 1 && d->n_misses == 1);
+
+        /* Entries that are not used survive one gc run only */
+        conf_cache_gc(c);
+        assert_se(hashmap_size(c->entries) == 1);
+        conf_cache_gc(c);
+        assert_se(hashmap_size(c->entries) == 0);
+
+        free(foo);
+        free(bar);
+
+        rm_rf_dangerous(dir, false, true, false);
+}
+
+int main(int argc, char *argv[]) {
+        log_set_max_level(LOG_DEBUG);
+
+        test_conf_cache();
+
+        return 0;
+}
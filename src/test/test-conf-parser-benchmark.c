@@ -0,0 +1,152 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "conf-parser.h"
+#include "mkdir.h"
+#include "strv.h"
+#include "util.h"
+
+#define N_SYNTHETIC 20000U
+
+static unsigned n_assignments = 0;
+
+static int count(const char *unit, const char *filename, unsigned line, const char *section, unsigned section_line,
+                 const char *lvalue, int ltype, const char *rvalue, void *data, void *userdata) {
+        n_assignments++;
+        return 0;
+}
+
+static const ConfigPerfItem any_item = { "", count, 0, 0 };
+
+/* Stands in for the unit file gperf lookup function, accepting
+ * everything, so that only the parser itself is measured */
+static const ConfigPerfItem* lookup_any(const char *key, unsigned length) {
+        return &any_item;
+}
+
+static char **list_files(const char *dir) {
+        _cleanup_closedir_ DIR *d = NULL;
+        char **l = NULL;
+        struct dirent *de;
+
+        d = opendir(dir);
+        assert_se(d);
+
+        FOREACH_DIRENT(de, d, assert_not_reached("readdir")) {
+                dirent_ensure_type(d, de);
+
+                /* The m4 sources of units are not valid yet */
+                if (de->d_type == DT_REG && !strstr(de->d_name, ".m4"))
+                        assert_se(strv_consume(&l, strjoin(dir, "/", de->d_name, NULL)) >= 0);
+        }
+
+        return l;
+}
+
+static void benchmark(const char *name, char **files, unsigned iterations) {
+        unsigned i, n = 0;
+        char **f;
+        usec_t t;
+
+        n_assignments = 0;
+        t = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < iterations; i++)
+                STRV_FOREACH(f, files) {
+                        assert_se(config_parse(NULL, *f, NULL,
+                                               "Unit\0Service\0Socket\0Timer\0Path\0Mount\0Automount\0Swap\0Target\0Slice\0Scope\0Install\0",
+                                               config_item_perf_lookup, lookup_any,
+                                               true, false, true, NULL) >= 0);
+                        n++;
+                }
+
+        t = now(CLOCK_MONOTONIC) - t;
+
+        log_info("%s: %u files, %u assignments in %.1f ms, %.1f us per file",
+                 name, n, n_assignments, (double) t / USEC_PER_MSEC, (double) t / n);
+}
+
+static void write_synthetic(const char *dir, unsigned n) {
+        unsigned i;
+
+        for (i = 0; i < n; i++) {
+                _cleanup_fclose_ FILE *f = NULL;
+                char path[strlen(dir) + sizeof("/synthetic-.service") + DECIMAL_STR_MAX(unsigned)];
+
+                sprintf(path, "%s/synthetic-%u.service", dir, i);
+                f = fopen(path, "we");
+                assert_se(f);
+
+                fprintf(f,
+                        "#  This file is part of a synthetic unit tree.\n"
+                        "\n"
+                        "[Unit]\n"
+                        "Description=Synthetic Service %u\n"
+                        "Documentation=man:systemd.service(5)\n"
+                        "After=synthetic-%u.service network.target\n"
+                        "Wants=synthetic-%u.service\n"
+                        "\n"
+                        "[Service]\n"
+                        "Type=notify\n"
+                        "ExecStart=/usr/bin/synthetic --instance=%u \\\n"
+                        "          --verbose --config=/etc/synthetic/%u.conf\n"
+                        "ExecReload=/bin/kill -HUP $MAINPID\n"
+                        "Restart=on-failure\n"
+                        "Environment=FOO=%u BAR=baz\n"
+                        "PrivateTmp=yes\n"
+                        "\n"
+                        "[Install]\n"
+                        "WantedBy=multi-user.target\n",
+                        i, i / 2, i / 2, i, i, i);
+        }
+}
+
+int main(int argc, char *argv[]) {
+        char dir[] = "/tmp/test-conf-parser-benchmark.XXXXXX";
+        _cleanup_strv_free_ char **units = NULL, **synthetic = NULL;
+        const char *units_dir;
+
+        log_set_max_level(LOG_INFO);
+
+        units_dir = argc > 1 ? argv[1] : UNITS_DIR;
+
+        units = list_files(units_dir);
+        assert_se(units);
+        benchmark(units_dir, units, 100);
+
+        assert_se(mkdtemp(dir));
+        write_synthetic(dir, N_SYNTHETIC);
+
+        synthetic = list_files(dir);
+        assert_se(synthetic);
+        benchmark("synthetic", synthetic, 1);
+
+        /* Once more, with the page cache populated */
+        benchmark("synthetic", synthetic, 1);
+
+        rm_rf_dangerous(dir, false, true, false);
+
+        return 0;
+}
@@ -0,0 +1,156 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "conf-parser.h"
+#include "fileio.h"
+#include "macro.h"
+#include "util.h"
+
+typedef struct Settings {
+        char *foo;
+        char *bar;
+        char *baz;
+        char *long_name;
+        unsigned line;
+} Settings;
+
+static int parse_string_line(const char *unit, const char *filename, unsigned line, const char *section, unsigned section_line,
+                             const char *lvalue, int ltype, const char *rvalue, void *data, void *userdata) {
+        Settings *s = userdata;
+
+        s->line = line;
+        return config_parse_string(unit, filename, line, section, section_line, lvalue, ltype, rvalue, data, userdata);
+}
+
+#define LONG_NAME "ThisIsAVeryLongVariableNameThatDoesNotFitIntoTheBufferTheKeyIsUsuallyBuiltIn" \
+        "ThisIsAVeryLongVariableNameThatDoesNotFitIntoTheBufferTheKeyIsUsuallyBuiltIn" \
+        "ThisIsAVeryLongVariableNameThatDoesNotFitIntoTheBufferTheKeyIsUsuallyBuiltIn" \
+        "ThisIsAVeryLongVariableNameThatDoesNotFitIntoTheBufferTheKeyIsUsuallyBuiltIn"
+
+static const ConfigPerfItem perf_items[] = {
+        { "Section.Foo", parse_string_line, 0, offsetof(Settings, foo) },
+        { "Section.Bar", parse_string_line, 0, offsetof(Settings, bar) },
+        { "Section.Baz", parse_string_line, 0, offsetof(Settings, baz) },
+        { "Section." LONG_NAME, parse_string_line, 0, offsetof(Settings, long_name) },
+};
+
+/* Stands in for a gperf generated lookup function */
+static const ConfigPerfItem* perf_lookup(const char *key, unsigned length) {
+        unsigned i;
+
+        assert_se(strlen(key) == length);
+
+        for (i = 0; i < ELEMENTSOF(perf_items); i++)
+                if (streq(perf_items[i].section_and_lvalue, key))
+                        return perf_items + i;
+
+        return NULL;
+}
+
+static void settings_done(Settings *s) {
+        free(s->foo);
+        free(s->bar);
+        free(s->baz);
+        free(s->long_name);
+        zero(*s);
+}
+
+static void parse(const char *path, const char *contents, Settings *s) {
+        _cleanup_fclose_ FILE *f = NULL;
+
+        settings_done(s);
+
+        /* Not write_string_file(), which adds a newline */
+        f = fopen(path, "we");
+        assert_se(f);
+        assert_se(fputs(contents, f) >= 0);
+        assert_se(fflush(f) == 0);
+
+        assert_se(config_parse(NULL, path, NULL, "Section\0",
+                               config_item_perf_lookup, perf_lookup,
+                               false, false, true, s) == 0);
+}
+
+static void test_config_parse(void) {
+        char dir[] = "/tmp/test-conf-parser.XXXXXX";
+        _cleanup_free_ char *path = NULL;
+        Settings s = {};
+
+        assert_se(mkdtemp(dir));
+        path = strappend(dir, "/test.conf");
+        assert_se(path);
+
+        /* Continuation lines, comments and empty lines */
+        parse(path,
+              "# comment\n"
+              "[Section]\n"
+              "Bar = d  \n"
+              "\n"
+              "; another comment\n"
+              "Foo=a \\\n"
+              "  b \\\n"
+              "c\n", &s);
+        assert_se(streq(s.foo, "a    b  c"));
+        assert_se(streq(s.bar, "d"));
+        assert_se(!s.baz);
+        assert_se(s.line == 6);
+
+        /* CRLF line endings, an escaped backslash at the end of a
+         * line, and no newline at the end of the file */
+        parse(path,
+              "[Section]\r\n"
+              "Foo=a\\\\\r\n"
+              "Bar=b\\\\\n"
+              "Baz=c", &s);
+        assert_se(streq(s.foo, "a\\\\"));
+        assert_se(streq(s.bar, "b\\\\"));
+        assert_se(streq(s.baz, "c"));
+
+        /* A continuation at the end of the file is dropped */
+        parse(path,
+              "[Section]\n"
+              "Foo=a\n"
+              "Bar=b\\", &s);
+        assert_se(streq(s.foo, "a"));
+        assert_se(!s.bar);
+
+        /* Keys that do not fit into the usual buffer */
+        parse(path,
+              "[Section]\n"
+              LONG_NAME "=long\n", &s);
+        assert_se(streq(s.long_name, "long"));
+
+        settings_done(&s);
+
+        rm_rf_dangerous(dir, false, true, false);
+}
+
+int main(int argc, char *argv[]) {
+        log_set_max_level(LOG_DEBUG);
+
+        test_config_parse();
+
+        return 0;
+}
@@ -0,0 +1,127 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+
+#include "manager.h"
+#include "bus-util.h"
+#include "util.h"
+
+#define N_UNITS 50000U
+#define N_PER_LINE 100U
+
+static void write_units(const char *dir) {
+        _cleanup_fclose_ FILE *target = NULL;
+        char path[PATH_MAX], *p;
+        unsigned i;
+
+        p = strappenda(dir, "/bench.target");
+        target = fopen(p, "we");
+        assert_se(target);
+
+        fputs("[Unit]\n"
+              "DefaultDependencies=no\n", target);
+
+        for (i = 0; i < N_UNITS; i++) {
+                _cleanup_fclose_ FILE *f = NULL;
+                char name[sizeof("bench-.service") + DECIMAL_STR_MAX(unsigned)];
+
+                sprintf(name, "bench-%u.service", i);
+
+                snprintf(path, sizeof(path), "%s/%s", dir, name);
+                f = fopen(path, "we");
+                assert_se(f);
+
+                /* Every unit pulls in and orders after its
+                 * predecessor, which yields a long chain for the
+                 * transaction to walk */
+                fputs("[Unit]\n"
+                      "DefaultDependencies=no\n", f);
+                if (i > 0)
+                        fprintf(f,
+                                "Wants=bench-%1$u.service\n"
+                                "After=bench-%1$u.service\n", i - 1);
+                fputs("[Service]\n"
+                      "ExecStart=/bin/true\n", f);
+
+                fprintf(target, "%s%s", i % N_PER_LINE == 0 ? "\nWants=" : " ", name);
+        }
+
+        fputc('\n', target);
+}
+
+/* Large pools are mmap()ed separately, count them too */
+static size_t allocated(const struct mallinfo *mi) {
+        return (size_t) mi->uordblks + (size_t) mi->hblkhd;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+        char dir[] = "/tmp/test-dependency-benchmark.XXXXXX";
+        struct mallinfo before, after;
+        Manager *m = NULL;
+        Unit *target;
+        Job *j;
+        usec_t n;
+        int r;
+
+        log_set_max_level(LOG_INFO);
+
+        assert_se(mkdtemp(dir));
+        write_units(dir);
+        assert_se(set_unit_path(dir) >= 0);
+
+        r = manager_new(SYSTEMD_USER, true, &m);
+        if (IN_SET(r, -EPERM, -EACCES, -EADDRINUSE, -EHOSTDOWN, -ENOENT)) {
+                printf("Skipping test: manager_new: %s", strerror(-r));
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        before = mallinfo();
+        n = now(CLOCK_MONOTONIC);
+        assert_se(manager_load_unit(m, "bench.target", NULL, NULL, &target) >= 0);
+        manager_dispatch_load_queue(m);
+        after = mallinfo();
+
+        log_info("Loaded %u units in %.1f ms, %.1f MiB allocated",
+                 hashmap_size(m->units),
+                 (double) (now(CLOCK_MONOTONIC) - n) / USEC_PER_MSEC,
+                 (double) (allocated(&after) - allocated(&before)) / 1024 / 1024);
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(manager_add_job(m, JOB_START, target, JOB_REPLACE, false, &error, &j) >= 0);
+
+        log_info("Built transaction with %u jobs in %.1f ms",
+                 hashmap_size(m->jobs),
+                 (double) (now(CLOCK_MONOTONIC) - n) / USEC_PER_MSEC);
+
+        manager_free(m);
+
+        rm_rf_dangerous(dir, false, true, false);
+
+        return 0;
+}
@@ -0,0 +1,207 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "execute-helper.h"
+#include "strv.h"
+#include "util.h"
+
+static int wait_for(pid_t pid) {
+        int status;
+
+        /* The processes are forked off with us as their parent */
+        assert_se(waitpid(pid, &status, 0) == pid);
+        assert_se(WIFEXITED(status));
+
+        return WEXITSTATUS(status);
+}
+
+static void test_spawn(ExecHelper *h) {
+        ExecCommand command = {
+                .path = (char*) "/bin/sh",
+                .argv = STRV_MAKE("/bin/sh", "-c",
+                                  "test \"$FOO\" = bar && test \"$BAZ\" = quux && "
+                                  "test \"$LISTEN_FDS\" = 1 && echo hello >&3 && exit 42"),
+        };
+        ExecContext context = {};
+        ExecParameters params = {
+                .environment = STRV_MAKE("BAZ=quux"),
+                .unit_id = "test.service",
+                .bus_endpoint_fd = -1,
+        };
+        int p[2];
+        char buf[7] = {};
+        pid_t pid;
+
+        exec_context_init(&context);
+        context.environment = STRV_MAKE("FOO=bar");
+
+        /* The write end of the pipe is passed on as socket
+         * activation fd */
+        assert_se(pipe2(p, O_CLOEXEC) >= 0);
+        params.fds = p + 1;
+        params.n_fds = 1;
+
+        assert_se(exec_helper_spawn(h, &command, &context, &params, NULL, command.argv, NULL, &pid) >= 0);
+        safe_close(p[1]);
+
+        assert_se(wait_for(pid) == 42);
+        assert_se(read(p[0], buf, sizeof(buf) - 1) == 6);
+        assert_se(streq(buf, "hello\n"));
+        safe_close(p[0]);
+
+        /* The same through the regular path */
+        params.fds = NULL;
+        params.n_fds = 0;
+        command.argv = STRV_MAKE("/bin/sh", "-c", "test \"$FOO\" = bar && exit 7");
+        params.exec_helper = h;
+
+        assert_se(exec_spawn(&command, &context, &params, NULL, &pid) >= 0);
+        assert_se(wait_for(pid) == 7);
+}
+
+static void test_context(ExecHelper *h) {
+        ExecCommand command = {
+                .path = (char*) "/bin/sh",
+                .argv = STRV_MAKE("/bin/sh", "-c",
+                                  "test \"$(pwd)\" = / && test \"$(umask)\" = 0077 && "
+                                  "test \"$(ulimit -n)\" = 123 && exit 3"),
+        };
+        ExecContext context = {};
+        ExecParameters params = {
+                .apply_permissions = true,
+                .bus_endpoint_fd = -1,
+        };
+        struct rlimit nofile = { 123, 123 };
+        pid_t pid;
+
+        /* Settings of the various types make it through */
+        exec_context_init(&context);
+        context.working_directory = (char*) "/";
+        context.umask = 0077;
+        context.rlimit[RLIMIT_NOFILE] = &nofile;
+
+        assert_se(exec_helper_spawn(h, &command, &context, &params, NULL, command.argv, NULL, &pid) >= 0);
+        assert_se(wait_for(pid) == 3);
+}
+
+static void test_unsupported(ExecHelper *h) {
+        ExecCommand command = {
+                .path = (char*) "/bin/true",
+                .argv = STRV_MAKE("/bin/true"),
+        };
+        ExecContext context = {};
+        ExecParameters params = {
+                .confirm_spawn = true,
+                .bus_endpoint_fd = -1,
+        };
+        pid_t pid;
+
+        exec_context_init(&context);
+
+        assert_se(exec_helper_spawn(h, &command, &context, &params, NULL, command.argv, NULL, &pid) == -EOPNOTSUPP);
+}
+
+static void test_dead_helper(ExecHelper *h) {
+        ExecCommand command = {
+                .path = (char*) "/bin/true",
+                .argv = STRV_MAKE("/bin/true"),
+        };
+        ExecContext context = {};
+        ExecParameters params = {
+                .bus_endpoint_fd = -1,
+        };
+        int status;
+        pid_t pid;
+
+        exec_context_init(&context);
+
+        assert_se(kill(h->pid, SIGKILL) >= 0);
+        assert_se(waitpid(h->pid, &status, 0) == h->pid);
+
+        /* The request cannot be sent, hence we may fork ourselves,
+         * and the helper is not asked anymore */
+        assert_se(exec_helper_spawn(h, &command, &context, &params, NULL, command.argv, NULL, &pid) == -EOPNOTSUPP);
+        assert_se(h->fd < 0);
+        assert_se(exec_helper_spawn(h, &command, &context, &params, NULL, command.argv, NULL, &pid) == -EOPNOTSUPP);
+}
+
+static void test_hung_helper(void) {
+        ExecCommand command = {
+                .path = (char*) "/bin/true",
+                .argv = STRV_MAKE("/bin/true"),
+        };
+        ExecContext context = {};
+        ExecParameters params = {
+                .bus_endpoint_fd = -1,
+        };
+        ExecHelper *h;
+        int status;
+        pid_t pid;
+
+        exec_context_init(&context);
+
+        assert_se(exec_helper_new(&h) >= 0);
+        h->timeout = 100 * USEC_PER_MSEC;
+
+        /* A stopped helper is killed after the timeout, and since
+         * it never got to the request we may fork ourselves */
+        assert_se(kill(h->pid, SIGSTOP) >= 0);
+        assert_se(exec_helper_spawn(h, &command, &context, &params, NULL, command.argv, NULL, &pid) == -EOPNOTSUPP);
+        assert_se(h->fd < 0);
+
+        assert_se(waitpid(h->pid, &status, 0) == h->pid);
+        assert_se(WIFSIGNALED(status));
+        assert_se(WTERMSIG(status) == SIGKILL);
+
+        exec_helper_free(h);
+}
+
+int main(int argc, char *argv[]) {
+        ExecHelper *h;
+        int r;
+
+        log_parse_environment();
+        log_open();
+
+        r = exec_helper_new(&h);
+        if (r < 0) {
+                log_error("Failed to fork off exec helper: %s", strerror(-r));
+                return EXIT_TEST_SKIP;
+        }
+
+        test_spawn(h);
+        test_context(h);
+        test_unsupported(h);
+        test_dead_helper(h);
+
+        exec_helper_free(h);
+
+        test_hung_helper();
+
+        return 0;
+}
@@ -0,0 +1,151 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "fileio.h"
+#include "mkdir.h"
+#include "path-util.h"
+#include "install.h"
+
+static void write_unit(const char *root, const char *dir, const char *name, const char *contents) {
+        char *p;
+
+        p = strappenda(root, dir, "/", name);
+        assert_se(mkdir_parents(p, 0755) >= 0);
+        assert_se(write_string_file(p, contents) >= 0);
+}
+
+static void link_unit(const char *root, const char *dir, const char *name, const char *target) {
+        char *p;
+
+        p = strappenda(root, dir, "/", name);
+        assert_se(mkdir_parents(p, 0755) >= 0);
+        assert_se(symlink(target, p) >= 0);
+}
+
+static void test_states(const char *root) {
+        Hashmap *h;
+        UnitFileList *p;
+        Iterator i;
+        unsigned n = 0;
+
+        h = hashmap_new(&string_hash_ops);
+        assert_se(h);
+
+        assert_se(unit_file_get_list(UNIT_FILE_SYSTEM, root, h) >= 0);
+
+        /* The listing and the individual lookups agree */
+        HASHMAP_FOREACH(p, h, i) {
+                log_debug("%s (%s)", p->path, unit_file_state_to_string(p->state));
+
+                assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, basename(p->path)) == p->state);
+                n++;
+        }
+
+        assert_se(n == 8);
+
+        unit_file_list_free(h);
+
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "enabled.service") == UNIT_FILE_ENABLED);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "runtime.service") == UNIT_FILE_ENABLED_RUNTIME);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "disabled.service") == UNIT_FILE_DISABLED);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "static.service") == UNIT_FILE_STATIC);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "masked.service") == UNIT_FILE_MASKED);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "linked.service") == UNIT_FILE_LINKED);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "alias.service") == UNIT_FILE_ENABLED);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "aliased.service") == UNIT_FILE_ENABLED);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "missing.service") == -ENOENT);
+}
+
+static void test_presets(const char *root) {
+        UnitFileChange *changes = NULL;
+        unsigned n_changes = 0;
+
+        /* The first matching rule wins, regardless whether it is a
+         * glob or not */
+        write_unit(root, "/etc/systemd/system-preset", "00-test.preset",
+                   "disable enabled.service\n"
+                   "enable d*.service\n");
+        write_unit(root, "/usr/lib/systemd/system-preset", "90-test.preset",
+                   "# comment\n"
+                   "enable enabled.service\n"
+                   "disable dummy.service\n"
+                   "disable *\n"
+                   "enable static.service\n");
+
+        assert_se(unit_file_query_preset(UNIT_FILE_SYSTEM, root, "enabled.service") == 0);
+        assert_se(unit_file_query_preset(UNIT_FILE_SYSTEM, root, "disabled.service") == 1);
+        assert_se(unit_file_query_preset(UNIT_FILE_SYSTEM, root, "dummy.service") == 1);
+        assert_se(unit_file_query_preset(UNIT_FILE_SYSTEM, root, "static.service") == 0);
+        assert_se(unit_file_query_preset(UNIT_FILE_SYSTEM, root, "other.service") == 0);
+
+        assert_se(unit_file_preset_all(UNIT_FILE_SYSTEM, false, root, UNIT_FILE_PRESET_FULL, false, &changes, &n_changes) >= 0);
+        unit_file_changes_free(changes, n_changes);
+
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "enabled.service") == UNIT_FILE_DISABLED);
+        assert_se(unit_file_get_state(UNIT_FILE_SYSTEM, root, "disabled.service") == UNIT_FILE_ENABLED);
+}
+
+int main(int argc, char *argv[]) {
+        char root[] = "/tmp/test-install-root.XXXXXX";
+        const char *install = "[Install]\nWantedBy=multi-user.target\n";
+        char *p;
+
+        log_parse_environment();
+        log_open();
+
+        assert_se(mkdtemp(root));
+
+        assert_se(mkdir_p(strappenda(root, "/run/systemd/system"), 0755) >= 0);
+
+        write_unit(root, "/usr/lib/systemd/system", "enabled.service", install);
+        link_unit(root, "/etc/systemd/system/multi-user.target.wants", "enabled.service",
+                  "/usr/lib/systemd/system/enabled.service");
+
+        write_unit(root, "/usr/lib/systemd/system", "runtime.service", install);
+        link_unit(root, "/run/systemd/system/multi-user.target.wants", "runtime.service",
+                  "/usr/lib/systemd/system/runtime.service");
+
+        write_unit(root, "/usr/lib/systemd/system", "disabled.service", install);
+        write_unit(root, "/usr/lib/systemd/system", "static.service", "[Service]\nExecStart=/bin/true\n");
+
+        write_unit(root, "/usr/lib/systemd/system", "masked.service", install);
+        link_unit(root, "/etc/systemd/system", "masked.service", "/dev/null");
+
+        /* Linked in from outside of the search path */
+        write_unit(root, "/opt", "linked.service", install);
+        p = strappenda(root, "/opt/linked.service");
+        link_unit(root, "/etc/systemd/system", "linked.service", p);
+
+        write_unit(root, "/usr/lib/systemd/system", "aliased.service", "[Install]\nAlias=alias.service\n");
+        link_unit(root, "/etc/systemd/system", "alias.service", "/usr/lib/systemd/system/aliased.service");
+
+        test_states(root);
+        test_presets(root);
+
+        rm_rf_dangerous(root, false, true, false);
+
+        return 0;
+}
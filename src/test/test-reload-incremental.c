@@ -0,0 +1,177 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "manager.h"
+#include "fileio.h"
+#include "util.h"
+
+static void write_unit(const char *dir, const char *name, const char *contents) {
+        _cleanup_free_ char *p = NULL;
+
+        p = strjoin(dir, "/", name, NULL);
+        assert_se(p);
+        assert_se(write_string_file(p, contents) == 0);
+}
+
+static bool has_dependency(Unit *u, UnitDependency d, Unit *other) {
+        return !!unit_has_dependency(u, d, other);
+}
+
+int main(int argc, char *argv[]) {
+        char dir[] = "/tmp/test-reload-incremental.XXXXXX";
+        Manager *m = NULL;
+        Unit *a, *b, *c, *d;
+        const char *p;
+        usec_t ts;
+        int r;
+
+        log_set_max_level(LOG_DEBUG);
+
+        assert_se(mkdtemp(dir));
+
+        write_unit(dir, "a.service",
+                   "[Unit]\n"
+                   "Description=A\n"
+                   "Wants=b.service\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(dir, "b.service",
+                   "[Unit]\n"
+                   "Description=B\n"
+                   "After=a.service\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(dir, "c.service",
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(dir, "d.service",
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+
+        assert_se(set_unit_path(dir) >= 0);
+        r = manager_new(SYSTEMD_USER, true, &m);
+        if (IN_SET(r, -EPERM, -EACCES, -EADDRINUSE, -EHOSTDOWN, -ENOENT)) {
+                printf("Skipping test: manager_new: %s", strerror(-r));
+                rm_rf_dangerous(dir, false, true, false);
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        assert_se(manager_load_unit(m, "a.service", NULL, NULL, &a) >= 0);
+        assert_se(manager_load_unit(m, "c.service", NULL, NULL, &c) >= 0);
+        b = manager_get_unit(m, "b.service");
+        assert_se(b);
+        assert_se(has_dependency(a, UNIT_WANTS, b));
+        assert_se(has_dependency(a, UNIT_BEFORE, b));
+
+        /* Nothing changed, nothing is reloaded */
+        ts = a->load_timestamp;
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(manager_get_unit(m, "a.service") == a);
+        assert_se(a->load_timestamp == ts);
+
+        /* Comments do not count */
+        ts = b->load_timestamp;
+        write_unit(dir, "b.service",
+                   "# a comment\n"
+                   "[Unit]\n"
+                   "Description=B\n"
+                   "After=a.service\n"
+                   "\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        assert_se(manager_reload_incremental(m) >= 0);
+        assert_se(manager_get_unit(m, "b.service") == b);
+        assert_se(b->load_timestamp == ts);
+
+        /* A changed unit is replaced, and keeps its runtime state
+         * and the dependencies others have on it. Units that did
+         * not change are left alone. */
+        dual_timestamp_get(&a->condition_timestamp);
+        ts = a->condition_timestamp.monotonic;
+        c->cgroup_realized = true;
+        write_unit(dir, "a.service",
+                   "[Unit]\n"
+                   "Description=A2\n"
+                   "Wants=b.service\n"
+                   "After=c.service\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        assert_se(manager_reload_incremental(m) >= 0);
+        a = manager_get_unit(m, "a.service");
+        assert_se(a);
+        assert_se(streq(a->description, "A2"));
+        assert_se(a->condition_timestamp.monotonic == ts);
+        assert_se(c->cgroup_realized);
+        c->cgroup_realized = false;
+        assert_se(manager_get_unit(m, "b.service") == b);
+        assert_se(manager_get_unit(m, "c.service") == c);
+        assert_se(has_dependency(a, UNIT_WANTS, b));
+        assert_se(has_dependency(b, UNIT_WANTED_BY, a));
+        assert_se(has_dependency(b, UNIT_AFTER, a));
+        assert_se(has_dependency(a, UNIT_BEFORE, b));
+        assert_se(has_dependency(a, UNIT_AFTER, c));
+        assert_se(has_dependency(c, UNIT_BEFORE, a));
+
+        /* Dropping a dependency needs a full reload, which must
+         * get rid of it */
+        write_unit(dir, "a.service",
+                   "[Unit]\n"
+                   "Description=A3\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        assert_se(manager_reload_incremental(m) >= 0);
+        a = manager_get_unit(m, "a.service");
+        b = manager_get_unit(m, "b.service");
+        assert_se(a && b);
+        assert_se(streq(a->description, "A3"));
+        assert_se(!has_dependency(a, UNIT_WANTS, b));
+        assert_se(!has_dependency(b, UNIT_WANTED_BY, a));
+        assert_se(has_dependency(b, UNIT_AFTER, a));
+
+        /* A unit turning into an alias of another changed one needs
+         * a full reload too, which merges the two */
+        assert_se(manager_load_unit(m, "d.service", NULL, NULL, &d) >= 0);
+        write_unit(dir, "c.service",
+                   "[Unit]\n"
+                   "Description=C2\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        p = strappenda(dir, "/d.service");
+        assert_se(unlink(p) >= 0);
+        assert_se(symlink("c.service", p) >= 0);
+        assert_se(manager_reload_incremental(m) >= 0);
+        c = manager_get_unit(m, "c.service");
+        assert_se(c);
+        assert_se(streq(c->description, "C2"));
+        assert_se(manager_get_unit(m, "d.service") == c);
+
+        manager_free(m);
+        rm_rf_dangerous(dir, false, true, false);
+
+        return 0;
+}
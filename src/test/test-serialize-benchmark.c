@@ -0,0 +1,101 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "manager.h"
+#include "serialize.h"
+#include "fdset.h"
+#include "util.h"
+
+#define N_UNITS 50000U
+
+static void benchmark(Manager *m, SerializationFormat format) {
+        _cleanup_fdset_free_ FDSet *fds = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        usec_t n, n2, n3;
+        off_t size;
+
+        m->serialization_format = format;
+
+        fds = fdset_new();
+        assert_se(fds);
+
+        f = tmpfile();
+        assert_se(f);
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(manager_serialize(m, f, fds, false) >= 0);
+        assert_se(fflush(f) == 0);
+        n2 = now(CLOCK_MONOTONIC);
+
+        size = ftello(f);
+        assert_se(fseeko(f, 0, SEEK_SET) == 0);
+
+        n3 = now(CLOCK_MONOTONIC);
+        assert_se(manager_deserialize(m, f, fds) >= 0);
+
+        log_info("%s: %u units, %llu bytes, serialized in %.1f ms, deserialized in %.1f ms",
+                 serialization_format_to_string(format), hashmap_size(m->units),
+                 (unsigned long long) size,
+                 (double) (n2 - n) / USEC_PER_MSEC,
+                 (double) (now(CLOCK_MONOTONIC) - n3) / USEC_PER_MSEC);
+}
+
+int main(int argc, char *argv[]) {
+        char dir[] = "/tmp/test-serialize-benchmark.XXXXXX";
+        Manager *m = NULL;
+        unsigned i;
+        int r;
+
+        log_set_max_level(LOG_INFO);
+
+        assert_se(mkdtemp(dir));
+        assert_se(set_unit_path(dir) >= 0);
+
+        r = manager_new(SYSTEMD_USER, true, &m);
+        if (IN_SET(r, -EPERM, -EACCES, -EADDRINUSE, -EHOSTDOWN, -ENOENT)) {
+                printf("Skipping test: manager_new: %s", strerror(-r));
+                rmdir(dir);
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        for (i = 0; i < N_UNITS; i++) {
+                char name[sizeof("bench-.service") + DECIMAL_STR_MAX(unsigned)];
+                Unit *u;
+
+                sprintf(name, "bench-%u.service", i);
+                assert_se(manager_load_unit(m, name, NULL, NULL, &u) >= 0);
+        }
+
+        benchmark(m, SERIALIZATION_TEXT);
+        benchmark(m, SERIALIZATION_BINARY);
+
+        manager_free(m);
+        rmdir(dir);
+
+        return 0;
+}
@@ -0,0 +1,171 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+
+#include "serialize.h"
+#include "time-util.h"
+#include "util.h"
+#include "macro.h"
+
+static void check_item(SerializeState *st, const char *key, const char *value) {
+        char *k, *v;
+
+        assert_se(deserialize_item(st, &k, &v) == 1);
+        assert_se(streq(k, key));
+        assert_se(streq(v, value));
+}
+
+static void test_format(SerializationFormat format) {
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_serialize_state_free_ SerializeState *st = NULL;
+        _cleanup_free_ char *big = NULL;
+        dual_timestamp t = { 4711, 815 }, u = {};
+        char *k, *v, *l;
+        unsigned i;
+
+        log_info("/* %s (%s) */", __func__, serialization_format_to_string(format));
+
+        big = malloc(LINE_MAX * 3);
+        assert_se(big);
+        memset(big, 'x', LINE_MAX * 3 - 1);
+        big[LINE_MAX * 3 - 1] = 0;
+
+        f = tmpfile();
+        assert_se(f);
+
+        assert_se(serialize_begin(f, format, &st) == 0);
+
+        serialize_item(st, "foo", "bar");
+        serialize_item_format(st, "number", "%u", 42U);
+        dual_timestamp_serialize(st, "timestamp", &t);
+        serialize_section_end(st);
+
+        for (i = 0; i < 3; i++) {
+                serialize_marker(st, "waldo.service");
+                serialize_item(st, "foo", "quux");
+                serialize_item(st, "empty", "");
+                serialize_section_end(st);
+        }
+
+        if (format == SERIALIZATION_BINARY)
+                serialize_item_format(st, "big", "%s", big);
+
+        st = serialize_state_free(st);
+
+        assert_se(fflush(f) == 0);
+        rewind(f);
+
+        assert_se(deserialize_begin(f, &st) == 0);
+
+        assert_se(deserialize_line(st, &l) == 1);
+        assert_se(streq(l, "foo=bar"));
+        check_item(st, "number", "42");
+        assert_se(deserialize_item(st, &k, &v) == 1);
+        assert_se(streq(k, "timestamp"));
+        dual_timestamp_deserialize(v, &u);
+        assert_se(u.realtime == t.realtime && u.monotonic == t.monotonic);
+        assert_se(deserialize_line(st, &l) == 1);
+        assert_se(streq(l, ""));
+
+        for (i = 0; i < 3; i++) {
+                check_item(st, "waldo.service", "");
+                check_item(st, "foo", "quux");
+                check_item(st, "empty", "");
+                check_item(st, "", "");
+        }
+
+        /* Only the binary format can carry arbitrarily long values */
+        if (format == SERIALIZATION_BINARY)
+                check_item(st, "big", big);
+
+        assert_se(deserialize_item(st, &k, &v) == 0);
+
+        st = serialize_state_free(st);
+}
+
+static void test_garbage(void) {
+        _cleanup_fclose_ FILE *f = NULL;
+        SerializeState *st = NULL;
+        char *k, *v;
+
+        f = tmpfile();
+        assert_se(f);
+
+        /* A key number that was never defined */
+        assert_se(fwrite("\377SDSRL\001\n\002\005\001x", 1, 12, f) == 12);
+        rewind(f);
+
+        assert_se(deserialize_begin(f, &st) == 0);
+        assert_se(deserialize_item(st, &k, &v) == -EBADMSG);
+        st = serialize_state_free(st);
+
+        /* Newer version */
+        rewind(f);
+        assert_se(fwrite("\377SDSRL\002\n", 1, 8, f) == 8);
+        rewind(f);
+        assert_se(deserialize_begin(f, &st) == -EPROTONOSUPPORT);
+}
+
+static void test_streams(void) {
+        _cleanup_fclose_ FILE *f = NULL, *g = NULL;
+        _cleanup_serialize_state_free_ SerializeState *a = NULL, *b = NULL;
+
+        /* Key numbers are per stream, even if written interleaved */
+
+        f = tmpfile();
+        g = tmpfile();
+        assert_se(f && g);
+
+        assert_se(serialize_begin(f, SERIALIZATION_BINARY, &a) == 0);
+        assert_se(serialize_begin(g, SERIALIZATION_BINARY, &b) == 0);
+
+        serialize_item(a, "foo", "a1");
+        serialize_item(b, "bar", "b1");
+        serialize_item(b, "foo", "b2");
+        serialize_item(a, "foo", "a2");
+
+        a = serialize_state_free(a);
+        b = serialize_state_free(b);
+
+        assert_se(fflush(f) == 0 && fflush(g) == 0);
+        rewind(f);
+        rewind(g);
+
+        assert_se(deserialize_begin(f, &a) == 0);
+        assert_se(deserialize_begin(g, &b) == 0);
+
+        check_item(b, "bar", "b1");
+        check_item(a, "foo", "a1");
+        check_item(a, "foo", "a2");
+        check_item(b, "foo", "b2");
+}
+
+int main(int argc, char *argv[]) {
+        log_set_max_level(LOG_DEBUG);
+
+        test_format(SERIALIZATION_TEXT);
+        test_format(SERIALIZATION_BINARY);
+        test_garbage();
+        test_streams();
+
+        return 0;
+}
@@ -0,0 +1,105 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#include "execute-helper.h"
+#include "strv.h"
+#include "util.h"
+
+#define N_SPAWN 200U
+
+/* Spawns /bin/true a number of times, the way a unit would, and
+ * reports the rate. The memory the test occupies to resemble a large
+ * PID 1 may be given in MiB as argument. */
+
+static void benchmark(const char *name, ExecHelper *h) {
+        ExecCommand command = {
+                .path = (char*) "/bin/true",
+                .argv = STRV_MAKE("/bin/true"),
+        };
+        ExecContext context = {};
+        ExecParameters params = {
+                .bus_endpoint_fd = -1,
+                .unit_id = "benchmark.service",
+                .exec_helper = h,
+        };
+        unsigned i;
+        usec_t n;
+
+        exec_context_init(&context);
+
+        n = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < N_SPAWN; i++) {
+                pid_t pid;
+
+                assert_se(exec_spawn(&command, &context, &params, NULL, &pid) >= 0);
+                assert_se(waitpid(pid, NULL, 0) == pid);
+        }
+
+        n = now(CLOCK_MONOTONIC) - n;
+
+        log_info("%s: %u processes in %.1f ms, %.0f/s",
+                 name, N_SPAWN, (double) n / USEC_PER_MSEC,
+                 (double) N_SPAWN * USEC_PER_SEC / n);
+}
+
+int main(int argc, char *argv[]) {
+        ExecHelper *h = NULL;
+        unsigned mib = 512;
+        size_t size, k;
+        char *p;
+        int r;
+
+        log_set_max_level(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &mib) >= 0);
+
+        /* Like PID 1 does, fork off the helper before growing */
+        r = exec_helper_new(&h);
+        if (r < 0) {
+                log_error("Failed to fork off exec helper: %s", strerror(-r));
+                return EXIT_TEST_SKIP;
+        }
+
+        size = (size_t) mib * 1024 * 1024;
+        p = malloc(size);
+        assert_se(p);
+
+        /* Make sure the memory is actually mapped */
+        for (k = 0; k < size; k += page_size())
+                p[k] = 1;
+
+        log_info("Occupying %u MiB.", mib);
+
+        benchmark("fork", NULL);
+        benchmark("helper", h);
+
+        exec_helper_free(h);
+        free(p);
+
+        return 0;
+}
@@ -271,6 +271,20 @@ static void test_strv_overlap(void) {
         assert_se(!strv_overlap((char **)input_table, (char**)input_table_unique));
 }
 
+static void test_strv_equal(void) {
+        const char * const a[] = { "one", "two", NULL };
+        const char * const b[] = { "one", "two", NULL };
+        const char * const c[] = { "one", "two", "three", NULL };
+        const char * const empty[] = { NULL };
+
+        assert_se(strv_equal((char**) a, (char**) b));
+        assert_se(!strv_equal((char**) a, (char**) c));
+        assert_se(!strv_equal((char**) c, (char**) a));
+        assert_se(!strv_equal((char**) a, NULL));
+        assert_se(strv_equal((char**) empty, NULL));
+        assert_se(strv_equal(NULL, NULL));
+}
+
 static void test_strv_sort(void) {
         const char* input_table[] = {
                 "durian",
@@ -456,6 +470,7 @@ int main(int argc, char *argv[]) {
         test_strv_split_nulstr();
         test_strv_parse_nulstr();
         test_strv_overlap();
+        test_strv_equal();
         test_strv_sort();
         test_strv_extend_strv();
         test_strv_extend_strv_concat();
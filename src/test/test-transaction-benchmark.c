@@ -0,0 +1,162 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "manager.h"
+#include "transaction.h"
+#include "bus-util.h"
+#include "util.h"
+
+#define N_PER_LINE 50U
+
+/* Writes a target pulling in n units. In the "ordered" graph each of
+ * them is ordered after its predecessor, which makes for a deep
+ * ordering graph. The "cyclic" graph additionally orders the first
+ * after the last unit, which the transaction has to break up. All
+ * units are part of the target, so that stopping it yields n
+ * redundant jobs to drop. Targets are used since they do not get a
+ * slice, so that loading stays cheap. */
+static void write_graph(const char *dir, const char *name, unsigned n, bool cyclic) {
+        _cleanup_fclose_ FILE *top = NULL;
+        char path[PATH_MAX], *p;
+        unsigned i;
+
+        p = strappenda(dir, "/", name, ".target");
+        top = fopen(p, "we");
+        assert_se(top);
+
+        fputs("[Unit]\n"
+              "DefaultDependencies=no\n", top);
+
+        for (i = 0; i < n; i++) {
+                _cleanup_fclose_ FILE *f = NULL;
+                char unit[strlen(name) + sizeof("--.target") + DECIMAL_STR_MAX(unsigned)];
+
+                sprintf(unit, "%s-%u.target", name, i);
+
+                snprintf(path, sizeof(path), "%s/%s", dir, unit);
+                f = fopen(path, "we");
+                assert_se(f);
+
+                fprintf(f,
+                        "[Unit]\n"
+                        "DefaultDependencies=no\n"
+                        "PartOf=%s.target\n", name);
+                if (i > 0)
+                        fprintf(f, "After=%s-%u.target\n", name, i - 1);
+                else if (cyclic)
+                        fprintf(f, "After=%s-%u.target\n", name, n - 1);
+
+                fprintf(top, "%s%s", i % N_PER_LINE == 0 ? "\nWants=" : " ", unit);
+        }
+
+        fputc('\n', top);
+}
+
+static int benchmark(const char *name, JobType type) {
+        _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+        Manager *m = NULL;
+        Transaction *tr;
+        Unit *target;
+        unsigned n_jobs;
+        usec_t n, n2;
+        char *id;
+        int r;
+
+        /* Each graph gets a manager of its own, since they do not
+         * all fit in one */
+        r = manager_new(SYSTEMD_USER, true, &m);
+        if (IN_SET(r, -EPERM, -EACCES, -EADDRINUSE, -EHOSTDOWN, -ENOENT)) {
+                printf("Skipping test: manager_new: %s", strerror(-r));
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        id = strappenda(name, ".target");
+        assert_se(manager_load_unit(m, id, NULL, NULL, &target) >= 0);
+
+        tr = transaction_new(false);
+        assert_se(tr);
+
+        n = now(CLOCK_MONOTONIC);
+        assert_se(transaction_add_job_and_dependencies(tr, type, target, NULL, true, false, false, false, false, &error) >= 0);
+        n_jobs = hashmap_size(tr->jobs);
+
+        n2 = now(CLOCK_MONOTONIC);
+        assert_se(transaction_activate(tr, m, JOB_REPLACE, &error) >= 0);
+
+        log_info("%s/%s: %u jobs, built in %.1f ms, activated in %.1f ms",
+                 name, job_type_to_string(type), n_jobs,
+                 (double) (n2 - n) / USEC_PER_MSEC,
+                 (double) (now(CLOCK_MONOTONIC) - n2) / USEC_PER_MSEC);
+
+        transaction_free(tr);
+        manager_free(m);
+
+        return 0;
+}
+
+int main(int argc, char *argv[]) {
+        static const unsigned sizes[] = { 1000, 10000, 100000 };
+        char dir[] = "/tmp/test-transaction-benchmark.XXXXXX";
+        char name[sizeof("ordered-") + DECIMAL_STR_MAX(unsigned)];
+        unsigned i;
+        int r = 0;
+
+        log_set_max_level(LOG_INFO);
+
+        assert_se(mkdtemp(dir));
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++) {
+                sprintf(name, "ordered-%u", sizes[i]);
+                write_graph(dir, name, sizes[i], false);
+
+                sprintf(name, "cyclic-%u", sizes[i]);
+                write_graph(dir, name, sizes[i], true);
+        }
+
+        assert_se(set_unit_path(dir) >= 0);
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++) {
+                sprintf(name, "ordered-%u", sizes[i]);
+                r = benchmark(name, JOB_START);
+                if (r != 0)
+                        break;
+
+                r = benchmark(name, JOB_STOP);
+                if (r != 0)
+                        break;
+
+                sprintf(name, "cyclic-%u", sizes[i]);
+                r = benchmark(name, JOB_START);
+                if (r != 0)
+                        break;
+        }
+
+        rm_rf_dangerous(dir, false, true, false);
+
+        return r;
+}
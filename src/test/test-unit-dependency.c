@@ -0,0 +1,143 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include "unit-dependency.h"
+#include "util.h"
+#include "macro.h"
+
+/* The table never dereferences the units, hence any distinct
+ * addresses will do */
+static char units[1000];
+#define UNIT(n) ((struct Unit*) (units + (n)))
+
+static void test_basic(void) {
+        UnitDependencies deps = {};
+        struct Unit *other;
+        uint32_t mask;
+        unsigned i, n;
+
+        assert_se(unit_dependencies_get(&deps, UNIT(0)) == 0);
+        assert_se(!unit_dependencies_remove(&deps, UNIT(0), UNIT_WANTS));
+
+        assert_se(unit_dependencies_add(&deps, UNIT(0), UNIT_WANTS) == 1);
+        assert_se(unit_dependencies_add(&deps, UNIT(0), UNIT_WANTS) == 0);
+        assert_se(unit_dependencies_add(&deps, UNIT(0), UNIT_AFTER) == 1);
+        assert_se(unit_dependencies_add(&deps, UNIT(1), UNIT_AFTER) == 1);
+
+        assert_se(deps.n_used == 2);
+        assert_se(deps.count[UNIT_WANTS] == 1);
+        assert_se(deps.count[UNIT_AFTER] == 2);
+        assert_se(unit_dependencies_get(&deps, UNIT(0)) ==
+                  (UNIT_DEPENDENCY_BIT(UNIT_WANTS) | UNIT_DEPENDENCY_BIT(UNIT_AFTER)));
+
+        n = 0;
+        UNIT_DEPENDENCIES_FOREACH(other, &deps, UNIT_AFTER, i) {
+                assert_se(other == UNIT(0) || other == UNIT(1));
+                n++;
+        }
+        assert_se(n == 2);
+
+        n = 0;
+        UNIT_DEPENDENCIES_FOREACH(other, &deps, UNIT_BEFORE, i)
+                n++;
+        assert_se(n == 0);
+
+        assert_se(unit_dependencies_remove(&deps, UNIT(0), UNIT_WANTS));
+        assert_se(!unit_dependencies_remove(&deps, UNIT(0), UNIT_WANTS));
+        assert_se(deps.n_used == 2);
+
+        assert_se(unit_dependencies_remove_all(&deps, UNIT(1)) == UNIT_DEPENDENCY_BIT(UNIT_AFTER));
+        assert_se(deps.n_used == 1);
+        assert_se(deps.count[UNIT_AFTER] == 1);
+
+        /* The freed slot is reused rather than appended */
+        assert_se(unit_dependencies_add(&deps, UNIT(2), UNIT_BEFORE) == 1);
+        assert_se(deps.n_entries == 2);
+
+        n = 0;
+        UNIT_DEPENDENCIES_FOREACH_ANY(other, mask, &deps, i) {
+                assert_se(mask == unit_dependencies_get(&deps, other));
+                n++;
+        }
+        assert_se(n == 2);
+
+        unit_dependencies_done(&deps);
+        assert_se(deps.n_used == 0);
+        assert_se(!deps.entries);
+}
+
+static void test_many(void) {
+        UnitDependencies deps = {};
+        struct Unit *other;
+        unsigned i, k, n;
+
+        /* Enough entries to switch to the index and grow it a few
+         * times */
+        for (k = 0; k < ELEMENTSOF(units); k++)
+                assert_se(unit_dependencies_add(&deps, UNIT(k), k % 2 ? UNIT_WANTS : UNIT_REQUIRES) == 1);
+
+        assert_se(deps.index);
+        assert_se(deps.index_size >= 2 * ELEMENTSOF(units));
+        assert_se(deps.count[UNIT_WANTS] == ELEMENTSOF(units) / 2);
+
+        for (k = 0; k < ELEMENTSOF(units); k++)
+                assert_se(unit_dependencies_get(&deps, UNIT(k)) ==
+                          UNIT_DEPENDENCY_BIT(k % 2 ? UNIT_WANTS : UNIT_REQUIRES));
+
+        /* Removing while iterating is fine */
+        UNIT_DEPENDENCIES_FOREACH(other, &deps, UNIT_WANTS, i)
+                if (((char*) other - units) % 3 == 0)
+                        assert_se(unit_dependencies_remove(&deps, other, UNIT_WANTS));
+
+        for (k = 0; k < ELEMENTSOF(units); k++) {
+                uint32_t mask = unit_dependencies_get(&deps, UNIT(k));
+
+                if (k % 2 == 0)
+                        assert_se(mask == UNIT_DEPENDENCY_BIT(UNIT_REQUIRES));
+                else if (k % 3 == 0)
+                        assert_se(mask == 0);
+                else
+                        assert_se(mask == UNIT_DEPENDENCY_BIT(UNIT_WANTS));
+        }
+
+        n = 0;
+        UNIT_DEPENDENCIES_FOREACH(other, &deps, UNIT_WANTS, i)
+                n++;
+        assert_se(n == deps.count[UNIT_WANTS]);
+
+        /* Everything can be found again after the removals shifted
+         * the index around */
+        for (k = 0; k < ELEMENTSOF(units); k++)
+                unit_dependencies_remove_all(&deps, UNIT(k));
+
+        assert_se(deps.n_used == 0);
+        for (k = 0; k < ELEMENTSOF(units); k++)
+                assert_se(unit_dependencies_get(&deps, UNIT(k)) == 0);
+
+        unit_dependencies_done(&deps);
+}
+
+int main(int argc, char *argv[]) {
+        test_basic();
+        test_many();
+
+        return 0;
+}
@@ -0,0 +1,297 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of systemd.
+
+  Copyright 2026 agent
+
+  systemd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  systemd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with systemd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "manager.h"
+#include "dbus-unit.h"
+#include "fileio.h"
+#include "util.h"
+#include "strv.h"
+#include "bus-util.h"
+
+/* Checks that GetAll() on a unit never returns a stale snapshot of
+ * its cached properties, by serving the Unit interface to a client
+ * over a socket pair, and changing each kind of cached property
+ * between two calls. */
+
+static void write_unit(const char *dir, const char *name, const char *contents) {
+        _cleanup_free_ char *p = NULL;
+
+        p = strjoin(dir, "/", name, NULL);
+        assert_se(p);
+        assert_se(write_string_file(p, contents) == 0);
+}
+
+static int unit_find(sd_bus *bus, const char *path, const char *interface, void *userdata, void **found, sd_bus_error *error) {
+        Manager *m = userdata;
+        Unit *u;
+        int r;
+
+        r = manager_load_unit_from_dbus_path(m, path, error, &u);
+        if (r < 0)
+                return 0;
+
+        *found = u;
+        return 1;
+}
+
+static int get_all_handler(sd_bus *bus, sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        sd_bus_message **reply = userdata;
+
+        assert_se(!sd_bus_message_is_method_error(m, NULL));
+        *reply = sd_bus_message_ref(m);
+
+        return 0;
+}
+
+static sd_bus_message *get_all(sd_bus *client, sd_bus *server, Unit *u) {
+        _cleanup_bus_message_unref_ sd_bus_message *m = NULL;
+        _cleanup_free_ char *path = NULL;
+        sd_bus_message *reply = NULL;
+
+        path = unit_dbus_path(u);
+        assert_se(path);
+
+        assert_se(sd_bus_message_new_method_call(client, &m, NULL, path, "org.freedesktop.DBus.Properties", "GetAll") >= 0);
+        assert_se(sd_bus_message_append(m, "s", "org.freedesktop.systemd1.Unit") >= 0);
+        assert_se(sd_bus_call_async(client, NULL, m, get_all_handler, &reply, 0) >= 0);
+
+        while (!reply) {
+                int r, q;
+
+                r = sd_bus_process(server, NULL);
+                assert_se(r >= 0);
+
+                q = sd_bus_process(client, NULL);
+                assert_se(q >= 0);
+
+                if (r == 0 && q == 0)
+                        assert_se(sd_bus_wait(client, 10 * USEC_PER_MSEC) >= 0);
+        }
+
+        return reply;
+}
+
+/* Positions the reply inside the value of the specified property */
+static void find_property(sd_bus_message *reply, const char *name, const char *contents) {
+        const char *member;
+
+        assert_se(sd_bus_message_rewind(reply, true) >= 0);
+        assert_se(sd_bus_message_enter_container(reply, 'a', "{sv}") > 0);
+
+        while (sd_bus_message_enter_container(reply, 'e', "sv") > 0) {
+                assert_se(sd_bus_message_read(reply, "s", &member) > 0);
+
+                if (streq(member, name)) {
+                        assert_se(sd_bus_message_enter_container(reply, 'v', contents) > 0);
+                        return;
+                }
+
+                assert_se(sd_bus_message_skip(reply, "v") >= 0);
+                assert_se(sd_bus_message_exit_container(reply) >= 0);
+        }
+
+        assert_not_reached("Property not found");
+}
+
+static uint32_t get_job_id(sd_bus *client, sd_bus *server, Unit *u) {
+        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        const char *path;
+        uint32_t id;
+
+        reply = get_all(client, server, u);
+        find_property(reply, "Job", "(uo)");
+        assert_se(sd_bus_message_read(reply, "(uo)", &id, &path) > 0);
+
+        return id;
+}
+
+static uint64_t get_condition_timestamp(sd_bus *client, sd_bus *server, Unit *u) {
+        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        uint64_t t;
+
+        reply = get_all(client, server, u);
+        find_property(reply, "ConditionTimestampMonotonic", "t");
+        assert_se(sd_bus_message_read(reply, "t", &t) > 0);
+
+        return t;
+}
+
+static char **get_strv(sd_bus *client, sd_bus *server, Unit *u, const char *name) {
+        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        char **l = NULL;
+
+        reply = get_all(client, server, u);
+        find_property(reply, name, "as");
+        assert_se(sd_bus_message_read_strv(reply, &l) >= 0);
+
+        return l;
+}
+
+static void test_order(sd_bus *client, sd_bus *server, Unit *u) {
+        _cleanup_bus_message_unref_ sd_bus_message *reply = NULL;
+        const sd_bus_vtable *v;
+        const char *member;
+
+        /* Cached and uncached properties come in vtable order */
+
+        reply = get_all(client, server, u);
+        assert_se(sd_bus_message_enter_container(reply, 'a', "{sv}") > 0);
+
+        for (v = bus_unit_vtable + 1; v->type != _SD_BUS_VTABLE_END; v++) {
+                if (v->type != _SD_BUS_VTABLE_PROPERTY && v->type != _SD_BUS_VTABLE_WRITABLE_PROPERTY)
+                        continue;
+
+                if (v->flags & SD_BUS_VTABLE_HIDDEN)
+                        continue;
+
+                assert_se(sd_bus_message_enter_container(reply, 'e', "sv") > 0);
+                assert_se(sd_bus_message_read(reply, "s", &member) > 0);
+                assert_se(streq(member, v->x.property.member));
+                assert_se(sd_bus_message_skip(reply, "v") >= 0);
+                assert_se(sd_bus_message_exit_container(reply) >= 0);
+        }
+
+        assert_se(sd_bus_message_exit_container(reply) >= 0);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_bus_error_free_ sd_bus_error error = SD_BUS_ERROR_NULL;
+        char dir[] = "/tmp/test-unit-property-cache.XXXXXX";
+        sd_bus *server = NULL, *client = NULL;
+        Unit *cond, *req, *dep, *ord, *missing, *merged;
+        _cleanup_strv_free_ char **l = NULL;
+        Manager *m = NULL;
+        sd_id128_t id;
+        int fds[2];
+        Job *j;
+        int r;
+
+        assert_se(mkdtemp(dir));
+
+        write_unit(dir, "cond.service",
+                   "[Unit]\n"
+                   "ConditionPathExists=/nonexistent\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(dir, "req.service",
+                   "[Unit]\n"
+                   "Requires=dep.service\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(dir, "dep.service",
+                   "[Unit]\n"
+                   "DefaultDependencies=no\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(dir, "ord.service",
+                   "[Unit]\n"
+                   "After=missing.service\n"
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+        write_unit(dir, "merged.service",
+                   "[Service]\n"
+                   "ExecStart=/bin/true\n");
+
+        assert_se(set_unit_path(dir) >= 0);
+        r = manager_new(SYSTEMD_USER, true, &m);
+        if (IN_SET(r, -EPERM, -EACCES, -EADDRINUSE, -EHOSTDOWN, -ENOENT)) {
+                printf("Skipping test: manager_new: %s", strerror(-r));
+                rm_rf_dangerous(dir, false, true, false);
+                return EXIT_TEST_SKIP;
+        }
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        assert_se(manager_load_unit(m, "cond.service", NULL, NULL, &cond) >= 0);
+        assert_se(manager_load_unit(m, "req.service", NULL, NULL, &req) >= 0);
+        assert_se(manager_load_unit(m, "ord.service", NULL, NULL, &ord) >= 0);
+        assert_se(manager_load_unit(m, "merged.service", NULL, NULL, &merged) >= 0);
+        dep = manager_get_unit(m, "dep.service");
+        assert_se(dep);
+        missing = manager_get_unit(m, "missing.service");
+        assert_se(missing);
+
+        /* Serve the units like on a private connection, so that the
+         * manager invalidates the snapshots on this bus */
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, fds) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&server) >= 0);
+        assert_se(sd_bus_set_fd(server, fds[0], fds[0]) >= 0);
+        assert_se(sd_bus_set_server(server, true, id) >= 0);
+        assert_se(sd_bus_set_anonymous(server, true) >= 0);
+        assert_se(sd_bus_add_fallback_vtable(server, NULL, "/org/freedesktop/systemd1/unit", "org.freedesktop.systemd1.Unit", bus_unit_vtable, unit_find, m) >= 0);
+        assert_se(sd_bus_start(server) >= 0);
+
+        assert_se(sd_bus_new(&client) >= 0);
+        assert_se(sd_bus_set_fd(client, fds[1], fds[1]) >= 0);
+        assert_se(sd_bus_start(client) >= 0);
+
+        assert_se(set_ensure_allocated(&m->private_buses, NULL) >= 0);
+        assert_se(set_put(m->private_buses, server) > 0);
+
+        test_order(client, server, ord);
+
+        /* Testing the conditions, even if the start is skipped */
+        assert_se(get_condition_timestamp(client, server, cond) == 0);
+        assert_se(unit_start(cond) == -EALREADY);
+        assert_se(get_condition_timestamp(client, server, cond) > 0);
+
+        /* Installing and removing a job */
+        assert_se(get_job_id(client, server, dep) == 0);
+        assert_se(manager_add_job(m, JOB_START, dep, JOB_REPLACE, false, &error, &j) >= 0);
+        assert_se(get_job_id(client, server, dep) == j->id);
+        job_finish_and_invalidate(j, JOB_CANCELED, false);
+        assert_se(get_job_id(client, server, dep) == 0);
+
+        /* Freeing a unit another one depends on */
+        l = get_strv(client, server, dep, "RequiredBy");
+        assert_se(strv_equal(l, STRV_MAKE("req.service")));
+        strv_free(l);
+        unit_free(req);
+        l = get_strv(client, server, dep, "RequiredBy");
+        assert_se(strv_isempty(l));
+        strv_free(l);
+
+        /* Merging a unit another one depends on */
+        l = get_strv(client, server, ord, "After");
+        assert_se(strv_contains(l, "missing.service"));
+        strv_free(l);
+        assert_se(unit_merge(merged, missing) >= 0);
+        l = get_strv(client, server, ord, "After");
+        assert_se(strv_contains(l, "merged.service"));
+        assert_se(!strv_contains(l, "missing.service"));
+
+        set_remove(m->private_buses, server);
+        sd_bus_unref(client);
+        sd_bus_unref(server);
+
+        manager_free(m);
+        rm_rf_dangerous(dir, false, true, false);
+
+        return 0;
+}